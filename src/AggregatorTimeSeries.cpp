@@ -13,7 +13,8 @@
 #include <boost/foreach.hpp>
 #include <boost/range/adaptors.hpp>
 #include <set>
-#include <future>
+
+#include "Executor.h"
 
 using namespace RTX;
 using namespace std;
@@ -77,6 +78,7 @@ void AggregatorTimeSeries::addSource(TimeSeries::_sp timeSeries, double multipli
   }
   
   _tsList.push_back((AggregatorSource){timeSeries,multiplier});
+  timeSeries->filterDidAddSource(share_me(this));
   this->invalidate();
 }
 
@@ -95,6 +97,7 @@ void AggregatorTimeSeries::removeSource(TimeSeries::_sp timeSeries) {
   }
   // save the new source list
   _tsList = newSourceList;
+  timeSeries->filterDidRemoveSource(share_me(this));
   
   this->invalidate();
 }
@@ -125,6 +128,14 @@ bool AggregatorTimeSeries::hasUpstreamSeries(TimeSeries::_sp other) {
   return false;
 }
 
+uint64_t AggregatorTimeSeries::clockVersion() {
+  uint64_t v = TimeSeries::clockVersion();
+  for (auto i : _tsList) {
+    v += i.timeseries->clockVersion();
+  }
+  return v;
+}
+
 std::vector<TimeSeries::_sp> AggregatorTimeSeries::rootTimeSeries() {
   std::vector<TimeSeries::_sp> roots;
   
@@ -182,8 +193,8 @@ time_t AggregatorTimeSeries::timeAfter(time_t time) {
 
 
 
-std::set<time_t> AggregatorTimeSeries::timeValuesInRange(TimeRange range) {
-  set<time_t> timeList;
+TimeList AggregatorTimeSeries::timeValuesInRange(TimeRange range) {
+  TimeList timeList;
   TimeRange netRange = range;
   bool hasLogged = false;
   for(AggregatorSource aggSource: this->sources()) {      
@@ -215,8 +226,7 @@ std::set<time_t> AggregatorTimeSeries::timeValuesInRange(TimeRange range) {
     // get the set of times from the aggregator sources
     if (netRange.isValid()) {
       for (auto aggSource : this->sources()) {
-        set<time_t> sourceTimes = aggSource.timeseries->timeValuesInRange(netRange);
-        timeList.insert(sourceTimes.begin(), sourceTimes.end());
+        timeList = TimeList::unionOf(timeList, aggSource.timeseries->timeValuesInRange(netRange));
       }
     }
   }
@@ -224,13 +234,13 @@ std::set<time_t> AggregatorTimeSeries::timeValuesInRange(TimeRange range) {
 }
 
 PointCollection AggregatorTimeSeries::filterPointsInRange(TimeRange range) {
-  set<time_t> droppedTimes;
   vector<Point> aggregated;
   double nSources = (double)(this->sources().size());
   
-  set<time_t> desiredTimes = this->timeValuesInRange(range);
+  TimeList desiredTimes = this->timeValuesInRange(range);
   
   // pre-load a vector of points.
+  aggregated.reserve(desiredTimes.size());
   for(time_t now: desiredTimes) {
     Point p(now); // default quality == bad
     
@@ -251,49 +261,51 @@ PointCollection AggregatorTimeSeries::filterPointsInRange(TimeRange range) {
   
   
   
-  // asynchronously get source series
-  vector< future< map< time_t, Point> > > aggSeriesData;
+  // fetch source series concurrently, on the shared executor. evaluating a source graph only writes to
+  // records and filter memos, which are locked, so sources that share upstream series may overlap freely.
   auto mySources = this->sources();
   auto mode = this->_mode;
-  for(AggregatorSource sd : mySources) {
+  Units myUnits = this->units();
+  vector<PointCollection> sourceData(mySources.size());
+  Executor::shared().parallelFor(mySources.size(), [&](size_t iSource) {
+    TimeSeries::_sp sourceTs = mySources[iSource].timeseries;
+    TimeRange componentRange = range;
+    componentRange.start = sourceTs->timeBefore(range.start + 1);
+    componentRange.end = sourceTs->timeAfter(range.end - 1);
+    componentRange.correctWithRange(range);
     
-    auto task = async(launch::deferred, [=]() -> map< time_t, Point> {
-      TimeSeries::_sp sourceTs = sd.timeseries;
-      double multiplier = sd.multiplier;
-      TimeRange componentRange = range;
-      componentRange.start = sourceTs->timeBefore(range.start + 1);
-      componentRange.end = sourceTs->timeAfter(range.end - 1);
-      componentRange.correctWithRange(range);
-      
-      PointCollection componentCollection = sourceTs->pointCollection(componentRange);
-      if (mode != AggregatorModeUnion) {
-        componentCollection.resample(desiredTimes);
-      }
-      componentCollection.convertToUnits(this->units());
-      
-      // make it easy to find any times that were dropped (bad points from a source series)
-      map<time_t, Point> sourcePointMap;
-      componentCollection.apply([&](Point& p){
-        sourcePointMap[p.time] = p * multiplier;
-      });
-      return sourcePointMap;
-    });
-    
-    aggSeriesData.push_back( std::move(task) ); //push_back;
-  }//for sourceDesc
+    PointCollection componentCollection = sourceTs->pointCollection(componentRange);
+    if (mode != AggregatorModeUnion) {
+      componentCollection.resample(desiredTimes);
+    }
+    componentCollection.convertToUnits(myUnits);
+    sourceData[iSource] = componentCollection;
+  });
   
   
   
-  set<time_t> unionSet;
+  // merge: every source is sorted by time, and so are the aggregated points.
+  // one cursor per source walks forward alongside the output, so there are no lookups.
+  vector<bool> dropped(aggregated.size(), false);
+  vector<bool> unionFilled(aggregated.size(), false);
   
-  for(auto &task : aggSeriesData) {
+  for (size_t iSource = 0; iSource < sourceData.size(); ++iSource) {
     
-    map<time_t, Point> sourcePointMap = task.get();
+    const PointCollection& source = sourceData[iSource];
+    const double multiplier = mySources[iSource].multiplier;
+    const time_t* sourceTime = source.timesBegin();
+    const time_t* sourceEnd = source.timesEnd();
+    PointCollection::pvIt sourcePoint = source.begin();
     
     // do the aggregation.
-    for(Point& p: aggregated) {
-      if (sourcePointMap.count(p.time) > 0) {
-        Point pointToAggregate = sourcePointMap[p.time]; // already multiplied
+    for (size_t i = 0; i < aggregated.size(); ++i) {
+      Point& p = aggregated[i];
+      while (sourceTime != sourceEnd && *sourceTime < p.time) {
+        ++sourceTime;
+        ++sourcePoint;
+      }
+      if (sourceTime != sourceEnd && *sourceTime == p.time) {
+        Point pointToAggregate = *sourcePoint * multiplier;
         
         switch (_mode) {
           case AggregatorModeSum:
@@ -322,9 +334,9 @@ PointCollection AggregatorTimeSeries::filterPointsInRange(TimeRange range) {
             break;
           case AggregatorModeUnion:
           {
-            if (unionSet.count(pointToAggregate.time) == 0) {
+            if (!unionFilled[i]) {
               p = pointToAggregate;
-              unionSet.insert(pointToAggregate.time);
+              unionFilled[i] = true;
             }
           }
             break;
@@ -335,7 +347,7 @@ PointCollection AggregatorTimeSeries::filterPointsInRange(TimeRange range) {
       }
       else {
         if (_mode != AggregatorModeUnion) {
-          droppedTimes.insert(p.time); // if any member is missing, then remove the point from the output
+          dropped[i] = true; // if any member is missing, then remove the point from the output
         }
       }
     }
@@ -343,9 +355,10 @@ PointCollection AggregatorTimeSeries::filterPointsInRange(TimeRange range) {
   
   // prune dropped points from aggregation result.
   vector<Point> goodPoints;
-  for(const Point& p: aggregated) {
-    if (droppedTimes.count(p.time) == 0) {
-      goodPoints.push_back(p);
+  goodPoints.reserve(aggregated.size());
+  for (size_t i = 0; i < aggregated.size(); ++i) {
+    if (!dropped[i]) {
+      goodPoints.push_back(aggregated[i]);
     }
   }
   
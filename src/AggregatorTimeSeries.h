@@ -68,6 +68,7 @@ namespace RTX {
     
     virtual bool hasUpstreamSeries(TimeSeries::_sp other);
     virtual std::vector<TimeSeries::_sp> rootTimeSeries();
+    virtual uint64_t clockVersion();
     
     // chainable
     AggregatorTimeSeries::_sp add(TimeSeries::_sp ts, double multiplier) {this->addSource(ts,multiplier); return share_me(this);};
@@ -75,7 +76,7 @@ namespace RTX {
     
   protected:
     PointCollection filterPointsInRange(TimeRange range);
-    std::set<time_t> timeValuesInRange(TimeRange range);
+    TimeList timeValuesInRange(TimeRange range);
     bool canSetSource(TimeSeries::_sp ts);
     void didSetSource(TimeSeries::_sp ts);
 
@@ -52,7 +52,7 @@ BaseStatsTimeSeries::StatsSamplingMode_t BaseStatsTimeSeries::samplingMode() {
   return _samplingMode;
 }
 
-BaseStatsTimeSeries::rangeGroup BaseStatsTimeSeries::subRanges(set<time_t> times) {
+BaseStatsTimeSeries::rangeGroup BaseStatsTimeSeries::subRanges(const TimeList& times) {
   rangeGroup group;
     
   if (times.size() == 0 || !this->window()) {
@@ -60,8 +60,8 @@ BaseStatsTimeSeries::rangeGroup BaseStatsTimeSeries::subRanges(set<time_t> times
   }
   
   TimeSeries::_sp sourceTs = this->source();
-  time_t fromTime = *(times.begin());
-  time_t toTime = *(times.rbegin());
+  time_t fromTime = times.front();
+  time_t toTime = times.back();
   
   time_t w = this->window()->period();
   
@@ -78,7 +78,7 @@ BaseStatsTimeSeries::rangeGroup BaseStatsTimeSeries::subRanges(set<time_t> times
   // force a pre-cache on the source time series
   group.retainedCollection = sourceTs->pointCollection(TimeRange(fromTime - t_lag, toTime + t_lead));
   
-  auto t1 = *(times.begin());
+  auto t1 = times.front();
   // make a fake range to prepopulate the scanning range subgroup thingy
   PointCollection::pvRange previousRange = group.retainedCollection.subRange(TimeRange(t1,t1));
   
@@ -74,7 +74,7 @@ namespace RTX {
     
   protected:
     virtual PointCollection filterPointsInRange(TimeRange range) = 0; // pure virtual. don't use this class directly.
-    rangeGroup subRanges(std::set<time_t> times);
+    rangeGroup subRanges(const TimeList& times);
     
   private:
     Clock::_sp _window;
@@ -8,9 +8,10 @@
 
 #include "BufferPointRecord.h"
 #include <iostream>
+#include <algorithm>
+#include <cmath>
 #include <thread>
 #include <mutex>
-#include <shared_mutex>
 
 #include "WhereClause.h"
 
@@ -21,6 +22,7 @@ using namespace std;
 
 BufferPointRecord::BufferPointRecord(int defaultCapacity) {
   _defaultCapacity = defaultCapacity;
+  _index.reset( new SeriesIndex() );
 }
 
 
@@ -35,28 +37,111 @@ std::ostream& BufferPointRecord::toStream(std::ostream &stream) {
 }
 
 
+#pragma mark - Columns
+
+BufferPointRecord::ColumnStore::ColumnStore(size_t slots) : times(slots), values(slots), qualities(slots), confidences(slots) {
+  
+}
+
+void BufferPointRecord::ColumnStore::set(size_t i, const Point& p) {
+  times[i] = p.time;
+  values[i] = p.value;
+  qualities[i] = p.quality;
+  confidences[i] = (float)p.confidence;
+}
+
+Point BufferPointRecord::PointColumns::at(size_t i) const {
+  // field-wise, so cached NaNs don't trip the constructor's logging
+  Point p;
+  p.time = store->times[begin + i];
+  p.value = store->values[begin + i];
+  p.quality = store->qualities[begin + i];
+  p.confidence = (double)store->confidences[begin + i];
+  p.isValid = !(std::isnan(p.value) || p.time == 0 || p.hasQual(Point::opc_bad));
+  return p;
+}
+
+size_t BufferPointRecord::PointColumns::lowerBound(time_t t) const {
+  if (this->empty()) {
+    return 0;
+  }
+  const time_t* first = this->times();
+  return std::lower_bound(first, first + this->size(), t) - first;
+}
+
+size_t BufferPointRecord::PointColumns::upperBound(time_t t) const {
+  if (this->empty()) {
+    return 0;
+  }
+  const time_t* first = this->times();
+  return std::upper_bound(first, first + this->size(), t) - first;
+}
+
+std::shared_ptr<BufferPointRecord::PointBuffer> BufferPointRecord::rebuilt(const std::vector<Point>& points, size_t capacity) {
+  // room to append about as many again before the next rebuild, but not more than twice the capacity
+  size_t n = points.size();
+  size_t slots = std::max(n, std::min(std::max(2 * n, (size_t)16), 2 * capacity));
+  std::shared_ptr<PointBuffer> next( new PointBuffer() );
+  next->capacity = capacity;
+  next->store.reset( new ColumnStore(slots) );
+  for (size_t i = 0; i < n; ++i) {
+    next->store->set(i, points[i]);
+  }
+  next->end = n;
+  return next;
+}
+
+std::vector<Point> BufferPointRecord::PointsView::points() const {
+  std::vector<Point> out;
+  out.reserve(this->size());
+  for (size_t i = _begin; i < _end; ++i) {
+    out.push_back(_columns->at(i));
+  }
+  return out;
+}
+
+
+#pragma mark - Index
+
+BufferPointRecord::SeriesHandle BufferPointRecord::series(const string& identifier) {
+  auto idx = this->index();
+  auto it = idx->find(identifier);
+  if (it == idx->end()) {
+    return SeriesHandle();
+  }
+  return it->second;
+}
+
+BufferPointRecord::BufferSnapshot BufferPointRecord::snapshot(const string& identifier) {
+  auto s = this->series(identifier);
+  if (!s) {
+    return BufferSnapshot();
+  }
+  return s->load();
+}
+
+
 bool BufferPointRecord::registerAndGetIdentifierForSeriesWithUnits(std::string recordName, Units units) {
-  // register the recordName internally and generate a buffer and mutex
-  std::lock_guard lock(_buffer_readwrite); // get a write lock
-  if (_keyedBuffers.find(recordName) != _keyedBuffers.end()) {
-    // got the name - do the units match?
-    Buffer b = _keyedBuffers[recordName];
-    if (b.units == units) {
-      // total match! use it.
-      return true;
-    }
-    else {
-      _keyedBuffers.erase(recordName);
-    }
+  // register the recordName internally and generate a buffer
+  std::lock_guard<std::mutex> lock(_indexWriteMutex);
+  auto current = this->index();
+  auto it = current->find(recordName);
+  if (it != current->end() && it->second->units == units) {
+    // total match! use it.
+    return true;
   }
   
-  // check to see that it's not there
-  if (_keyedBuffers.find(recordName) == _keyedBuffers.end()) {
-    Buffer b;
-    b.circularBuffer.set_capacity(_defaultCapacity);
-    b.units = units;
-    _keyedBuffers[recordName] = b;
-  }
+  // new name, or the units changed: publish a copy of the index with a fresh series in it.
+  SeriesHandle s( new Series() );
+  s->units = units;
+  std::shared_ptr<PointBuffer> empty( new PointBuffer() );
+  empty->capacity = _defaultCapacity;
+  s->publish(empty);
+  
+  std::shared_ptr<SeriesIndex> updated( new SeriesIndex(*current) );
+  (*updated)[recordName] = s;
+  std::atomic_store(&_index, std::shared_ptr<const SeriesIndex>(updated));
+  this->didCreateSeries(recordName);
   
   return true;
 }
@@ -64,109 +149,77 @@ bool BufferPointRecord::registerAndGetIdentifierForSeriesWithUnits(std::string r
 IdentifierUnitsList BufferPointRecord::identifiersAndUnits() {
   IdentifierUnitsList list;
   std::map<std::string,pair<Units,string> > *ids = list.get();
-  for (const auto &p : _keyedBuffers) {
-    (*ids)[p.first] = {p.second.units, p.second.units.to_string()};
+  for (const auto &p : *(this->index())) {
+    (*ids)[p.first] = {p.second->units, p.second->units.to_string()};
   }
   return list;
 }
 
+
+#pragma mark - Reads
+
 Point BufferPointRecord::point(const string& identifier, time_t time) {
   
-  Point bp = PointRecord::point(identifier,time);
-  if (bp.isValid) {
-    return bp;
-  }
-  
-  std::shared_lock lock(_buffer_readwrite); // get a read lock
-  
-  auto it = _keyedBuffers.find(identifier);
-  if (it == _keyedBuffers.end()) {
-    // nobody here by that name
-    return Point();
-  }
-  
-  // get the constituents
-  PointBuffer& buffer = (it->second.circularBuffer);
-  
-  if (buffer.empty()) {
-    return Point();
-  }
-  
-  Point pFirst = buffer.front();
-  Point pLast = buffer.back();
-  
-  if (pFirst.time <= time && time <= pLast.time) {
-    // search the buffer
-    Point finder(time, 0);
-    PointBuffer::iterator startIterator = buffer.begin();
-    PointBuffer::iterator pbIt = std::lower_bound(startIterator, buffer.end(), finder, &Point::comparePointTime);
-    if (pbIt != buffer.end() && pbIt->time == time) {
-      Point p = *pbIt;
-      PointRecord::addPoint(identifier, p);
-      return p;
-    }
-    else {
-      return Point();
+  auto snap = this->snapshot(identifier);
+  if (snap && !snap->empty()) {
+    const PointBuffer& buffer = *snap;
+    if (buffer.timeAt(0) <= time && time <= buffer.timeAt(buffer.size() - 1)) {
+      // search the buffer
+      size_t i = buffer.lowerBound(time);
+      if (i < buffer.size() && buffer.timeAt(i) == time) {
+        return buffer.at(i);
+      }
     }
   }
   
-  
-  return Point();
+  // only a miss takes the single-point cache's lock: addPoint and addSnapshot leave their points there
+  return PointRecord::point(identifier, time);
 }
 
 
 
 Point BufferPointRecord::pointBefore(const string& identifier, time_t time, WhereClause q) {
   
-  std::shared_lock lock(_buffer_readwrite); // get a read lock
-  
   Point foundPoint;
   
-  auto vRange = this->range(identifier);
+  auto snap = this->snapshot(identifier);
+  if (!snap || snap->empty()) {
+    return foundPoint;
+  }
+  const PointBuffer& buffer = *snap;
+  
+  TimeRange vRange(buffer.timeAt(0), buffer.timeAt(buffer.size() - 1));
   if (!vRange.contains(time)) {
     // don't bother if its' not in range
     return foundPoint;
   }
   
-  //TimePointPair_t finder(time, PointPair_t(0,0));
-  Point finder(time, 0);
+  size_t i = buffer.lowerBound(time);
+  if (i != 0) {
+    // we're not at the beginning, so there is a point before time
+    if (i != buffer.size()) {
+      // and we're not at the end, so the point is within the continuous buffer
+      // we want the previous point
+      foundPoint = buffer.at(--i);
+    }
+    else if (buffer.timeAt(--i) == time - 1) {
+      // edge case where end of buffer is adjacent to requested time
+      foundPoint = buffer.at(i);
+    }
+  }
   
-  auto it = _keyedBuffers.find(identifier);
-  if (it != _keyedBuffers.end()) {
-    // get the constituents
-    PointBuffer& buffer = (it->second.circularBuffer);
-    
-    PointBuffer::const_iterator it  = lower_bound(buffer.begin(), buffer.end(), finder, &Point::comparePointTime);
-    if (it != buffer.begin()) {
-      // we're not at the beginning, so there is a point before time
-      if (it != buffer.end()) {
-        // and we're not at the end, so the point is within the continuous buffer
-        // we want the previous point
-        foundPoint = *(--it);
-        PointRecord::addPoint(identifier, foundPoint);
-      }
-      else if ((--it)->time == time - 1) {
-        // edge case where end of buffer is adjacent to requested time
-        foundPoint = *it;
-        PointRecord::addPoint(identifier, foundPoint);
-      }
+  if (q.clauses.empty()) {
+    return foundPoint;
+  }
+  else {
+    // there is a clause! use the time-bound point to start looking back...
+    while (i != 0 && !q.filter(buffer.at(i))) {
+      --i;
     }
-    
-    if (q.clauses.empty()) {
+    if (i != 0) {
+      foundPoint = buffer.at(i);
       return foundPoint;
     }
-    else {
-      // there is a clause! use the time-bound point to start looking back...
-      while (it != buffer.begin() && !q.filter(*it)) {
-        --it;
-      }
-      if (it != buffer.begin()) {
-        foundPoint = *it;
-        PointRecord::addPoint(identifier, foundPoint);
-        return foundPoint;
-      }
-    }
-    
   }
   
   return foundPoint;
@@ -175,83 +228,67 @@ Point BufferPointRecord::pointBefore(const string& identifier, time_t time, Wher
 // pre-supposes that the time supplied is within my buffer.
 Point BufferPointRecord::pointAfter(const string& identifier, time_t time, WhereClause q) {
   
-  std::shared_lock lock(_buffer_readwrite); // get a read lock
-  
   Point foundPoint;
   
-  auto vRange = this->range(identifier);
+  auto snap = this->snapshot(identifier);
+  if (!snap || snap->empty()) {
+    return foundPoint;
+  }
+  const PointBuffer& buffer = *snap;
+  
+  TimeRange vRange(buffer.timeAt(0), buffer.timeAt(buffer.size() - 1));
   if (!vRange.contains(time)) {
     // don't bother if its' not in range
     return foundPoint;
   }
   
-  //TimePointPair_t finder(time, PointPair_t(0,0));
-  Point finder(time, 0);
+  size_t i = buffer.upperBound(time);
+  if (i != buffer.size()) {
+    // OK we're not at the end, so there is a point after time
+    if (i != 0 || (buffer.timeAt(i) == time + 1)) {
+      // exclude the first point of the buffer, since this means that the requested time is outside my range.
+      // either we're not at the beginning, so the point is within the continuous buffer -
+      // or edge case where beginning of buffer is adjacent to requested time
+      foundPoint = buffer.at(i);
+    }
+  }
   
-  auto it = _keyedBuffers.find(identifier);
-  if (it != _keyedBuffers.end()) {
-    // get the constituents
-    PointBuffer& buffer = (it->second.circularBuffer);
-    
-    PointBuffer::const_iterator it = upper_bound(buffer.begin(), buffer.end(), finder, &Point::comparePointTime);
-    if (it != buffer.end()) {
-      // OK we're not at the end, so there is a point after time
-      if (it != buffer.begin() || (it->time == time + 1)) {
-        // exclude the first point of the buffer, since this means that the requested time is outside my range.
-        // either we're not at the beginning, so the point is within the continuous buffer -
-        // or edge case where beginning of buffer is adjacent to requested time
-        foundPoint = *it;
-        PointRecord::addPoint(identifier, foundPoint); // single point cache layer
-      }
+  if (q.clauses.empty()) {
+    return foundPoint;
+  }
+  else {
+    // there is a clause! use the time-bound point to start looking back...
+    while (i != buffer.size() && !q.filter(buffer.at(i))) {
+      ++i;
     }
-    
-    if (q.clauses.empty()) {
+    if (i != buffer.size()) {
+      foundPoint = buffer.at(i);
       return foundPoint;
     }
-    else {
-      // there is a clause! use the time-bound point to start looking back...
-      while (it != buffer.end() && !q.filter(*it)) {
-        ++it;
-      }
-      if (it != buffer.end()) {
-        foundPoint = *it;
-        PointRecord::addPoint(identifier, foundPoint);
-        return foundPoint;
-      }
-    }
-    
   }
   
   return foundPoint;
 }
 
 
-std::vector<Point> BufferPointRecord::pointsInRange(const string& identifier, TimeRange range) {
-  
-  std::shared_lock lock(_buffer_readwrite); // get a read lock
-  
-  std::vector<Point> pointVector;
-  
-  //TimePointPair_t finder(startTime, PointPair_t(0,0));
-  Point finder(range.start, 0);
-  
-  auto it = _keyedBuffers.find(identifier);
-  if (it != _keyedBuffers.end()) {
-    // get the constituents
-    PointBuffer& buffer = (it->second.circularBuffer);
-    
-    PointBuffer::const_iterator it = lower_bound(buffer.begin(), buffer.end(), finder, &Point::comparePointTime);
-    while ( (it != buffer.end()) && (it->time <= range.end) ) {
-      Point newPoint = *it;
-      pointVector.push_back(newPoint);
-      it++;
-    }
+BufferPointRecord::PointsView BufferPointRecord::pointsView(const string& identifier, TimeRange range) {
+  PointsView view;
+  auto snap = this->snapshot(identifier);
+  if (snap) {
+    view._columns = snap;
+    view._begin = snap->lowerBound(range.start);
+    view._end = std::max(view._begin, snap->upperBound(range.end));
   }
-  
-  return pointVector;
+  return view;
+}
+
+std::vector<Point> BufferPointRecord::pointsInRange(const string& identifier, TimeRange range) {
+  return this->pointsView(identifier, range).points();
 }
 
 
+#pragma mark - Writes
+
 void BufferPointRecord::addPoint(const string& identifier, Point point) {
   
   PointRecord::addPoint(identifier, point);
@@ -268,150 +305,226 @@ void BufferPointRecord::addPoints(const string& identifier, std::vector<Point> p
     return;
   }
   
-  std::lock_guard lock(_buffer_readwrite); // get a write lock
+  auto s = this->series(identifier);
+  if (!s) {
+    //DebugLog << "keyed buffer not found for id: " << identifier << EOL;
+    return;
+  }
+  
+  std::lock_guard<std::mutex> lock(s->writeMutex); // single writer for this series
+  
+  // readers holding the old snapshot are unaffected: we only write storage past the end of every published window.
+  auto current = s->load();
+  const PointBuffer& buffer = *current;
   
   // check the cache size, and upgrade if needed.
-  auto it = _keyedBuffers.find(identifier);
-  if (it != _keyedBuffers.end()) {
-    PointBuffer& buffer = (it->second.circularBuffer);
-    size_t capacity = buffer.capacity();
-    if (capacity < points.size()) {
-      // plenty of room
-      buffer.set_capacity(points.size() + capacity);
+  size_t capacity = buffer.capacity;
+  if (capacity < points.size()) {
+    // plenty of room
+    capacity = points.size() + capacity;
+  }
+  
+  // make sure they're in order
+  std::sort(points.begin(), points.end(), &Point::comparePointTime);
+  
+  // figure out the insert order...
+  // if the set we're inserting has to be prepended to the buffer...
+  
+  time_t firstInsertionTime = points.front().time;
+  time_t lastInsertionTime = points.back().time;
+  
+  TimeRange existingRange = buffer.empty() ? TimeRange() : TimeRange(buffer.timeAt(0), buffer.timeAt(buffer.size() - 1));
+  
+  // more gap detection? right on!
+  bool hasPoints = !buffer.empty();
+  bool appending = hasPoints && (firstInsertionTime <= existingRange.end && existingRange.end < lastInsertionTime);
+  bool prepending = hasPoints && (firstInsertionTime < existingRange.start && existingRange.start <= lastInsertionTime);
+  bool overlapping = hasPoints && (existingRange.start <= firstInsertionTime && lastInsertionTime <= existingRange.end);
+  
+  if (!appending && !prepending && overlapping) {
+    // complete overlap -- why did we even try to add these?
+    if (capacity != buffer.capacity) {
+      std::shared_ptr<PointBuffer> next( new PointBuffer(buffer) ); // same window, no points copied
+      next->capacity = capacity;
+      s->publish(next);
     }
+    return;
+  }
+  
+  if (appending || prepending) {
+    // new points that fall outside the existing range, on either side
+    Point endFinder(existingRange.end, 0), startFinder(existingRange.start, 0);
+    auto appendBegin = appending ? upper_bound(points.begin(), points.end(), endFinder, &Point::comparePointTime) : points.end();
+    auto prependEnd = prepending ? lower_bound(points.begin(), points.end(), startFinder, &Point::comparePointTime) : points.begin();
+    size_t nAppend = points.end() - appendBegin;
+    size_t nPrepend = prependEnd - points.begin();
     
-    // figure out the insert order...
-    // if the set we're inserting has to be prepended to the buffer...
-    
-    time_t firstInsertionTime = points.front().time;
-    time_t lastInsertionTime = points.back().time;
-    
-    TimeRange existingRange = BufferPointRecord::range(identifier);
+    // circular-buffer semantics: appending past capacity drops the oldest points,
+    // then prepending past capacity drops the newest.
+    size_t nExisting = buffer.size();
+    size_t dropFront = (nExisting + nAppend > capacity) ? (nExisting + nAppend - capacity) : 0;
     
-    // make sure they're in order
-    std::sort(points.begin(), points.end(), &Point::comparePointTime);
+    if (nPrepend == 0 && dropFront <= nExisting && buffer.end + nAppend <= buffer.store->slots()) {
+      // the common case: write just the new points into the free tail, and widen the window over them
+      for (size_t i = 0; i < nAppend; ++i) {
+        buffer.store->set(buffer.end + i, *(appendBegin + i));
+      }
+      std::shared_ptr<PointBuffer> next( new PointBuffer(buffer) );
+      next->capacity = capacity;
+      next->begin = buffer.begin + dropFront;
+      next->end = buffer.end + nAppend;
+      s->publish(next);
+      return;
+    }
     
-    // scoped for clarity
-    {
-      // more gap detection? right on!
-      bool gap = true;
-      
-      if (firstInsertionTime <= existingRange.end && existingRange.end < lastInsertionTime) {
-        // some of these new points need to be inserted ono the end.
-        // fast-fwd along the new points vector, ignoring any points that will not be appended.
-        gap = false;
-        Point finder(existingRange.end, 0);
-        vector<Point>::const_iterator pIt = upper_bound(points.begin(), points.end(), finder, &Point::comparePointTime);
-        // now insert these trailing points.
-        while (pIt != points.end()) {
-          if (pIt->time > existingRange.end) {
-            //BufferPointRecord::addPoint(identifier, *pIt);
-            // append to circular buffer.
-            buffer.push_back(*pIt);
-          }
-          else {
-            cerr << "BufferPointRecord: inserted points not ordered correctly" << endl;
-          }
-          ++pIt;
-        }
-      } // appending
-      
-      if (firstInsertionTime < existingRange.start && existingRange.start <= lastInsertionTime) {
-        // some of the new points need to be pre-pended to the buffer.
-        // insert onto front (reverse iteration)
-        gap = false;
-        vector<Point>::const_reverse_iterator pIt = points.rbegin();
-
-        while (pIt != points.rend()) {
-          // make this smarter? using upper_bound maybe? todo - figure out upper_bound with a reverse_iterator
-          // skip overlapping points.
-          
-          if (pIt->time < existingRange.start) {
-            buffer.push_front(*pIt);
-          }
-          // else { /* skip */ }
-          
-          ++pIt;
-        }
-      } // prepending
-      
-      if (existingRange.start <= firstInsertionTime && lastInsertionTime <= existingRange.end) {
-        // complete overlap -- why did we even try to add these?
-        gap = false;
-      } // complete overlap
-      
-      // gap means that the points we're trying to insert do not overlap the existing points.
-      // therefore, there's no guarantee of contiguity. so our only option is to clear out the existing cache
-      // and insert the new points all by themselves.
-      if (gap) {
-        // clear the buffer and set the capacity to something more conservative.
-        buffer.clear();
-        buffer.set_capacity(points.size());
-        
-        // add new points.
-        for(const Point &p : points) {
-          buffer.push_back(p);
-        }
-      } // gap
-    }// scoped
-  }
-  //else {
-  //  DebugLog << "keyed buffer not found for id: " << identifier << EOL;
-  //}
+    // otherwise rebuild: [prepended] [existing, after dropFront] [appended, after any dropFront beyond existing]
+    size_t keptAfterAppend = nExisting + nAppend - dropFront;
+    size_t total = std::min(capacity, nPrepend + keptAfterAppend);
+    std::vector<Point> merged;
+    merged.reserve(total);
+    for (auto pIt = points.begin(); pIt != prependEnd && merged.size() < total; ++pIt) {
+      merged.push_back(*pIt);
+    }
+    for (size_t i = dropFront; i < nExisting && merged.size() < total; ++i) {
+      merged.push_back(buffer.at(i));
+    }
+    size_t skipAppend = (dropFront > nExisting) ? (dropFront - nExisting) : 0;
+    for (auto pIt = appendBegin + skipAppend; pIt != points.end() && merged.size() < total; ++pIt) {
+      merged.push_back(*pIt);
+    }
+    s->publish(rebuilt(merged, capacity));
+  }
+  else {
+    // gap means that the points we're trying to insert do not overlap the existing points.
+    // therefore, there's no guarantee of contiguity. so our only option is to clear out the existing cache
+    // and insert the new points all by themselves, with a more conservative capacity.
+    s->publish(rebuilt(points, points.size()));
+  }
 }
 
 
 
+void BufferPointRecord::mergePoints(const string& identifier, std::vector<Point> points) {
+  auto s = this->series(identifier);
+  if (!s || points.empty()) {
+    return;
+  }
+  
+  std::lock_guard<std::mutex> lock(s->writeMutex);
+  auto current = s->load();
+  const PointBuffer& buffer = *current;
+  if (buffer.empty()) {
+    return;
+  }
+  
+  // only inside the run is the buffer known to be contiguous, so only there can a point go in without a gap
+  time_t first = buffer.timeAt(0), last = buffer.timeAt(buffer.size() - 1);
+  std::stable_sort(points.begin(), points.end(), &Point::comparePointTime);
+  std::vector<Point> merged;
+  merged.reserve(buffer.size() + points.size());
+  size_t i = 0;
+  for (const Point& p : points) {
+    if (p.time < first || last < p.time) {
+      continue;
+    }
+    while (i < buffer.size() && buffer.timeAt(i) < p.time) {
+      merged.push_back(buffer.at(i++));
+    }
+    if (i < buffer.size() && buffer.timeAt(i) == p.time) {
+      ++i; // replaced
+    }
+    if (!merged.empty() && merged.back().time == p.time) {
+      merged.back() = p; // the later of two writes wins
+    }
+    else {
+      merged.push_back(p);
+    }
+  }
+  if (merged.empty()) {
+    return; // nothing landed inside
+  }
+  while (i < buffer.size()) {
+    merged.push_back(buffer.at(i++));
+  }
+  
+  // an interior insert rebuilds. past capacity, the oldest points go, as they would on an append.
+  if (merged.size() > buffer.capacity && buffer.capacity > 0) {
+    merged.erase(merged.begin(), merged.begin() + (merged.size() - buffer.capacity));
+  }
+  s->publish(rebuilt(merged, buffer.capacity));
+}
+
+
 void BufferPointRecord::reset() {
-  for (auto kb : _keyedBuffers) {
-    auto bufferName = kb.first;
-    auto buff = kb.second;
-    auto cb = kb.second.circularBuffer;
-    cb.clear();
+  for (const auto& kb : *(this->index())) {
+    SeriesHandle s = kb.second;
+    std::lock_guard<std::mutex> lock(s->writeMutex);
+    std::shared_ptr<PointBuffer> empty( new PointBuffer() );
+    empty->capacity = s->load()->capacity;
+    s->publish(empty);
   }
 }
 
 void BufferPointRecord::reset(const string& identifier) {
-  std::lock_guard lock(_buffer_readwrite); // get a write lock
-  auto it = _keyedBuffers.find(identifier);
-  if (it != _keyedBuffers.end()) {
-    PointBuffer& buffer = (it->second.circularBuffer);
-    buffer.clear();
+  auto s = this->series(identifier);
+  if (s) {
+    std::lock_guard<std::mutex> lock(s->writeMutex);
+    std::shared_ptr<PointBuffer> empty( new PointBuffer() );
+    empty->capacity = s->load()->capacity;
+    s->publish(empty);
   }
 }
 
+void BufferPointRecord::trimBefore(const string& identifier, time_t time) {
+  auto s = this->series(identifier);
+  if (!s) {
+    return;
+  }
+  std::lock_guard<std::mutex> lock(s->writeMutex);
+  auto current = s->load();
+  size_t upper = current->upperBound(time);
+  size_t first = (upper > 0) ? upper - 1 : 0;
+  if (first == 0) {
+    return;
+  }
+  if ((current->size() - first) * 4 < current->store->slots()) {
+    // mostly dead storage: copy what's left, so the memory actually goes
+    std::vector<Point> kept;
+    kept.reserve(current->size() - first);
+    for (size_t i = first; i < current->size(); ++i) {
+      kept.push_back(current->at(i));
+    }
+    s->publish(rebuilt(kept, current->capacity));
+    return;
+  }
+  std::shared_ptr<PointBuffer> next( new PointBuffer(*current) );
+  next->begin += first;
+  s->publish(next);
+}
+
 
 Point BufferPointRecord::firstPoint(const string& id) {
   Point foundPoint;
-  auto it = _keyedBuffers.find(id);
-  if (it != _keyedBuffers.end()) {
-    PointBuffer& buffer = (it->second.circularBuffer);
-    if (buffer.empty()) {
-      return foundPoint;
-    }
-    foundPoint = buffer.front(); // Point(tpPair.first, tpPair.second.first);
+  auto snap = this->snapshot(id);
+  if (snap && !snap->empty()) {
+    foundPoint = snap->at(0);
   }
   return foundPoint;
 }
 
 Point BufferPointRecord::lastPoint(const string& id) {
   Point foundPoint;
-  auto it = _keyedBuffers.find(id);
-  if (it != _keyedBuffers.end()) {
-    // get the constituents
-    PointBuffer& buffer = (it->second.circularBuffer);
-    
-    if (buffer.empty()) {
-      return foundPoint;
-    }
-    
-    //TimePointPair_t tpPair = buffer.back();
-    foundPoint = buffer.back(); // Point(tpPair.first, tpPair.second.first);
-    
+  auto snap = this->snapshot(id);
+  if (snap && !snap->empty()) {
+    foundPoint = snap->at(snap->size() - 1);
   }
   return foundPoint;
 }
 
 TimeRange BufferPointRecord::range(const string& id) {
-  return TimeRange(BufferPointRecord::firstPoint(id).time, BufferPointRecord::lastPoint(id).time);
+  auto snap = this->snapshot(id);
+  if (!snap || snap->empty()) {
+    return TimeRange(0,0);
+  }
+  return TimeRange(snap->timeAt(0), snap->timeAt(snap->size() - 1));
 }
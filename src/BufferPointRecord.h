@@ -21,20 +21,77 @@
 #include "rtxExceptions.h"
 #include "PointRecord.h"
 
-#include <boost/circular_buffer.hpp>
 #include <thread>
 #include <mutex>
-#include <shared_mutex>
+#include <memory>
+#include <unordered_map>
 
 using std::string;
 
 namespace RTX {
   
+  /*!
+   \class BufferPointRecord
+   \brief In-memory cache of recent points, one bounded buffer per series
+
+   Each buffer is kept sorted by time in separate column arrays (time, value, quality, confidence), so bound lookups are a binary search over a contiguous array of times. Confidence is cached at float precision. A cached point costs 21 bytes instead of the 32 of a Point. Like a circular buffer, each series has a capacity, and appending past it drops the oldest points.
+
+   Reads never block on writers. Each series publishes an immutable snapshot of its buffer, a window onto column storage that successive snapshots share. Readers load the current snapshot atomically and search their window. Writers append into storage past the end of every published window, then publish a wider window (RCU style), so an append only writes the new points. The storage is sized with room to spare; when it runs out, the live points are copied into fresh storage, which keeps appends amortized O(1) however large the capacity. Prepending, or a gap, rebuilds the buffer. Writers to the same series are serialized by that series' own mutex. The identifier index is a hash map published the same way, and only copied when a series is registered.
+
+   Buffer hits don't touch the single-point cache, which has a lock of its own. point() only falls back to it on a miss.
+
+   */
+  
   class BufferPointRecord : public PointRecord {
     
   public:
     
     RTX_BASE_PROPS(BufferPointRecord);
+    
+    //! fixed-size column storage. slots inside a published window are never written again; slots past every window may be.
+    class ColumnStore {
+    public:
+      ColumnStore(size_t slots);
+      std::vector<time_t> times;
+      std::vector<double> values;
+      std::vector<Point::PointQuality> qualities;
+      std::vector<float> confidences;
+      size_t slots() const { return times.size(); };
+      void set(size_t i, const Point& p);
+    };
+    
+    //! immutable, time-sorted window [begin, end) onto a series' storage
+    class PointColumns {
+    public:
+      std::shared_ptr<ColumnStore> store;
+      size_t begin = 0, end = 0;
+      size_t capacity = 0;
+      
+      size_t size() const { return end - begin; };
+      bool empty() const { return end == begin; };
+      Point at(size_t i) const;
+      time_t timeAt(size_t i) const { return store->times[begin + i]; };
+      const time_t* times() const { return store ? store->times.data() + begin : NULL; };
+      const double* values() const { return store ? store->values.data() + begin : NULL; };
+      size_t lowerBound(time_t t) const; // first index with time >= t
+      size_t upperBound(time_t t) const; // first index with time > t
+    };
+    
+    //! zero-copy view of a time range. keeps the underlying columns alive, so it stays valid while the buffer is rewritten.
+    class PointsView {
+    public:
+      size_t size() const { return _end - _begin; };
+      bool empty() const { return _end == _begin; };
+      Point operator[](size_t i) const { return _columns->at(_begin + i); };
+      const time_t* times() const { return _columns && _columns->store ? _columns->times() + _begin : NULL; };
+      const double* values() const { return _columns && _columns->store ? _columns->values() + _begin : NULL; };
+      std::vector<Point> points() const;
+    private:
+      friend class BufferPointRecord;
+      std::shared_ptr<const PointColumns> _columns;
+      size_t _begin = 0, _end = 0;
+    };
+    
     BufferPointRecord(int defaultCapacity = RTX_BUFFER_DEFAULT_CACHESIZE);
     virtual ~BufferPointRecord() {};
     
@@ -45,6 +102,7 @@ namespace RTX {
     virtual Point pointBefore(const string& identifier, time_t time, WhereClause q = WhereClause());
     virtual Point pointAfter(const string& identifier, time_t time, WhereClause q = WhereClause());
     virtual std::vector<Point> pointsInRange(const string& identifier, TimeRange range);
+    PointsView pointsView(const string& identifier, TimeRange range);
     virtual Point firstPoint(const string& id);
     virtual Point lastPoint(const string& id);
     virtual TimeRange range(const string& id);
@@ -54,22 +112,39 @@ namespace RTX {
     
     virtual void reset();
     virtual void reset(const string& identifier);
+    virtual void trimBefore(const string& identifier, time_t time); // drop older points, keeping the one in effect at `time`
     
     virtual std::ostream& toStream(std::ostream &stream);
     
     
   protected:
+    void mergePoints(const string& identifier, std::vector<Point> points); // into the buffered run: new times are inserted, equal times replaced. points outside the run are ignored.
+    virtual void didCreateSeries(const string& identifier) { }; // a fresh, empty buffer now stands for this identifier: it is new, or its units changed
     
   private:
-    typedef boost::circular_buffer<Point> PointBuffer;
-    class Buffer {
+    typedef PointColumns PointBuffer;
+    typedef std::shared_ptr<const PointBuffer> BufferSnapshot;
+    static std::shared_ptr<PointBuffer> rebuilt(const std::vector<Point>& points, size_t capacity); // into fresh storage
+    
+    class Series {
     public:
       Units units;
-      PointBuffer circularBuffer;
+      std::mutex writeMutex; // one writer at a time; readers never take it
+      BufferSnapshot load() const { return std::atomic_load(&_current); };
+      void publish(BufferSnapshot b) { std::atomic_store(&_current, b); };
+    private:
+      BufferSnapshot _current;
     };
-    std::map<std::string, Buffer> _keyedBuffers;
+    typedef std::shared_ptr<Series> SeriesHandle; // stable for the life of the registration
+    typedef std::unordered_map<std::string, SeriesHandle> SeriesIndex;
+    
+    SeriesHandle series(const string& identifier);
+    BufferSnapshot snapshot(const string& identifier);
+    std::shared_ptr<const SeriesIndex> index() const { return std::atomic_load(&_index); };
+    
+    std::shared_ptr<const SeriesIndex> _index;
+    std::mutex _indexWriteMutex;
     size_t _defaultCapacity;
-    std::shared_mutex _buffer_readwrite;
   };
   
   std::ostream& operator<< (std::ostream &out, BufferPointRecord &pr);
@@ -12,7 +12,7 @@
 
 using namespace RTX;
 
-Clock::Clock(int period, time_t start) : _name("") {
+Clock::Clock(int period, time_t start) : _name(""), _version(0) {
   if (period > 0) {
     _period = period;
     _isRegular = true;
@@ -95,6 +95,7 @@ void Clock::setPeriod(int p) {
   if (p > 0) {
     _isRegular = true;
   }
+  ++_version;
 }
 
 time_t Clock::start() {
@@ -103,6 +104,7 @@ time_t Clock::start() {
 
 void Clock::setStart(time_t startTime) {
   _start = startTime;
+  ++_version;
 }
 
 time_t Clock::validTime(time_t time) {
@@ -135,11 +137,15 @@ time_t Clock::timeAfter(time_t time) {
   }
 }
 
-std::set< time_t > Clock::timeValuesInRange(TimeRange range) {
-  std::set<time_t> timeList;
+TimeList Clock::timeValuesInRange(TimeRange range) {
   if (!isValid(range.start)) {
     range.start = timeAfter(range.start);
   }
+  if (_isRegular && _period > 0) {
+    size_t count = (range.start != 0 && range.start <= range.end) ? (size_t)((range.end - range.start) / _period) + 1 : 0;
+    return TimeList::regular(range.start, _period, count);
+  }
+  TimeList timeList;
   for (time_t thisTime = range.start; thisTime <= range.end; thisTime = timeAfter(thisTime)) {
     if (thisTime == 0) {
       break;
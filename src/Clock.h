@@ -10,10 +10,12 @@
 #define epanet_rtx_clock_h
 
 #include <time.h>
+#include <atomic>
 #include <vector>
 #include <set>
 #include "rtxMacros.h"
 #include "TimeRange.h"
+#include "TimeList.h"
 
 namespace RTX {
   
@@ -58,6 +60,10 @@ namespace RTX {
    \brief The starting point for the clock.
    \return A unix-time value for the clock's start position (offset from zero-time).
    
+   \fn uint64_t Clock::version()
+   \brief A counter that moves whenever the period or start changes.
+   \return The current version. Filters compare it to know whether time lists they remembered are still on this clock's grid.
+   
    \fn time_t Clock::timeAfter(time_t time)
    \brief The next time step in this clock's regular pattern.
    \param time A time value.
@@ -69,11 +75,10 @@ namespace RTX {
    \param time A time value.
    \return A unix-time value representing the previous step in the pattern.
    
-   \fn std::vector<time_t> Clock::timeValuesInRange(time_t start, time_t end)
+   \fn TimeList Clock::timeValuesInRange(TimeRange range)
    \brief Get a list of time values that are valid within a range.
-   \param start A range start time.
-   \param end A range end time.
-   \return A vector of time_t values that are valid for this clock within the specified range.
+   \param range The time range.
+   \return A TimeList of values that are valid for this clock within the specified range. Regular clocks return an arithmetic range, without allocating.
    
    */
   
@@ -103,7 +108,8 @@ namespace RTX {
     void setPeriod(int p);
     time_t start();
     void setStart(time_t startTime);
-    virtual std::set< time_t > timeValuesInRange(TimeRange range);
+    uint64_t version() { return _version; };
+    virtual TimeList timeValuesInRange(TimeRange range);
     virtual std::ostream& toStream(std::ostream &stream);
     
   private:
@@ -112,6 +118,7 @@ namespace RTX {
     int _period;
     bool _isRegular;
     std::string _name;
+    std::atomic<uint64_t> _version;
     
   };
   
@@ -23,6 +23,12 @@ std::string SqlitePointRecord::basePath() {
 void SqlitePointRecord::setBasePath(const std::string& path) {
   ((SqliteAdapter*)_adapter)->basePath = path;
 }
+bool SqlitePointRecord::clusteredStorage() {
+  return ((SqliteAdapter*)_adapter)->clusteredStorage;
+}
+void SqlitePointRecord::setClusteredStorage(bool clustered) {
+  ((SqliteAdapter*)_adapter)->clusteredStorage = clustered;
+}
 
 
 /***************************************************************************************/
@@ -17,6 +17,8 @@ namespace RTX {
     
     std::string basePath();
     void setBasePath(const std::string& path);
+    bool clusteredStorage();
+    void setClusteredStorage(bool clustered); // takes effect when the database file is created
     
     bool supportsQualifiedQuery() { return true; };
   };
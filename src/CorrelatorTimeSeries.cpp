@@ -74,13 +74,221 @@ void CorrelatorTimeSeries::setLagSeconds(int nSeconds) {
 
 #pragma mark - superclass overrides
 
-PointCollection CorrelatorTimeSeries::filterPointsInRange(TimeRange range) {
+// correlate the primary points against the secondary series shifted back in time by `shift` seconds.
+// the secondary is linearly resampled at the primary's times, the same way PointCollection::resample would,
+// and only the times where that succeeds are paired. returns false if there are fewer than two pairs.
+static bool __laggedCorrelation(PointCollection::pvRange primary, const PointCollection& secondary, time_t shift, double& corrcoef) {
+  const time_t* st = secondary.timesBegin();
+  const double* sv = secondary.valuesBegin();
+  const size_t n = secondary.count();
+  if (n == 0) {
+    return false;
+  }
   
-  PointCollection data(vector<Point>(), this->units());
-  if (!this->secondary() || !this->source()) {
-    return data;
+  accumulator_set<double, stats<tag::mean, tag::variance> > acc1;
+  accumulator_set<double, stats<tag::mean, tag::variance> > acc2;
+  accumulator_set<double, stats<tag::covariance<double, tag::covariate1> > > acc3;
+  size_t nPairs = 0;
+  size_t left = 0, right = 1;
+  
+  for (auto it = primary.first; it != primary.second; ++it) {
+    time_t now = it.time() + shift;
+    if (now < st[left]) {
+      continue;
+    }
+    while (right != n && st[right] <= now) {
+      ++left;
+      ++right;
+    }
+    double v2;
+    bool last = (right == n);
+    if (!last) {
+      if (st[left] == now) {
+        v2 = sv[left];
+      }
+      else {
+        double dv = sv[right] - sv[left];
+        v2 = sv[left] + dv * (now - st[left]) / (st[right] - st[left]);
+      }
+    }
+    else if (st[left] == now) {
+      v2 = sv[left];
+    }
+    else {
+      break;
+    }
+    double v1 = it.value();
+    acc1(v1);
+    acc2(v2);
+    acc3(v1, covariate1 = v2);
+    ++nPairs;
+    if (last) {
+      break;
+    }
+  }
+  
+  if (nPairs < 2) {
+    return false;
+  }
+  corrcoef = covariance(acc3)/sqrt(variance(acc1))/sqrt(variance(acc2));
+  return true;
+}
+
+
+// resample the secondary onto a regular grid g0 + j*period, j in [jBegin, jBegin + y.size()), with the same
+// linear interpolation as __laggedCorrelation. only the contiguous run [yLo,yHi] inside the secondary's
+// time span is usable. returns false if no grid point is.
+static bool __resampleOntoGrid(const PointCollection& secondary, time_t g0, time_t period, long jBegin, vector<double>& y, long& yLo, long& yHi) {
+  const time_t* st = secondary.timesBegin();
+  const double* sv = secondary.valuesBegin();
+  const size_t n = secondary.count();
+  yLo = 1;
+  yHi = 0;
+  if (n == 0) {
+    return false;
+  }
+  size_t left = 0, right = 1;
+  for (size_t j = 0; j < y.size(); ++j) {
+    time_t now = g0 + (jBegin + (long)j) * period;
+    if (now < st[0]) {
+      continue;
+    }
+    while (right != n && st[right] <= now) {
+      ++left;
+      ++right;
+    }
+    if (st[left] == now) {
+      y[j] = sv[left];
+    }
+    else if (right != n) {
+      double dv = sv[right] - sv[left];
+      y[j] = sv[left] + dv * (now - st[left]) / (st[right] - st[left]);
+    }
+    else {
+      break; // past the end
+    }
+    if (yLo > yHi) {
+      yLo = jBegin + (long)j;
+    }
+    yHi = jBegin + (long)j;
   }
+  return yLo <= yHi;
+}
+
+// visit the correlation coefficient at every candidate lag for each sample time. candidate shifts are the
+// distances from a sample time to the primary's own times within maxLag, and each sample's shifts are
+// visited in descending order.
+//
+// if the primary is on a regular grid, the secondary is resampled onto that grid once and each lag is
+// evaluated for all samples at once from prefix sums, so the cost is O(lags * (points + samples)) rather
+// than O(samples * lags * window). samples off the grid take the exact per-lag path.
+static void __correlateLags(const PointCollection& primary, const PointCollection& secondary, const TimeList& sampleTimes, time_t window, time_t maxLag, function<void(size_t iSample, time_t shift, double corrcoef)> visit) {
+  
+  const time_t* pt = primary.timesBegin();
+  const double* pv = primary.valuesBegin();
+  const long N = (long)primary.count();
   
+  time_t g0 = 0, period = 0;
+  if (N > 1) {
+    g0 = pt[0];
+    period = pt[1] - pt[0];
+    for (long i = 2; i < N && period > 0; ++i) {
+      if (pt[i] - pt[i-1] != period) {
+        period = 0; // not regular
+      }
+    }
+  }
+  
+  vector<size_t> offGrid;
+  vector<pair<size_t, long> > onGrid; // sample index, grid index of the sample time
+  for (size_t s = 0; s < sampleTimes.size(); ++s) {
+    time_t t = sampleTimes[s];
+    if (period > 0 && t >= g0 && (t - g0) % period == 0 && (t - g0) / period < N) {
+      onGrid.push_back(make_pair(s, (long)((t - g0) / period)));
+    }
+    else {
+      offGrid.push_back(s);
+    }
+  }
+  
+  for (size_t s : offGrid) {
+    time_t t = sampleTimes[s];
+    // views into the prefetched primary data -- nothing is copied per sample or per lag.
+    PointCollection::pvRange sourceRange = primary.subRange(TimeRange(t - window, t));
+    PointCollection::pvRange lagEvaluationRange = primary.subRange(TimeRange(t - maxLag, t + maxLag));
+    for (auto lagIt = lagEvaluationRange.first; lagIt != lagEvaluationRange.second; ++lagIt) {
+      time_t shift = t - lagIt.time();
+      double corrcoef;
+      if (__laggedCorrelation(sourceRange, secondary, shift, corrcoef)) {
+        visit(s, shift, corrcoef);
+      }
+    }
+  }
+  
+  if (onGrid.empty()) {
+    return;
+  }
+  
+  const long K = (long)(maxLag / period);
+  const long W = (long)(window / period);
+  
+  // resample once, far enough out for every lag
+  vector<double> y(N + 2 * K, 0.);
+  long yLo, yHi;
+  if (!__resampleOntoGrid(secondary, g0, period, -K, y, yLo, yHi)) {
+    return;
+  }
+  
+  // center both series so the prefix sums don't swamp the windowed ones
+  double xBar = 0, yBar = 0;
+  for (long i = 0; i < N; ++i) {
+    xBar += pv[i];
+  }
+  xBar /= (double)N;
+  for (long j = yLo; j <= yHi; ++j) {
+    yBar += y[j + K];
+  }
+  yBar /= (double)(yHi - yLo + 1);
+  
+  vector<double> x(N), sx(N + 1, 0.), sxx(N + 1, 0.), sy(N + 1), syy(N + 1), sxy(N + 1);
+  for (long i = 0; i < N; ++i) {
+    x[i] = pv[i] - xBar;
+    sx[i+1] = sx[i] + x[i];
+    sxx[i+1] = sxx[i] + x[i] * x[i];
+  }
+  
+  for (long k = K; k >= -K; --k) {
+    // pairs (x[i], y[i+k]) are usable for i in [yLo - k, yHi - k]
+    sy[0] = syy[0] = sxy[0] = 0;
+    for (long i = 0; i < N; ++i) {
+      long j = i + k;
+      double yv = (j >= yLo && j <= yHi) ? y[j + K] - yBar : 0.;
+      sy[i+1] = sy[i] + yv;
+      syy[i+1] = syy[i] + yv * yv;
+      sxy[i+1] = sxy[i] + x[i] * yv;
+    }
+    for (auto& sample : onGrid) {
+      long iT = sample.second;
+      if (iT - k < 0 || iT - k >= N) {
+        continue; // no primary point at this distance
+      }
+      long lo = max(max(iT - W, 0L), yLo - k);
+      long hi = min(iT, yHi - k);
+      if (hi - lo + 1 < 2) {
+        continue;
+      }
+      double n = (double)(hi - lo + 1);
+      double Sx = sx[hi+1] - sx[lo], Sy = sy[hi+1] - sy[lo];
+      double cov = (sxy[hi+1] - sxy[lo]) - Sx * Sy / n;
+      double varX = (sxx[hi+1] - sxx[lo]) - Sx * Sx / n;
+      double varY = (syy[hi+1] - syy[lo]) - Sy * Sy / n;
+      visit(sample.first, k * period, cov / sqrt(varX) / sqrt(varY));
+    }
+  }
+}
+
+
+void CorrelatorTimeSeries::fetchCollections(TimeRange range, PointCollection& primary, PointCollection& secondary) {
   // force pre-cache
   TimeRange preFetchRange(range.start - this->correlationWindow()->period(), range.end + _lagSeconds);
   TimeRange correlatorFetchRange = preFetchRange;
@@ -92,99 +300,63 @@ PointCollection CorrelatorTimeSeries::filterPointsInRange(TimeRange range) {
   correlatorFetchRange.end = this->secondary()->timeAfter(correlatorNext - 1);
   correlatorFetchRange.correctWithRange(TimeRange(correlatorPrior,correlatorNext)); // get rid of zero-range
   
-  PointCollection m_primaryCollection = this->source()->pointCollection(preFetchRange);
-  PointCollection m_secondaryCollection = this->secondary()->pointCollection(correlatorFetchRange);
-  m_secondaryCollection.convertToUnits(m_primaryCollection.units);
+  primary = this->source()->pointCollection(preFetchRange);
+  secondary = this->secondary()->pointCollection(correlatorFetchRange);
+  secondary.convertToUnits(primary.units);
+}
+
+
+PointCollection CorrelatorTimeSeries::filterPointsInRange(TimeRange range) {
+  
+  PointCollection data(vector<Point>(), this->units());
+  if (!this->secondary() || !this->source()) {
+    return data;
+  }
   
-  TimeSeries::_sp sourceTs = this->source();
-  time_t windowWidth = this->correlationWindow()->period();
+  PointCollection m_primaryCollection, m_secondaryCollection;
+  this->fetchCollections(range, m_primaryCollection, m_secondaryCollection);
   
-  set<time_t> sampleTimes;
+  TimeList sampleTimes;
   if (this->clock()) {
     sampleTimes = this->clock()->timeValuesInRange(range);
   }
   else {
     sampleTimes = m_primaryCollection.trimmedToRange(range).times(); //this->timeValuesInRange(range);
   }
-  vector<Point> thePoints;
-  thePoints.reserve(sampleTimes.size());
   
-  for(time_t t : sampleTimes) {
-    double corrcoef = 0;
-    TimeRange q(t-windowWidth, t);
-    PointCollection sourceCollection = m_primaryCollection.trimmedToRange(q); //sourceTs->pointCollection(q);
-    
-    set<time_t> sourceTimeValues = sourceCollection.times();
-    
-    set<time_t> lagEvaluationTimes = m_primaryCollection.trimmedToRange(TimeRange(t - _lagSeconds, t + _lagSeconds)).times();
-    if (lagEvaluationTimes.size() == 0) {
-      continue; // next time.
-    }
-    
-    pair<double, int> maxCorrelationAtLaggedTime(-MAXFLOAT,0);
-    
-    for(time_t lagTime : lagEvaluationTimes) {
-      
-      int timeDistance = (int)(t - lagTime);
-      PointCollection sourceCollectionForAnalysis = sourceCollection;
-      PointCollection secondaryCollection = m_secondaryCollection;
-      // perform a time lag on the secondary points if needed.
-      if (timeDistance != 0) {
-        auto pv = secondaryCollection.points();
-        for (Point &p : pv) {
-          p.time -= timeDistance;
-        }          
-        secondaryCollection.setPoints(pv);
-      }
-      
-      // resample secondary points for the correlation analysis.
-      secondaryCollection.resample(sourceCollection.times());
-      
-      if (secondaryCollection.count() < 2) {
-        continue;
-      }
-      // trim points on primary?
-      if (secondaryCollection.count() != sourceCollectionForAnalysis.count()) {
-        sourceCollectionForAnalysis.resample(secondaryCollection.times());
-      }
-      
-      if (secondaryCollection.count() != sourceCollectionForAnalysis.count()) {
-        continue; // skip this. something is wrong.
-      }
-      
-      // do the correlation calculation.
-      
-      accumulator_set<double, stats<tag::mean, tag::variance> > acc1;
-      accumulator_set<double, stats<tag::mean, tag::variance> > acc2;
-      accumulator_set<double, stats<tag::covariance<double, tag::covariate1> > > acc3;
-      auto sca = sourceCollectionForAnalysis.points();
-      auto sc = secondaryCollection.points();
-      for (int i = 0; i < sourceCollectionForAnalysis.count(); i++) {
-        Point p1 = sca.at(i);
-        Point p2 = sc.at(i);
-        acc1(p1.value);
-        acc2(p2.value);
-        acc3(p1.value, covariate1 = p2.value);
-      }
-      corrcoef = covariance(acc3)/sqrt(variance(acc1))/sqrt(variance(acc2));
-      
-      if (corrcoef > maxCorrelationAtLaggedTime.first) {
-        maxCorrelationAtLaggedTime.first = corrcoef;
-        maxCorrelationAtLaggedTime.second = timeDistance;
-      }
-      
+  // running maximum per sample: (correlation, lag)
+  vector<pair<double, time_t> > maxCorrelationAtLaggedTime(sampleTimes.size(), make_pair(-MAXFLOAT, 0));
+  __correlateLags(m_primaryCollection, m_secondaryCollection, sampleTimes, this->correlationWindow()->period(), _lagSeconds, [&](size_t iSample, time_t shift, double corrcoef) {
+    if (corrcoef > maxCorrelationAtLaggedTime[iSample].first) {
+      maxCorrelationAtLaggedTime[iSample] = make_pair(corrcoef, shift);
     }
-    
-    
-    if (maxCorrelationAtLaggedTime.first > -MAXFLOAT) {
-      thePoints.push_back(Point(t,maxCorrelationAtLaggedTime.first, Point::opc_rtx_override, (double)(maxCorrelationAtLaggedTime.second)));
+  });
+  
+  vector<Point> thePoints;
+  thePoints.reserve(sampleTimes.size());
+  for (size_t i = 0; i < sampleTimes.size(); ++i) {
+    if (maxCorrelationAtLaggedTime[i].first > -MAXFLOAT) {
+      thePoints.push_back(Point(sampleTimes[i], maxCorrelationAtLaggedTime[i].first, Point::opc_rtx_override, (double)(maxCorrelationAtLaggedTime[i].second)));
     }
-    
   }
   
   return PointCollection(thePoints, RTX_DIMENSIONLESS);
 }
 
+map<int, double> CorrelatorTimeSeries::lagCurve(time_t time) {
+  map<int, double> curve;
+  if (!this->secondary() || !this->source() || !this->correlationWindow()) {
+    return curve;
+  }
+  
+  PointCollection primary, secondary;
+  this->fetchCollections(TimeRange(time, time), primary, secondary);
+  __correlateLags(primary, secondary, TimeList({time}), this->correlationWindow()->period(), _lagSeconds, [&](size_t iSample, time_t shift, double corrcoef) {
+    curve[(int)shift] = corrcoef;
+  });
+  return curve;
+}
+
 bool CorrelatorTimeSeries::canSetSource(TimeSeries::_sp ts) {
   if (this->secondary() && !ts->units().isSameDimensionAs(this->secondary()->units())) {
     return false;
@@ -12,6 +12,7 @@
 #include "TimeSeriesFilterSecondary.h"
 
 #include <iostream>
+#include <map>
 
 
 namespace RTX {
@@ -33,6 +34,9 @@ namespace RTX {
     int lagSeconds();
     void setLagSeconds(int nSeconds);
     
+    ///! the full lag curve behind a single point: correlation coefficient keyed by lag (in seconds), for every lag evaluated at that time.
+    std::map<int, double> lagCurve(time_t time);
+    
     // chainable
     CorrelatorTimeSeries::_sp window(Clock::_sp w) {this->setCorrelationWindow(w); return share_me(this);};
     CorrelatorTimeSeries::_sp lag(int seconds) {this->setLagSeconds(seconds); return share_me(this);};
@@ -46,6 +50,7 @@ namespace RTX {
     bool canChangeToUnits(Units units);
     
   private:
+    void fetchCollections(TimeRange range, PointCollection& primary, PointCollection& secondary);
     Clock::_sp _corWindow;
     int _lagSeconds;
   };
@@ -51,7 +51,7 @@ PointCollection CurveFunction::filterPointsInRange(RTX::TimeRange range) {
   }
   
   if (this->willResample()) {
-    set<time_t> resTimes = this->timeValuesInRange(range);
+    TimeList resTimes = this->timeValuesInRange(range);
     output.resample(resTimes);
   }
   
@@ -4,6 +4,7 @@
 #include <boost/atomic.hpp>
 #include <mutex>
 #include <vector>
+#include <map>
 #include <functional>
 
 #include "Point.h"
@@ -32,6 +33,7 @@ namespace RTX {
     };
     
     typedef std::function<void(const std::string)> errCallback_t;
+    typedef size_t seriesHandle_t;
     
     DbAdapter( errCallback_t cb ) : _errCallback(cb) { };
     virtual ~DbAdapter() { };
@@ -55,16 +57,68 @@ namespace RTX {
     virtual std::map<std::string, std::vector<Point> > wideQuery(TimeRange range) { return std::map<std::string, std::vector<Point> >(); };
     
     // READ
+    // throw if the store could not answer. an empty result means there is no data, and the record remembers it.
     virtual std::vector<Point> selectRange(const std::string& id, TimeRange range) = 0;
     virtual Point selectNext(const std::string& id, time_t time, WhereClause q = WhereClause()) = 0;
     virtual Point selectPrevious(const std::string& id, time_t time, WhereClause q = WhereClause()) = 0;
     virtual std::vector<Point> selectWithQuery(const std::string& query, TimeRange range) { return std::vector<Point>(); };
     
+    // READ -- BATCHED
+    // many series in one round trip. results are keyed by the ids passed in; series with nothing to return are left out.
+    // the defaults fall back to one query per series; adapters override with something native.
+    virtual std::map<std::string, std::vector<Point> > selectRanges(const std::vector<std::string>& ids, TimeRange range) {
+      std::map<std::string, std::vector<Point> > out;
+      for (const std::string& id : ids) {
+        std::vector<Point> points = this->selectRange(id, range);
+        if (!points.empty()) {
+          out[id] = points;
+        }
+      }
+      return out;
+    };
+    virtual std::map<std::string, Point> selectPreviousMany(const std::vector<std::string>& ids, time_t time) {
+      std::map<std::string, Point> out;
+      for (const std::string& id : ids) {
+        Point p = this->selectPrevious(id, time);
+        if (p.isValid) {
+          out[id] = p;
+        }
+      }
+      return out;
+    };
+    
     // CREATE
     virtual bool insertIdentifierAndUnits(const std::string& id, Units units) = 0;
     virtual void insertSingle(const std::string& id, Point point) = 0;
     virtual void insertRange(const std::string& id, std::vector<Point> points) = 0;
     
+    // CREATE -- SNAPSHOTS
+    // resolve an identifier once, then insert many series at a single time by handle.
+    // the defaults fall back to insertSingle; adapters override with something native.
+    virtual seriesHandle_t resolveSeriesHandle(const std::string& id) {
+      std::lock_guard<std::mutex> lock(_dbMtx);
+      auto found = _snapshotHandles.find(id);
+      if (found != _snapshotHandles.end()) {
+        return found->second;
+      }
+      _snapshotIds.push_back(id);
+      return _snapshotHandles[id] = _snapshotIds.size() - 1;
+    };
+    virtual void insertSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values) {
+      std::vector<std::string> ids;
+      {
+        std::lock_guard<std::mutex> lock(_dbMtx);
+        for (auto h : handles) {
+          ids.push_back(h < _snapshotIds.size() ? _snapshotIds[h] : "");
+        }
+      }
+      for (size_t i = 0; i < ids.size() && i < values.size(); ++i) {
+        if (!ids[i].empty()) {
+          this->insertSingle(ids[i], Point(time, values[i]));
+        }
+      }
+    };
+    
     // UPDATE
     virtual bool assignUnitsToRecord(const std::string& name, const Units& units) = 0;
     
@@ -77,6 +131,8 @@ namespace RTX {
     boost::atomic<bool> _connected;
     std::mutex _dbMtx;
     std::function<void(const std::string errMsg)> _errCallback;
+    std::vector<std::string> _snapshotIds;
+    std::map<std::string, seriesHandle_t> _snapshotHandles; // by id, so resolving a series again reuses its handle
     
     
   };
@@ -15,6 +15,10 @@
 #include <thread>
 #include <mutex>
 #include <shared_mutex>
+#include <algorithm>
+#include <limits>
+#include <future>
+#include <list>
 
 #include "DbPointRecord.h"
 #include "DbAdapter.h"
@@ -26,24 +30,95 @@ using namespace std;
 #define SERIES_LIST_TTL 30
 #define FUSE_DURATION 1
 
-/************ request type *******************/
+/************ coverage *******************/
 
-DbPointRecord::request_t::request_t(string id, TimeRange r_range) : range(r_range), id(id) { }
+void DbPointRecord::coverage_t::add(TimeRange range) {
+  addTo(_spans, range);
+}
 
-bool DbPointRecord::request_t::contains(std::string id, time_t t) {
-  if (this->range.start <= t 
-      && t <= this->range.end 
-      && RTX_STRINGS_ARE_EQUAL(id, this->id)) {
-    return true;
+void DbPointRecord::coverage_t::addRecent(TimeRange range, time_t now, time_t expires) {
+  if (!this->recentValid(now)) {
+    _recent.clear();
+    _recentExpires = expires; // the whole set goes at once, so later spans don't keep earlier ones alive
+  }
+  addTo(_recent, range);
+}
+
+void DbPointRecord::coverage_t::remove(TimeRange range) {
+  removeFrom(_spans, range);
+  removeFrom(_recent, range);
+}
+
+vector<TimeRange> DbPointRecord::coverage_t::gaps(TimeRange range, time_t now) const {
+  vector<TimeRange> out, settled;
+  gapsIn(_spans, range, settled);
+  if (!this->recentValid(now)) {
+    return settled;
+  }
+  for (const TimeRange& g : settled) {
+    gapsIn(_recent, g, out);
+  }
+  return out;
+}
+
+void DbPointRecord::coverage_t::addTo(spans_t& spans, TimeRange range) {
+  if (range.end < range.start) {
+    return;
+  }
+  // swallow every span that overlaps or abuts the new one
+  auto it = spans.upper_bound(range.start);
+  if (it != spans.begin() && prev(it)->second + 1 >= range.start) {
+    --it;
+  }
+  while (it != spans.end() && it->first <= range.end + 1) {
+    range.start = min(range.start, it->first);
+    range.end = max(range.end, it->second);
+    it = spans.erase(it);
+  }
+  spans[range.start] = range.end;
+}
+
+void DbPointRecord::coverage_t::removeFrom(spans_t& spans, TimeRange range) {
+  if (range.end < range.start) {
+    return;
+  }
+  auto it = spans.upper_bound(range.start);
+  if (it != spans.begin() && prev(it)->second >= range.start) {
+    --it;
+  }
+  while (it != spans.end() && it->first <= range.end) {
+    time_t start = it->first, end = it->second;
+    it = spans.erase(it);
+    if (start < range.start) {
+      spans[start] = range.start - 1;
+    }
+    if (end > range.end) {
+      spans[range.end + 1] = end;
+    }
   }
-  return false;
 }
 
-void DbPointRecord::request_t::clear() {
-  this->range = TimeRange();
-  this->id = "";
+void DbPointRecord::coverage_t::gapsIn(const spans_t& spans, TimeRange range, vector<TimeRange>& out) {
+  time_t cursor = range.start;
+  auto it = spans.upper_bound(range.start);
+  if (it != spans.begin()) {
+    --it;
+  }
+  for (; it != spans.end() && it->first <= range.end && cursor <= range.end; ++it) {
+    if (it->second < cursor) {
+      continue;
+    }
+    if (it->first > cursor) {
+      out.push_back(TimeRange(cursor, it->first - 1));
+    }
+    cursor = it->second + 1;
+  }
+  if (cursor <= range.end) {
+    out.push_back(TimeRange(cursor, range.end));
+  }
 }
 
+
 /************ widequery info *******************/
 
 bool DbPointRecord::WideQueryInfo::valid() {
@@ -55,11 +130,21 @@ bool DbPointRecord::WideQueryInfo::valid() {
   }
 };
 
+DbPointRecord::WideQueryInfo DbPointRecord::wideQuery() {
+  std::lock_guard<std::mutex> lock(_wideQueryMtx);
+  return _wideQuery;
+}
+
+void DbPointRecord::setWideQuery(WideQueryInfo info) {
+  std::lock_guard<std::mutex> lock(_wideQueryMtx);
+  _wideQuery = info;
+}
+
 
 
 /************ impl *******************/
 
-DbPointRecord::DbPointRecord() : _last_request("",TimeRange()) {
+DbPointRecord::DbPointRecord() {
   _lastFailedAttempt = std::chrono::time_point<std::chrono::system_clock>();
   _adapter = NULL;
   errorMessage = "Not Connected";
@@ -68,6 +153,9 @@ DbPointRecord::DbPointRecord() : _last_request("",TimeRange()) {
   
   iterativeSearchMaxIterations = 8;
   iterativeSearchStride = 3*60*60;
+  _coverageHorizon = RTX_DB_COVERAGE_HORIZON;
+  _recentCoverageTtl = RTX_DB_RECENT_COVERAGE_TTL;
+  this->resetReadCounters();
     
   _errCB = [&](const std::string& msg)->void {
     this->errorMessage = msg;
@@ -77,6 +165,12 @@ DbPointRecord::DbPointRecord() : _last_request("",TimeRange()) {
 }
 
 void DbPointRecord::setConnectionString(const std::string &str) {
+  {
+    std::lock_guard lock(_db_readwrite);
+    _adapterHandles.clear(); // adapter handles are only good for one connection
+    _adapterHandleResolved.clear();
+  }
+  this->forgetCoverage();
   _adapter->setConnectionString(str);
   _lastFailedAttempt = std::chrono::time_point<std::chrono::system_clock>();
 }
@@ -207,6 +301,11 @@ bool DbPointRecord::registerAndGetIdentifierForSeriesWithUnits(string name, Unit
     
     // by now, nothing is there - insert a new series.
     bool inserted = _adapter->insertIdentifierAndUnits(name, units);
+    // the adapter may key the new series differently (a new row id), so just its snapshot handle is resolved again
+    seriesHandle_t h = this->handleForIdentifier(name);
+    if (h < _adapterHandleResolved.size()) {
+      _adapterHandleResolved[h] = false;
+    }
     bool cached = DB_PR_SUPER::registerAndGetIdentifierForSeriesWithUnits(name, units);
     return inserted && cached;
   }
@@ -261,21 +360,163 @@ void DbPointRecord::willQuery(RTX::TimeRange range) {
     _lastIdRequest = 0;
     this->identifiersAndUnits();
     
-    auto fetch = _adapter->wideQuery(range);
+    map<string, vector<Point> > fetch;
+    try {
+      fetch = _adapter->wideQuery(range);
+    } catch (const std::exception& e) {
+      cerr << "wide query failed: " << e.what() << endl; // nothing is marked fetched, so reads go to the db as usual
+      return;
+    }
     for (auto res : fetch) {
-      DB_PR_SUPER::addPoints(res.first, res.second);
+      this->bufferFetched(res.first, res.second, {range});
     }
     // optimization: if the adaptor supports wide query then allow queries to bypass db hits
     // so cache the range of that query.
     if (_adapter->options().canDoWideQuery) {
-      _wideQuery = WideQueryInfo(range);
+      this->setWideQuery(WideQueryInfo(range));
+    }
+  }
+}
+
+void DbPointRecord::willQuery(TimeRange range, const std::vector<std::string>& ids) {
+  if (!checkConnected() || ids.empty()) {
+    return;
+  }
+  std::shared_lock lock(_db_readwrite); // get a read lock
+  
+  // reach back to the point in effect at the start, so a step early in the window
+  // doesn't need its own "previous point" query. the buffer has to stay contiguous, so fetch from there.
+  map<string, TimeRange> fetch;
+  map<string, Point> priors; // fetched here, so the span between them and the window is known to be empty
+  vector<string> needPrior;
+  for (const string& id : ids) {
+    fetch[id] = range;
+    Point prior = DB_PR_SUPER::pointBefore(id, range.start + 1);
+    if (prior.isValid && this->uncovered(id, TimeRange(prior.time, range.start)).empty()) {
+      fetch[id].start = min(prior.time, range.start);
+    }
+    else {
+      needPrior.push_back(id);
     }
   }
+  if (!needPrior.empty()) {
+    map<string, Point> found;
+    try {
+      found = _adapter->selectPreviousMany(needPrior, range.start + 1); // one round trip for all of them
+    } catch (const std::exception& e) {
+      cerr << "prefetch failed: " << e.what() << endl; // reads fall back to fetching as they go
+      return;
+    }
+    for (auto& prior : found) {
+      Point p = this->pointWithOpcFilter(prior.second);
+      if (p.isValid && p.time < range.start && fetch.count(prior.first)) {
+        fetch[prior.first].start = p.time;
+        priors[prior.first] = p;
+      }
+    }
+  }
+  
+  // claim the gaps nobody is fetching yet, the same way pointsInRange does, so concurrent readers wait on us
+  map<string, vector<TimeRange> > gaps;
+  map<string, promise<vector<Point> > > done;
+  map<string, list<fetch_t>::iterator> mine;
+  TimeRange hull;
+  {
+    std::lock_guard covLock(_coverageMtx);
+    for (auto& f : fetch) {
+      const string& id = f.first;
+      auto cov = _coverage.find(id);
+      vector<TimeRange> g = (cov == _coverage.end()) ? vector<TimeRange>({f.second}) : cov->second.gaps(f.second, this->coverageNow());
+      bool busy = any_of(_inFlight.begin(), _inFlight.end(), [&](const fetch_t& other){ return other.id == id && !other.abandoned; });
+      if (g.empty() || busy) {
+        continue;
+      }
+      gaps[id] = g;
+      mine[id] = _inFlight.insert(_inFlight.end(), fetch_t(id, g, done[id].get_future().share()));
+      for (TimeRange r : g) {
+        r.start = max(r.start, range.start); // anything earlier is just the prior point
+        if (r.start <= r.end) {
+          hull = hull.isValid() ? TimeRange::unionOf(hull, r) : r;
+        }
+      }
+    }
+  }
+  if (gaps.empty()) {
+    ++_cacheHits;
+    return;
+  }
+  
+  auto finish = [&]() {
+    std::lock_guard covLock(_coverageMtx);
+    for (auto& m : mine) {
+      _inFlight.erase(m.second);
+    }
+  };
+  
+  map<string, vector<Point> > deDuped;
+  try {
+    // every claimed series over the span covering all their gaps, in one round trip
+    vector<string> batch;
+    for (auto& g : gaps) {
+      batch.push_back(g.first);
+    }
+    map<string, vector<Point> > fetched;
+    if (hull.isValid()) {
+      fetched = _adapter->selectRanges(batch, hull); // db hit
+      ++_dbFetches;
+    }
+    
+    for (auto& g : gaps) {
+      const string& id = g.first;
+      vector<Point> merged = DB_PR_SUPER::pointsInRange(id, fetch[id]);
+      vector<Point> points = this->pointsWithOpcFilter(fetched[id]);
+      if (priors.count(id)) {
+        points.push_back(priors[id]); // already filtered
+      }
+      for (const Point& p : points) {
+        for (const TimeRange& r : g.second) {
+          if (r.contains(p.time)) {
+            merged.push_back(p);
+            break;
+          }
+        }
+      }
+      deDuped[id] = this->mergedPoints(merged, fetch[id]);
+    }
+    
+    // mutation happens outside the read lock
+    lock.unlock();
+    for (auto& g : gaps) {
+      this->bufferFetched(g.first, deDuped[g.first], g.second, &*mine[g.first]);
+    }
+  } catch (const std::exception& e) {
+    // nothing was marked fetched. anyone waiting on us gets the failure, and reads fall back to fetching as they go
+    finish();
+    for (auto& d : done) {
+      d.second.set_exception(current_exception());
+    }
+    cerr << "prefetch failed: " << e.what() << endl;
+    return;
+  } catch (...) {
+    finish();
+    for (auto& d : done) {
+      d.second.set_exception(current_exception());
+    }
+    throw;
+  }
+  finish();
+  for (auto& d : done) {
+    d.second.set_value(deDuped[d.first]);
+  }
 }
 
 vector<Point> DbPointRecord::pointsWithQuery(const string& query, TimeRange range) {
   if (checkConnected()) {
-    return _adapter->selectWithQuery(query, range);
+    try {
+      return _adapter->selectWithQuery(query, range);
+    } catch (const std::exception& e) {
+      cerr << "could not query " << query << ": " << e.what() << endl;
+    }
   }
   return vector<Point>();
 }
@@ -291,39 +532,27 @@ Point DbPointRecord::point(const string& id, time_t time) {
   
   // if there is a valid ("alive") wide query, and if the time requested is in range, then the point should be there.
   // if it's not there, it doesn't exist (within TTL anyway)
-  if (_wideQuery.valid() && _wideQuery.range().contains(time)) {
+  WideQueryInfo wide = this->wideQuery();
+  if (wide.valid() && wide.range().contains(time)) {
     return p;
   }
   
   if (!p.isValid) {
     
-    // see if we just asked the db for something in this range.
-    // if so, and Super couldn't find it, then it's just not here.
-    // todo -- check staleness
-    
-    if (_last_request.contains(id, time)) {
+    // if we already fetched this time and Super couldn't find it, then it's just not here.
+    if (this->uncovered(id, TimeRange(time, time)).empty()) {
       return Point();
     }
     
-    if (_wideQuery.valid() && _wideQuery.range().contains(time)) {
+    if (wide.valid() && wide.range().contains(time)) {
       return Point();
     }
     
     time_t margin = 60*60*12;
     time_t start = time - margin, end = time + margin;
     
-    // do the request, and cache the request parameters.
-    
-    vector<Point> pVec = _adapter->selectRange(id, TimeRange(start, end));
-    pVec = this->pointsWithOpcFilter(pVec);
-    
-    if (pVec.size() > 0) {
-      _last_request = request_t(id, TimeRange(pVec.front().time, pVec.back().time));
-    }
-    else {
-      _last_request = request_t(id,TimeRange());
-    }
-    
+    // fetch (and cache) the neighborhood
+    vector<Point> pVec = this->pointsInRange(id, TimeRange(start, end));
     
     vector<Point>::const_iterator pIt = pVec.begin();
     while (pIt != pVec.end()) {
@@ -335,8 +564,6 @@ Point DbPointRecord::point(const string& id, time_t time) {
       }
       ++pIt;
     }
-    // cache this latest result set
-    DB_PR_SUPER::addPoints(id, pVec);
   }
   
   
@@ -356,9 +583,10 @@ Point DbPointRecord::pointBefore(const string& id, time_t time, WhereClause q) {
   // if there is a valid ("alive") wide query, and if the time requested is in range, then the point should be there.
   // The Base buffer class might not catch this, since it depends on a time range based on extant data.
   // so we (partially) reproduce some logic here to get that edge case.
-  if (_wideQuery.valid()) {
+  WideQueryInfo wide = this->wideQuery();
+  if (wide.valid()) {
     // the actual effective range is the superset of the buffered range and the wide query range.
-    TimeRange actualRange = TimeRange::unionOf(_wideQuery.range(), DB_PR_SUPER::range(id));
+    TimeRange actualRange = TimeRange::unionOf(wide.range(), DB_PR_SUPER::range(id));
     
     if (actualRange.contains(time)) {
       // last check...
@@ -401,7 +629,11 @@ Point DbPointRecord::pointBefore(const string& id, time_t time, WhereClause q) {
   
   // try a singly-bounded query
   if (_adapter->options().supportsSinglyBoundQuery) {
-    p = _adapter->selectPrevious(id, time, q);
+    try {
+      p = _adapter->selectPrevious(id, time, q);
+    } catch (const std::exception& e) {
+      cerr << "could not fetch " << id << ": " << e.what() << endl;
+    }
   }
   if (p.isValid) {
     return this->pointWithOpcFilter(p);
@@ -421,9 +653,10 @@ Point DbPointRecord::pointAfter(const string& id, time_t time, WhereClause q) {
   
   // if there is a valid ("alive") wide query, and if the time requested is in range, then the point should be there.
   // if it's not there, it doesn't exist (within TTL anyway)
-  if (_wideQuery.valid()) {
+  WideQueryInfo wide = this->wideQuery();
+  if (wide.valid()) {
     // the actual effective range is the superset of the buffered range and the wide query range.
-    TimeRange actualRange = TimeRange::unionOf(_wideQuery.range(), DB_PR_SUPER::range(id));
+    TimeRange actualRange = TimeRange::unionOf(wide.range(), DB_PR_SUPER::range(id));
     
     if (actualRange.contains(time)) {
       // last check...
@@ -462,7 +695,11 @@ Point DbPointRecord::pointAfter(const string& id, time_t time, WhereClause q) {
   
   // singly bounded?
   if (_adapter->options().supportsSinglyBoundQuery) {
-    p = _adapter->selectNext(id, time, q);
+    try {
+      p = _adapter->selectNext(id, time, q);
+    } catch (const std::exception& e) {
+      cerr << "could not fetch " << id << ": " << e.what() << endl;
+    }
   }
   if (p.isValid) {
     return this->pointWithOpcFilter(p);
@@ -524,19 +761,26 @@ Point DbPointRecord::searchNextIteratively(const string& id, time_t time) {
 
 
 std::vector<Point> DbPointRecord::pointsInRange(const string& id, TimeRange qrange) {
-  std::shared_lock lock(_db_readwrite); // get a read lock
-  
-  // limit double-queries
-  if (_last_request.range.containsRange(qrange) && _last_request.id == id) {
+  try {
+    return this->fetchRange(id, qrange);
+  } catch (const std::exception& e) {
+    // nothing was marked fetched, so the next read asks again
+    cerr << "could not fetch " << id << ": " << e.what() << endl;
     return DB_PR_SUPER::pointsInRange(id, qrange);
   }
+}
+
+std::vector<Point> DbPointRecord::fetchRange(const string& id, TimeRange qrange) {
+  std::shared_lock lock(_db_readwrite); // get a read lock
   
   // wide query optimization
-  if (_wideQuery.valid() && _wideQuery.range().intersection(qrange) == TimeRange::intersect_other_internal) {
+  WideQueryInfo wide = this->wideQuery();
+  if (wide.valid() && wide.range().intersection(qrange) == TimeRange::intersect_other_internal) {
+    ++_cacheHits;
     return DB_PR_SUPER::pointsInRange(id, qrange);
   }
   else {
-    _wideQuery = WideQueryInfo(); // the intersection did not align, so invalidate this wide query marker. Beyond here we may mutate the cache.
+    this->setWideQuery(WideQueryInfo()); // the intersection did not align, so invalidate this wide query marker. Beyond here we may mutate the cache.
   }
   
   
@@ -544,76 +788,105 @@ std::vector<Point> DbPointRecord::pointsInRange(const string& id, TimeRange qran
     return DB_PR_SUPER::pointsInRange(id, qrange);
   }
   
-  TimeRange range = DB_PR_SUPER::range(id);
-  TimeRange::intersect_type intersect = range.intersection(qrange);
-
-  // if the requested range is not in memcache, then fetch it.
-  if ( intersect == TimeRange::intersect_other_internal || intersect == TimeRange::intersect_equal ) {
-    return DB_PR_SUPER::pointsInRange(id, qrange);
-  }
-  else {
-    vector<Point> left, middle, right;
-    TimeRange n_range;
-    
-    if (intersect == TimeRange::intersect_left) {
-      // left-fill query
-      n_range.start = qrange.start;
-      n_range.end = range.start;
-      middle = this->pointsWithOpcFilter(_adapter->selectRange(id, n_range));
-      right = DB_PR_SUPER::pointsInRange(id, TimeRange(range.start, qrange.end));
-    }
-    else if (intersect == TimeRange::intersect_right) {
-      // right-fill query
-      n_range.start = range.end;
-      n_range.end = qrange.end;
-      left = DB_PR_SUPER::pointsInRange(id, TimeRange(qrange.start, range.end));
-      middle = this->pointsWithOpcFilter(_adapter->selectRange(id, n_range));
-    }
-    else if (intersect == TimeRange::intersect_other_external){
-      // query overlaps but extends on both sides
-      TimeRange q_left, q_right;
-      
-      q_left.start = qrange.start;
-      q_left.end = range.start;
-      q_right.start = range.end;
-      q_right.end = qrange.end;
-      
-      left = this->pointsWithOpcFilter(_adapter->selectRange(id, q_left));
-      middle = DB_PR_SUPER::pointsInRange(id, range);
-      right = this->pointsWithOpcFilter(_adapter->selectRange(id, q_right));
+  vector<TimeRange> gaps;
+  promise<vector<Point> > done;
+  list<fetch_t>::iterator mine;
+  bool waited = false; // counted once, by how the read was finally answered
+  while (true) {
+    // only the spans we have never fetched go to the db -- unless someone is already fetching them
+    shared_future<vector<Point> > inFlight;
+    bool covered = false;
+    {
+      std::lock_guard covLock(_coverageMtx);
+      auto cov = _coverage.find(id);
+      gaps = (cov == _coverage.end()) ? vector<TimeRange>({qrange}) : cov->second.gaps(qrange, this->coverageNow());
+      for (const auto& f : _inFlight) {
+        if (gaps.empty() || f.id != id || f.abandoned) {
+          continue;
+        }
+        bool overlaps = false, all = true;
+        for (const TimeRange& g : gaps) {
+          bool inside = false;
+          for (const TimeRange& fg : f.gaps) {
+            overlaps = overlaps || (g.start <= fg.end && fg.start <= g.end);
+            inside = inside || fg.containsRange(g);
+          }
+          all = all && inside;
+        }
+        if (overlaps) {
+          inFlight = f.points;
+          covered = all;
+          break;
+        }
+      }
+      if (!gaps.empty() && !inFlight.valid()) {
+        mine = _inFlight.insert(_inFlight.end(), fetch_t(id, gaps, done.get_future().share()));
+        break; // ours to fetch
+      }
     }
-    else {
-      middle = this->pointsWithOpcFilter(_adapter->selectRange(id, qrange));
+    if (gaps.empty()) {
+      ++(waited ? _coalescedReads : _cacheHits);
+      return DB_PR_SUPER::pointsInRange(id, qrange);
     }
-    // db hit
     
-    vector<Point> merged;
-    merged.reserve(middle.size() + left.size() + right.size());
-    merged.insert(merged.end(), left.begin(), left.end());
-    merged.insert(merged.end(), middle.begin(), middle.end());
-    merged.insert(merged.end(), right.begin(), right.end());
-
-    set<time_t> addedTimes;
-    vector<Point> deDuped;
-    deDuped.reserve(merged.size());
-    for(const Point& p : merged) {
-      if (addedTimes.count(p.time) == 0) {
-        addedTimes.insert(p.time);
-        if (qrange.start <= p.time && p.time <= qrange.end) {
-          deDuped.push_back(p);
+    const vector<Point>& shared = inFlight.get(); // rethrows the fetcher's failure
+    waited = true;
+    if (!covered) {
+      continue; // it only had part of what we need. look again.
+    }
+    ++_coalescedReads;
+    // everything we lack is in the other fetch's results
+    vector<Point> merged = DB_PR_SUPER::pointsInRange(id, qrange);
+    for (const Point& p : shared) {
+      for (const TimeRange& g : gaps) {
+        if (g.contains(p.time)) {
+          merged.push_back(p);
+          break;
         }
       }
     }
+    return this->mergedPoints(merged, qrange);
+  }
+  
+  // whatever happens, our entry comes out before anyone waiting on it is released
+  auto finish = [&]() {
+    std::lock_guard covLock(_coverageMtx);
+    _inFlight.erase(mine);
+  };
+  
+  vector<Point> deDuped;
+  try {
+    vector<Point> merged = DB_PR_SUPER::pointsInRange(id, qrange);
+    for (const TimeRange& gap : gaps) {
+      vector<Point> fetched = this->pointsWithOpcFilter(_adapter->selectRange(id, gap)); // db hit
+      ++_dbFetches;
+      merged.insert(merged.end(), fetched.begin(), fetched.end());
+    }
+    deDuped = this->mergedPoints(merged, qrange);
     
-    // mutation requires getting a write lock...
+    // mutation happens outside the read lock
     lock.unlock();
-    {
-      std::lock_guard lock2(_db_readwrite);
-      _last_request = (deDuped.size() > 0) ? request_t(id, qrange) : request_t(id,TimeRange());
+    this->bufferFetched(id, deDuped, gaps, &*mine);
+  } catch (...) {
+    finish();
+    done.set_exception(current_exception());
+    throw;
+  }
+  finish();
+  done.set_value(deDuped);
+  return deDuped;
+}
+
+vector<Point> DbPointRecord::mergedPoints(vector<Point>& points, TimeRange range) {
+  stable_sort(points.begin(), points.end(), &Point::comparePointTime);
+  vector<Point> deDuped;
+  deDuped.reserve(points.size());
+  for(const Point& p : points) {
+    if ((deDuped.empty() || deDuped.back().time != p.time) && range.start <= p.time && p.time <= range.end) {
+      deDuped.push_back(p);
     }
-    DB_PR_SUPER::addPoints(id, deDuped);
-    return deDuped;
   }
+  return deDuped;
 }
 
 
@@ -622,6 +895,10 @@ void DbPointRecord::addPoint(const string& id, Point point) {
   if (!this->readonly() && checkConnected()) {
     DB_PR_SUPER::addPoint(id, point);
     _adapter->insertSingle(id, point);
+    // only the single-point cache has it if it missed the buffered run, so the buffer is no longer complete there
+    if (!this->bufferWritten(id, {point}).empty()) {
+      this->forgetCoverage(id, TimeRange(point.time, point.time));
+    }
   }
 }
 
@@ -629,16 +906,58 @@ void DbPointRecord::addPoint(const string& id, Point point) {
 void DbPointRecord::addPoints(const string& id, std::vector<Point> points) {
   std::lock_guard lock(_db_readwrite); // get a write lock
   if (!this->readonly() && checkConnected()) {
-    DB_PR_SUPER::addPoints(id, points);
+    this->bufferWritten(id, points); // the interior...
+    this->bufferFetched(id, points, {}); // ...then either end, which the buffer appends or prepends
     _adapter->insertRange(id, points);
   }
 }
 
 
+void DbPointRecord::addSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values) {
+  std::lock_guard lock(_db_readwrite); // one write lock for the whole snapshot
+  if (this->readonly() || !checkConnected()) {
+    return;
+  }
+  DB_PR_SUPER::addSnapshot(time, handles, values);
+  for (size_t i = 0; i < handles.size() && i < values.size(); ++i) {
+    // as with addPoint
+    const string id = this->identifierForHandle(handles[i]);
+    if (!this->bufferWritten(id, {Point(time, values[i])}).empty()) {
+      this->forgetCoverage(id, TimeRange(time, time));
+    }
+  }
+  
+  // translate record handles into adapter handles, resolving any that are new to us.
+  std::vector<DbAdapter::seriesHandle_t> adapterHandles;
+  std::vector<double> adapterValues;
+  adapterHandles.reserve(handles.size());
+  adapterValues.reserve(values.size());
+  for (size_t i = 0; i < handles.size() && i < values.size(); ++i) {
+    const seriesHandle_t h = handles[i];
+    if (h >= _adapterHandles.size()) {
+      _adapterHandles.resize(this->handleCount(), 0);
+      _adapterHandleResolved.resize(this->handleCount(), false);
+      if (h >= _adapterHandles.size()) {
+        continue; // not a handle from this record
+      }
+    }
+    if (!_adapterHandleResolved[h]) {
+      _adapterHandles[h] = _adapter->resolveSeriesHandle(this->identifierForHandle(h));
+      _adapterHandleResolved[h] = true;
+    }
+    adapterHandles.push_back(_adapterHandles[h]);
+    adapterValues.push_back(values[i]);
+  }
+  
+  _adapter->insertSnapshot(time, adapterHandles, adapterValues);
+}
+
+
 void DbPointRecord::truncate() {
   std::lock_guard lock(_db_readwrite); // get a write lock
   if (!this->readonly() && checkConnected()) {
     DB_PR_SUPER::reset();
+    this->forgetCoverage();
     _adapter->removeAllRecords();
   }
 }
@@ -647,6 +966,7 @@ void DbPointRecord::reset() {
   std::lock_guard lock(_db_readwrite); // get a write lock
   if (!this->readonly() && checkConnected()) {
     DB_PR_SUPER::reset();
+    this->forgetCoverage();
     cerr << "deprecated. do not use" << endl;
     //this->truncate();
   }
@@ -659,13 +979,169 @@ void DbPointRecord::reset(const string& id) {
     // deprecate?
     //cout << "Whoops - don't use this" << endl;
     DB_PR_SUPER::reset(id);
-    _last_request.clear();
+    {
+      std::lock_guard covLock(_coverageMtx);
+      _coverage.erase(id);
+    }
     //this->removeRecord(id);
     // wiped out the record completely, so re-initialize it.
     //this->registerAndGetIdentifier(id);
   }
 }
 
+void DbPointRecord::trimBefore(const string& id, time_t time) {
+  std::lock_guard lock(_db_readwrite); // get a write lock
+  // the trimmed span is no longer buffered, so nothing may claim it is
+  {
+    std::lock_guard<std::mutex> wideLock(_wideQueryMtx);
+    if (_wideQuery.valid() && _wideQuery.range().start < time) {
+      _wideQuery = WideQueryInfo();
+    }
+  }
+  std::lock_guard covLock(_coverageMtx);
+  DB_PR_SUPER::trimBefore(id, time);
+  auto cov = _coverage.find(id);
+  if (cov != _coverage.end()) {
+    cov->second.remove(TimeRange(numeric_limits<time_t>::min(), time - 1));
+  }
+}
+
+void DbPointRecord::resetReadCounters() {
+  _cacheHits = 0;
+  _coalescedReads = 0;
+  _dbFetches = 0;
+}
+
+void DbPointRecord::setCoverageHorizon(time_t seconds) {
+  std::lock_guard covLock(_coverageMtx);
+  _coverageHorizon = (seconds > 0) ? seconds : 0;
+}
+
+time_t DbPointRecord::coverageHorizon() {
+  std::lock_guard covLock(_coverageMtx);
+  return _coverageHorizon;
+}
+
+void DbPointRecord::setRecentCoverageTtl(time_t seconds) {
+  std::lock_guard covLock(_coverageMtx);
+  _recentCoverageTtl = (seconds > 0) ? seconds : 0;
+}
+
+time_t DbPointRecord::recentCoverageTtl() {
+  std::lock_guard covLock(_coverageMtx);
+  return _recentCoverageTtl;
+}
+
+vector<TimeRange> DbPointRecord::uncovered(const string& id, TimeRange range) {
+  std::lock_guard covLock(_coverageMtx);
+  auto cov = _coverage.find(id);
+  if (cov == _coverage.end()) {
+    return {range};
+  }
+  return cov->second.gaps(range, this->coverageNow());
+}
+
+void DbPointRecord::bufferFetched(const string& id, const vector<Point>& points, const vector<TimeRange>& fetched, const fetch_t* claim) {
+  std::lock_guard covLock(_coverageMtx);
+  if (claim && claim->abandoned) {
+    return; // fetched for a series that has since been replaced
+  }
+  TimeRange before = DB_PR_SUPER::range(id);
+  DB_PR_SUPER::addPoints(id, points);
+  TimeRange after = DB_PR_SUPER::range(id);
+  
+  coverage_t& cov = _coverage[id];
+  // the buffer is one contiguous run. whatever it dropped to take these points (all of it, on a gap,
+  // or the oldest few, at capacity) lay inside its old extent, and no longer inside its new one.
+  if (before.isValid()) {
+    if (!after.isValid() || after.end < before.start || before.end < after.start) {
+      cov.remove(before);
+    }
+    else {
+      if (before.start < after.start) {
+        cov.remove(TimeRange(before.start, after.start - 1));
+      }
+      if (after.end < before.end) {
+        cov.remove(TimeRange(after.end + 1, before.end));
+      }
+    }
+  }
+  
+  // a fetched span is complete if the buffer kept everything found in it (it ignores points landing
+  // inside what it already has). the part old enough to be settled stays complete; the rest only for the ttl.
+  time_t now = this->coverageNow();
+  time_t settled = now - _coverageHorizon;
+  auto kept = [&](TimeRange span) {
+    auto first = lower_bound(points.begin(), points.end(), Point(span.start, 0), &Point::comparePointTime);
+    auto last = upper_bound(points.begin(), points.end(), Point(span.end, 0), &Point::comparePointTime);
+    return (size_t)(last - first) == DB_PR_SUPER::pointsView(id, span).size();
+  };
+  for (const TimeRange& span : fetched) {
+    TimeRange old(span.start, min(span.end, settled));
+    TimeRange recent(max(span.start, settled + 1), span.end);
+    if (old.start <= old.end && kept(old)) {
+      cov.add(old);
+    }
+    if (_recentCoverageTtl > 0 && recent.start <= recent.end && kept(recent)) {
+      cov.addRecent(recent, now, now + _recentCoverageTtl);
+    }
+  }
+  if (cov.empty(now)) {
+    _coverage.erase(id);
+  }
+}
+
+vector<Point> DbPointRecord::bufferWritten(const string& id, const vector<Point>& points) {
+  // a write inside the buffered run goes into it, so the buffer stays complete there and nothing is re-fetched.
+  std::lock_guard covLock(_coverageMtx);
+  TimeRange before = DB_PR_SUPER::range(id);
+  vector<Point> outside;
+  for (const Point& p : points) {
+    if (!before.isValid() || !before.contains(p.time)) {
+      outside.push_back(p);
+    }
+  }
+  if (outside.size() < points.size()) {
+    DB_PR_SUPER::mergePoints(id, points);
+  }
+  auto cov = _coverage.find(id);
+  if (cov == _coverage.end()) {
+    return outside;
+  }
+  TimeRange after = DB_PR_SUPER::range(id);
+  if (before.isValid() && after.isValid() && before.start < after.start) {
+    cov->second.remove(TimeRange(before.start, after.start - 1)); // dropped at capacity
+  }
+  if (cov->second.empty(this->coverageNow())) {
+    _coverage.erase(cov);
+  }
+  return outside;
+}
+
+void DbPointRecord::didCreateSeries(const string& identifier) {
+  // the buffer behind this id was replaced by an empty one, so nothing we knew about it holds
+  std::lock_guard covLock(_coverageMtx);
+  _coverage.erase(identifier);
+  for (auto& f : _inFlight) {
+    if (f.id == identifier) {
+      f.abandoned = true;
+    }
+  }
+}
+
+void DbPointRecord::forgetCoverage() {
+  std::lock_guard covLock(_coverageMtx);
+  _coverage.clear();
+}
+
+void DbPointRecord::forgetCoverage(const string& id, TimeRange range) {
+  std::lock_guard covLock(_coverageMtx);
+  auto cov = _coverage.find(id);
+  if (cov != _coverage.end()) {
+    cov->second.remove(range);
+  }
+}
+
 void DbPointRecord::invalidate(const string &identifier) {
   if (!this->readonly() && checkConnected()) {
     _adapter->removeRecord(identifier);
@@ -717,6 +1193,7 @@ void DbPointRecord::setOpcFilterType(OpcFilterType type) {
   
   if (_filterType != type) {
     BufferPointRecord::reset(); // mem cache
+    this->forgetCoverage();
     _filterType = type;
     _opcFilter = opcFilters.at(type);
   }
@@ -733,6 +1210,7 @@ std::set<unsigned int> DbPointRecord::opcFilterList() {
 void DbPointRecord::clearOpcFilterList() {
   _opcFilterCodes.clear();
   BufferPointRecord::reset(); // mem cache
+  this->forgetCoverage();
   if (this->isConnected()) {
     this->dbConnect();
   }
@@ -741,6 +1219,7 @@ void DbPointRecord::clearOpcFilterList() {
 void DbPointRecord::addOpcFilterCode(unsigned int code) {
   _opcFilterCodes.insert(code);
   BufferPointRecord::reset(); // mem cache
+  this->forgetCoverage();
   if (this->isConnected()) {
     this->dbConnect();
   }
@@ -750,6 +1229,7 @@ void DbPointRecord::removeOpcFilterCode(unsigned int code) {
   if (_opcFilterCodes.count(code) > 0) {
     _opcFilterCodes.erase(code);
     BufferPointRecord::reset(); // mem cache
+    this->forgetCoverage();
     if (this->isConnected()) {
       this->dbConnect();
     }
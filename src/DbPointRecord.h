@@ -11,8 +11,21 @@
 
 #define DB_PR_SUPER BufferPointRecord
 
+#ifndef RTX_DB_COVERAGE_HORIZON
+#define RTX_DB_COVERAGE_HORIZON 3600
+#endif
+
+#ifndef RTX_DB_RECENT_COVERAGE_TTL
+#define RTX_DB_RECENT_COVERAGE_TTL 60
+#endif
+
 #include <set>
+#include <map>
+#include <list>
+#include <mutex>
 #include <shared_mutex>
+#include <future>
+#include <atomic>
 
 #include "BufferPointRecord.h"
 #include "rtxExceptions.h"
@@ -51,9 +64,11 @@ namespace RTX {
     //// insert
     void addPoint(const string& id, Point point);
     void addPoints(const string& id, std::vector<Point> points);
+    void addSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values);
     //// drop
     void reset();
     void reset(const string& id);
+    void trimBefore(const string& id, time_t time);
     
     // db-only methods
     std::string errorMessage;
@@ -65,11 +80,29 @@ namespace RTX {
     virtual bool readonly();
     virtual void setReadonly(bool readOnly);
     virtual void truncate(); 
+    bool changesExternally() { return true; };
+    
+    // fetched spans older than the horizon are remembered as complete, so they are never fetched again.
+    // anything newer may still be arriving, so it is only trusted for a short ttl and then re-fetched on demand.
+    // in realtime use every read is inside the horizon: the ttl is what keeps a sparse tag at "now" from being
+    // re-queried every step, at the price of points arriving up to ttl seconds late. a ttl of zero re-fetches every time.
+    void setCoverageHorizon(time_t seconds);
+    time_t coverageHorizon();
+    void setRecentCoverageTtl(time_t seconds);
+    time_t recentCoverageTtl();
+    
+    // read counters, for monitoring: reads answered from the buffer, reads that waited on a fetch
+    // already in flight instead of querying, and range queries sent to the adapter.
+    size_t cacheHits() { return _cacheHits; };
+    size_t coalescedReads() { return _coalescedReads; };
+    size_t dbFetches() { return _dbFetches; };
+    void resetReadCounters();
     
     void beginBulkOperation();
     void endBulkOperation();
     
     void willQuery(TimeRange range);
+    void willQuery(TimeRange range, const std::vector<std::string>& ids); // just these series
     
     std::vector<Point> pointsWithQuery(const std::string& query, TimeRange range);
 
@@ -108,11 +141,15 @@ namespace RTX {
     
   protected:
     
+    void didCreateSeries(const string& identifier);
+    virtual time_t coverageNow() { return time(NULL); }; // the clock that settles and expires coverage
+    
     DbAdapter *_adapter;
     DbAdapter::errCallback_t _errCB;
     
     Point searchPreviousIteratively(const string& id, time_t time);
     Point searchNextIteratively(const string& id, time_t time);
+    std::vector<Point> fetchRange(const string& id, TimeRange range); // pointsInRange, but adapter failures propagate
     
     int iterativeSearchStride;
     int iterativeSearchMaxIterations;
@@ -120,15 +157,23 @@ namespace RTX {
     IdentifierUnitsList _identifiersAndUnitsCache; /// for subs to use
     time_t _lastIdRequest;
     
-    class request_t {
+    //! spans of one series that are known to be completely buffered -- including spans known to hold no points at all
+    class coverage_t {
     public:
-      TimeRange range;
-      std::string id;
-      request_t(std::string id, TimeRange range);
-      bool contains(std::string id, time_t t);
-      void clear();
+      void add(TimeRange range);
+      void addRecent(TimeRange range, time_t now, time_t expires); // until `expires` -- or sooner, with the recent spans already there
+      void remove(TimeRange range);
+      std::vector<TimeRange> gaps(TimeRange range, time_t now) const; // the parts of `range` not covered
+      bool empty(time_t now) const { return _spans.empty() && !this->recentValid(now); };
+    private:
+      typedef std::map<time_t, time_t> spans_t; // start -> end, inclusive, disjoint and never adjacent
+      spans_t _spans, _recent;
+      time_t _recentExpires = 0;
+      bool recentValid(time_t now) const { return !_recent.empty() && now < _recentExpires; };
+      static void addTo(spans_t& spans, TimeRange range);
+      static void removeFrom(spans_t& spans, TimeRange range);
+      static void gapsIn(const spans_t& spans, TimeRange range, std::vector<TimeRange>& out);
     };
-    request_t _last_request;
     
     class WideQueryInfo {
     public:
@@ -142,7 +187,8 @@ namespace RTX {
       TimeRange _range;
     };
     
-    WideQueryInfo _wideQuery;
+    WideQueryInfo wideQuery(); // a copy, so callers test and use one consistent marker
+    void setWideQuery(WideQueryInfo info);
     
     
   private:
@@ -152,6 +198,8 @@ namespace RTX {
     
     bool _readOnly;
     bool _badConnection = false;
+    WideQueryInfo _wideQuery;
+    std::mutex _wideQueryMtx; // readers holding the shared db lock may still replace the marker
     std::chrono::time_point<std::chrono::system_clock> _lastFailedAttempt;
     std::set<unsigned int> _opcFilterCodes;
     OpcFilterType _filterType;
@@ -159,6 +207,33 @@ namespace RTX {
     
     std::function<Point(Point)> _opcFilter;
     
+    std::vector<DbAdapter::seriesHandle_t> _adapterHandles; // indexed by record handle
+    std::vector<bool> _adapterHandleResolved;
+    
+    class fetch_t;
+    std::vector<TimeRange> uncovered(const string& id, TimeRange range);
+    std::vector<Point> mergedPoints(std::vector<Point>& points, TimeRange range); // sorted, unique times, within range
+    void bufferFetched(const string& id, const std::vector<Point>& points, const std::vector<TimeRange>& fetched, const fetch_t* claim = NULL);
+    std::vector<Point> bufferWritten(const string& id, const std::vector<Point>& points); // merges writes inside the buffered run; returns the rest
+    void forgetCoverage();
+    void forgetCoverage(const string& id, TimeRange range);
+    
+    std::map<std::string, coverage_t> _coverage;
+    std::mutex _coverageMtx; // guards coverage and the in-flight list
+    time_t _coverageHorizon, _recentCoverageTtl;
+    
+    //! a range query on its way to the db. overlapping reads wait for its points instead of asking again.
+    class fetch_t {
+    public:
+      std::string id;
+      std::vector<TimeRange> gaps;
+      std::shared_future<std::vector<Point> > points;
+      bool abandoned = false; // the series was re-created while this was out, so its points are neither buffered nor waited on
+      fetch_t(const std::string& id, const std::vector<TimeRange>& gaps, std::shared_future<std::vector<Point> > points) : id(id), gaps(gaps), points(points) { };
+    };
+    std::list<fetch_t> _inFlight;
+    std::atomic<size_t> _cacheHits, _coalescedReads, _dbFetches;
+    
     
     
   };
@@ -734,7 +734,7 @@ int Dma::allocateDemandToJunctions(time_t time) {
       if (dp.isValid) {
         Point newDemandPoint = Point::convertPoint(dp, junction->boundaryFlow()->units(), junction->demand()->units());
         newDemandPoint.time = time;
-        junction->state_demand = newDemandPoint.value;
+        junction->setState(StateStore::Demand, newDemandPoint.value);
       }
       else {
         err = 1;
@@ -746,11 +746,11 @@ int Dma::allocateDemandToJunctions(time_t time) {
       double baseDemand = Units::convertValue(junction->baseDemand(), modelUnits, myUnits);
       double newDemand = baseDemand * ( allocableDemand / totalBaseDemand );
       newDemand = Units::convertValue(newDemand, myUnits, junction->demand()->units());
-      junction->state_demand = newDemand;
+      junction->setState(StateStore::Demand, newDemand);
     }
     else {
       // for instance if totalBaseDemand == 0 then this demand = 0
-      junction->state_demand = 0;
+      junction->setState(StateStore::Demand, 0);
     }
   }
   
@@ -7,6 +7,7 @@
 //  
 
 #include <cstdlib>
+#include <algorithm>
 #include <cmath>
 #include <sstream>
 #include <iostream>
@@ -15,6 +16,9 @@
 #include "CurveFunction.h"
 
 #include <types.h>
+extern "C" {
+#include <funcs.h> // addseg, for restoring quality segments
+}
 
 #include <boost/filesystem.hpp>
 
@@ -27,6 +31,7 @@ EpanetModel::EpanetModel() : Model() {
   // nothing to do, right?
   _enOpened = false;
   _enModel = NULL;
+  _junctionCount = 0;
 //  EN_API_CHECK( EN_newModel(&_enModel), "EN_newModel");
 }
 
@@ -178,6 +183,11 @@ void EpanetModel::useEpanetModel(EN_Project *model, string path) {
     _linkIndex[string(enName)] = iLink;
   }
   
+  _junctionCount = nodeCount - tankCount;
+  _statusControlIndex.assign(linkCount, 0);
+  _settingControlIndex.assign(linkCount, 0);
+  this->bindEngineIndices();
+  
   // get the valve types
   for(Valve::_sp v : this->valves()) {
     int enIdx = _linkIndex[v->name()];
@@ -405,6 +415,9 @@ void EpanetModel::createRtxWrappers() {
         throw "Node Type Unknown";
     } // switch nodeType
     
+    newJunction->engineIndex = iNode - 1;
+    newJunction->setStateStore(this->stateStore());
+    
     // set units for new element
     newJunction->head()->setUnits(headUnits());
     newJunction->pressure()->setUnits(pressureUnits());
@@ -419,7 +432,7 @@ void EpanetModel::createRtxWrappers() {
     // Initial quality specified in input data
     double initQual;
     EN_API_CHECK(EN_getnodevalue(_enModel, iNode, EN_INITQUAL, &initQual), "EN_INITQUAL");
-    newJunction->state_quality = initQual;
+    newJunction->setState(StateStore::Quality, initQual);
     
     // Base demand is sum of all demand categories, accounting for patterns
     double demand = 0, categoryDemand = 0, avgPatternValue = 0;
@@ -550,6 +563,28 @@ void EpanetModel::createRtxWrappers() {
     
   } // for iLink
   
+  this->bindEngineIndices();
+}
+
+void EpanetModel::bindEngineIndices() {
+  // cache the engine slot on each element, so that state exchange during simulation needs no name lookups
+  for(Node::_sp n : this->nodes()) {
+    Junction::_sp j = std::dynamic_pointer_cast<Junction>(n);
+    if (!j) {
+      continue;
+    }
+    auto it = _nodeIndex.find(j->name());
+    j->engineIndex = (it == _nodeIndex.end()) ? -1 : it->second - 1;
+  }
+  for(Link::_sp l : this->links()) {
+    Pipe::_sp p = std::dynamic_pointer_cast<Pipe>(l);
+    if (!p) {
+      continue;
+    }
+    auto it = _linkIndex.find(p->name());
+    p->engineIndex = (it == _linkIndex.end()) ? -1 : it->second - 1;
+  }
+  this->bindStateStore();
 }
 
 void EpanetModel::overrideControls() {
@@ -690,9 +725,7 @@ void EpanetModel::setReservoirHead(const string& reservoir, double level) {
 }
 
 void EpanetModel::setReservoirQuality(const string& reservoir, double quality) {
-  setNodeValue(EN_INITQUAL, reservoir, quality); // set initquality in case setpoint is lower than old value
-  setNodeValue(EN_SOURCETYPE, reservoir, CONCEN);
-  setNodeValue(EN_SOURCEQUAL, reservoir, quality);
+  setReservoirQualityAtIndex(_nodeIndex[reservoir] - 1, quality);
 }
 
 void EpanetModel::setTankLevel(const string& tank, double level) {
@@ -701,7 +734,52 @@ void EpanetModel::setTankLevel(const string& tank, double level) {
 }
 
 void EpanetModel::setJunctionDemand(const string& junction, double demand) {
-  int nodeIndex = _nodeIndex[junction];
+  setJunctionDemandAtIndex(_nodeIndex[junction] - 1, demand);
+}
+
+void EpanetModel::setJunctionQuality(const std::string& junction, double quality) {
+  setJunctionQualityAtIndex(_nodeIndex[junction] - 1, quality);
+}
+
+void EpanetModel::setPipeStatus(const string& pipe, Pipe::status_t status) {
+  setLinkValue(EN_STATUS, pipe, status);
+}
+
+void EpanetModel::setPipeStatusControl(const std::string& pipe, Pipe::status_t status, enableControl_t enableStatus) {
+  setLinkStatusControlAtIndex(_linkIndex[pipe] - 1, status, enableStatus);
+}
+
+void EpanetModel::setPumpStatus(const string& pump, Pipe::status_t status) {
+  // call the setPipeStatus method, since they are the same in epanet.
+  setPipeStatus(pump, status);
+}
+
+void EpanetModel::setPumpStatusControl(const string& pump, Pipe::status_t status, enableControl_t enableStatus) {
+  // call the setPipeStatusControl method, since they are the same in epanet.
+  setPipeStatusControl(pump, status, enableStatus);
+}
+
+void EpanetModel::setPumpSetting(const string& pump, double setting) {
+  setLinkValue(EN_SETTING, pump, setting);
+}
+
+void EpanetModel::setPumpSettingControl(const string& pump, double setting, enableControl_t enableStatus) {
+  setLinkSettingControlAtIndex(_linkIndex[pump] - 1, setting, enableStatus);
+}
+
+void EpanetModel::setValveSetting(const string& valve, double setting) {
+  setLinkValue(EN_SETTING, valve, setting);
+}
+
+void EpanetModel::setValveSettingControl(const string& valve, double setting, enableControl_t enableStatus) {
+  // call the setPumpSettingControl method, since they are the same in epanet.
+  setPumpSettingControl(valve, setting, enableStatus);
+}
+
+#pragma mark Index-based Setters
+
+void EpanetModel::setJunctionDemandAtIndex(int index, double demand) {
+  int nodeIndex = index + 1;
   // Junction demand is total demand - so deal with multiple categories
   int numDemands = 0;
   EN_API_CHECK( EN_getnumdemands(_enModel, nodeIndex, &numDemands), "EN_getnumdemands()");
@@ -712,64 +790,64 @@ void EpanetModel::setJunctionDemand(const string& junction, double demand) {
   EN_API_CHECK( EN_setbasedemand(_enModel, nodeIndex, numDemands, demand), "EN_setbasedemand()" );
 }
 
-void EpanetModel::setJunctionQuality(const std::string& junction, double quality) {
+void EpanetModel::setJunctionQualityAtIndex(int index, double quality) {
   // todo - add more source types, depending on time series dimension?
-  setNodeValue(EN_INITQUAL, junction, quality); // set initquality in case setpoint is lower than old value
-  setNodeValue(EN_SOURCETYPE, junction, FLOWPACED);
-  setNodeValue(EN_SOURCEQUAL, junction, quality);
+  int nodeIndex = index + 1;
+  EN_API_CHECK(EN_setnodevalue(_enModel, nodeIndex, EN_INITQUAL, quality), "EN_setnodevalue EN_INITQUAL"); // set initquality in case setpoint is lower than old value
+  EN_API_CHECK(EN_setnodevalue(_enModel, nodeIndex, EN_SOURCETYPE, FLOWPACED), "EN_setnodevalue EN_SOURCETYPE");
+  EN_API_CHECK(EN_setnodevalue(_enModel, nodeIndex, EN_SOURCEQUAL, quality), "EN_setnodevalue EN_SOURCEQUAL");
 }
 
-void EpanetModel::setPipeStatus(const string& pipe, Pipe::status_t status) {
-  setLinkValue(EN_STATUS, pipe, status);
+void EpanetModel::setReservoirHeadAtIndex(int index, double head) {
+  EN_API_CHECK(EN_setnodevalue(_enModel, index + 1, EN_TANKLEVEL, head), "EN_setnodevalue EN_TANKLEVEL");
 }
 
-void EpanetModel::setPipeStatusControl(const std::string& pipe, Pipe::status_t status, enableControl_t enableStatus) {
-  int linkIndex = _linkIndex[pipe];
+void EpanetModel::setReservoirQualityAtIndex(int index, double quality) {
+  int nodeIndex = index + 1;
+  EN_API_CHECK(EN_setnodevalue(_enModel, nodeIndex, EN_INITQUAL, quality), "EN_setnodevalue EN_INITQUAL"); // set initquality in case setpoint is lower than old value
+  EN_API_CHECK(EN_setnodevalue(_enModel, nodeIndex, EN_SOURCETYPE, CONCEN), "EN_setnodevalue EN_SOURCETYPE");
+  EN_API_CHECK(EN_setnodevalue(_enModel, nodeIndex, EN_SOURCEQUAL, quality), "EN_setnodevalue EN_SOURCEQUAL");
+}
+
+void EpanetModel::setTankLevelAtIndex(int index, double level) {
+  setReservoirHeadAtIndex(index, level);
+}
+
+void EpanetModel::setLinkStatusControlAtIndex(int index, Pipe::status_t status, enableControl_t enableStatus) {
+  if (index < 0 || index >= (int)_statusControlIndex.size()) {
+    EN_API_CHECK(204, "EN_addstatuscontrol"); // undefined link
+  }
+  int linkIndex = index + 1;
   int enEnableStatus = (enableStatus == enable) ? EN_ENABLE : EN_DISABLE;
+  int& cindex = _statusControlIndex[index];
 
-  if (_statusControlIndex.count(pipe) == 0) {
+  if (cindex == 0) {
     // if this element doesn't have a control, add one
-    int cindex;
     EN_API_CHECK(EN_addstatuscontrol(_enModel, EN_TIMER, linkIndex, (EN_API_FLOAT_TYPE)status, 0, (EN_API_FLOAT_TYPE)0.0, &cindex), "EN_addcontrol");
-    _statusControlIndex[pipe] = cindex;
     EN_API_CHECK(EN_setControlEnabled(_enModel, cindex, enEnableStatus), "EN_setControlEnabled");
   }
   else {
     // set the control
-    int cindex = _statusControlIndex[pipe];
     EN_API_CHECK(EN_setstatuscontrol(_enModel, cindex, EN_TIMER, linkIndex, (EN_API_FLOAT_TYPE)status, 0, (EN_API_FLOAT_TYPE)0.0), "EN_setcontrol");
     EN_API_CHECK(EN_setControlEnabled(_enModel, cindex, enEnableStatus), "EN_setControlEnabled");
   }
 }
 
-void EpanetModel::setPumpStatus(const string& pump, Pipe::status_t status) {
-  // call the setPipeStatus method, since they are the same in epanet.
-  setPipeStatus(pump, status);
-}
-
-void EpanetModel::setPumpStatusControl(const string& pump, Pipe::status_t status, enableControl_t enableStatus) {
-  // call the setPipeStatusControl method, since they are the same in epanet.
-  setPipeStatusControl(pump, status, enableStatus);
-}
-
-void EpanetModel::setPumpSetting(const string& pump, double setting) {
-  setLinkValue(EN_SETTING, pump, setting);
-}
-
-void EpanetModel::setPumpSettingControl(const string& pump, double setting, enableControl_t enableStatus) {
-  int linkIndex = _linkIndex[pump];
+void EpanetModel::setLinkSettingControlAtIndex(int index, double setting, enableControl_t enableStatus) {
+  if (index < 0 || index >= (int)_settingControlIndex.size()) {
+    EN_API_CHECK(204, "EN_addcontrol"); // undefined link
+  }
+  int linkIndex = index + 1;
   int enEnableStatus = (enableStatus == enable) ? EN_ENABLE : EN_DISABLE;
+  int& cindex = _settingControlIndex[index];
 
-  if (_settingControlIndex.count(pump) == 0) {
+  if (cindex == 0) {
     // if this element doesn't have a control, add one
-    int cindex;
     EN_API_CHECK(EN_addcontrol(_enModel, EN_TIMER, linkIndex, (EN_API_FLOAT_TYPE)setting, 0, (EN_API_FLOAT_TYPE)0.0, &cindex), "EN_addcontrol");
-    _settingControlIndex[pump] = cindex;
     EN_API_CHECK(EN_setControlEnabled(_enModel, cindex, enEnableStatus), "EN_setControlEnabled");
   }
   else {
     // set the control
-    int cindex = _settingControlIndex[pump];
     try {
       EN_API_CHECK(EN_setcontrol(_enModel, cindex, EN_TIMER, linkIndex, (EN_API_FLOAT_TYPE)setting, 0, (EN_API_FLOAT_TYPE)0.0), "EN_setcontrol");
       EN_API_CHECK(EN_setControlEnabled(_enModel, cindex, enEnableStatus), "EN_setControlEnabled");
@@ -782,15 +860,6 @@ void EpanetModel::setPumpSettingControl(const string& pump, double setting, enab
   }
 }
 
-void EpanetModel::setValveSetting(const string& valve, double setting) {
-  setLinkValue(EN_SETTING, valve, setting);
-}
-
-void EpanetModel::setValveSettingControl(const string& valve, double setting, enableControl_t enableStatus) {
-  // call the setPumpSettingControl method, since they are the same in epanet.
-  setPumpSettingControl(valve, setting, enableStatus);
-}
-
 #pragma mark Getters
 
 double EpanetModel::junctionDemand(const string &junction) {
@@ -851,6 +920,84 @@ double EpanetModel::pipeEnergy(const string &name) {
   return getLinkValue(EN_ENERGY, name);
 }
 
+#pragma mark Bulk Getters
+
+int EpanetModel::engineNodeCount() {
+  return (int)_nodeIndex.size();
+}
+
+int EpanetModel::engineLinkCount() {
+  return (int)_linkIndex.size();
+}
+
+void EpanetModel::fetchAllNodeValues(nodeQuantity_t quantity, double *out) {
+  int nodeCount = this->engineNodeCount();
+  int firstNode = 0;
+  int code = EN_HEAD;
+  
+  switch (quantity) {
+    case NodeHead:
+      code = EN_HEAD;
+      break;
+    case NodePressure:
+      code = EN_PRESSURE;
+      break;
+    case NodeDemand:
+      code = EN_DEMAND;
+      break;
+    case NodeQuality:
+      code = EN_QUALITY;
+      break;
+    case NodeTankVolume:
+      code = EN_TANKVOLUME;
+      firstNode = _junctionCount; // storage-only quantity
+      break;
+    case NodeInletQuality:
+      code = EN_INLETQUALITY;
+      firstNode = _junctionCount;
+      break;
+  }
+  
+  std::fill(out, out + firstNode, 0.);
+  
+  for (int i = firstNode; i < nodeCount; ++i) {
+    int err = EN_getnodevalue(_enModel, i + 1, code, &out[i]);
+    if (quantity == NodeInletQuality) {
+      if (err == EN_ERR_ILLEGAL_NUMERIC_VALUE) {
+        // this is a special edge-edge case: volume into the tank over this step is <= 0
+        out[i] = NAN;
+      }
+    }
+    else {
+      EN_API_CHECK(err, "EN_getnodevalue");
+    }
+  }
+}
+
+void EpanetModel::fetchAllLinkValues(linkQuantity_t quantity, double *out) {
+  int linkCount = this->engineLinkCount();
+  int code = EN_FLOW;
+  
+  switch (quantity) {
+    case LinkFlow:
+      code = EN_FLOW;
+      break;
+    case LinkSetting:
+      code = EN_SETTING;
+      break;
+    case LinkStatus:
+      code = EN_STATUS;
+      break;
+    case LinkEnergy:
+      code = EN_ENERGY;
+      break;
+  }
+  
+  for (int i = 0; i < linkCount; ++i) {
+    EN_API_CHECK(EN_getlinkvalue(_enModel, i + 1, code, &out[i]), "EN_getlinkvalue");
+  }
+}
+
 #pragma mark - Sim options
 void EpanetModel::enableControls() {
   for (int i = 1; i <= _controlCount; ++i) {
@@ -1094,21 +1241,21 @@ void EpanetModel::applyInitialQuality() {
 
   // Junctions
   for(Junction::_sp junc : this->junctions()) {
-    double qual = junc->state_quality;
+    double qual = junc->state(StateStore::Quality);
     int iNode = _nodeIndex[junc->name()];
     EN_API_CHECK(EN_setnodevalue(_enModel, iNode, EN_INITQUAL, qual), "EN_setnodevalue - EN_INITQUAL");
   }
   
   // Tanks
   for(Tank::_sp tank : this->tanks()) {
-    double qual = tank->state_quality;
+    double qual = tank->state(StateStore::Quality);
     int iNode = _nodeIndex[tank->name()];
     EN_API_CHECK(EN_setnodevalue(_enModel, iNode, EN_INITQUAL, qual), "EN_setnodevalue - EN_INITQUAL");
   }
   
   // reservoirs
   for(auto r: this->reservoirs()) {
-    double q = r->state_quality;
+    double q = r->state(StateStore::Quality);
     int iNode = _nodeIndex[r->name()];
     EN_API_CHECK(EN_setnodevalue(_enModel, iNode, EN_INITQUAL, q), "EN_setnodevalue - EN_INITIALQUAL");
   }
@@ -1127,7 +1274,7 @@ void EpanetModel::applyInitialTankLevels() {
   
   // Tanks
   for(Tank::_sp tank : this->tanks()) {
-    double level = tank->state_level;
+    double level = tank->state(StateStore::Level);
     int iNode = _nodeIndex[tank->name()];
     try {
       EN_API_CHECK(EN_setnodevalue(_enModel, iNode, EN_TANKLEVEL, level), "EN_setnodevalue - EN_TANKLEVEL");
@@ -1148,6 +1295,73 @@ void EpanetModel::applyInitialTankLevels() {
   EN_API_CHECK(EN_initH(_enModel, 10), "ENinitH");
 }
 
+void EpanetModel::applyInitialLinkStatus() {
+  if (!_enOpened) {
+    DebugLog << "Could not apply initial link status; engine not opened" << EOL;
+    return;
+  }
+  // links with a status boundary get theirs every step anyway, and check valves are never ours to set.
+  // takes effect at the next EN_initH (applyInitialTankLevels does one).
+  auto apply = [this](Pipe::_sp p) {
+    Valve::_sp v = std::dynamic_pointer_cast<Valve>(p);
+    if (p->statusBoundary() || (v && v->valveType == EN_CVPIPE)) {
+      return;
+    }
+    double status = p->state(StateStore::Status);
+    this->setLinkValue(EN_INITSTATUS, p->name(), (status > 0) ? 1. : 0.);
+  };
+  for (auto p : this->pipes()) {
+    apply(p);
+  }
+  for (auto p : this->pumps()) {
+    apply(p);
+  }
+  for (auto v : this->valves()) {
+    apply(v);
+  }
+}
+
+void EpanetModel::captureSegmentQuality(StateStore& states) {
+  states.clearSegments();
+  if (!_enOpened || !this->shouldRunWaterQuality()) {
+    return;
+  }
+  // the toolkit has no accessor for routing segments, so read the project's own lists.
+  // owners are the links, then the tanks; each list runs downstream to upstream. values stay in engine units.
+  const int owners = _enModel->network.Nlinks + _enModel->network.Ntanks;
+  for (int k = 1; k <= owners; ++k) {
+    states.beginSegmentOwner();
+    for (Pseg seg = _enModel->quality.FirstSeg[k]; seg != NULL; seg = seg->prev) {
+      states.appendSegment(seg->v, seg->c);
+    }
+  }
+}
+
+void EpanetModel::applySegmentQuality(const StateStore& states) {
+  if (!_enOpened || !this->shouldRunWaterQuality()) {
+    return;
+  }
+  const int owners = _enModel->network.Nlinks + _enModel->network.Ntanks;
+  if (states.segmentOwnerCount() != (size_t)owners) {
+    return; // nothing captured (or not from this network): keep the segments EN_initQ seeded
+  }
+  for (int k = 1; k <= owners; ++k) {
+    // hand the seeded segments back to the free list, the way the engine does, then rebuild the captured ones
+    Pseg& first = _enModel->quality.FirstSeg[k];
+    Pseg& last = _enModel->quality.LastSeg[k];
+    if (last != NULL) {
+      last->prev = _enModel->quality.FreeSeg;
+      _enModel->quality.FreeSeg = first;
+    }
+    first = last = NULL;
+    const size_t n = states.segmentCount(k - 1);
+    const double *v = states.segmentVolumes(k - 1), *c = states.segmentQualities(k - 1);
+    for (size_t i = 0; i < n; ++i) {
+      addseg(_enModel, k, v[i], c[i]);
+    }
+  }
+}
+
 void EpanetModel::updateEngineWithElementProperties(Element::_sp e) {
   
   //! update hydraulic engine representation with full list of properties from this element.
@@ -1224,8 +1438,8 @@ void EpanetModel::cleanupModelAfterSimulation() {
   for (int i = nC; i >= _controlCount + 1; --i) {
     EN_API_CHECK(EN_deletecontrol(_enModel, i), "EN_deletecontrol");
   }
-  _settingControlIndex.clear();
-  _statusControlIndex.clear();
+  std::fill(_settingControlIndex.begin(), _settingControlIndex.end(), 0);
+  std::fill(_statusControlIndex.begin(), _statusControlIndex.end(), 0);
   
   // TODO - revert base demands (and patterns!) back to their previous values
   
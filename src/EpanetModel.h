@@ -82,6 +82,21 @@ namespace RTX {
 
     // quality
     void setJunctionQuality(const std::string& junction, double quality);
+    virtual void captureSegmentQuality(StateStore& states);
+    virtual void applySegmentQuality(const StateStore& states);
+    
+    // bulk, index-addressed state exchange
+    int engineNodeCount();
+    int engineLinkCount();
+    void fetchAllNodeValues(nodeQuantity_t quantity, double *out);
+    void fetchAllLinkValues(linkQuantity_t quantity, double *out);
+    void setJunctionDemandAtIndex(int index, double demand);
+    void setJunctionQualityAtIndex(int index, double quality);
+    void setReservoirHeadAtIndex(int index, double head);
+    void setReservoirQualityAtIndex(int index, double quality);
+    void setTankLevelAtIndex(int index, double level);
+    void setLinkStatusControlAtIndex(int index, Pipe::status_t status, enableControl_t);
+    void setLinkSettingControlAtIndex(int index, double setting, enableControl_t);
     
     void setQualityOptions(QualityType qt, const std::string& traceNode = "");
     QualityType qualityType();
@@ -102,6 +117,7 @@ namespace RTX {
     virtual void setQualityTimeStep(int seconds);
     virtual void applyInitialQuality();
     virtual void applyInitialTankLevels();
+    virtual void applyInitialLinkStatus();
     void EN_API_CHECK(int errorCode, std::string externalFunction);
     void updateEngineWithElementProperties(Element::_sp e);
     virtual void cleanupModelAfterSimulation();
@@ -118,12 +134,14 @@ namespace RTX {
   private:
     std::map<std::string, int> _nodeIndex;
     std::map<std::string, int> _linkIndex;
-    std::map<std::string, int> _statusControlIndex;
-    std::map<std::string, int> _settingControlIndex;
+    std::vector<int> _statusControlIndex; // by link slot; 0 == no control added yet
+    std::vector<int> _settingControlIndex;
+    int _junctionCount; // epanet orders storage nodes after all junctions
     // TODO - use boost filesystem instead of std::string path
 //    std::string _modelFile;
     
     void createRtxWrappers();
+    void bindEngineIndices();
     bool _didConverge(time_t time, int errorCode);
     bool _enOpened;
     int _controlCount;
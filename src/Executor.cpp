@@ -0,0 +1,115 @@
+//
+//  Executor.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include "Executor.h"
+
+using namespace RTX;
+using namespace std;
+
+Executor& Executor::shared() {
+  static Executor executor([]() -> size_t {
+    size_t n = RTX_EXECUTOR_THREADS;
+    if (n == 0) {
+      n = thread::hardware_concurrency();
+    }
+    // the calling thread always helps, so one fewer worker fills the machine
+    return (n > 1) ? n - 1 : 1;
+  }());
+  return executor;
+}
+
+Executor::Executor(size_t nThreads) : _stop(false) {
+  for (size_t i = 0; i < nThreads; ++i) {
+    _threads.push_back(thread(&Executor::workerLoop, this));
+  }
+}
+
+Executor::~Executor() {
+  {
+    lock_guard<mutex> lock(_mtx);
+    _stop = true;
+  }
+  _jobReady.notify_all();
+  for (auto& t : _threads) {
+    if (t.joinable()) {
+      t.join();
+    }
+  }
+}
+
+void Executor::runClaimed(Job_sp job, size_t i) {
+  try {
+    job->fn(i);
+  } catch (...) {
+    lock_guard<mutex> lock(job->mtx);
+    if (!job->error) {
+      job->error = current_exception();
+    }
+  }
+  if (++job->finished == job->n) {
+    lock_guard<mutex> lock(job->mtx);
+    job->allDone.notify_all();
+  }
+}
+
+void Executor::parallelFor(size_t n, std::function<void(size_t)> fn) {
+  if (n == 0) {
+    return;
+  }
+  Job_sp job(new Job);
+  job->fn = fn;
+  job->n = n;
+
+  if (n > 1) {
+    {
+      lock_guard<mutex> lock(_mtx);
+      _jobs.push_back(job);
+    }
+    _jobReady.notify_all();
+  }
+
+  // pull our own weight
+  size_t i;
+  while ((i = job->next++) < n) {
+    runClaimed(job, i);
+  }
+
+  {
+    // everything is claimed. wait for any indices still running on workers.
+    unique_lock<mutex> lock(job->mtx);
+    job->allDone.wait(lock, [&]{ return job->finished == job->n; });
+  }
+
+  if (job->error) {
+    rethrow_exception(job->error);
+  }
+}
+
+void Executor::workerLoop() {
+  while (true) {
+    Job_sp job;
+    {
+      unique_lock<mutex> lock(_mtx);
+      _jobReady.wait(lock, [&]{
+        // drop jobs with nothing left to claim
+        while (!_jobs.empty() && _jobs.front()->next >= _jobs.front()->n) {
+          _jobs.pop_front();
+        }
+        return _stop || !_jobs.empty();
+      });
+      if (_stop) {
+        return;
+      }
+      job = _jobs.front();
+    }
+    size_t i;
+    while ((i = job->next++) < job->n) {
+      runClaimed(job, i);
+    }
+  }
+}
@@ -0,0 +1,74 @@
+//
+//  Executor.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_Executor_h
+#define epanet_rtx_Executor_h
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <exception>
+
+#include "rtxMacros.h"
+
+#ifndef RTX_EXECUTOR_THREADS
+#define RTX_EXECUTOR_THREADS 0 // zero means one per hardware thread
+#endif
+
+namespace RTX {
+
+  /*!
+   \class Executor
+   \brief A fixed pool of worker threads for fanning out independent work
+
+   parallelFor() runs fn(0) … fn(n-1) and returns when every call has finished. The calling thread claims indices as well, so a parallelFor issued from inside another one (an aggregator of aggregators, say) always makes progress on its own work and never waits on an idle pool. The pool never grows, so nesting does not oversubscribe the machine.
+
+   */
+
+  class Executor : public RTX_object {
+  public:
+    RTX_BASE_PROPS(Executor);
+
+    static Executor& shared();
+
+    Executor(size_t nThreads);
+    ~Executor();
+
+    size_t threadCount() { return _threads.size(); };
+    void parallelFor(size_t n, std::function<void(size_t)> fn); // rethrows the first exception thrown by fn
+
+  private:
+    class Job {
+    public:
+      std::function<void(size_t)> fn;
+      size_t n = 0;
+      std::atomic<size_t> next{0}, finished{0};
+      std::mutex mtx;
+      std::condition_variable allDone;
+      std::exception_ptr error;
+    };
+    typedef std::shared_ptr<Job> Job_sp;
+
+    static void runClaimed(Job_sp job, size_t i);
+    void workerLoop();
+
+    std::vector<std::thread> _threads;
+    std::deque<Job_sp> _jobs;
+    std::mutex _mtx;
+    std::condition_variable _jobReady;
+    bool _stop;
+  };
+
+}
+
+#endif
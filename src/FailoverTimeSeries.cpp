@@ -54,17 +54,16 @@ void FailoverTimeSeries::swapSourceWithFailover() {
 
 
 
-set<time_t> FailoverTimeSeries::timeValuesInRange(TimeRange range) {
+TimeList FailoverTimeSeries::timeValuesInRange(TimeRange range) {
   if (!this->secondary() || this->clock()) {
     return TimeSeriesFilter::timeValuesInRange(range);
   }
   else if (!this->clock()) {
-    set<time_t> times;
     PointCollection pc = this->filterPointsInRange(range);
     return pc.times();
   }
   
-  return set<time_t>();
+  return TimeList();
 }
 
 PointCollection FailoverTimeSeries::filterPointsInRange(TimeRange range) {
@@ -33,7 +33,7 @@ namespace RTX {
   protected:
     bool canSetSecondary(TimeSeries::_sp secondary);
     PointCollection filterPointsInRange(TimeRange range);
-    std::set<time_t> timeValuesInRange(TimeRange range);
+    TimeList timeValuesInRange(TimeRange range);
     bool canSetSource(TimeSeries::_sp ts);
     
   private:
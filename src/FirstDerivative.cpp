@@ -62,7 +62,7 @@ PointCollection FirstDerivative::filterPointsInRange(TimeRange range) {
   data.setPoints(outPoints);
   
   if (this->willResample()) {
-    set<time_t> timeValues = this->timeValuesInRange(range);
+    TimeList timeValues = this->timeValuesInRange(range);
     data.resample(timeValues);
   }
   
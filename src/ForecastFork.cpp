@@ -0,0 +1,127 @@
+//
+//  ForecastFork.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <chrono>
+#include <algorithm>
+
+#include "ForecastFork.h"
+#include "ScenarioRunner.h"
+
+using namespace RTX;
+using namespace std;
+
+ForecastFork::ForecastFork(EpanetModel::_sp liveModel, PointRecord::_sp record) : _liveModel(liveModel), _snapshotQuality(false), _running(false), _success(false) {
+  if (!_liveModel) {
+    throw RtxException("ForecastFork: no model to fork");
+  }
+  _model = ScenarioRunner::cloneModel(_liveModel);
+  _model->setName(_liveModel->name() + " :: forecast");
+  ScenarioRunner::shareInputs(_liveModel, _model);
+  // the inputs are the live model's records: a fork running hours ahead must not prefetch into them, or evict from them
+  _model->setBoundaryLookahead(0);
+  _model->setBoundaryEviction(false);
+  ScenarioRunner::routeOutputs(_model, record);
+  _model->initEngine();
+
+  _forkLatency.reset(new TimeSeries);
+  _forkLatency->name("duration,component=fork,generator=forecast")->units(RTX_SECOND);
+}
+
+ForecastFork::~ForecastFork() {
+  this->wait();
+}
+
+bool ForecastFork::fork(time_t duration) {
+  if (_running) {
+    return false;
+  }
+  auto t1 = chrono::steady_clock::now();
+
+  StateStore::_sp live = _liveModel->stateStore();
+  size_t nodeCount = live->size(StateStore::Head);
+  size_t linkCount = live->size(StateStore::Flow);
+  if (nodeCount == 0) {
+    return false; // nothing simulated yet
+  }
+  if (_thread.joinable()) {
+    _thread.join(); // already finished, so this doesn't wait
+  }
+  if (_snapshot.size(StateStore::Head) != nodeCount || _snapshot.size(StateStore::Flow) != linkCount) {
+    _snapshot.resize(nodeCount, linkCount);
+  }
+  for (int i = 0; i < StateStore::QuantityCount; ++i) {
+    StateStore::quantity_t q = (StateStore::quantity_t)i;
+    std::copy(live->column(q), live->column(q) + min(live->size(q), _snapshot.size(q)), _snapshot.column(q));
+  }
+  _snapshotQuality = _liveModel->shouldRunWaterQuality();
+  if (_snapshotQuality) {
+    _liveModel->captureSegmentQuality(_snapshot); // the water in the pipes, not just at the nodes
+  }
+  else {
+    _snapshot.clearSegments();
+  }
+  time_t start = _liveModel->currentSimulationTime();
+  bool tanksNeedReset = _liveModel->tanksNeedReset();
+
+  _running = true;
+  _thread = thread(&ForecastFork::run, this, start, start + duration, tanksNeedReset);
+
+  double latency = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+  _forkLatency->insert(Point(start, latency));
+  if (latency >= (double)_liveModel->hydraulicTimeStep()) {
+    cerr << "WARNING: forecast fork held up the live model for " << latency << " s" << endl;
+  }
+  return true;
+}
+
+bool ForecastFork::isRunning() {
+  return _running;
+}
+
+void ForecastFork::wait() {
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+}
+
+bool ForecastFork::success() {
+  lock_guard<mutex> lock(_resultMutex);
+  return _success;
+}
+
+std::string ForecastFork::errorMessage() {
+  lock_guard<mutex> lock(_resultMutex);
+  return _errorMessage;
+}
+
+void ForecastFork::run(time_t start, time_t end, bool tanksNeedReset) {
+  bool ok = false;
+  string message;
+  try {
+    _model->restoreState(_snapshot, start, _snapshotQuality);
+    if (tanksNeedReset) {
+      _model->setTanksNeedReset(true); // the live model was about to re-sync them, so the fork should too
+    }
+    _model->runForecast(start, end);
+    _model->waitForPendingSaves();
+    ok = true;
+  } catch (const std::exception& e) {
+    message = e.what();
+  } catch (const std::string& e) {
+    message = e;
+  }
+  if (!ok) {
+    cerr << "forecast fork failed: " << message << endl;
+  }
+  {
+    lock_guard<mutex> lock(_resultMutex);
+    _success = ok;
+    _errorMessage = message;
+  }
+  _running = false;
+}
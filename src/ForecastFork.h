@@ -0,0 +1,70 @@
+//
+//  ForecastFork.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_ForecastFork_h
+#define epanet_rtx_ForecastFork_h
+
+#include <string>
+#include <thread>
+#include <mutex>
+#include <atomic>
+
+#include "EpanetModel.h"
+#include "StateStore.h"
+#include "TimeSeries.h"
+#include "PointRecord.h"
+#include "rtxMacros.h"
+
+namespace RTX {
+
+  /*!
+   \class ForecastFork
+   \brief Branches forecasts off a running model without stopping it
+
+   Model::runForecast works on the live model: it turns controls back on and moves the tanks, so a realtime loop would have to stop while it runs. A ForecastFork keeps its own copy of the live model, cloned once up front (the expensive part: it loads the network and opens a second EPANET project). The copy shares the live model's inputs and writes to its own record. It never prefetches or evicts boundary data, because those records belong to the live model.
+
+   fork() copies the live model's state store (heads, levels, quality, link status, everything) into a buffer kept for the purpose. When quality is running, it also copies the quality segments inside each pipe. It then starts a worker thread and returns. That copy is all the live model waits for, and it does not allocate after the first fork. The worker loads the snapshot into the copy as initial conditions, the same way a checkpoint is loaded, and runs the forecast.
+
+   Call fork() on the live model's simulation thread, between steps (the did-simulate callback is a good place), so the snapshot is not taken while a step is writing its states. Each fork's latency, meaning the time the caller was held up, goes into forkLatency() in seconds.
+
+   */
+
+  class ForecastFork : public RTX_object {
+  public:
+    RTX_BASE_PROPS(ForecastFork);
+
+    ForecastFork(EpanetModel::_sp liveModel, PointRecord::_sp record);
+    ~ForecastFork();
+
+    bool fork(time_t duration); // forecast from the live model's current time; false if the last forecast is still running
+    bool isRunning();
+    void wait(); // block until the running forecast (if any) has finished and saved its states
+
+    EpanetModel::_sp model() { return _model; }; // the fork's own copy
+    TimeSeries::_sp forkLatency() { return _forkLatency; };
+    bool success();
+    std::string errorMessage();
+
+  private:
+    void run(time_t start, time_t end, bool tanksNeedReset);
+
+    EpanetModel::_sp _liveModel, _model;
+    StateStore _snapshot;
+    bool _snapshotQuality;
+    TimeSeries::_sp _forkLatency;
+
+    std::thread _thread;
+    std::atomic<bool> _running;
+    std::mutex _resultMutex;
+    bool _success;
+    std::string _errorMessage;
+  };
+
+}
+
+#endif
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <regex>
 #include <boost/lexical_cast.hpp>
 #include <boost/algorithm/string/replace.hpp>
@@ -214,6 +215,63 @@ void InfluxAdapter::insertRange(const std::string& id, std::vector<Point> points
   
 }
 
+// handles index the escaped measurement+tags key, so the id parsing in influxIdForTsId happens once per series.
+DbAdapter::seriesHandle_t InfluxAdapter::resolveSeriesHandle(const std::string& id) {
+  string key = influxIdForTsId(id);
+  boost::replace_all(key, " ", "\\ ");
+  _RTX_DB_SCOPED_LOCK;
+  auto found = _snapshotHandles.find(id);
+  if (found != _snapshotHandles.end()) {
+    return found->second;
+  }
+  _snapshotIds.push_back(key);
+  return _snapshotHandles[id] = _snapshotIds.size() - 1;
+}
+
+void InfluxAdapter::insertSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values) {
+  if (handles.size() == 0) {
+    return;
+  }
+  // every line shares the same fields suffix and timestamp
+  const string tail = ",quality=" + to_string((int)Point::opc_rtx_override) + "i,confidence=0 " + this->formatTimestamp(time);
+  
+  vector<string> content;
+  content.reserve(handles.size());
+  {
+    _RTX_DB_SCOPED_LOCK;
+    const size_t n = std::min(handles.size(), values.size());
+    for (size_t i = 0; i < n; ++i) {
+      if (handles[i] >= _snapshotIds.size() || _snapshotIds[handles[i]].empty()) {
+        continue;
+      }
+      string line = _snapshotIds[handles[i]];
+      line.append(" value=");
+      line.append(to_string(values[i]));
+      line.append(tail);
+      content.push_back(std::move(line));
+    }
+  }
+  
+  if (_inTransaction) {
+    size_t nLines = 0;
+    { // mutex
+      _RTX_DB_SCOPED_LOCK;
+      _transactionLines.insert(_transactionLines.end(), std::make_move_iterator(content.begin()), std::make_move_iterator(content.end()));
+      nLines = _transactionLines.size();
+    } // end mutex
+    if (nLines > maxTransactionLines()) {
+      this->commitTransactionLines();
+    }
+  }
+  else {
+    {
+      _RTX_DB_SCOPED_LOCK;
+      _transactionLines = std::move(content);
+    }
+    this->commitTransactionLines();
+  }
+}
+
 
 void InfluxAdapter::sendInfluxString(time_t time, const string& seriesId, const string& values) {
   
@@ -608,13 +666,7 @@ std::map<std::string, std::vector<Point> > InfluxTcpAdapter::wideQuery(TimeRange
   string nextQuery = "SELECT time, value, quality, confidence FROM /.*/ WHERE time > " + to_string(range.end) + "s GROUP BY * order by time asc limit 1";
   
   auto qstr = prevQuery + ";" + ss.str() + ";" + nextQuery;
-  json jsv;
-  try {
-    auto response = _restClient->doQueryWithTimePrecision(this->conn.getAuthString(), this->conn.db, encodeQuery(qstr), "s");
-    jsv = jsonFromResponse(response);
-  } catch (const std::exception &err) {
-    cerr << "error executing query: " << err.what() << endl;
-  }
+  json jsv = this->selectJson(qstr);
   
   
   map<string, vector<Point> > fetch = __pointsFromJson(jsv);
@@ -630,17 +682,79 @@ std::vector<Point> InfluxTcpAdapter::selectRange(const std::string& id, TimeRang
   q.where.push_back("time >= " + to_string(range.start) + "s");
   q.where.push_back("time <= " + to_string(range.end) + "s");
   
-  json jsv;
-  try {
-    auto response = _restClient->doQueryWithTimePrecision(this->conn.getAuthString(), this->conn.db, encodeQuery(q.selectStr()), "s");
-    jsv = jsonFromResponse(response);
-  } catch (const std::exception &err) {
-    cerr << "error executing query: " << err.what() << endl;
-  }
+  json jsv = this->selectJson(q.selectStr());
   
   return __pointsSingle(jsv);
 }
 
+std::map<std::string, std::vector<Point> > InfluxTcpAdapter::selectRanges(const std::vector<std::string>& ids, TimeRange range) {
+  // one statement per series (each has its own tag filter), sent together as a multi-statement request
+  vector<string> statements;
+  for (const string& id : ids) {
+    Query q = this->queryPartsFromMetricId(influxIdForTsId(id));
+    q.where.push_back("time >= " + to_string(range.start) + "s");
+    q.where.push_back("time <= " + to_string(range.end) + "s");
+    statements.push_back(q.selectStr());
+  }
+  
+  map<string, vector<Point> > out;
+  auto results = this->selectStatements(statements);
+  for (size_t i = 0; i < results.size() && i < ids.size(); ++i) {
+    if (!results[i].empty()) {
+      out[ids[i]] = results[i];
+    }
+  }
+  return out;
+}
+
+std::map<std::string, Point> InfluxTcpAdapter::selectPreviousMany(const std::vector<std::string>& ids, time_t time) {
+  vector<string> statements;
+  for (const string& id : ids) {
+    Query q = this->queryPartsFromMetricId(influxIdForTsId(id));
+    q.where.push_back("time < " + to_string(time) + "s");
+    q.order = "time desc limit 1";
+    statements.push_back(q.selectStr());
+  }
+  
+  map<string, Point> out;
+  auto results = this->selectStatements(statements);
+  for (size_t i = 0; i < results.size() && i < ids.size(); ++i) {
+    if (!results[i].empty()) {
+      out[ids[i]] = results[i].front();
+    }
+  }
+  return out;
+}
+
+vector<vector<Point> > InfluxTcpAdapter::selectStatements(const vector<string>& statements) {
+  vector<vector<Point> > out(statements.size());
+  
+  for (size_t first = 0; first < statements.size(); first += RTX_INFLUX_STATEMENTS_PER_REQUEST) {
+    size_t count = std::min((size_t)RTX_INFLUX_STATEMENTS_PER_REQUEST, statements.size() - first);
+    vector<string> batch(statements.begin() + first, statements.begin() + first + count);
+    
+    json jsv = this->selectJson(boost::algorithm::join(batch, ";"));
+    if (jsv[kRESULTS].size() != count) {
+      throw runtime_error("error executing query: expected " + to_string(count) + " results, got " + to_string(jsv[kRESULTS].size()));
+    }
+    // results come back one per statement, tagged with the statement's index in the request
+    size_t iResult = 0;
+    for (auto &statement : jsv[kRESULTS]) {
+      size_t iStatement = iResult++;
+      if (statement.is_object() && statement.contains("statement_id") && statement["statement_id"].is_number_integer()) {
+        iStatement = statement["statement_id"].get<size_t>();
+      }
+      if (iStatement >= count) {
+        continue;
+      }
+      json single = {{kRESULTS, json::array({statement})}};
+      out[first + iStatement] = __pointsSingle(single);
+    }
+  }
+  
+  return out;
+}
+
 vector<string> _makeSelectStrs(WhereClause q);
 vector<string> _makeSelectStrs(WhereClause q) {
   vector<string> clauses;
@@ -681,13 +795,7 @@ Point InfluxTcpAdapter::selectNext(const std::string& id, time_t time, WhereClau
     }
   }
   
-  json jsv;
-  try {
-    auto response = _restClient->doQueryWithTimePrecision(this->conn.getAuthString(), this->conn.db, encodeQuery(q.selectStr()), "s");
-    jsv = jsonFromResponse(response);
-  } catch (const std::exception &err) {
-    cerr << "error executing query: " << err.what() << endl;
-  }
+  json jsv = this->selectJson(q.selectStr());
   
   points = __pointsSingle(jsv);
   
@@ -715,13 +823,7 @@ Point InfluxTcpAdapter::selectPrevious(const std::string& id, time_t time, Where
     }
   }
   
-  json jsv;
-  try {
-    auto response = _restClient->doQueryWithTimePrecision(this->conn.getAuthString(), this->conn.db, encodeQuery(q.selectStr()), "s");
-    jsv = jsonFromResponse(response);
-  } catch (const std::exception &err) {
-    cerr << "error executing query: " << err.what() << endl;
-  }
+  json jsv = this->selectJson(q.selectStr());
   
   points = __pointsSingle(jsv);
   
@@ -769,13 +871,7 @@ vector<Point> InfluxTcpAdapter::selectWithQuery(const std::string& query, TimeRa
   else {
     qStr += " order by asc";
   }
-  json jsv;
-  try {
-    auto response = _restClient->doQueryWithTimePrecision(this->conn.getAuthString(), this->conn.db, encodeQuery(qStr), "s");
-    jsv = jsonFromResponse(response);
-  } catch (const std::exception &err) {
-    cerr << "error executing query: " << err.what() << endl;
-  }
+  json jsv = this->selectJson(qStr);
   
   auto points = __pointsSingle(jsv);
   return points;
@@ -900,6 +996,41 @@ json InfluxTcpAdapter::jsonFromResponse(const std::shared_ptr<Response> response
   }
 }
 
+json InfluxTcpAdapter::selectJson(const std::string& query) {
+  // unlike jsonFromResponse, anything short of a complete answer is an error.
+  // the record remembers empty results, so "no data" must never stand in for "no response".
+  string body;
+  try {
+    auto response = _restClient->doQueryWithTimePrecision(this->conn.getAuthString(), this->conn.db, encodeQuery(query), "s");
+    if (response == nullptr) {
+      throw runtime_error("no response");
+    }
+    body = response->readBodyToString().getValue("");
+    if (response->getStatusCode() != 200) {
+      throw runtime_error(to_string(response->getStatusCode()) + " " + response->getStatusDescription()->c_str() + " - " + body);
+    }
+  } catch (const std::exception &err) {
+    throw runtime_error(string("error executing query: ") + err.what());
+  }
+  
+  if (!json::accept(body)) {
+    throw runtime_error("error executing query: response is not JSON");
+  }
+  json js = json::parse(body);
+  if (js.is_object() && js.contains(kERROR)) {
+    throw runtime_error("error executing query: " + js[kERROR].dump());
+  }
+  if (!js.is_object() || !js.contains(kRESULTS) || !js[kRESULTS].is_array()) {
+    throw runtime_error("error executing query: JSON Format Not Recognized");
+  }
+  for (auto &statement : js[kRESULTS]) {
+    if (statement.is_object() && statement.contains(kERROR)) {
+      throw runtime_error("error executing query: " + statement[kERROR].dump());
+    }
+  }
+  return js;
+}
+
 
 vector<Point> InfluxTcpAdapter::__pointsSingle(json& json) {
   auto multi = __pointsFromJson(json);
@@ -25,6 +25,11 @@
 #include "DbAdapter.h"
 #include "InfluxClient.hpp"
 
+// batched reads send one statement per series; this caps how many go in a single request (the query rides in the url)
+#ifndef RTX_INFLUX_STATEMENTS_PER_REQUEST
+#define RTX_INFLUX_STATEMENTS_PER_REQUEST 50
+#endif
+
 namespace RTX {
   class InfluxAdapter : public DbAdapter {
   public:
@@ -42,6 +47,8 @@ namespace RTX {
     bool insertIdentifierAndUnits(const std::string& id, Units units);
     void insertSingle(const std::string& id, Point point);
     void insertRange(const std::string& id, std::vector<Point> points);
+    seriesHandle_t resolveSeriesHandle(const std::string& id);
+    void insertSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values);
     
     // UPDATE
     bool assignUnitsToRecord(const std::string& name, const Units& units);
@@ -99,6 +106,8 @@ namespace RTX {
     Point selectNext(const std::string& id, time_t time, WhereClause q = WhereClause());
     Point selectPrevious(const std::string& id, time_t time, WhereClause q = WhereClause());
     std::vector<Point> selectWithQuery(const std::string& query, TimeRange range);
+    std::map<std::string, std::vector<Point> > selectRanges(const std::vector<std::string>& ids, TimeRange range);
+    std::map<std::string, Point> selectPreviousMany(const std::vector<std::string>& ids, time_t time);
 
     
     // PREFETCH
@@ -132,9 +141,11 @@ namespace RTX {
     std::future<void> sendPointsFuture;
 
     Query queryPartsFromMetricId(const std::string& name);
+    std::vector<std::vector<Point> > selectStatements(const std::vector<std::string>& statements); // one result per statement, in order
     
     std::string encodeQuery(std::string queryString);
     nlohmann::json jsonFromResponse(const std::shared_ptr<Response> response);
+    nlohmann::json selectJson(const std::string& query); // throws unless every statement came back
     
     static std::map<std::string, std::vector<Point> > __pointsFromJson(nlohmann::json& json);
     static std::vector<Point> __pointsSingle(nlohmann::json& json);
@@ -100,7 +100,7 @@ PointCollection IntegratorTimeSeries::filterPointsInRange(TimeRange range) {
   data.convertToUnits(this->units());
   
   if (this->willResample()) {
-    set<time_t> timeValues = this->timeValuesInRange(range);
+    TimeList timeValues = this->timeValuesInRange(range);
     data.resample(timeValues);
   }
   return data;
@@ -29,13 +29,7 @@ Junction::Junction(const std::string& name) : Node(name) {
   _baseDemand = 0;
   
   
-  state_head = 0;
-  state_pressure = 0; 
-  state_demand = 0;
-  state_quality = 0;
-  state_inlet_quality = 0;
-  state_volume = 0;
-  state_flow = 0;
+  engineIndex = -1;
 }
 Junction::~Junction() {
   
@@ -49,6 +43,23 @@ void Junction::setBaseDemand(double demand) {
   _baseDemand = demand;
 }
 
+double Junction::state(StateStore::quantity_t quantity) {
+  if (!_stateStore) {
+    return 0;
+  }
+  return _stateStore->value(quantity, engineIndex);
+}
+
+void Junction::setState(StateStore::quantity_t quantity, double value) {
+  if (_stateStore) {
+    _stateStore->setValue(quantity, engineIndex, value);
+  }
+}
+
+void Junction::setStateStore(StateStore::_sp store) {
+  _stateStore = store;
+}
+
  void Junction::setRecord(PointRecord::_sp record) {
   _headState->setRecord(record);
   _pressureState->setRecord(record);
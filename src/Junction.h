@@ -10,6 +10,7 @@
 #define epanet_rtx_junction_h
 
 #include "Node.h"
+#include "StateStore.h"
 
 namespace RTX {
   
@@ -34,8 +35,14 @@ namespace RTX {
     TimeSeries::_sp demand();
     TimeSeries::_sp quality();
     
-    // public ivars for temporary (that is, steady-state) solutions
-    double state_head, state_pressure, state_demand, state_quality, state_inlet_quality, state_volume, state_flow;
+    // temporary (that is, steady-state) solutions, kept in the model's columnar state store
+    double state(StateStore::quantity_t quantity);
+    void setState(StateStore::quantity_t quantity, double value);
+    void setStateStore(StateStore::_sp store);
+    
+    // zero-based slot of this node in the engine's bulk state arrays, which is also
+    // its offset into the state store columns (-1 if not bound to an engine)
+    int engineIndex;
     
     
     // parameters
@@ -67,6 +74,7 @@ namespace RTX {
     TimeSeries::_sp _qualityState;
     // properties
     double _baseDemand;
+    StateStore::_sp _stateStore;
     
   }; // Junction
   
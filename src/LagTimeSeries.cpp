@@ -82,19 +82,14 @@ bool LagTimeSeries::willResample() {
 }
 
 
-set<time_t> LagTimeSeries::timeValuesInRange(TimeRange range) {
+TimeList LagTimeSeries::timeValuesInRange(TimeRange range) {
   if (this->clock()) {
     return this->clock()->timeValuesInRange(range);
   }
   TimeRange lagRange = range;
   lagRange.start -= _lag;
   lagRange.end -= _lag;
-  set<time_t> sourceTimes = TimeSeriesFilter::timeValuesInRange(lagRange);
-  set<time_t> outTimes;
-  for(time_t t: sourceTimes) {
-    outTimes.insert(t + _lag);
-  }
-  return outTimes;
+  return TimeSeriesFilter::timeValuesInRange(lagRange).shifted(_lag);
 }
 
 PointCollection LagTimeSeries::filterPointsInRange(TimeRange range) {
@@ -118,7 +113,7 @@ PointCollection LagTimeSeries::filterPointsInRange(TimeRange range) {
   bool dataOk = false;
   dataOk = data.convertToUnits(this->units());
   if (dataOk && this->willResample()) {
-    set<time_t> timeValues = this->timeValuesInRange(range);
+    TimeList timeValues = this->timeValuesInRange(range);
     dataOk = data.resample(timeValues);
   }
   
@@ -31,7 +31,7 @@ namespace RTX {
   protected:
     bool willResample();
     PointCollection filterPointsInRange(TimeRange range);
-    std::set<time_t> timeValuesInRange(TimeRange range);
+    TimeList timeValuesInRange(TimeRange range);
     
   private:
     time_t _lag;
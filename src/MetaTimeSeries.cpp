@@ -36,8 +36,8 @@ PointCollection MetaTimeSeries::filterPointsInRange(TimeRange range) {
   }
   
   auto raw = sourceData.raw();
-  vector<Point>::const_iterator it = raw.first;
-  vector<Point>::const_iterator prev = it;
+  PointCollection::pvIt it = raw.first;
+  PointCollection::pvIt prev = it;
   if (_metaMode == MetaModeGap) {
     ++it;
   }
@@ -72,7 +72,7 @@ PointCollection MetaTimeSeries::filterPointsInRange(TimeRange range) {
   gaps.convertToUnits(this->units());
   
   if (this->willResample()) {
-    set<time_t> times = this->timeValuesInRange(range);
+    TimeList times = this->timeValuesInRange(range);
     gaps.resample(times);
   }
   
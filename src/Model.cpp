@@ -8,6 +8,10 @@
 
 
 #include <iostream>
+#include <fstream>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
 #include <set>
 #include <boost/lexical_cast.hpp>
 #include "Model.h"
@@ -29,6 +33,7 @@
 
 #include <boost/range/adaptors.hpp>
 #include <future>
+#include <chrono>
 
 #include <thread>
 #include <mutex>
@@ -46,7 +51,7 @@ Model::Model() : _flowUnits(1), _headUnits(1), _pressureUnits(1) {
   this->initObj();
 }
 Model::~Model() {
-  
+  _savePipeline.reset(); // flush queued states while the stats series are still alive
 }
 
 void Model::initObj() {
@@ -72,6 +77,12 @@ void Model::initObj() {
   _simWallTime->name("duration,component=simulate,generator=simulation")->units(RTX_SECOND);
   _saveWallTime.reset(new TimeSeries);
   _saveWallTime->name("duration,component=save,generator=simulation")->units(RTX_SECOND);
+  _saveQueueDepth.reset(new TimeSeries);
+  _saveQueueDepth->name("depth,component=save_queue,generator=simulation")->units(RTX_DIMENSIONLESS);
+  _saveStallTime.reset(new TimeSeries);
+  _saveStallTime->name("duration,component=save_stall,generator=simulation")->units(RTX_SECOND);
+  _saveThroughput.reset(new TimeSeries);
+  _saveThroughput->name("throughput,component=save,generator=simulation")->units(RTX_HERTZ);
   
   _filterWallTime.reset(new TimeSeries);
   _filterWallTime->name("duration,component=filter,generator=simulation")->units(RTX_SECOND);
@@ -79,6 +90,9 @@ void Model::initObj() {
   _doesOverrideDemands = false;
   _shouldRunWaterQuality = false;
   
+  _stateStore.reset( new StateStore );
+  _stateConversionsValid = false;
+  
   _dmaShouldDetectClosedLinks = false;
   _dmaPipesToIgnore = vector<Pipe::_sp>();
   
@@ -90,10 +104,15 @@ void Model::initObj() {
   _shouldCancelSimulation = false;
   _tanksNeedReset = false;
   
+  _boundaryPlanner.reset(new QueryPlanner);
+  _boundaryPrefetcher.reset(new LookaheadPrefetcher(_boundaryPlanner, RTX_BOUNDARY_LOOKAHEAD));
+  _boundaryPrefetcher->setEvicting(RTX_BOUNDARY_EVICTION);
+  _boundaryPlanValid = false;
+  
   _simLogCallback = NULL;
   _didSimulateCallback = NULL;
   
-  _saveStateFuture = async(launch::async, [&](){return;});
+  _savePipeline.reset( new SavePipeline([this](StateSnapshot& snapshot){ this->writeNetworkStates(snapshot); }) );
 }
 
 
@@ -181,6 +200,11 @@ void Model::setDidSimulateCallback(std::function<void(time_t)> cb) {
   _didSimulateCallback = cb;
 }
 
+void Model::setStateHandler(std::function<void(StateSnapshot&)> handler) {
+  this->waitForPendingSaves(); // the writers call it
+  _stateHandler = handler;
+}
+
 void Model::logLine(const std::string& line) {
   DebugLog << line << EOL << flush;
   string myLine(line);
@@ -226,6 +250,7 @@ void Model::setFlowUnits(Units units)    {
     return;
   }
   _flowUnits = units;
+  _stateConversionsValid = false;
   for(Node::_sp n : this->nodes()) {
     auto j = dynamic_pointer_cast<Junction>(n);
     j->demand()->setUnits(units);
@@ -241,6 +266,7 @@ void Model::setFlowUnits(Units units)    {
 }
 void Model::setHeadUnits(Units units)    {
   _headUnits = units;
+  _stateConversionsValid = false;
   for(Node::_sp n : this->nodes()) {
     auto j = dynamic_pointer_cast<Junction>(n);
     j->head()->setUnits(units);
@@ -251,6 +277,7 @@ void Model::setHeadUnits(Units units)    {
 }
 void Model::setPressureUnits(Units units) {
   _pressureUnits = units;
+  _stateConversionsValid = false;
   for(Node::_sp n : this->nodes()) {
     Junction::_sp j = dynamic_pointer_cast<Junction>(n);
     j->pressure()->setUnits(units);
@@ -258,6 +285,7 @@ void Model::setPressureUnits(Units units) {
 }
 void Model::setQualityUnits(Units units) {
   _qualityUnits = units;
+  _stateConversionsValid = false;
   for(Node::_sp n : this->nodes()) {
     Junction::_sp j = dynamic_pointer_cast<Junction>(n);
     j->quality()->setUnits(units);
@@ -269,6 +297,7 @@ void Model::setQualityUnits(Units units) {
 
 void Model::setVolumeUnits(RTX::Units units) {
   _volumeUnits = units;
+  _stateConversionsValid = false;
   for(Tank::_sp t : this->tanks()) {
     t->volume()->setUnits(units);
     t->volumeCalc()->setUnits(units);
@@ -292,6 +321,9 @@ void Model::setRecordForSimulationStats(PointRecord::_sp record) {
   _heartbeat->setRecord(record);
   _simWallTime->setRecord(record);
   _saveWallTime->setRecord(record);
+  _saveQueueDepth->setRecord(record);
+  _saveStallTime->setRecord(record);
+  _saveThroughput->setRecord(record);
   _filterWallTime->setRecord(record);
 }
 
@@ -299,6 +331,19 @@ TimeSeries::_sp Model::heartbeat() {
   return _heartbeat;
 }
 
+std::vector<TimeSeries::_sp> Model::solverStats() {
+  return {_relativeError, _iterations, _convergence, _simWallTime, _filterWallTime, _saveStallTime, _saveQueueDepth};
+}
+
+void Model::recordDmaDemands(TimeRange range) {
+  if (!_doesOverrideDemands) {
+    return;
+  }
+  for (Dma::_sp dma : this->dmas()) {
+    dma->demand()->points(range);
+  }
+}
+
 
 void Model::refreshRecordsForModeledStates() {
   set<PointRecord::_sp> stateRecordsUsed;
@@ -717,7 +762,9 @@ void Model::runSinglePeriod(time_t time) {
 
 bool Model::solveInitial(time_t simTime) {
   _regularMasterClock->setStart(simTime);
+  _boundaryPlanValid = false; // boundaries may have been re-wired since the last run
   this->setCurrentSimulationTime(simTime);
+  _stateConversionsValid = false; // pick up any changes to element units
   
   if (_willSimulateCallback != NULL) {
     _willSimulateCallback(simTime);
@@ -788,16 +835,28 @@ bool Model::solveAndSaveOutputAtTime(time_t simulationTime) {
     auto stateRecordsUsed = _recordsForModeledStates;
     // tell each element to update its derived states (simulation-computed values)
     if (!_simReportClock || _simReportClock->isValid(simulationTime)) {
-      if (_saveStateFuture.valid()) {
-        _saveStateFuture.wait();
-      }
       this->fetchSimulationStates();
       
       if (_didSimulateCallback != NULL) {
         this->_didSimulateCallback(simulationTime);
       }
-      _saveStateFuture = async(launch::async, &Model::saveNetworkStates, this, simulationTime, stateRecordsUsed);
       
+      // copy the states into a free slot and move on; the writer thread takes it from here.
+      double stall = 0;
+      StateSnapshot& snapshot = _savePipeline->acquire(stall);
+      snapshot.time = simulationTime;
+      snapshot.bulkRecords = stateRecordsUsed;
+      this->captureNetworkStates(snapshot);
+      _savePipeline->submit();
+      
+      _saveStallTime->insert(Point(simulationTime, stall));
+      _saveQueueDepth->insert(Point(simulationTime, (double)_savePipeline->depth()));
+    }
+    if (_checkpointClock && _checkpointClock->isValid(simulationTime)) {
+      if (_simReportClock && !_simReportClock->isValid(simulationTime)) {
+        this->fetchSimulationStates(); // not fetched above
+      }
+      this->saveCheckpoint(_checkpointPath);
     }
   }
   return success;
@@ -871,6 +930,7 @@ void Model::runExtendedPeriod(time_t start, time_t end) {
   
   this->solveInitial(start);
   this->updateSimulationToTime(end);
+  this->waitForPendingSaves();
   this->cleanupModelAfterSimulation();
   
   _shouldCancelSimulation = false;
@@ -899,6 +959,8 @@ void Model::runForecast(time_t start, time_t end) {
   
   
   this->enableControls();
+  this->waitForPendingSaves(); // don't interleave with realtime states still in the queue
+  _boundaryPlanValid = false;
   
   // get the record(s) being used
   this->refreshRecordsForModeledStates();
@@ -1005,17 +1067,17 @@ void Model::setInitialQualityConditionsFromHotStart(time_t time) {
   for (auto &j : this->junctions()) {
     Point p = j->quality()->pointAtOrBefore(time);
     if (p.isValid) {
-      j->state_quality = p.value;
+      j->setState(StateStore::Quality, p.value);
     }
     else {
       cerr << "invalid point for junction: " << j->name() << endl;
     }
   }
   for(auto t : this->tanks()) {
-    t->state_quality = t->quality()->pointAtOrBefore(time).value;
+    t->setState(StateStore::Quality, t->quality()->pointAtOrBefore(time).value);
   }
   for(auto r : this->reservoirs()) {
-    r->state_quality = r->quality()->pointAtOrBefore(time).value;
+    r->setState(StateStore::Quality, r->quality()->pointAtOrBefore(time).value);
   }
   
   this->applyInitialQuality();
@@ -1025,13 +1087,13 @@ void Model::setInitialJunctionUniformQuality(double qual) {
   _initialQuality = qual;
   // Constant initial quality of Junctions and Tanks (Reservoirs are boundary conditions)
   for(Junction::_sp junc : this->junctions()) {
-    junc->state_quality = qual;
+    junc->setState(StateStore::Quality, qual);
   }
   for(Tank::_sp tank : this->tanks()) {
-    tank->state_quality = qual;
+    tank->setState(StateStore::Quality, qual);
   }
   for(auto r : this->reservoirs()) {
-    r->state_quality = qual;
+    r->setState(StateStore::Quality, qual);
   }
   this->applyInitialQuality();
 }
@@ -1040,6 +1102,174 @@ void Model::setTankResetClock(Clock::_sp resetClock) {
   _tankResetClock = resetClock;
 }
 
+Clock::_sp Model::tankResetClock() {
+  return _tankResetClock;
+}
+
+void Model::setBoundaryLookahead(time_t seconds) {
+  _boundaryPrefetcher->setLookahead(seconds);
+}
+
+time_t Model::boundaryLookahead() {
+  return _boundaryPrefetcher->lookahead();
+}
+
+void Model::setBoundaryEviction(bool evict) {
+  _boundaryPrefetcher->setEvicting(evict);
+}
+
+bool Model::boundaryEviction() {
+  return _boundaryPrefetcher->evicting();
+}
+
+#pragma mark - Checkpoints
+
+// file layout, native endian: magic, format version, model hash (length-prefixed), simulation time, flags, then the state store columns and quality segments.
+static const char _rtx_checkpoint_magic[8] = {'R','T','X','H','O','T','S','T'};
+static const uint32_t _rtx_checkpoint_version = 2;
+static const uint32_t _rtx_checkpoint_quality = 1 << 0;
+
+void Model::setCheckpointFile(const std::string& path, Clock::_sp clock) {
+  _checkpointPath = path;
+  _checkpointClock = path.empty() ? Clock::_sp() : clock;
+  _checkpointHash.clear();
+}
+
+bool Model::saveCheckpoint(const std::string& path) {
+  if (_stateStore->size(StateStore::Head) != (size_t)this->engineNodeCount() || _stateStore->size(StateStore::Flow) != (size_t)this->engineLinkCount()) {
+    return false; // nothing simulated yet
+  }
+  if (_checkpointHash.empty()) {
+    _checkpointHash = this->modelHash();
+  }
+  if (this->shouldRunWaterQuality()) {
+    this->captureSegmentQuality(*_stateStore);
+  }
+  else {
+    _stateStore->clearSegments();
+  }
+  
+  // write beside the target and swap it in, so a crash mid-write never leaves a torn checkpoint
+  string tmpPath = path + ".tmp";
+  {
+    ofstream out(tmpPath, ios::binary | ios::trunc);
+    if (!out) {
+      cerr << "could not write checkpoint: " << tmpPath << endl;
+      return false;
+    }
+    uint32_t hashLength = (uint32_t)_checkpointHash.size();
+    int64_t simTime = (int64_t)this->currentSimulationTime();
+    uint32_t flags = this->shouldRunWaterQuality() ? _rtx_checkpoint_quality : 0;
+    out.write(_rtx_checkpoint_magic, sizeof(_rtx_checkpoint_magic));
+    out.write((const char*)&_rtx_checkpoint_version, sizeof(_rtx_checkpoint_version));
+    out.write((const char*)&hashLength, sizeof(hashLength));
+    out.write(_checkpointHash.data(), hashLength);
+    out.write((const char*)&simTime, sizeof(simTime));
+    out.write((const char*)&flags, sizeof(flags));
+    _stateStore->write(out);
+    if (!out) {
+      cerr << "could not write checkpoint: " << tmpPath << endl;
+      return false;
+    }
+  }
+  if (rename(tmpPath.c_str(), path.c_str()) != 0) {
+    cerr << "could not replace checkpoint: " << path << endl;
+    return false;
+  }
+  return true;
+}
+
+time_t Model::loadCheckpoint(const std::string& path) {
+  ifstream in(path, ios::binary);
+  if (!in) {
+    return 0;
+  }
+  char magic[sizeof(_rtx_checkpoint_magic)];
+  uint32_t version = 0, hashLength = 0, flags = 0;
+  int64_t simTime = 0;
+  in.read(magic, sizeof(magic));
+  in.read((char*)&version, sizeof(version));
+  in.read((char*)&hashLength, sizeof(hashLength));
+  if (!in || memcmp(magic, _rtx_checkpoint_magic, sizeof(magic)) != 0 || version != _rtx_checkpoint_version || hashLength > 1024) {
+    cerr << "not a checkpoint this version can read: " << path << endl;
+    return 0;
+  }
+  string hash(hashLength, '\0');
+  in.read(&hash[0], hashLength);
+  in.read((char*)&simTime, sizeof(simTime));
+  in.read((char*)&flags, sizeof(flags));
+  if (!in || hash != this->modelHash()) {
+    cerr << "checkpoint was saved from a different model: " << path << endl;
+    return 0;
+  }
+  
+  StateStore loaded;
+  if (!loaded.read(in) || loaded.size(StateStore::Head) != (size_t)this->engineNodeCount() || loaded.size(StateStore::Flow) != (size_t)this->engineLinkCount()) {
+    cerr << "checkpoint is damaged or does not match the engine: " << path << endl;
+    return 0;
+  }
+  
+  this->restoreState(loaded, (time_t)simTime, (flags & _rtx_checkpoint_quality) != 0);
+  return (time_t)simTime;
+}
+
+void Model::restoreState(const StateStore& states, time_t time, bool quality) {
+  if (_stateStore->size(StateStore::Head) != states.size(StateStore::Head) || _stateStore->size(StateStore::Flow) != states.size(StateStore::Flow)) {
+    this->bindStateStore();
+  }
+  for (int i = 0; i < StateStore::QuantityCount; ++i) {
+    StateStore::quantity_t q = (StateStore::quantity_t)i;
+    size_t n = min(states.size(q), _stateStore->size(q));
+    std::copy(states.column(q), states.column(q) + n, _stateStore->column(q));
+  }
+  
+  // hand the states to the engine as initial conditions
+  this->applyInitialLinkStatus();
+  this->applyInitialTankLevels();
+  if (quality) {
+    this->applyInitialQuality(); // seeds each link from its node qualities...
+    this->applySegmentQuality(states); // ...then puts back the water that was actually in it, if captured
+  }
+  this->setTanksNeedReset(false);
+  this->setCurrentSimulationTime(time);
+}
+
+
+void Model::copySimulationSettings(Model::_sp source) {
+  if (!source) {
+    return;
+  }
+  this->setFlowUnits(source->flowUnits());
+  this->setHeadUnits(source->headUnits());
+  this->setPressureUnits(source->pressureUnits());
+  this->setQualityUnits(source->qualityUnits());
+  this->setVolumeUnits(source->volumeUnits());
+  
+  this->setHydraulicTimeStep(source->hydraulicTimeStep());
+  this->setQualityTimeStep(source->qualityTimeStep());
+  if (source->_simReportClock) {
+    this->setReportTimeStep(source->reportTimeStep());
+  }
+  _tankResetClock = source->_tankResetClock; // clocks are shareable
+  this->setBoundaryLookahead(source->boundaryLookahead()); // but not eviction: a copy usually shares its source's input records, so shareInputs turns it off
+  
+  this->setShouldRunWaterQuality(source->shouldRunWaterQuality());
+  this->setQualityOptions(source->qualityType(), source->qualityTraceNode());
+  _initialQuality = source->_initialQuality;
+  
+  _dmaShouldDetectClosedLinks = source->_dmaShouldDetectClosedLinks;
+  _dmaPipesToIgnore.clear();
+  for (auto p : source->_dmaPipesToIgnore) {
+    auto mine = dynamic_pointer_cast<Pipe>(this->linkWithName(p->name()));
+    if (mine) {
+      _dmaPipesToIgnore.push_back(mine);
+    }
+  }
+  if (source->_doesOverrideDemands) {
+    this->overrideControls();
+  }
+}
+
 bool Model::tanksNeedReset() {
   return _tanksNeedReset;
 }
@@ -1053,6 +1283,68 @@ void Model::setTanksNeedReset(bool reset) {
   
 }
 
+void Model::planBoundaryQueries() {
+  // everything setSimulationParameters (and the dma allocation it calls) reads, plus the measurements we get compared against
+  _boundaryPlanner->clear();
+  if (_doesOverrideDemands) {
+    for (auto dma : this->dmas()) {
+      _boundaryPlanner->addSeries(dma->demand());
+      for (auto j : dma->junctions()) {
+        _boundaryPlanner->addSeries(j->boundaryFlow());
+      }
+    }
+  }
+  for (auto r : this->reservoirs()) {
+    _boundaryPlanner->addSeries(r->boundaryHead());
+  }
+  for (auto t : this->tanks()) {
+    _boundaryPlanner->addSeries(t->levelMeasure());
+  }
+  for (auto v : this->valves()) {
+    _boundaryPlanner->addSeries(v->statusBoundary());
+    _boundaryPlanner->addSeries(v->settingBoundary());
+    _boundaryPlanner->addSeries(v->flowMeasure());
+  }
+  for (auto p : this->pumps()) {
+    _boundaryPlanner->addSeries(p->statusBoundary());
+    _boundaryPlanner->addSeries(p->settingBoundary());
+    _boundaryPlanner->addSeries(p->flowMeasure());
+    _boundaryPlanner->addSeries(p->energyMeasure());
+  }
+  for (auto p : this->pipes()) {
+    _boundaryPlanner->addSeries(p->statusBoundary());
+    _boundaryPlanner->addSeries(p->flowMeasure());
+  }
+  for (auto j : this->junctions()) {
+    _boundaryPlanner->addSeries(j->headMeasure());
+    _boundaryPlanner->addSeries(j->pressureMeasure());
+    _boundaryPlanner->addSeries(j->qualityMeasure());
+  }
+  if (this->shouldRunWaterQuality()) {
+    for (auto j : this->junctions()) {
+      _boundaryPlanner->addSeries(j->qualitySource());
+    }
+    for (auto r : this->reservoirs()) {
+      _boundaryPlanner->addSeries(r->boundaryQuality());
+    }
+    for (auto t : this->tanks()) {
+      _boundaryPlanner->addSeries(t->qualitySource());
+    }
+  }
+  _boundaryPlanValid = true;
+}
+
+void Model::prepareBoundaries(time_t time) {
+  if (_boundaryPrefetcher->lookahead() == 0) {
+    return;
+  }
+  if (!_boundaryPlanValid) {
+    _boundaryPrefetcher->reset(); // nothing may be reading the plan while we rebuild it
+    this->planBoundaryQueries();
+  }
+  _boundaryPrefetcher->advanceTo(time);
+}
+
 void Model::_checkTanksForReset(time_t time) {
   
   if (!tanksNeedReset()) {
@@ -1067,7 +1359,7 @@ void Model::_checkTanksForReset(time_t time) {
         // adjust for model limits (epanet rejects otherwise, for example)
         levelValue = (levelValue <= tank->maxLevel()) ? levelValue : tank->maxLevel();
         levelValue = (levelValue >= tank->minLevel()) ? levelValue : tank->minLevel();
-        setTankLevel(tank->name(), levelValue);
+        setTankLevelAtIndex(tank->engineIndex, levelValue);
       }
       else {
         cerr << "ERR: Invalid head point for Tank " << tank->name() << " at time " << time << endl;
@@ -1118,7 +1410,7 @@ void Model::setInitialJunctionQualityFromMeasurements(time_t time) {
       }
     }
     // initialize the junction quality
-    junc->state_quality = initQuality;
+    junc->setState(StateStore::Quality, initQuality);
 //    cout << "Junction " << junc->name() << " Quality: " << initQuality << endl;
   }
   // tanks
@@ -1133,7 +1425,7 @@ void Model::setInitialJunctionQualityFromMeasurements(time_t time) {
       }
     }
     // initialize the tank quality
-    tank->state_quality = initQuality;
+    tank->setState(StateStore::Quality, initQuality);
 //    cout << "Tank " << tank->name() << " Quality: " << initQuality << endl;
   }
   
@@ -1195,6 +1487,10 @@ void Model::setSimulationParameters(time_t time) {
   time_str << put_time(timeinfo, "%F");
   OATPP_LOGD("Model", "Setting model inputs: %s", time_str.str().c_str());
 //  cout << EOL << "*** SETTING MODEL INPUTS *** " << asctime(timeinfo) << " - " << time << EOL;
+  
+  // keep every boundary's root series loaded ahead of us, so the element loops below find them buffered
+  this->prepareBoundaries(time);
+  
   // set all element parameters
   
   // allocate junction demands based on dmas, and set the junction demand values in the model.
@@ -1214,8 +1510,8 @@ void Model::setSimulationParameters(time_t time) {
     }
     // hydraulic junctions - set demand values.
     for(Junction::_sp junction: this->junctions()) {
-      double demandValue = Units::convertValue(junction->state_demand, junction->demand()->units(), flowUnits());
-      setJunctionDemand(junction->name(), demandValue);
+      double demandValue = Units::convertValue(junction->state(StateStore::Demand), junction->demand()->units(), flowUnits());
+      setJunctionDemandAtIndex(junction->engineIndex, demandValue);
     }
   }
   
@@ -1226,7 +1522,7 @@ void Model::setSimulationParameters(time_t time) {
       Point p = reservoir->boundaryHead()->pointAtOrBefore(time);
       if (p.isValid) {
         double headValue = Units::convertValue(p.value, reservoir->boundaryHead()->units(), headUnits());
-        setReservoirHead( reservoir->name(), headValue );
+        setReservoirHeadAtIndex( reservoir->engineIndex, headValue );
         DebugLog << "*  Reservoir " << reservoir->name() << " head --> " << p.value << EOL;
       }
       else {
@@ -1254,7 +1550,7 @@ void Model::setSimulationParameters(time_t time) {
       Point p = valve->statusBoundary()->pointAtOrBefore(time);
       if (p.isValid) {
         status = Pipe::status_t((int)(p.value));
-        setPipeStatusControl( valve->name(), status, enable );
+        setLinkStatusControlAtIndex( valve->engineIndex, status, enable );
         DebugLog << "*  Valve " << valve->name() << " status --> " << (p.value > 0 ? "ON" : "OFF") << EOL;
       }
       else {
@@ -1274,7 +1570,7 @@ void Model::setSimulationParameters(time_t time) {
           else if (settingUnits.isSameDimensionAs(RTX_GALLON_PER_MINUTE)) {
             p = Point::convertPoint(p, settingUnits, this->flowUnits());
           }
-          setValveSettingControl( valve->name(), p.value, enable );
+          setLinkSettingControlAtIndex( valve->engineIndex, p.value, enable );
           DebugLog << "*  Valve " << valve->name() << " setting --> " << p.value << EOL;
         }
         else {
@@ -1284,7 +1580,7 @@ void Model::setSimulationParameters(time_t time) {
         }
       }
       else {
-        setValveSettingControl( valve->name(), 0.0, disable );
+        setLinkSettingControlAtIndex( valve->engineIndex, 0.0, disable );
         stringstream ss;
         ss << "WARN: Ignoring setting for Valve because status is Closed: " << valve->name() << " :: " << asctime(timeinfo);
 //        this->logLine(ss.str());
@@ -1300,7 +1596,7 @@ void Model::setSimulationParameters(time_t time) {
       Point p = pump->statusBoundary()->pointAtOrBefore(time);
       if (p.isValid) {
         status = Pipe::status_t((int)(p.value));
-        setPumpStatusControl( pump->name(), status, enable );
+        setLinkStatusControlAtIndex( pump->engineIndex, status, enable );
         DebugLog << "*  Pump " << pump->name() << " status --> " << (p.value > 0 ? "ON" : "OFF") << EOL;
       }
       else {
@@ -1317,7 +1613,7 @@ void Model::setSimulationParameters(time_t time) {
           p.value /= 100.0;
         }
         if (p.isValid) {
-          setPumpSettingControl( pump->name(), p.value, enable );
+          setLinkSettingControlAtIndex( pump->engineIndex, p.value, enable );
           DebugLog << "*  Pump " << pump->name() << " setting --> " << p.value << EOL;
         }
         else {
@@ -1327,7 +1623,7 @@ void Model::setSimulationParameters(time_t time) {
         }
       }
       else {
-        setPumpSettingControl( pump->name(), 0.0, disable );
+        setLinkSettingControlAtIndex( pump->engineIndex, 0.0, disable );
         stringstream ss;
         ss << "WARN: Ignoring setting for Pump because status is Closed: " << pump->name() << " :: " << asctime(timeinfo);
 //        this->logLine(ss.str());
@@ -1341,7 +1637,7 @@ void Model::setSimulationParameters(time_t time) {
       Point p = pipe->statusBoundary()->pointAtOrBefore(time);
       if (p.isValid) {
         Pipe::status_t status = Pipe::status_t((int)(p.value));
-        setPipeStatusControl(pipe->name(), status, enable);
+        setLinkStatusControlAtIndex(pipe->engineIndex, status, enable);
         DebugLog << "*  Pipe " << pipe->name() << " status --> " << (p.value > 0 ? "ON" : "OFF") << EOL;
       }
       else {
@@ -1361,7 +1657,7 @@ void Model::setSimulationParameters(time_t time) {
         Point p = j->qualitySource()->pointAtOrBefore(time);
         if (p.isValid) {
           double quality = Units::convertValue(p.value, j->qualitySource()->units(), qualityUnits());
-          setJunctionQuality(j->name(), quality);
+          setJunctionQualityAtIndex(j->engineIndex, quality);
           DebugLog << "*  Junction " << j->name() << " quality --> " << p.value << EOL;
         }
         else {
@@ -1377,7 +1673,7 @@ void Model::setSimulationParameters(time_t time) {
         Point p = reservoir->boundaryQuality()->pointAtOrBefore(time);
         if (p.isValid) {
           double qualityValue = Units::convertValue(p.value, reservoir->boundaryQuality()->units(), qualityUnits());
-          setReservoirQuality( reservoir->name(), qualityValue );
+          setReservoirQualityAtIndex( reservoir->engineIndex, qualityValue );
           DebugLog << "*  Reservoir " << reservoir->name() << " quality --> " << p.value << EOL;
         }
         else {
@@ -1392,7 +1688,7 @@ void Model::setSimulationParameters(time_t time) {
         Point p = tank->qualitySource()->pointAtOrBefore(time);
         if (p.isValid) {
           double qualityValue = Units::convertValue(p.value, tank->qualitySource()->units(), qualityUnits());
-          setReservoirQuality( tank->name(), qualityValue ); // using setReservoirQuality to set concentration rather than mass addition
+          setReservoirQualityAtIndex( tank->engineIndex, qualityValue ); // using setReservoirQuality to set concentration rather than mass addition
           DebugLog << "*  Tank " << tank->name() << " quality --> " << p.value << EOL;
         }
         else {
@@ -1410,139 +1706,186 @@ void Model::setSimulationParameters(time_t time) {
 
 void Model::fetchSimulationStates() {
   
-  // retrieve results from the hydraulic sim
-  // then insert the state values into elements' "short-term" memory
+  // retrieve results from the hydraulic sim - one bulk engine call per quantity, written
+  // straight into the columnar state store (elements address it by engine index),
+  // then convert each column to the elements' units in a single scale/offset pass.
+  
+  StateStore::_sp st = _stateStore;
+  if (st->size(StateStore::Head) != (size_t)this->engineNodeCount() || st->size(StateStore::Flow) != (size_t)this->engineLinkCount()) {
+    this->bindStateStore();
+  }
+  if (!_stateConversionsValid) {
+    this->refreshStateConversions();
+  }
+  
+  const bool runQuality = this->shouldRunWaterQuality();
   
   // junctions, tanks, reservoirs
-  for(Junction::_sp junction : junctions()) {
-    double head;
-    head = Units::convertValue(junctionHead(junction->name()), headUnits(), junction->head()->units());
-    junction->state_head = head;
-    
-    double pressure;
-    pressure = Units::convertValue(junctionPressure(junction->name()), pressureUnits(), junction->pressure()->units());
-    junction->state_pressure = pressure;
-    
-    // todo - more fine-grained quality data? at wq step resolution...
-    if (this->shouldRunWaterQuality()) {
-      double quality;
-      quality = Units::convertValue(junctionQuality(junction->name()), this->qualityUnits(), junction->quality()->units());
-      junction->state_quality = quality;
+  this->fetchAllNodeValues(NodeHead, st->column(StateStore::Head));
+  if (!_tanks.empty()) {
+    for(Tank::_sp tank : _tanks) {
+      // node elevation & head in same engine units
+      st->setValue(StateStore::Level, tank->engineIndex, st->value(StateStore::Head, tank->engineIndex) - tank->elevation());
     }
+    st->applyConversion(StateStore::Level);
   }
+  st->applyConversion(StateStore::Head);
   
-  if (!_doesOverrideDemands) { // otherwise this state ivar is set by the containing DMA object
-    for(Junction::_sp junction : junctions()) {
-      double demand = Units::convertValue(junctionDemand(junction->name()), flowUnits(), junction->demand()->units());
-      junction->state_demand = demand;
+  this->fetchAllNodeValues(NodePressure, st->column(StateStore::Pressure));
+  st->applyConversion(StateStore::Pressure);
+  
+  if (!_doesOverrideDemands || !_tanks.empty()) {
+    // tank flow is the tank node's demand
+    this->fetchAllNodeValues(NodeDemand, st->column(StateStore::TankFlow));
+    if (!_doesOverrideDemands) { // otherwise the demand column is set by the containing DMA objects
+      std::copy(st->column(StateStore::TankFlow), st->column(StateStore::TankFlow) + st->size(StateStore::TankFlow), st->column(StateStore::Demand));
+      st->applyConversion(StateStore::Demand);
     }
+    st->applyConversion(StateStore::TankFlow);
   }
   
-  for(Reservoir::_sp reservoir : reservoirs()) {
-    double head;
-    head = Units::convertValue(junctionHead(reservoir->name()), headUnits(), reservoir->head()->units());
-    reservoir->state_head = head;
-    
-    double quality;
-    quality = Units::convertValue(junctionQuality(reservoir->name()), this->qualityUnits(), reservoir->quality()->units());
-    reservoir->state_quality = quality;
+  // todo - more fine-grained quality data? at wq step resolution...
+  if (runQuality) {
+    this->fetchAllNodeValues(NodeQuality, st->column(StateStore::Quality));
+    st->applyConversion(StateStore::Quality);
+  }
+  else if (!_reservoirs.empty()) {
+    // quality states hold the initial conditions when quality is not simulated, so only pick up the reservoirs
+    _nodeValueBuffer.resize(st->size(StateStore::Quality));
+    this->fetchAllNodeValues(NodeQuality, _nodeValueBuffer.data());
+    for(Reservoir::_sp reservoir : _reservoirs) {
+      if (reservoir->engineIndex < 0) {
+        continue;
+      }
+      reservoir->setState(StateStore::Quality, Units::convertValue(_nodeValueBuffer[reservoir->engineIndex], qualityUnits(), reservoir->quality()->units()));
+    }
   }
   
-  for(Tank::_sp tank : tanks()) {
-    double head;
-    head = Units::convertValue(junctionHead(tank->name()), headUnits(), tank->head()->units());
-    tank->state_head = head;
-    
-    double level;
-    level = Units::convertValue(tankLevel(tank->name()), headUnits(), tank->head()->units());
-    tank->state_level = level;
-    
-    double volume;
-    volume = Units::convertValue(tankVolume(tank->name()), this->volumeUnits(), tank->volume()->units());
-    tank->state_volume = volume;
-    
-    double flow;
-    flow = Units::convertValue(tankFlow(tank->name()), this->flowUnits(), tank->flow()->units());
-    tank->state_flow = flow;
-    
-    if (this->shouldRunWaterQuality()) {
-      double quality;
-      quality = Units::convertValue(junctionQuality(tank->name()), this->qualityUnits(), tank->quality()->units());
-      tank->state_quality = quality;
-      
-      double inletQuality;
-      inletQuality = Units::convertValue(tankInletQuality(tank->name()), this->qualityUnits(), tank->inletQuality()->units());
-      tank->state_inlet_quality = inletQuality;
+  if (!_tanks.empty()) {
+    this->fetchAllNodeValues(NodeTankVolume, st->column(StateStore::Volume));
+    st->applyConversion(StateStore::Volume);
+    if (runQuality) {
+      this->fetchAllNodeValues(NodeInletQuality, st->column(StateStore::InletQuality));
+      st->applyConversion(StateStore::InletQuality);
     }
   }
   
   // link elements
-  for(Link::_sp link : this->links()) {
-    auto pipe = dynamic_pointer_cast<Pipe>(link);
-    
-    double flow;
-    flow = Units::convertValue(pipeFlow(pipe->name()), flowUnits(), pipe->flow()->units());
-    pipe->state_flow = flow;
-    
-    double setting = pipeSetting(pipe->name());
-    pipe->state_setting = setting;
-    
-    double status = pipeStatus(pipe->name());
-    pipe->state_status = status;
-    
-    double energy = pipeEnergy(pipe->name());
-    pipe->state_energy = energy;
-  }
+  this->fetchAllLinkValues(LinkFlow, st->column(StateStore::Flow));
+  st->applyConversion(StateStore::Flow);
+  this->fetchAllLinkValues(LinkSetting, st->column(StateStore::Setting));
+  this->fetchAllLinkValues(LinkStatus, st->column(StateStore::Status));
+  this->fetchAllLinkValues(LinkEnergy, st->column(StateStore::Energy));
   
-  for(Valve::_sp valve : valves()) {
-    // nothing extra
+}
+
+StateStore::_sp Model::stateStore() {
+  return _stateStore;
+}
+
+void Model::bindStateStore() {
+  // size the columnar store to the engine's element counts, and point the elements at it.
+  _stateStore->resize(this->engineNodeCount(), this->engineLinkCount());
+  for(auto& nodePair : _nodes) {
+    auto j = dynamic_pointer_cast<Junction>(nodePair.second);
+    if (j) {
+      j->setStateStore(_stateStore);
+    }
+  }
+  for(auto& linkPair : _links) {
+    auto p = dynamic_pointer_cast<Pipe>(linkPair.second);
+    if (p) {
+      p->setStateStore(_stateStore);
+    }
   }
+  _stateConversionsValid = false;
+}
+
+void Model::refreshStateConversions() {
+  // per-slot linear conversion from engine units to each element's state series units
+  StateStore::_sp st = _stateStore;
+  double scale, shift;
+  auto conv = [&](StateStore::quantity_t q, int offset, const Units& from, const Units& to) {
+    Units::linearConversion(from, to, scale, shift);
+    st->setConversion(q, offset, scale, shift);
+  };
   
+  st->resetConversions();
+  
+  for(Junction::_sp j : _junctions) {
+    conv(StateStore::Head, j->engineIndex, headUnits(), j->head()->units());
+    conv(StateStore::Pressure, j->engineIndex, pressureUnits(), j->pressure()->units());
+    conv(StateStore::Demand, j->engineIndex, flowUnits(), j->demand()->units());
+    conv(StateStore::Quality, j->engineIndex, qualityUnits(), j->quality()->units());
+  }
+  for(Reservoir::_sp r : _reservoirs) {
+    conv(StateStore::Head, r->engineIndex, headUnits(), r->head()->units());
+    conv(StateStore::Quality, r->engineIndex, qualityUnits(), r->quality()->units());
+  }
+  for(Tank::_sp t : _tanks) {
+    conv(StateStore::Head, t->engineIndex, headUnits(), t->head()->units());
+    conv(StateStore::Level, t->engineIndex, headUnits(), t->head()->units());
+    conv(StateStore::Volume, t->engineIndex, volumeUnits(), t->volume()->units());
+    conv(StateStore::TankFlow, t->engineIndex, flowUnits(), t->flow()->units());
+    conv(StateStore::Quality, t->engineIndex, qualityUnits(), t->quality()->units());
+    conv(StateStore::InletQuality, t->engineIndex, qualityUnits(), t->inletQuality()->units());
+  }
+  for(auto& linkPair : _links) {
+    auto p = dynamic_pointer_cast<Pipe>(linkPair.second);
+    if (p) {
+      conv(StateStore::Flow, p->engineIndex, flowUnits(), p->flow()->units());
+    }
+  }
   
+  _stateConversionsValid = true;
 }
 
 
 void Model::saveNetworkStates(time_t simtime, std::set<PointRecord::_sp> bulkRecords) {
-  struct tm * timeinfo = localtime (&simtime);
-  OATPP_LOGD("Model", "saving network states: %s", put_time(timeinfo, "%c"));
-//  cout << "*** saving network states ***" << asctime(timeinfo) << " - " << simtime << EOL << flush;
-  auto t1 = time(NULL);
+  StateSnapshot snapshot;
+  snapshot.time = simtime;
+  snapshot.bulkRecords = bulkRecords;
+  this->captureNetworkStates(snapshot);
+  this->writeNetworkStates(snapshot);
+}
 
-  for(PointRecord::_sp r: bulkRecords) {
-    r->beginBulkOperation();
-  }
+void Model::waitForPendingSaves() {
+  _savePipeline->drain();
+}
+
+void Model::captureNetworkStates(StateSnapshot& snapshot) {
   // retrieve results from the hydraulic sim
   // then insert the state values into elements' time series.
   // junctions, tanks, reservoirs
   for(Junction::_sp junction : junctions()) {
-    junction->head()->insert(Point(simtime, junction->state_head));
-    junction->pressure()->insert(Point(simtime, junction->state_pressure));
+    snapshot.add(junction->head(), junction->state(StateStore::Head));
+    snapshot.add(junction->pressure(), junction->state(StateStore::Pressure));
     // todo - more fine-grained quality data? at wq step resolution...
     if (this->shouldRunWaterQuality()) {
-      junction->quality()->insert(Point(simtime, junction->state_quality));
+      snapshot.add(junction->quality(), junction->state(StateStore::Quality));
     }
   }
   
   for(Junction::_sp junction : junctions()) {
-    junction->demand()->insert(Point(simtime, junction->state_demand));
+    snapshot.add(junction->demand(), junction->state(StateStore::Demand));
   }
   
   for(Reservoir::_sp reservoir : reservoirs()) {
-    reservoir->head()->insert(Point(simtime, reservoir->state_head));
+    snapshot.add(reservoir->head(), reservoir->state(StateStore::Head));
     if (this->shouldRunWaterQuality()) {
-      reservoir->quality()->insert(Point(simtime, reservoir->state_quality));
+      snapshot.add(reservoir->quality(), reservoir->state(StateStore::Quality));
     }
   }
   
   for(Tank::_sp tank : tanks()) {
-    tank->head()->insert(Point(simtime, tank->state_head));
-    tank->level()->insert(Point(simtime, tank->state_level));
-    tank->volume()->insert(Point(simtime,tank->state_volume));
-    tank->flow()->insert(Point(simtime,tank->state_flow));
+    snapshot.add(tank->head(), tank->state(StateStore::Head));
+    snapshot.add(tank->level(), tank->state(StateStore::Level));
+    snapshot.add(tank->volume(), tank->state(StateStore::Volume));
+    snapshot.add(tank->flow(), tank->state(StateStore::TankFlow));
     if (this->shouldRunWaterQuality()) {
-      tank->quality()->insert(Point(simtime, tank->state_quality));
-      if (!isnan(tank->state_inlet_quality)) {
-        tank->inletQuality()->insert(Point(simtime, tank->state_inlet_quality));
+      snapshot.add(tank->quality(), tank->state(StateStore::Quality));
+      if (!isnan(tank->state(StateStore::InletQuality))) {
+        snapshot.add(tank->inletQuality(), tank->state(StateStore::InletQuality));
       }
     }
   }
@@ -1552,44 +1895,65 @@ void Model::saveNetworkStates(time_t simtime, std::set<PointRecord::_sp> bulkRec
   
   if (this->shouldRunWaterQuality()) {
     for(Pipe::_sp pipe : pipes()) {
-      pipe->quality()->insert(Point(simtime, pipe->state_quality()));
+      snapshot.add(pipe->quality(), pipe->state_quality());
     }
     for(Valve::_sp valve : valves()) {
-      valve->quality()->insert(Point(simtime, valve->state_quality()));
+      snapshot.add(valve->quality(), valve->state_quality());
     }
     for(Pump::_sp pump : pumps()) {
-      pump->quality()->insert(Point(simtime, pump->state_quality()));
+      snapshot.add(pump->quality(), pump->state_quality());
     }
   }
   
   for(Pipe::_sp pipe : pipes()) {
-    pipe->flow()->insert(Point(simtime, pipe->state_flow));
-    pipe->setting()->insert(Point(simtime, pipe->state_setting));
-    pipe->status()->insert(Point(simtime, pipe->state_status));
+    snapshot.add(pipe->flow(), pipe->state(StateStore::Flow));
+    snapshot.add(pipe->setting(), pipe->state(StateStore::Setting));
+    snapshot.add(pipe->status(), pipe->state(StateStore::Status));
   }
   
   for(Valve::_sp valve : valves()) {
-    valve->flow()->insert(Point(simtime, valve->state_flow));
-    valve->setting()->insert(Point(simtime, valve->state_setting));
-    valve->status()->insert(Point(simtime, valve->state_status));
+    snapshot.add(valve->flow(), valve->state(StateStore::Flow));
+    snapshot.add(valve->setting(), valve->state(StateStore::Setting));
+    snapshot.add(valve->status(), valve->state(StateStore::Status));
   }
   
   // pump energy
   for(Pump::_sp pump : pumps()) {
-    pump->flow()->insert(Point(simtime, pump->state_flow));
-    pump->energy()->insert(Point(simtime, pump->state_energy));
-    pump->setting()->insert(Point(simtime, pump->state_setting));
-    pump->status()->insert(Point(simtime, pump->state_status));
+    snapshot.add(pump->flow(), pump->state(StateStore::Flow));
+    snapshot.add(pump->energy(), pump->state(StateStore::Energy));
+    snapshot.add(pump->setting(), pump->state(StateStore::Setting));
+    snapshot.add(pump->status(), pump->state(StateStore::Status));
   }
-  
-  
-  for(PointRecord::_sp r : bulkRecords) {
-    r->endBulkOperation();
+}
+
+void Model::writeNetworkStates(StateSnapshot& snapshot) {
+  time_t simtime = snapshot.time;
+  struct tm * timeinfo = localtime (&simtime);
+  OATPP_LOGD("Model", "saving network states: %s", put_time(timeinfo, "%c"));
+//  cout << "*** saving network states ***" << asctime(timeinfo) << " - " << simtime << EOL << flush;
+  auto t1 = chrono::steady_clock::now();
+
+  if (_stateHandler) {
+    _stateHandler(snapshot);
+  }
+  else {
+    for(PointRecord::_sp r: snapshot.bulkRecords) {
+      r->beginBulkOperation();
+    }
+    
+    // one addSnapshot per record
+    snapshot.commit();
+    
+    for(PointRecord::_sp r : snapshot.bulkRecords) {
+      r->endBulkOperation();
+    }
   }
   
-  
-  auto saveWallDuration = time(NULL) - t1;
-  _saveWallTime->insert(Point(simtime, (double)saveWallDuration));
+  double saveWallDuration = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+  _saveWallTime->insert(Point(simtime, saveWallDuration));
+  if (saveWallDuration > 0) {
+    _saveThroughput->insert(Point(simtime, (double)snapshot.size() / saveWallDuration));
+  }
   
   // beating heart just after everything else is done.
   _heartbeat->insert(Point(simtime,1.0));
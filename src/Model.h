@@ -28,8 +28,19 @@
 #include "PointRecord.h"
 #include "Units.h"
 #include "Curve.h"
+#include "StateStore.h"
+#include "SavePipeline.h"
+#include "QueryPlanner.h"
 #include "rtxMacros.h"
 
+#ifndef RTX_BOUNDARY_LOOKAHEAD
+#define RTX_BOUNDARY_LOOKAHEAD (6*60*60) // seconds of boundary and measured data fetched ahead of the simulation
+#endif
+
+#ifndef RTX_BOUNDARY_EVICTION
+#define RTX_BOUNDARY_EVICTION false // drop boundary data left behind the simulation. boundary records are usually shared (scada), so off unless asked for
+#endif
+
 
 namespace RTX {
   
@@ -157,6 +168,15 @@ namespace RTX {
     void setInitialJunctionQualityFromMeasurements(time_t time);
     virtual void applyInitialQuality() { };
     virtual void applyInitialTankLevels() { };
+    virtual void applyInitialLinkStatus() { };
+    virtual void captureSegmentQuality(StateStore& states) { }; // the engine's water quality segments, into states
+    virtual void applySegmentQuality(const StateStore& states) { }; // and back, after initial quality is applied
+    
+    // hot-start checkpoints: every simulated state (levels, quality, demands, link status), in one binary file
+    bool saveCheckpoint(const std::string& path);
+    time_t loadCheckpoint(const std::string& path); // returns the checkpoint's simulation time, or zero if it doesn't fit this model
+    void setCheckpointFile(const std::string& path, Clock::_sp clock); // write one whenever the clock ticks during a simulation
+    void restoreState(const StateStore& states, time_t time, bool quality); // take a snapshot of a model of the same network as initial conditions
     vector<Node::_sp> nearestNodes(Node::_sp junc, double maxDistance);
 
     virtual time_t currentSimulationTime();
@@ -165,6 +185,12 @@ namespace RTX {
     TimeSeries::_sp convergence() {return _convergence; }
     
     void setTankResetClock(Clock::_sp resetClock);
+    Clock::_sp tankResetClock();
+    void setBoundaryLookahead(time_t seconds); // zero turns off background boundary fetching
+    time_t boundaryLookahead();
+    void setBoundaryEviction(bool evict); // drop boundary data behind the simulation, so a long run's memory stays bounded. off by default; only for a model that is the sole reader of its input records
+    bool boundaryEviction();
+    void copySimulationSettings(Model::_sp source); // clocks, units, and quality options from a model of the same network
     
     void setTanksNeedReset(bool reset);
     bool tanksNeedReset();
@@ -174,6 +200,8 @@ namespace RTX {
     void setRecordForDmaDemands(PointRecord::_sp record);
     void setRecordForSimulationStats(PointRecord::_sp record);
     TimeSeries::_sp heartbeat();
+    std::vector<TimeSeries::_sp> solverStats(); // the statistics recorded as each step is solved (error, iterations, convergence, wall times, save stalls)
+    void recordDmaDemands(TimeRange range); // evaluate (and so record) each dma's demand, for steps simulated by a copy of this model
     
     
     // specify records for certain states or inputs
@@ -222,12 +250,16 @@ namespace RTX {
     
     void setWillSimulateCallback(std::function<void(time_t)> cb);
     void setDidSimulateCallback(std::function<void(time_t)> cb);
+    void setStateHandler(std::function<void(StateSnapshot&)> handler); // receives each step's states instead of their records; empty restores normal saving
     
     std::map<std::string,std::string> dmaNameHashes;
         
     void setSimulationParameters(time_t time);
     void fetchSimulationStates();
+    StateStore::_sp stateStore();
     void saveNetworkStates(time_t time, std::set<PointRecord::_sp> bulkOperationRecords);
+    void waitForPendingSaves(); // block until queued states have been written
+    void writeNetworkStates(StateSnapshot& snapshot); // what the save writer does with each step: commit (or hand off) the states, then record save stats and the heartbeat
     
     
     
@@ -264,6 +296,37 @@ namespace RTX {
     virtual void setPumpSettingControl(const std::string& pump, double setting, enableControl_t) { };
     virtual void setValveSetting(const string& valve, double setting) { };
     virtual void setValveSettingControl(const string& valve, double setting, enableControl_t) { };
+    
+    // bulk, index-addressed state exchange.
+    // value arrays are indexed by the elements' cached engine slot (Junction::engineIndex, Pipe::engineIndex)
+    typedef enum {
+      NodeHead,
+      NodePressure,
+      NodeDemand,
+      NodeQuality,
+      NodeTankVolume,
+      NodeInletQuality
+    } nodeQuantity_t;
+    
+    typedef enum {
+      LinkFlow,
+      LinkSetting,
+      LinkStatus,
+      LinkEnergy
+    } linkQuantity_t;
+    
+    virtual int engineNodeCount() { return 0; };
+    virtual int engineLinkCount() { return 0; };
+    virtual void fetchAllNodeValues(nodeQuantity_t quantity, double *out) { };
+    virtual void fetchAllLinkValues(linkQuantity_t quantity, double *out) { };
+    
+    virtual void setJunctionDemandAtIndex(int index, double demand) { };
+    virtual void setJunctionQualityAtIndex(int index, double quality) { };
+    virtual void setReservoirHeadAtIndex(int index, double head) { };
+    virtual void setReservoirQualityAtIndex(int index, double quality) { };
+    virtual void setTankLevelAtIndex(int index, double level) { };
+    virtual void setLinkStatusControlAtIndex(int index, Pipe::status_t status, enableControl_t) { };
+    virtual void setLinkSettingControlAtIndex(int index, double setting, enableControl_t) { };
 
   protected:
     
@@ -275,6 +338,8 @@ namespace RTX {
     
     virtual void setCurrentSimulationTime(time_t time);
     
+    void bindStateStore();
+    
     double nodeDirectDistance(Node::_sp n1, Node::_sp n2);
     double toRadians(double degrees);
     
@@ -288,6 +353,11 @@ namespace RTX {
     bool _shouldRunWaterQuality;
     bool _tanksNeedReset;
     void _checkTanksForReset(time_t time);
+    void planBoundaryQueries();
+    void prepareBoundaries(time_t time);
+    QueryPlanner::_sp _boundaryPlanner;
+    LookaheadPrefetcher::_sp _boundaryPrefetcher;
+    bool _boundaryPlanValid;
     // master list access
     void add(Junction::_sp newJunction);
     void add(Pipe::_sp newPipe);
@@ -315,6 +385,7 @@ namespace RTX {
     
     Clock::_sp _regularMasterClock, _simReportClock;
     TimeSeries::_sp _relativeError, _iterations, _convergence, _heartbeat, _simWallTime, _saveWallTime, _filterWallTime;
+    TimeSeries::_sp _saveQueueDepth, _saveStallTime, _saveThroughput;
     Clock::_sp _tankResetClock;
     int _qualityTimeStep;
     bool _doesOverrideDemands;
@@ -325,8 +396,16 @@ namespace RTX {
     double _initialQuality;
     RTX_Logging_Callback_Block _simLogCallback;
     std::function<void(time_t)> _didSimulateCallback, _willSimulateCallback;
-    std::future<void> _saveStateFuture;
+    std::function<void(StateSnapshot&)> _stateHandler;
+    SavePipeline::_sp _savePipeline;
+    void captureNetworkStates(StateSnapshot& snapshot);
+    std::vector<double> _nodeValueBuffer; // scratch space for bulk state exchange
+    StateStore::_sp _stateStore;
+    bool _stateConversionsValid;
+    void refreshStateConversions();
     std::string _projectionString;
+    std::string _checkpointPath, _checkpointHash;
+    Clock::_sp _checkpointClock;
     
   };
   
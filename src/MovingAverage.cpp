@@ -7,18 +7,14 @@
 //  
 
 #include "MovingAverage.h"
+#include "SlidingWindowStats.h"
 #include <boost/foreach.hpp>
-#include <boost/accumulators/accumulators.hpp>
-#include <boost/accumulators/statistics/stats.hpp>
-#include <boost/accumulators/statistics/mean.hpp>
-#include <boost/circular_buffer.hpp>
 #include <math.h>
 
 #include <iostream>
 
 using namespace RTX;
 using namespace std;
-using namespace boost::accumulators;
 
 
 MovingAverage::MovingAverage() {
@@ -94,83 +90,51 @@ PointCollection MovingAverage::filterPointsInRange(TimeRange range) {
     });
   }
   
-  // set up some iterators to start scrubbing through the source data.
-  typedef std::vector<Point>::const_iterator pVec_cIt;
-  pVec_cIt vecBegin = sourcePoints.cbegin();
-  pVec_cIt vecEnd = sourcePoints.cend();
+  // slide a [lo,hi) window of 2*margin+1 points (clamped at the ends) across the
+  // valid points, touching only the points that enter or leave it.
+  size_t nPoints = sourcePoints.size();
+  size_t lo = 0, hi = 0;
+  SlidingWindowStats::Sum valueSum, confidenceSum;
+  int qualBits[6] = {0,0,0,0,0,0}; // how many points in the window carry each non-OPC quality bit
   
-  
-  // simple approach: take each point, and search through the vector for where
-  // to place the left/right cursors, then take the average.
-  
-  for(const Point& sPoint : sourcePoints) {
-    time_t now = sPoint.time;
+  for (size_t iPoint = 0; iPoint < nPoints; ++iPoint) {
+    time_t now = sourcePoints[iPoint].time;
     if (!rangeToResample.contains(now)) {
       continue; // out of bounds.
     }
     
-    // initialize the cursors
-    pVec_cIt seekCursor = sourcePoints.cbegin();
-    
-    // maybe the data doesn't support this particular time we want
-    if (seekCursor->time > now) {
-      continue; // go to the next time
-    }
-    
-    // seek to this time value in the source data
-    while (seekCursor != vecEnd && seekCursor->time < now ) {
-      ++seekCursor;
-    }
-    // have we run off the end?
-    if (seekCursor == vecEnd) {
-      break; // no more work here.
-    }
-    
-    // back-off to the left
-    pVec_cIt leftCurs = seekCursor;
-    for (int iLeft = 0; iLeft < margin; ) {
-      // did we stumble upon the vector.begin?
-      if (leftCurs == vecBegin) {
-        break;
+    size_t wantLo = (iPoint > (size_t)margin) ? iPoint - margin : 0;
+    size_t wantHi = min(iPoint + margin + 1, nPoints);
+    while (hi < wantHi) {
+      const Point& p = sourcePoints[hi++];
+      valueSum.add(p.value);
+      confidenceSum.add(p.confidence);
+      for (int b = 0; b < 6; ++b) {
+        qualBits[b] += (p.quality >> b) & 1;
       }
-      --leftCurs;
-      ++iLeft;
     }
-    
-    // back-off to the right
-    pVec_cIt rightCurs = seekCursor;
-    for (int iRight = 0; iRight < margin; ) {
-      ++rightCurs;
-      // end?
-      if (rightCurs == vecEnd) {
-        --rightCurs; // shaky standard?
-        break;
+    while (lo < wantLo) {
+      const Point& p = sourcePoints[lo++];
+      valueSum.add(-p.value);
+      confidenceSum.add(-p.confidence);
+      for (int b = 0; b < 6; ++b) {
+        qualBits[b] -= (p.quality >> b) & 1;
       }
-      ++iRight;
     }
     
-    
-    // at this point, the left and right cursors should be located properly.
-    // take an average between them.
-    accumulator_set<double, stats<tag::mean> > meanAccumulator;
-    accumulator_set<double, stats<tag::mean> > confidenceAccum;
-    int nAccumulated = 0;
+    double n = (double)(hi - lo);
     Point meanPoint(now);
+    meanPoint.value = valueSum.value() / n;
+    meanPoint.confidence = confidenceSum.value() / n;
     
-    seekCursor = leftCurs;
-    while (seekCursor != rightCurs+1) {
-      
-      Point p = *seekCursor;
-      meanAccumulator(p.value);
-      confidenceAccum(p.confidence);
-      meanPoint.addQualFlag(p.quality);
-      ++nAccumulated;
-      ++seekCursor;
+    // same flags as folding addQualFlag over the window: every point's RTX bits, plus the last point's OPC bits.
+    int qual = sourcePoints[hi - 1].quality;
+    for (int b = 0; b < 6; ++b) {
+      if (qualBits[b] > 0) {
+        qual |= (1 << b);
+      }
     }
-    
-    // done with computing the average. Save the new value.
-    meanPoint.value = mean(meanAccumulator);
-    meanPoint.confidence = mean(confidenceAccum);
+    meanPoint.addQualFlag((Point::PointQuality)qual);
     filteredPoints.push_back(meanPoint);
   }
   
@@ -181,7 +145,7 @@ PointCollection MovingAverage::filterPointsInRange(TimeRange range) {
   bool dataOk = false;
   dataOk = outData.convertToUnits(this->units());
   if (dataOk && this->willResample()) {
-    set<time_t> timeValues = this->timeValuesInRange(range);
+    TimeList timeValues = this->timeValuesInRange(range);
     dataOk = outData.resample(timeValues);
   }
   
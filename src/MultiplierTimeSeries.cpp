@@ -26,15 +26,13 @@ void MultiplierTimeSeries::didSetSecondary(TimeSeries::_sp secondary) {
   this->didSetSource(this->source());
 }
 
-std::set<time_t> MultiplierTimeSeries::timeValuesInRange(RTX::TimeRange range) {
-  std::set<time_t> timeSet;
+TimeList MultiplierTimeSeries::timeValuesInRange(RTX::TimeRange range) {
+  TimeList timeSet;
   if (this->clock()) {
     return this->clock()->timeValuesInRange(range);
   }
   if (this->secondary() && this->source()) {
-    timeSet = this->source()->timeValuesInRange(range);
-    set<time_t> secSet = this->secondary()->timeValuesInRange(range);
-    timeSet.insert(secSet.begin(), secSet.end());
+    timeSet = TimeList::unionOf(this->source()->timeValuesInRange(range), this->secondary()->timeValuesInRange(range));
   }
   return timeSet;
 }
@@ -94,12 +92,7 @@ PointCollection MultiplierTimeSeries::filterPointsInRange(RTX::TimeRange range)
   
   PointCollection secondary = this->secondary()->pointCollection(queryRange);
   
-  set<time_t> pTimes = primary.times();
-  set<time_t> sTimes = secondary.times();
-  
-  set<time_t> combinedTimes;
-  combinedTimes.insert(pTimes.begin(), pTimes.end());
-  combinedTimes.insert(sTimes.begin(), sTimes.end());
+  TimeList combinedTimes = TimeList::unionOf(primary.times(), secondary.times());
 
   primary.resample(combinedTimes);
   secondary.resample(combinedTimes);
@@ -36,7 +36,7 @@ namespace RTX {
   protected:
     void didSetSecondary(TimeSeries::_sp secondary);
     PointCollection filterPointsInRange(TimeRange range);
-    std::set<time_t> timeValuesInRange(TimeRange range);
+    TimeList timeValuesInRange(TimeRange range);
     bool canSetSource(TimeSeries::_sp ts);
     void didSetSource(TimeSeries::_sp ts);
     bool canChangeToUnits(Units units);
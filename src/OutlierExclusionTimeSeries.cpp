@@ -57,9 +57,9 @@ PointCollection OutlierExclusionTimeSeries::filterPointsInRange(TimeRange range)
 
   // get raw values, exclude outliers, then resample if needed.
   PointCollection raw = this->source()->pointCollection(sourceQuery);
-  set<time_t> rawTimes = raw.times();
+  TimeList rawTimes = raw.times();
   
-  set<time_t> proposedOutTimes; // = this->timeValuesInRange(range); // can't do this because recursion.
+  TimeList proposedOutTimes; // = this->timeValuesInRange(range); // can't do this because recursion.
   if (this->clock()) {
     proposedOutTimes = this->clock()->timeValuesInRange(range);
   }
@@ -0,0 +1,339 @@
+//
+//  ParallelHindcast.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <thread>
+#include <atomic>
+#include <algorithm>
+
+#include "ParallelHindcast.h"
+#include "ScenarioRunner.h"
+
+using namespace RTX;
+using namespace std;
+
+namespace {
+  // keeps whatever a clone's statistics series insert, until the segment is merged
+  class StatsCollector : public PointRecord {
+  public:
+    RTX_BASE_PROPS(StatsCollector);
+    void addPoint(const string& identifier, Point point) {
+      lock_guard<mutex> lock(_mtx);
+      _points[identifier].push_back(point);
+    };
+    void addPoints(const string& identifier, std::vector<Point> points) {
+      lock_guard<mutex> lock(_mtx);
+      vector<Point>& mine = _points[identifier];
+      mine.insert(mine.end(), points.begin(), points.end());
+    };
+    map<string, vector<Point> > take() {
+      lock_guard<mutex> lock(_mtx);
+      map<string, vector<Point> > taken;
+      taken.swap(_points);
+      return taken;
+    };
+  private:
+    mutex _mtx;
+    map<string, vector<Point> > _points;
+  };
+}
+
+ParallelHindcast::ParallelHindcast(EpanetModel::_sp baseModel) : _baseModel(baseModel), _nextMerge(0), _maxAhead(1), _merging(false) {
+  unsigned int hw = thread::hardware_concurrency();
+  _threadCount = (hw > 0) ? hw : 1;
+}
+
+void ParallelHindcast::setThreadCount(size_t n) {
+  _threadCount = (n < 1) ? 1 : n;
+}
+
+size_t ParallelHindcast::threadCount() {
+  return _threadCount;
+}
+
+vector<TimeRange> ParallelHindcast::segmentsFor(time_t start, time_t end) {
+  vector<TimeRange> segments;
+  if (end <= start) {
+    return segments;
+  }
+  Clock::_sp resetClock = _baseModel->tankResetClock();
+  // a reset only re-syncs tank levels. water quality carries straight through it, so with quality on nothing can be split.
+  if (resetClock && !_baseModel->shouldRunWaterQuality()) {
+    time_t reset = resetClock->timeAfter(start);
+    while (reset > start && reset < end) {
+      segments.push_back(TimeRange(start, reset));
+      start = reset;
+      reset = resetClock->timeAfter(start);
+    }
+  }
+  segments.push_back(TimeRange(start, end));
+  return segments;
+}
+
+#pragma mark - Running
+
+bool ParallelHindcast::runExtendedPeriod(time_t start, time_t end) {
+  if (!_baseModel) {
+    throw RtxException("ParallelHindcast: no base model");
+  }
+  _segments.clear();
+  for (const TimeRange& r : this->segmentsFor(start, end)) {
+    Segment s;
+    s.range = r;
+    _segments.push_back(s);
+  }
+  size_t nSegments = _segments.size();
+  size_t nThreads = min(_threadCount, nSegments);
+
+  if (nThreads < 2) {
+    // nothing to split, or no one to split it with
+    bool ok = false;
+    string message;
+    try {
+      _baseModel->runExtendedPeriod(start, end);
+      ok = true;
+    } catch (const std::exception& e) {
+      message = e.what();
+    } catch (const std::string& e) {
+      message = e;
+    }
+    for (auto& s : _segments) {
+      s.success = ok;
+      s.errorMessage = message;
+    }
+    return ok;
+  }
+
+  // clones are built here: opening EPANET projects is not safe to do concurrently
+  _targets.clear();
+  vector<EpanetModel::_sp> clones;
+  vector<StatsCollector::_sp> collectors;
+  for (size_t i = 0; i < nThreads; ++i) {
+    collectors.push_back(StatsCollector::_sp(new StatsCollector));
+    clones.push_back(this->cloneForWorker(collectors.back()));
+  }
+
+  _held.clear();
+  _held.resize(nSegments);
+  _finished.assign(nSegments, false);
+  _nextMerge = 0;
+  _maxAhead = 2 * nThreads;
+  _merging = false;
+
+  // the first segment starts where a sequential run would: from the base's tanks, unless the base is about to reset them.
+  // a clone has only the network file's levels, so it takes the base's last simulated state.
+  bool firstReset = _baseModel->tanksNeedReset();
+  StateStore::_sp baseStates = _baseModel->stateStore();
+  StateStore firstStates;
+  bool restoreFirst = !firstReset && baseStates && baseStates->size(StateStore::Head) > 0;
+  if (restoreFirst) {
+    firstStates.resize(baseStates->size(StateStore::Head), baseStates->size(StateStore::Flow));
+    for (int q = 0; q < StateStore::QuantityCount; ++q) {
+      StateStore::quantity_t quantity = (StateStore::quantity_t)q;
+      std::copy(baseStates->column(quantity), baseStates->column(quantity) + baseStates->size(quantity), firstStates.column(quantity));
+    }
+  }
+
+  atomic<size_t> next(0);
+  auto work = [&](size_t iWorker) {
+    EpanetModel::_sp model = clones[iWorker];
+    StatsCollector::_sp collector = collectors[iWorker];
+    mutex heldMutex;
+    vector<StateSnapshot> held;
+    // the model's save writer calls this, from its own thread. the writer is done with the snapshot once we return.
+    model->setStateHandler([&](StateSnapshot& snapshot) {
+      lock_guard<mutex> lock(heldMutex);
+      held.push_back(std::move(snapshot));
+    });
+    size_t i;
+    while ((i = next++) < nSegments) {
+      this->waitForMergeWindow(i);
+      Segment& s = _segments[i];
+      try {
+        if (i == 0 && restoreFirst) {
+          model->restoreState(firstStates, s.range.start, false);
+        }
+        model->setTanksNeedReset(i == 0 ? firstReset : true); // every later segment starts at a reset
+        model->runExtendedPeriod(s.range.start, s.range.end); // drains the save writer before returning
+        s.success = true;
+      } catch (const std::exception& e) {
+        s.success = false;
+        s.errorMessage = e.what();
+      } catch (const std::string& e) {
+        s.success = false;
+        s.errorMessage = e;
+      }
+      model->waitForPendingSaves();
+      Held done;
+      {
+        lock_guard<mutex> lock(heldMutex);
+        done.states.swap(held);
+      }
+      done.stats = collector->take();
+      this->deposit(i, done); // partial results from a failed segment are still merged
+    }
+    model->setStateHandler(nullptr);
+  };
+
+  vector<thread> pool;
+  for (size_t i = 1; i < nThreads; ++i) {
+    pool.push_back(thread(work, i));
+  }
+  work(0);
+  for (auto& t : pool) {
+    t.join();
+  }
+
+  _held.clear();
+  return all_of(_segments.begin(), _segments.end(), [](const Segment& s){ return s.success; });
+}
+
+EpanetModel::_sp ParallelHindcast::cloneForWorker(PointRecord::_sp statsRecord) {
+  EpanetModel::_sp clone = ScenarioRunner::cloneModel(_baseModel);
+  clone->setName(_baseModel->name() + " :: hindcast");
+  ScenarioRunner::shareInputs(_baseModel, clone);
+  // the input records are shared, and each clone reads a different stretch of them
+  clone->setBoundaryLookahead(0);
+  clone->setBoundaryEviction(false);
+  // held back with the states, and merged into the base's statistics in order
+  clone->setRecordForSimulationStats(statsRecord);
+
+  // every state the model saves goes to the same record as the base's matching series
+  bool collect = _targets.empty();
+  auto mirror = [&](TimeSeries::_sp mine, TimeSeries::_sp theirs) {
+    mine->setRecord(theirs->record());
+    if (collect) {
+      _targets.push_back(theirs);
+    }
+  };
+  auto mirrorNode = [&](Junction::_sp mine, Junction::_sp theirs) {
+    mirror(mine->head(), theirs->head());
+    mirror(mine->pressure(), theirs->pressure());
+    mirror(mine->quality(), theirs->quality());
+    mirror(mine->demand(), theirs->demand());
+  };
+  auto mirrorLink = [&](Pipe::_sp mine, Pipe::_sp theirs) {
+    mirror(mine->flow(), theirs->flow());
+    mirror(mine->setting(), theirs->setting());
+    mirror(mine->status(), theirs->status());
+    mirror(mine->quality(), theirs->quality());
+  };
+  for (auto j : _baseModel->junctions()) {
+    auto mine = dynamic_pointer_cast<Junction>(clone->nodeWithName(j->name()));
+    if (mine) {
+      mirrorNode(mine, j);
+    }
+  }
+  for (auto r : _baseModel->reservoirs()) {
+    auto mine = dynamic_pointer_cast<Reservoir>(clone->nodeWithName(r->name()));
+    if (mine) {
+      mirrorNode(mine, r);
+    }
+  }
+  for (auto t : _baseModel->tanks()) {
+    auto mine = dynamic_pointer_cast<Tank>(clone->nodeWithName(t->name()));
+    if (mine) {
+      mirrorNode(mine, t);
+      mirror(mine->level(), t->level());
+      mirror(mine->volume(), t->volume());
+      mirror(mine->flow(), t->flow());
+      mirror(mine->inletQuality(), t->inletQuality());
+    }
+  }
+  for (auto p : _baseModel->pipes()) {
+    auto mine = dynamic_pointer_cast<Pipe>(clone->linkWithName(p->name()));
+    if (mine) {
+      mirrorLink(mine, p);
+    }
+  }
+  for (auto v : _baseModel->valves()) {
+    auto mine = dynamic_pointer_cast<Valve>(clone->linkWithName(v->name()));
+    if (mine) {
+      mirrorLink(mine, v);
+    }
+  }
+  for (auto p : _baseModel->pumps()) {
+    auto mine = dynamic_pointer_cast<Pump>(clone->linkWithName(p->name()));
+    if (mine) {
+      mirrorLink(mine, p);
+      mirror(mine->energy(), p->energy());
+    }
+  }
+  clone->refreshRecordsForModeledStates();
+  clone->initEngine();
+  return clone;
+}
+
+#pragma mark - Merging
+
+void ParallelHindcast::waitForMergeWindow(size_t iSegment) {
+  // the segment at _nextMerge is always running or merging, so the window always moves
+  unique_lock<mutex> lock(_mergeMutex);
+  _mergeAdvanced.wait(lock, [&]{ return iSegment < _nextMerge + _maxAhead; });
+}
+
+void ParallelHindcast::deposit(size_t iSegment, Held& held) {
+  unique_lock<mutex> lock(_mergeMutex);
+  _held[iSegment] = std::move(held);
+  _finished[iSegment] = true;
+  if (_merging) {
+    return; // whoever is merging will get to it
+  }
+  _merging = true;
+  while (_nextMerge < _finished.size() && _finished[_nextMerge]) {
+    size_t k = _nextMerge++;
+    Held ready = std::move(_held[k]);
+    _held[k] = Held();
+    lock.unlock();
+    _mergeAdvanced.notify_all();
+    this->merge(k, ready);
+    lock.lock();
+  }
+  _merging = false;
+}
+
+void ParallelHindcast::merge(size_t iSegment, Held& held) {
+  bool last = (iSegment + 1 == _segments.size());
+  TimeRange range = _segments[iSegment].range;
+  auto kept = [&](time_t t) {
+    return last || t < range.end; // the next segment's reset step replaces the last one
+  };
+
+  // solver statistics first, as a sequential run records them before saving each step
+  for (TimeSeries::_sp ts : _baseModel->solverStats()) {
+    auto found = held.stats.find(ts->name());
+    if (found == held.stats.end()) {
+      continue;
+    }
+    vector<Point> points;
+    for (const Point& p : found->second) {
+      if (kept(p.time)) {
+        points.push_back(p);
+      }
+    }
+    if (!points.empty()) {
+      ts->insertPoints(points);
+    }
+  }
+
+  // a clone writes in step order; sorting keeps the merge safe whatever order they arrive in
+  stable_sort(held.states.begin(), held.states.end(), [](const StateSnapshot& a, const StateSnapshot& b){ return a.time < b.time; });
+  for (StateSnapshot& snapshot : held.states) {
+    if (!kept(snapshot.time)) {
+      continue;
+    }
+    _baseModel->writeNetworkStates(snapshot); // commits, then records save stats and the heartbeat
+  }
+  held.states.clear();
+
+  _baseModel->recordDmaDemands(range);
+
+  // the clones wrote behind the base series' backs
+  for (auto& ts : _targets) {
+    ts->bumpVersion();
+  }
+}
@@ -0,0 +1,86 @@
+//
+//  ParallelHindcast.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_ParallelHindcast_h
+#define epanet_rtx_ParallelHindcast_h
+
+#include <vector>
+#include <string>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+
+#include "EpanetModel.h"
+#include "SavePipeline.h"
+#include "TimeRange.h"
+#include "rtxMacros.h"
+
+namespace RTX {
+
+  /*!
+   \class ParallelHindcast
+   \brief Runs a long extended-period simulation as independent segments across cores
+
+   With a tank reset clock, every reset re-syncs the tanks from their measurements. Nothing simulated before a reset carries past it, so the periods between resets can be simulated independently. This class cuts [start, end] at the base model's reset times and hands the segments to a pool of cloned models, one clone per thread. Each clone shares the base's inputs and writes to the base's records. Clones don't prefetch or evict boundary data: the input records are shared, and one clone's window would push out another's.
+
+   Segments finish out of order, so each clone holds its states back instead of writing them, along with its per-step solver statistics. As soon as every earlier segment is in, a segment is merged in time order: its statistics go into the base's statistics series, its states are written through the base model's own save path (which adds the save statistics and the heartbeat), and the base's DMA demands are evaluated over the segment. So the base's records receive what a sequential run would have written, in the same order, though the wall times naturally differ. Every segment after the first starts with its tanks reset from measurements. The first starts as a sequential run would: from the base model's last simulated state, unless the base's tanks need a reset anyway. A segment's last step is dropped in favor of the next segment's first, which is the reset step at the same time.
+
+   Held segments are bounded: a worker does not start a segment more than two segments per worker ahead of the merge.
+
+   Without a reset clock there is only one segment, and it runs on the base model itself. The same goes for a model that runs water quality: a reset restores tank levels but not the quality in pipes and tanks, so a segment started from initial quality would not match a sequential run.
+
+   */
+
+  class ParallelHindcast : public RTX_object {
+  public:
+    RTX_BASE_PROPS(ParallelHindcast);
+
+    class Segment {
+    public:
+      TimeRange range;
+      bool success = false;
+      std::string errorMessage;
+    };
+
+    ParallelHindcast(EpanetModel::_sp baseModel);
+
+    void setThreadCount(size_t n);
+    size_t threadCount();
+
+    std::vector<TimeRange> segmentsFor(time_t start, time_t end); // cut at the base model's tank resets, unless it runs water quality
+    bool runExtendedPeriod(time_t start, time_t end);             // false if any segment failed
+    const std::vector<Segment>& segments() { return _segments; };
+
+  private:
+    class Held {
+    public:
+      std::vector<StateSnapshot> states;
+      std::map<std::string, std::vector<Point> > stats; // per-step solver statistics, by series name
+    };
+
+    EpanetModel::_sp cloneForWorker(PointRecord::_sp statsRecord);
+    void waitForMergeWindow(size_t iSegment);
+    void deposit(size_t iSegment, Held& held);
+    void merge(size_t iSegment, Held& held);
+
+    EpanetModel::_sp _baseModel;
+    size_t _threadCount;
+    std::vector<Segment> _segments;
+    std::vector<TimeSeries::_sp> _targets; // the base's output series, whose records the clones write through
+
+    std::mutex _mergeMutex;
+    std::condition_variable _mergeAdvanced;
+    std::vector<Held> _held;
+    std::vector<bool> _finished;
+    size_t _nextMerge, _maxAhead;
+    bool _merging;
+  };
+
+}
+
+#endif
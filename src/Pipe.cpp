@@ -24,9 +24,7 @@ Pipe::Pipe(const std::string& name) : Link(name) {
   
   _fixedStatus = Pipe::OPEN;
   
-  state_flow    = 0.;
-  state_setting = 0.;
-  state_status  = 0.;
+  engineIndex = -1;
   
   _roughness = 100;
   _minorLoss = 0;
@@ -99,11 +97,28 @@ TimeSeries::_sp Pipe::quality() {
   return _qualityState;
 }
 
+double Pipe::state(StateStore::quantity_t quantity) {
+  if (!_stateStore) {
+    return 0;
+  }
+  return _stateStore->value(quantity, engineIndex);
+}
+
+void Pipe::setState(StateStore::quantity_t quantity, double value) {
+  if (_stateStore) {
+    _stateStore->setValue(quantity, engineIndex, value);
+  }
+}
+
+void Pipe::setStateStore(StateStore::_sp store) {
+  _stateStore = store;
+}
+
 double Pipe::state_quality() {
   auto j1 = std::dynamic_pointer_cast<Junction>(this->from());
   auto j2 = std::dynamic_pointer_cast<Junction>(this->to());
   
-  return (j1->state_quality + j2->state_quality) / 2.0;
+  return (j1->state(StateStore::Quality) + j2->state(StateStore::Quality)) / 2.0;
 }
 
 
@@ -10,6 +10,7 @@
 #define epanet_rtx_Pipe_h
 
 #include "Link.h"
+#include "StateStore.h"
 
 namespace RTX {
 //!   Pipe Class
@@ -45,10 +46,16 @@ public:
   TimeSeries::_sp flow();
   TimeSeries::_sp quality();
 
-  // public ivars for temporary (that is, steady-state) solutions
-  double state_flow, state_setting, state_status, state_energy;
+  // temporary (that is, steady-state) solutions, kept in the model's columnar state store
+  double state(StateStore::quantity_t quantity);
+  void setState(StateStore::quantity_t quantity, double value);
+  void setStateStore(StateStore::_sp store);
   double state_quality();
   
+  // zero-based slot of this link in the engine's bulk state arrays, which is also
+  // its offset into the state store columns (-1 if not bound to an engine)
+  int engineIndex;
+  
   
   // parameters
   TimeSeries::_sp statusBoundary();
@@ -74,6 +81,7 @@ private:
   TimeSeries::_sp _statusBoundary;
   TimeSeries::_sp _settingBoundary;
   TimeSeries::_sp _status, _setting;
+  StateStore::_sp _stateStore;
 };
 }
 
@@ -14,11 +14,11 @@ using std::cout;
 using std::endl;
 using namespace RTX;
 
-Point::Point() : time(0),value(0),quality(PointQuality::opc_bad),confidence(0),isValid(false) {
+Point::Point() : time(0),value(0),confidence(0),quality(PointQuality::opc_bad),isValid(false) {
   
 }
 
-Point::Point(time_t t, double v, PointQuality q, double c) : time(t),value(v),quality(q),confidence(c),isValid((std::isnan(v)) ? false : true) {
+Point::Point(time_t t, double v, PointQuality q, double c) : time(t),value(v),confidence(c),quality(q),isValid((std::isnan(v)) ? false : true) {
   if (std::isnan(v)) {
     cout << "nan" << endl;
   }
@@ -63,10 +63,11 @@ namespace RTX {
 //    virtual std::ostream& toStream(std::ostream& stream);
 
     // simple tuple class, so no getters/setters
+    // ordered largest-first so the point packs into 32 bytes
     time_t time;
     double value;
-    PointQuality quality;
     double confidence;
+    PointQuality quality;
     bool isValid;
     
     // convenience
@@ -1,5 +1,8 @@
 #include "PointCollection.h"
 
+#include <cmath>
+#include <algorithm>
+
 #include <boost/accumulators/accumulators.hpp>
 #include <boost/accumulators/statistics.hpp>
 #include <boost/accumulators/statistics/tail_quantile.hpp>
@@ -12,35 +15,140 @@ using pvIt = PointCollection::pvIt;
 
 
 
-inline void __apply(RTX::PointCollection::pvRange r, function<void(Point&)> fn) {
+template<class F>
+inline void __applyValues(RTX::PointCollection::pvRange r, F fn) {
   auto i = r.first;
   while (i != r.second) {
-    fn(*i);
+    fn(i.value());
     ++i;
   }
 }
 
 
 
+#pragma mark - Columns
+
+void PointCollection::Columns::reserve(size_t n) {
+  times.reserve(n);
+  values.reserve(n);
+}
+
+Point PointCollection::Columns::at(size_t i) const {
+  // field-wise, so stored NaNs don't trip the constructor's logging
+  Point p;
+  p.time = times[i];
+  p.value = values[i];
+  p.quality = qualities.empty() ? quality : qualities[i];
+  p.confidence = confidences.empty() ? confidence : confidences[i];
+  p.isValid = validity.empty() ? isValid : validity[i];
+  return p;
+}
+
+void PointCollection::Columns::set(size_t i, const Point& p) {
+  times[i] = p.time;
+  values[i] = p.value;
+  
+  bool only = (this->size() == 1);
+  if (qualities.empty() && p.quality != quality) {
+    if (only) quality = p.quality; else qualities.assign(this->size(), quality);
+  }
+  if (confidences.empty() && p.confidence != confidence) {
+    if (only) confidence = p.confidence; else confidences.assign(this->size(), confidence);
+  }
+  if (validity.empty() && p.isValid != isValid) {
+    if (only) isValid = p.isValid; else validity.assign(this->size(), isValid);
+  }
+  
+  if (!qualities.empty()) qualities[i] = p.quality;
+  if (!confidences.empty()) confidences[i] = p.confidence;
+  if (!validity.empty()) validity[i] = p.isValid;
+}
+
+PointCollection::Columns PointCollection::Columns::slice(size_t b, size_t e) const {
+  Columns c;
+  c.times.assign(times.begin() + b, times.begin() + e);
+  c.values.assign(values.begin() + b, values.begin() + e);
+  if (!qualities.empty()) c.qualities.assign(qualities.begin() + b, qualities.begin() + e);
+  if (!confidences.empty()) c.confidences.assign(confidences.begin() + b, confidences.begin() + e);
+  if (!validity.empty()) c.validity.assign(validity.begin() + b, validity.begin() + e);
+  c.quality = quality;
+  c.confidence = confidence;
+  c.isValid = isValid;
+  return c;
+}
+
+void PointCollection::Columns::push_back(const Point& p) {
+  if (times.empty()) {
+    // the first point sets the shared attributes
+    quality = p.quality;
+    confidence = p.confidence;
+    isValid = p.isValid;
+  }
+  else {
+    // a differing point means the attribute needs its own column from here on
+    if (qualities.empty() && p.quality != quality) {
+      qualities.assign(this->size(), quality);
+    }
+    if (confidences.empty() && p.confidence != confidence) {
+      confidences.assign(this->size(), confidence);
+    }
+    if (validity.empty() && p.isValid != isValid) {
+      validity.assign(this->size(), isValid);
+    }
+  }
+  times.push_back(p.time);
+  values.push_back(p.value);
+  if (!qualities.empty()) qualities.push_back(p.quality);
+  if (!confidences.empty()) confidences.push_back(p.confidence);
+  if (!validity.empty()) validity.push_back(p.isValid);
+}
+
+
+
+#pragma mark - PointCollection
+
 PointCollection::PointCollection(vector<Point> points, Units units) : units(units) {
   this->setPoints(points);
 }
-PointCollection::PointCollection() : units(1) { 
-  this->setPoints(vector<Point>());
+PointCollection::PointCollection() : units(1), _begin(0), _end(0) { 
+  _columns = make_shared<Columns>();
+}
+PointCollection::PointCollection(shared_ptr<Columns> columns, Units units) : units(units), _columns(columns), _begin(0), _end(columns->size()) {
+  
+}
+
+PointCollection::pvRange PointCollection::raw() const {
+  return make_pair(this->begin(), this->end());
 }
 
-pair<pvIt,pvIt> PointCollection::raw() const {
-  return make_pair(_points->begin(),_points->end());
+void PointCollection::detach() {
+  if (_columns.use_count() == 1 && _begin == 0 && _end == _columns->size()) {
+    return; // already the sole owner of exactly these points
+  }
+  _columns = make_shared<Columns>(_columns->slice(_begin, _end));
+  _end -= _begin;
+  _begin = 0;
 }
 
-void PointCollection::apply(std::function<void(Point&)> function) const {
-  auto raw = this->raw();
-  __apply(raw, function);
+void PointCollection::apply(std::function<void(Point&)> function) {
+  for (size_t i = _begin; i < _end; ++i) {
+    Point p = _columns->at(i);
+    Point orig = p;
+    function(p);
+    bool changed = (p.time != orig.time || p.value != orig.value || p.quality != orig.quality || p.confidence != orig.confidence || p.isValid != orig.isValid);
+    if (changed) {
+      // copy-on-write: other collections may share these columns
+      size_t offset = i - _begin;
+      this->detach();
+      i = _begin + offset;
+      _columns->set(i, p);
+    }
+  }
 }
 
 TimeRange PointCollection::range() const {
-  if (_points) {
-    return TimeRange(_points->begin()->time, _points->rbegin()->time);
+  if (_end > _begin) {
+    return TimeRange(_columns->times[_begin], _columns->times[_end - 1]);
   }
   else {
     return TimeRange();
@@ -48,53 +156,65 @@ TimeRange PointCollection::range() const {
 }
 
 vector<Point> PointCollection::points() const {
-  if (_points) {
-    return vector<Point>(*_points.get());
-  }
-  else {
-    return vector<Point>();
+  vector<Point> pv;
+  pv.reserve(this->count());
+  for (size_t i = _begin; i < _end; ++i) {
+    pv.push_back(_columns->at(i));
   }
+  return pv;
 }
 
-void PointCollection::setPoints(vector<Point> points) {
-  _points = make_shared< vector<Point> >(points);
+void PointCollection::setPoints(const vector<Point>& points) {
+  auto c = make_shared<Columns>();
+  c->reserve(points.size());
+  for (const Point& p : points) {
+    c->push_back(p);
+  }
+  _columns = c;
+  _begin = 0;
+  _end = c->size();
 }
 
-const set<time_t> PointCollection::times() const {
-  set<time_t> t;
-  this->apply([&](Point& p){
-    t.insert(p.time);
-  });
-  return t;
+TimeList PointCollection::times() const {
+  // aliases our times column, keeping the columns alive
+  shared_ptr<const vector<time_t> > t(_columns, &_columns->times);
+  return TimeList(t, _begin, _end);
 }
 
 bool PointCollection::convertToUnits(RTX::Units u) {
   if (!u.isSameDimensionAs(this->units)) {
     return false;
   }
-  vector<Point> converted;
-  this->apply([&](Point& p){
-    converted.push_back(Point::convertPoint(p, this->units, u));
-  });
-  this->setPoints(converted);
+  double scale, shift;
+  Units::linearConversion(this->units, u, scale, shift);
+  const Columns& source = *_columns;
+  auto c = make_shared<Columns>();
+  c->reserve(this->count());
+  for (size_t i = _begin; i < _end; ++i) {
+    // same as Point::converted, without the per-point unit lookups
+    Point p = source.at(i);
+    c->push_back(Point(p.time, p.value * scale + shift, p.quality, p.confidence * scale + shift));
+  }
+  _columns = c;
+  _begin = 0;
+  _end = c->size();
   this->units = u;
   return true;
 }
 
 void PointCollection::addQualityFlag(Point::PointQuality q) {
-  auto pv = this->points();
-  for(Point &p : pv) {
+  this->apply([&](Point& p){
     p.addQualFlag(q);
-  }
-  this->setPoints(pv);
+  });
 }
 
 
 
-bool PointCollection::resample(set<time_t> timeList, ResampleMode mode) {
+bool PointCollection::resample(const TimeList& timeList, ResampleMode mode) {
   PointCollection c = this->resampledAtTimes(timeList,mode);
-  auto p = c.points();
-  this->setPoints(p);
+  _columns = c._columns;
+  _begin = c._begin;
+  _end = c._end;
   
   if (this->count() > 0) {
     return true;
@@ -102,7 +222,7 @@ bool PointCollection::resample(set<time_t> timeList, ResampleMode mode) {
   return false;
 }
 
-PointCollection PointCollection::resampledAtTimes(const std::set<time_t>& timeList, ResampleMode mode) const {
+PointCollection PointCollection::resampledAtTimes(const TimeList& timeList, ResampleMode mode) const {
   
   
   // sanity
@@ -114,28 +234,25 @@ PointCollection PointCollection::resampledAtTimes(const std::set<time_t>& timeLi
   }
   
   
-  vector<Point> resampled;
-  vector<Point>::size_type s = timeList.size();
-  resampled.reserve(s);
+  auto resampled = make_shared<Columns>();
+  resampled->reserve(timeList.size());
   
   
-  // iterators for scrubbing through the source points
-  pvIt sourceBegin = _points->begin();
-  pvIt sourceEnd = _points->end();
-  pvIt right = sourceBegin;
-  pvIt left = sourceBegin;
-  
-  ++right; // get one step ahead.
+  // cursors for scrubbing through the source points
+  const Columns& source = *_columns;
+  const size_t sourceEnd = _end;
+  size_t left = _begin;
+  size_t right = _begin + 1; // get one step ahead.
   
   for (const time_t now : timeList) {
     
     // maybe we can't resample at now
-    if (now < left->time) {
+    if (now < source.times[left]) {
       continue;
     }
     
     // get positioned
-    while (right != sourceEnd && right->time <= now) {
+    while (right != sourceEnd && source.times[right] <= now) {
       ++left;
       ++right;
     }
@@ -143,21 +260,20 @@ PointCollection PointCollection::resampledAtTimes(const std::set<time_t>& timeLi
     Point p;
     if (mode == ResampleModeLinear) {
       if (right != sourceEnd) {
-        p = Point::linearInterpolate(*left, *right, now);
-        resampled.push_back(p);
+        p = Point::linearInterpolate(source.at(left), source.at(right), now);
+        resampled->push_back(p);
       }
       else {
-        if (left->time == now) {
-          p = *left;
-          resampled.push_back(p);
+        if (source.times[left] == now) {
+          resampled->push_back(source.at(left));
         }
         break;
       }
     }
     else if (mode == ResampleModeStep) {
-      p = *left;
+      p = source.at(left);
       p.time = now;
-      resampled.push_back(p);
+      resampled->push_back(p);
     }
   }
   
@@ -166,54 +282,27 @@ PointCollection PointCollection::resampledAtTimes(const std::set<time_t>& timeLi
 
 
 PointCollection::pvRange PointCollection::subRange(TimeRange r, PointCollection::pvRange range_hint) const {
-  pvIt it = _points->begin();
-  pvIt r1 = it, r2 = it;
-  pvIt end = _points->end();
-  
-  /*
-   TODO:
-   there is a nice optimization to be done here, but this attempt was half-baked.
-   re-think how to accept range hints to begin the search along the vector.
-   */
-  bool _hint_provided = false;
-  // _hint_provided = (range_hint.first != pvIt() && range_hint.second != pvIt());
-  // if a range hint is provided, then use it!
-  if (_hint_provided) {
-    // range hint was given.
-    it = range_hint.first;
-    r2 = range_hint.second;
-  }
-  
-  
-  while (it != end) {
-    time_t t = it->time;
-    if (r.contains(t)) {
-      r1 = it;
-      break;
-    }
-    ++it;
-  }
-  
-  if (_hint_provided) {
-    it = r2;
-  }
-  
-  while (it != end) {
-    time_t t = it->time;
-    if (!r.contains(t)) {
-      break;
+  // times are sorted, so the bounds are binary searches. a usable hint narrows the search.
+  const time_t* t = _columns->times.data();
+  const time_t* searchBegin = t + _begin;
+  const time_t* searchEnd = t + _end;
+  if (range_hint.first._c == _columns.get()) {
+    size_t h = range_hint.first.index();
+    if (_begin < h && h <= _end && t[h - 1] < r.start) {
+      searchBegin = t + h;
     }
-    ++it;
-    r2 = it;
   }
-  
-  return make_pair(r1,r2);
+  const time_t* lo = lower_bound(searchBegin, searchEnd, r.start);
+  const time_t* hi = upper_bound(lo, searchEnd, r.end);
+  return make_pair(pvIt(_columns.get(), lo - t), pvIt(_columns.get(), hi - t));
 }
 
 PointCollection PointCollection::trimmedToRange(TimeRange range) const {
+  // a view onto the same columns
   auto iters = this->subRange(range);
-  vector<Point> ranged(iters.first,iters.second);
-  PointCollection c(ranged,this->units);
+  PointCollection c = *this;
+  c._begin = iters.first.index();
+  c._end = iters.second.index();
   return c;
 }
 
@@ -225,15 +314,15 @@ PointCollection PointCollection::asDelta() const {
     return PointCollection(deltaPoints, this->units);
   }
   
-  Point lastP = _points->front();
+  Point lastP = _columns->at(_begin);
   deltaPoints.push_back(lastP);
   
-  this->apply([&](Point& p){
-    if (p.value != lastP.value) {
-      lastP = p;
+  for (size_t i = _begin; i < _end; ++i) {
+    if (_columns->values[i] != lastP.value) {
+      lastP = _columns->at(i);
       deltaPoints.push_back(lastP);
     }
-  });
+  }
   
   return PointCollection(deltaPoints, this->units);
 }
@@ -261,13 +350,13 @@ double PointCollection::percentile(double p, pvRange r) {
   
   if (cacheSize == 1 && p == 0.5) {
     // single point median
-    return r.first->value;
+    return r.first.value();
   }
   
   if (p <= 0.5) {
     accumulator_set<double, stats<tag::tail_quantile<boost::accumulators::left> > > centile( tag::tail<boost::accumulators::left>::cache_size = cacheSize );
-    __apply(r,[&](Point& p){
-      centile(p.value);
+    __applyValues(r,[&](double v){
+      centile(v);
     });
     
     double pct = quantile(centile, quantile_probability = p);
@@ -275,8 +364,8 @@ double PointCollection::percentile(double p, pvRange r) {
   }
   else {
     accumulator_set<double, stats<tag::tail_quantile<boost::accumulators::right> > > centile( tag::tail<boost::accumulators::right>::cache_size = cacheSize );
-    __apply(r,[&](Point& p){
-      centile(p.value);
+    __applyValues(r,[&](double v){
+      centile(v);
     });
     double pct = quantile(centile, quantile_probability = p);
     return pct;
@@ -285,11 +374,7 @@ double PointCollection::percentile(double p, pvRange r) {
 }
 
 size_t PointCollection::count(pvRange r) {
-  size_t count = 0;
-  __apply(r,[&](Point& p){
-    ++count;
-  });
-  return count;
+  return r.second - r.first;
 }
 
 
@@ -300,8 +385,8 @@ double PointCollection::min(pvRange r) {
   
   accumulator_set<double, features<tag::min> > acc;
   
-  __apply(r,[&](Point& p){
-    acc(p.value);
+  __applyValues(r,[&](double v){
+    acc(v);
   });
   
   double min = extract::min(acc);
@@ -314,8 +399,8 @@ double PointCollection::max(pvRange r) {
   }
   
   accumulator_set<double, features<tag::max> > acc;
-  __apply(r,[&](Point& p){
-    acc(p.value);
+  __applyValues(r,[&](double v){
+    acc(v);
   });
   
   double max = extract::max(acc);
@@ -328,8 +413,8 @@ double PointCollection::mean(pvRange r) {
   }
   accumulator_set<double, features<tag::mean> > acc;
   
-  __apply(r,[&](Point& p){
-    acc(p.value);
+  __applyValues(r,[&](double v){
+    acc(v);
   });
   
   double mean = extract::mean(acc);
@@ -342,8 +427,8 @@ double PointCollection::variance(pvRange r) {
   }
   accumulator_set<double, features<tag::variance(lazy)> > acc;
   
-  __apply(r,[&](Point& p){
-    acc(p.value);
+  __applyValues(r,[&](double v){
+    acc(v);
   });
   
   double variance = extract::variance(acc);
@@ -358,7 +443,10 @@ double PointCollection::interquartilerange(pvRange r) {
 }
 
 TimeRange PointCollection::timeRange(pvRange r) {
-  return TimeRange(r.first->time, r.second->time);
+  if (r.first == r.second) {
+    return TimeRange();
+  }
+  return TimeRange(r.first.time(), (r.second - 1).time());
 }
 
 
@@ -4,44 +4,130 @@
 #include <stdio.h>
 #include <vector>
 #include <set>
+#include <memory>
+#include <iterator>
 #include <functional>
 
 #include "Units.h"
 #include "TimeRange.h"
 #include "Point.h"
+#include "TimeList.h"
 
 namespace RTX {
-  
+
   typedef enum {
     ResampleModeLinear = 0,
     ResampleModeStep = 1
   } ResampleMode;
-  
+
   /// PointCollection is a wrapper for a point vector, with some intelligence for sampling and subranging
-  
+  /*!
+   Points are stored column-wise: a times array and a values array. Quality, confidence and validity are
+   kept as a single shared value until some point differs, and only then get a column of their own, so
+   a typical series costs 16 bytes per point. Iterators synthesize Point objects on dereference.
+   
+   A collection is a window [begin,end) onto columns that may be shared with other collections, so
+   trimming is free. Writes go to a private copy.
+   */
+
   class PointCollection {
   public:
-    typedef std::vector<Point>::iterator pvIt;
+
+    class Columns {
+    public:
+      std::vector<time_t> times;
+      std::vector<double> values;
+      std::vector<Point::PointQuality> qualities; // empty while every point has `quality`
+      std::vector<double> confidences;            // empty while every point has `confidence`
+      std::vector<bool> validity;                 // empty while every point has `isValid`
+      Point::PointQuality quality = Point::opc_rtx_override;
+      double confidence = 0;
+      bool isValid = true;
+
+      size_t size() const { return times.size(); };
+      void reserve(size_t n);
+      Point at(size_t i) const;
+      void set(size_t i, const Point& p);
+      void push_back(const Point& p);
+      Columns slice(size_t b, size_t e) const;
+    };
+
+    /// read-only random access iterator. dereferencing yields a Point by value.
+    class const_iterator {
+    public:
+      class arrow {
+      public:
+        arrow(const Point& p) : _p(p) {};
+        const Point* operator->() const { return &_p; };
+      private:
+        Point _p;
+      };
+      typedef std::random_access_iterator_tag iterator_category;
+      typedef Point value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef arrow pointer;
+      typedef Point reference;
+
+      const_iterator() : _c(NULL), _i(0) {};
+      const_iterator(const Columns* c, size_t i) : _c(c), _i(i) {};
+
+      Point operator*() const { return _c->at(_i); };
+      arrow operator->() const { return arrow(_c->at(_i)); };
+      Point operator[](difference_type n) const { return _c->at(_i + n); };
+      // column access without building a Point
+      time_t time() const { return _c->times[_i]; };
+      double value() const { return _c->values[_i]; };
+      size_t index() const { return _i; };
+
+      const_iterator& operator++() { ++_i; return *this; };
+      const_iterator operator++(int) { const_iterator t = *this; ++_i; return t; };
+      const_iterator& operator--() { --_i; return *this; };
+      const_iterator operator--(int) { const_iterator t = *this; --_i; return t; };
+      const_iterator& operator+=(difference_type n) { _i += n; return *this; };
+      const_iterator& operator-=(difference_type n) { _i -= n; return *this; };
+      const_iterator operator+(difference_type n) const { return const_iterator(_c, _i + n); };
+      const_iterator operator-(difference_type n) const { return const_iterator(_c, _i - n); };
+      difference_type operator-(const const_iterator& o) const { return (difference_type)_i - (difference_type)o._i; };
+      bool operator==(const const_iterator& o) const { return _c == o._c && _i == o._i; };
+      bool operator!=(const const_iterator& o) const { return !(*this == o); };
+      bool operator<(const const_iterator& o) const { return _i < o._i; };
+      bool operator>(const const_iterator& o) const { return _i > o._i; };
+      bool operator<=(const const_iterator& o) const { return _i <= o._i; };
+      bool operator>=(const const_iterator& o) const { return _i >= o._i; };
+
+    private:
+      friend class PointCollection;
+      const Columns* _c;
+      size_t _i;
+    };
+
+    typedef const_iterator pvIt;
     typedef std::pair<pvIt,pvIt> pvRange;
-    
+
     PointCollection(std::vector<Point> points, Units units);
     PointCollection();
-    
-    void apply(std::function<void(Point&)> function) const;
+
+    void apply(std::function<void(Point&)> function); // changes are written back to the collection
     pvRange raw() const;
+    pvIt begin() const { return pvIt(_columns.get(), _begin); };
+    pvIt end() const { return pvIt(_columns.get(), _end); };
+    const time_t* timesBegin() const { return _columns->times.data() + _begin; }; // sorted, no copy
+    const time_t* timesEnd() const { return _columns->times.data() + _end; };
+    const double* valuesBegin() const { return _columns->values.data() + _begin; };
+    const Columns& columns() const { return *_columns; }; // shared storage; may be wider than this collection
     std::vector<Point> points() const;
-    void setPoints(std::vector<Point> points);
-    
+    void setPoints(const std::vector<Point>& points);
+
     Units units;
-    const std::set<time_t> times() const;
+    TimeList times() const; // shares storage, no copy
     TimeRange range() const;
-    
-    bool resample(std::set<time_t> timeList, ResampleMode mode = ResampleModeLinear);
+
+    bool resample(const TimeList& timeList, ResampleMode mode = ResampleModeLinear);
     bool convertToUnits(Units u);
     void addQualityFlag(Point::PointQuality q);
-    
+
     // statistical methods on point collections
-    
+
     static double min(pvRange r);
     static double max(pvRange r);
     static double mean(pvRange r);
@@ -50,25 +136,28 @@ namespace RTX {
     static double percentile(double p, pvRange r);
     static double interquartilerange(pvRange r);
     static TimeRange timeRange(pvRange r);
-    
+
     double min() const { return PointCollection::min(this->raw()); };
-    double max() const { return PointCollection::min(this->raw()); };
+    double max() const { return PointCollection::max(this->raw()); };
     double mean() const { return PointCollection::mean(this->raw()); };
     double variance() const { return PointCollection::variance(this->raw()); };
-    size_t count() const { return _points->size(); };
+    size_t count() const { return _end - _begin; };
     double percentile(double p) const { return PointCollection::percentile(p,this->raw()); };
     double interquartilerange() const { return PointCollection::interquartilerange(this->raw()); };
     TimeRange timeRange() const { return PointCollection::timeRange(this->raw()); };
-    
-    
-    // non-mutating
+
+
+    // non-mutating. subRange and trimmedToRange share storage with this collection instead of copying.
     pvRange subRange(TimeRange r, pvRange range_hint = pvRange()) const;
     PointCollection trimmedToRange(TimeRange range) const;
-    PointCollection resampledAtTimes(const std::set<time_t>& times, ResampleMode mode = ResampleModeLinear) const;
+    PointCollection resampledAtTimes(const TimeList& times, ResampleMode mode = ResampleModeLinear) const;
     PointCollection asDelta() const;
-    
+
   private:
-    std::shared_ptr< std::vector<Point> > _points;
+    PointCollection(std::shared_ptr<Columns> columns, Units units);
+    void detach(); // take a private copy of our points before writing
+    std::shared_ptr<Columns> _columns;
+    size_t _begin, _end;
   };
 }
 
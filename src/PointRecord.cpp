@@ -7,6 +7,7 @@
 //  
 
 #include <iostream>
+#include <algorithm>
 
 #include "PointRecord.h"
 
@@ -42,6 +43,7 @@ bool PointRecord::registerAndGetIdentifierForSeriesWithUnits(std::string recordN
   
   _idsCache.set(recordName, units);
   
+  std::lock_guard<std::mutex> lock(_singlePointMutex);
   if (_singlePointCache.find(recordName) == _singlePointCache.end()) {
     _singlePointCache[recordName] = Point();
   }
@@ -60,9 +62,10 @@ bool PointRecord::exists(const std::string &name, const RTX::Units &units) {
 
 Point PointRecord::point(const string& identifier, time_t time) {
   // return the cached point if it is valid
-  
-  if (_singlePointCache.find(identifier) != _singlePointCache.end()) {
-    Point p = _singlePointCache[identifier];
+  std::lock_guard<std::mutex> lock(_singlePointMutex);
+  auto found = _singlePointCache.find(identifier);
+  if (found != _singlePointCache.end()) {
+    const Point& p = found->second;
     if (p.time == time) {
       return p;
     }
@@ -111,6 +114,7 @@ TimeRange PointRecord::range(const string& id) {
 
 void PointRecord::addPoint(const string& identifier, Point point) {
   // Cache this single point
+  std::lock_guard<std::mutex> lock(_singlePointMutex);
   _singlePointCache[identifier] = point;
 }
 
@@ -120,6 +124,51 @@ void PointRecord::addPoints(const string& identifier, std::vector<Point> points)
 }
 
 
+#pragma mark - Snapshots
+
+PointRecord::seriesHandle_t PointRecord::handleForIdentifier(const string& identifier) {
+  std::lock_guard<std::mutex> lock(_handleMutex);
+  auto found = _handleLookup.find(identifier);
+  if (found != _handleLookup.end()) {
+    return found->second;
+  }
+  seriesHandle_t handle = _handleIdentifiers.size();
+  _handleIdentifiers.push_back(identifier);
+  {
+    std::lock_guard<std::mutex> cacheLock(_singlePointMutex); // always taken after _handleMutex
+    _handlePointCache.push_back(&(_singlePointCache[identifier]));
+  }
+  _handleLookup[identifier] = handle;
+  return handle;
+}
+
+std::string PointRecord::identifierForHandle(seriesHandle_t handle) {
+  std::lock_guard<std::mutex> lock(_handleMutex);
+  if (handle >= _handleIdentifiers.size()) {
+    return "";
+  }
+  return _handleIdentifiers[handle];
+}
+
+size_t PointRecord::handleCount() {
+  std::lock_guard<std::mutex> lock(_handleMutex);
+  return _handleIdentifiers.size();
+}
+
+void PointRecord::addSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values) {
+  // same effect as addPoint for each handle/value pair, but with one lock and no identifier lookups.
+  std::lock_guard<std::mutex> lock(_handleMutex);
+  std::lock_guard<std::mutex> cacheLock(_singlePointMutex);
+  const size_t n = std::min(handles.size(), values.size());
+  const size_t nHandles = _handlePointCache.size();
+  for (size_t i = 0; i < n; ++i) {
+    if (handles[i] < nHandles) {
+      *(_handlePointCache[handles[i]]) = Point(time, values[i]);
+    }
+  }
+}
+
+
 void PointRecord::reset() {
   
 }
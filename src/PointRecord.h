@@ -15,6 +15,7 @@
 #include <deque>
 #include <fstream>
 #include <map>
+#include <mutex>
 
 
 #include "Point.h"
@@ -60,6 +61,7 @@ namespace RTX {
     
   public:
     RTX_BASE_PROPS(PointRecord);
+    typedef size_t seriesHandle_t;
     
     PointRecord();
     virtual ~PointRecord() {};
@@ -86,19 +88,31 @@ namespace RTX {
     virtual Point lastPoint(const string& id);
     virtual TimeRange range(const string& id);
     virtual bool supportsQualifiedQuery() { return false; };
+    virtual bool changesExternally() { return false; }; // can someone else write to our storage?
     
     virtual std::ostream& toStream(std::ostream &stream);
     
     virtual void beginBulkOperation() {};
     virtual void endBulkOperation() {};
     
+    // snapshot insertion: resolve each identifier to a handle once, then write many series at a single time stamp.
+    seriesHandle_t handleForIdentifier(const string& identifier);
+    std::string identifierForHandle(seriesHandle_t handle);
+    virtual void addSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values);
+    
     
   protected:
-    std::map<std::string,Point> _singlePointCache;
+    std::map<std::string,Point> _singlePointCache; // guarded by _singlePointMutex
+    std::mutex _singlePointMutex;
     IdentifierUnitsList _idsCache;
+    size_t handleCount();
     
   private:
     std::string _name;
+    std::mutex _handleMutex;
+    std::map<std::string, seriesHandle_t> _handleLookup;
+    std::vector<std::string> _handleIdentifiers;
+    std::vector<Point*> _handlePointCache; // stable: map nodes are never erased
   
   };
   
@@ -0,0 +1,189 @@
+//
+//  QueryPlanner.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <iostream>
+
+#include "QueryPlanner.h"
+#include "DbPointRecord.h"
+
+using namespace RTX;
+using namespace std;
+
+void QueryPlanner::addSeries(TimeSeries::_sp ts) {
+  if (!ts || _seen.count(ts) > 0) {
+    return;
+  }
+  _seen.insert(ts);
+  for (auto root : ts->rootTimeSeries()) {
+    PointRecord::_sp record = root->record();
+    if (record) {
+      _plan[record].insert(root->name());
+    }
+  }
+}
+
+void QueryPlanner::clear() {
+  _plan.clear();
+  _seen.clear();
+}
+
+bool QueryPlanner::empty() {
+  return _plan.empty();
+}
+
+void QueryPlanner::prepare(TimeRange window) {
+  if (!window.isValid()) {
+    return;
+  }
+  for (auto& entry : _plan) {
+    DbPointRecord::_sp dbRecord = dynamic_pointer_cast<DbPointRecord>(entry.first);
+    if (!dbRecord) {
+      continue;
+    }
+    vector<string> ids(entry.second.begin(), entry.second.end());
+    dbRecord->willQuery(window, ids);
+  }
+}
+
+void QueryPlanner::evictBefore(time_t time) {
+  for (auto& entry : _plan) {
+    DbPointRecord::_sp dbRecord = dynamic_pointer_cast<DbPointRecord>(entry.first);
+    if (!dbRecord) {
+      continue; // in-memory data has nowhere to be re-fetched from
+    }
+    for (const string& id : entry.second) {
+      dbRecord->trimBefore(id, time);
+    }
+  }
+}
+
+map<PointRecord::_sp, set<string> > QueryPlanner::plan() {
+  return _plan;
+}
+
+
+#pragma mark - LookaheadPrefetcher
+
+LookaheadPrefetcher::LookaheadPrefetcher(QueryPlanner::_sp planner, time_t lookahead) : _planner(planner), _lookahead(lookahead), _evict(false), _queued(false), _busy(false), _stop(false) {
+  // the worker starts with the first window it is handed
+}
+
+LookaheadPrefetcher::~LookaheadPrefetcher() {
+  {
+    lock_guard<mutex> lock(_mtx);
+    _stop = true;
+  }
+  _workQueued.notify_all();
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+}
+
+void LookaheadPrefetcher::advanceTo(time_t cursor) {
+  unique_lock<mutex> lock(_mtx);
+  if (_lookahead <= 0 || _planner->empty()) {
+    return;
+  }
+  
+  bool crossed = false;
+  if (!_ready.isValid() || !_ready.contains(cursor)) {
+    this->waitForWorker(lock);
+    if (_pending.isValid() && _pending.contains(cursor)) {
+      _ready = _pending; // the usual case: the worker already has it
+    }
+    else {
+      // jumped (or just started). load the window we are in ourselves.
+      _ready = TimeRange(cursor, cursor + _lookahead);
+      lock.unlock();
+      _planner->prepare(_ready);
+      lock.lock();
+    }
+    _pending = TimeRange();
+    crossed = true;
+  }
+  
+  if (!_pending.isValid()) {
+    _pending = TimeRange(_ready.end, _ready.end + _lookahead);
+    _queued = _busy = true;
+    if (!_thread.joinable()) {
+      _thread = thread(&LookaheadPrefetcher::workerLoop, this);
+    }
+    _workQueued.notify_all();
+  }
+  bool evict = _evict;
+  lock.unlock();
+  
+  if (crossed && evict) {
+    // safe alongside the worker: it only appends past the end of what we trim
+    _planner->evictBefore(cursor - _lookahead);
+  }
+}
+
+void LookaheadPrefetcher::reset() {
+  unique_lock<mutex> lock(_mtx);
+  this->waitForWorker(lock);
+  _ready = TimeRange();
+  _pending = TimeRange();
+}
+
+time_t LookaheadPrefetcher::lookahead() {
+  lock_guard<mutex> lock(_mtx);
+  return _lookahead;
+}
+
+void LookaheadPrefetcher::setLookahead(time_t seconds) {
+  unique_lock<mutex> lock(_mtx);
+  this->waitForWorker(lock);
+  _lookahead = (seconds > 0) ? seconds : 0;
+  _ready = TimeRange();
+  _pending = TimeRange();
+}
+
+bool LookaheadPrefetcher::evicting() {
+  lock_guard<mutex> lock(_mtx);
+  return _evict;
+}
+
+void LookaheadPrefetcher::setEvicting(bool evict) {
+  lock_guard<mutex> lock(_mtx);
+  _evict = evict;
+}
+
+void LookaheadPrefetcher::waitForWorker(unique_lock<mutex>& lock) {
+  _workDone.wait(lock, [&]{ return !_busy; });
+}
+
+void LookaheadPrefetcher::workerLoop() {
+  while (true) {
+    TimeRange window;
+    {
+      unique_lock<mutex> lock(_mtx);
+      _workQueued.wait(lock, [&]{ return _stop || _queued; });
+      if (_stop) {
+        _busy = false;
+        _workDone.notify_all();
+        return;
+      }
+      window = _pending;
+      _queued = false;
+    }
+    try {
+      _planner->prepare(window);
+    } catch (const std::exception& e) {
+      // not fatal: the simulation falls back to fetching as it goes
+      cerr << "lookahead prefetch failed: " << e.what() << endl;
+    } catch (const std::string& e) {
+      cerr << "lookahead prefetch failed: " << e << endl;
+    }
+    {
+      lock_guard<mutex> lock(_mtx);
+      _busy = false;
+    }
+    _workDone.notify_all();
+  }
+}
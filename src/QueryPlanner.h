@@ -0,0 +1,95 @@
+//
+//  QueryPlanner.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_QueryPlanner_h
+#define epanet_rtx_QueryPlanner_h
+
+#include <map>
+#include <set>
+#include <string>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+#include "TimeSeries.h"
+#include "PointRecord.h"
+#include "rtxMacros.h"
+
+namespace RTX {
+
+  /*!
+   \class QueryPlanner
+   \brief Warms the root series behind a set of filter graphs, one batched fetch per record
+
+   Add the series you are about to read (model boundary conditions, say). The planner walks each one down to its roots and groups the roots by the record that stores them. prepare() then asks each database-backed record for all of its roots over a window at once, instead of letting every filter chain miss the cache separately, one point at a time. In-memory records are already warm, so they are left alone.
+
+   */
+
+  class QueryPlanner : public RTX_object {
+  public:
+    RTX_BASE_PROPS(QueryPlanner);
+
+    void addSeries(TimeSeries::_sp ts);
+    void clear();
+    bool empty();
+
+    void prepare(TimeRange window); // fetch every planned root over the window
+    void evictBefore(time_t time);  // drop buffered root data older than the point in effect at `time`
+
+    std::map<PointRecord::_sp, std::set<std::string> > plan(); // root identifiers, by record
+
+  private:
+    std::map<PointRecord::_sp, std::set<std::string> > _plan;
+    std::set<TimeSeries::_sp> _seen;
+  };
+
+
+  /*!
+   \class LookaheadPrefetcher
+   \brief Keeps a planner's roots loaded ahead of a cursor that only moves forward, on a background thread
+
+   Time is cut into windows of `lookahead` seconds. While the caller works inside one window, the worker fetches the next one (double buffering), so by the time the cursor crosses over, its data is usually already buffered. A cursor that jumps outside the two windows loads its new window synchronously. The worker thread is started by the first advanceTo, so a prefetcher that is never used costs nothing.
+
+   Eviction is opt-in. With setEvicting(true), each crossing also drops root data more than one window behind the cursor, so memory stays bounded at about three windows however long the run is. Only turn it on when this cursor is the sole reader of those records: the trim is record-wide, so it would pull data out from under anyone else reading the same roots (a cloned model sharing the inputs, for instance).
+
+   The planner must not be changed while the prefetcher is running; call reset() first.
+
+   */
+
+  class LookaheadPrefetcher : public RTX_object {
+  public:
+    RTX_BASE_PROPS(LookaheadPrefetcher);
+
+    LookaheadPrefetcher(QueryPlanner::_sp planner, time_t lookahead);
+    ~LookaheadPrefetcher();
+
+    void advanceTo(time_t cursor); // call before reading data at `cursor`
+    void reset();                  // wait for any fetch in flight and forget both windows
+
+    time_t lookahead();
+    void setLookahead(time_t seconds); // zero disables prefetching
+    bool evicting();
+    void setEvicting(bool evict); // off by default
+
+  private:
+    void workerLoop();
+    void waitForWorker(std::unique_lock<std::mutex>& lock);
+
+    QueryPlanner::_sp _planner;
+    time_t _lookahead;
+    TimeRange _ready;   // loaded, and the cursor is inside it
+    TimeRange _pending; // handed to the worker
+    bool _evict, _queued, _busy, _stop;
+    std::mutex _mtx;
+    std::condition_variable _workQueued, _workDone;
+    std::thread _thread;
+  };
+
+}
+
+#endif
@@ -0,0 +1,180 @@
+//
+//  SavePipeline.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <chrono>
+
+#include "SavePipeline.h"
+
+using namespace RTX;
+using namespace std;
+
+#pragma mark - StateSnapshot
+
+StateSnapshot::StateSnapshot(StateSnapshot&& other) noexcept {
+  *this = std::move(other);
+}
+
+StateSnapshot& StateSnapshot::operator=(StateSnapshot&& other) noexcept {
+  if (this != &other) {
+    time = other.time;
+    bulkRecords = std::move(other.bulkRecords);
+    _batches = std::move(other._batches);
+    _nBatches = other._nBatches;
+    _last = other._last;
+    // the batch counts must agree with the (now empty) batch list
+    other._batches.clear();
+    other.bulkRecords.clear();
+    other._nBatches = 0;
+    other._last = 0;
+    other.time = 0;
+  }
+  return *this;
+}
+
+void StateSnapshot::add(TimeSeries::_sp ts, double value) {
+  PointRecord::_sp r = ts->record();
+  if (_nBatches == 0 || _batches[_last].record != r) {
+    // only a handful of distinct records in practice, so a linear search is plenty
+    _last = 0;
+    while (_last < _nBatches && _batches[_last].record != r) {
+      ++_last;
+    }
+    if (_last == _nBatches) {
+      if (_nBatches == _batches.size()) {
+        _batches.push_back(batch_t());
+      }
+      _batches[_nBatches].record = r;
+      ++_nBatches;
+    }
+  }
+  _batches[_last].handles.push_back(ts->recordHandle());
+  _batches[_last].values.push_back(value);
+  _batches[_last].series.push_back(ts);
+}
+
+void StateSnapshot::clear() {
+  for (size_t i = 0; i < _nBatches; ++i) {
+    _batches[i].record.reset();
+    _batches[i].handles.clear(); // keeps capacity
+    _batches[i].values.clear();
+    _batches[i].series.clear();
+  }
+  _nBatches = 0;
+  _last = 0;
+  bulkRecords.clear();
+  time = 0;
+}
+
+size_t StateSnapshot::size() const {
+  size_t n = 0;
+  for (size_t i = 0; i < _nBatches; ++i) {
+    n += _batches[i].values.size();
+  }
+  return n;
+}
+
+void StateSnapshot::commit() {
+  for (size_t i = 0; i < _nBatches; ++i) {
+    _batches[i].record->addSnapshot(time, _batches[i].handles, _batches[i].values);
+    for (auto& ts : _batches[i].series) {
+      ts->bumpVersion();
+    }
+  }
+}
+
+
+#pragma mark - SavePipeline
+
+SavePipeline::SavePipeline(writer_t writer, size_t slots) : _writer(writer) {
+  slots = (slots < 1) ? 1 : slots;
+  _slots.resize(slots);
+  _states.resize(slots, SlotFree);
+  _fillIdx = 0;
+  _writeIdx = 0;
+  _depth = 0;
+  _stop = false;
+  _thread = thread(&SavePipeline::writerLoop, this);
+}
+
+SavePipeline::~SavePipeline() {
+  this->drain();
+  {
+    lock_guard<mutex> lock(_mtx);
+    _stop = true;
+  }
+  _slotReady.notify_all();
+  if (_thread.joinable()) {
+    _thread.join();
+  }
+}
+
+StateSnapshot& SavePipeline::acquire(double& stallSeconds) {
+  auto t1 = chrono::steady_clock::now();
+  unique_lock<mutex> lock(_mtx);
+  // backpressure: wait only if the next slot in the ring is still queued or being written
+  _slotFreed.wait(lock, [&]{ return _states[_fillIdx] == SlotFree; });
+  stallSeconds = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+  _states[_fillIdx] = SlotFilling;
+  StateSnapshot& slot = _slots[_fillIdx];
+  slot.clear();
+  return slot;
+}
+
+void SavePipeline::submit() {
+  {
+    lock_guard<mutex> lock(_mtx);
+    if (_states[_fillIdx] != SlotFilling) {
+      return;
+    }
+    _states[_fillIdx] = SlotReady;
+    _fillIdx = (_fillIdx + 1) % _slots.size();
+    ++_depth;
+  }
+  _slotReady.notify_one();
+}
+
+void SavePipeline::drain() {
+  unique_lock<mutex> lock(_mtx);
+  _slotFreed.wait(lock, [&]{ return _depth == 0; });
+}
+
+size_t SavePipeline::depth() {
+  lock_guard<mutex> lock(_mtx);
+  return _depth;
+}
+
+void SavePipeline::writerLoop() {
+  while (true) {
+    size_t idx;
+    {
+      unique_lock<mutex> lock(_mtx);
+      _slotReady.wait(lock, [&]{ return _stop || _states[_writeIdx] == SlotReady; });
+      if (_stop && _states[_writeIdx] != SlotReady) {
+        return;
+      }
+      idx = _writeIdx;
+      _states[idx] = SlotWriting;
+      _writeIdx = (_writeIdx + 1) % _slots.size();
+    }
+
+    try {
+      _writer(_slots[idx]);
+    } catch (exception& e) {
+      cerr << "exception saving states: " << e.what() << endl;
+    } catch (string& e) {
+      cerr << "exception saving states: " << e << endl;
+    }
+
+    {
+      lock_guard<mutex> lock(_mtx);
+      _states[idx] = SlotFree;
+      --_depth;
+    }
+    _slotFreed.notify_all();
+  }
+}
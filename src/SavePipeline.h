@@ -0,0 +1,107 @@
+//
+//  SavePipeline.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_SavePipeline_h
+#define epanet_rtx_SavePipeline_h
+
+#include <vector>
+#include <set>
+#include <memory>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include "TimeSeries.h"
+#include "PointRecord.h"
+#include "rtxMacros.h"
+
+#ifndef RTX_SAVE_PIPELINE_SLOTS
+#define RTX_SAVE_PIPELINE_SLOTS 8
+#endif
+
+namespace RTX {
+
+  /*!
+   \class StateSnapshot
+   \brief Simulated states for one time step, grouped by destination record
+
+   Values are copied in as they are added, so the snapshot stays valid after the model moves on. Clearing keeps every allocation, so a reused snapshot settles into zero allocations per step. Moving one out leaves an empty snapshot behind, ready for reuse.
+
+   */
+
+  class StateSnapshot {
+  public:
+    class batch_t {
+    public:
+      PointRecord::_sp record;
+      std::vector<PointRecord::seriesHandle_t> handles;
+      std::vector<double> values;
+      std::vector<TimeSeries::_sp> series; // written behind their backs, so their versions are bumped after commit
+    };
+
+    time_t time = 0;
+    std::set<PointRecord::_sp> bulkRecords;
+
+    StateSnapshot() = default;
+    StateSnapshot(const StateSnapshot&) = default;
+    StateSnapshot& operator=(const StateSnapshot&) = default;
+    StateSnapshot(StateSnapshot&& other) noexcept;
+    StateSnapshot& operator=(StateSnapshot&& other) noexcept;
+
+    void add(TimeSeries::_sp ts, double value);
+    void clear();
+    size_t size() const; // number of points
+    void commit(); // hand each record its batch via addSnapshot
+
+  private:
+    std::vector<batch_t> _batches;
+    size_t _nBatches = 0;
+    size_t _last = 0;
+  };
+
+
+  /*!
+   \class SavePipeline
+   \brief A bounded ring of StateSnapshot slots, drained by a writer thread
+
+   The producer acquires a free slot, fills it, and submits it. It only blocks when every slot is still waiting to be written. There is one writer, so slots are written strictly in the order they were submitted: records see time steps in order, and whatever the write callback does (stats, heartbeat) is never run twice at once.
+
+   */
+
+  class SavePipeline : public RTX_object {
+  public:
+    RTX_BASE_PROPS(SavePipeline);
+    typedef std::function<void(StateSnapshot&)> writer_t;
+
+    SavePipeline(writer_t writer, size_t slots = RTX_SAVE_PIPELINE_SLOTS);
+    ~SavePipeline();
+
+    StateSnapshot& acquire(double& stallSeconds); // blocks while the ring is full
+    void submit();                                // queue the slot from the last acquire()
+    void drain();                                 // wait for everything submitted to be written
+    size_t depth();                               // slots submitted and not yet written
+
+  private:
+    enum slotState_t { SlotFree, SlotFilling, SlotReady, SlotWriting };
+
+    void writerLoop();
+
+    writer_t _writer;
+    std::vector<StateSnapshot> _slots;
+    std::vector<slotState_t> _states;
+    size_t _fillIdx, _writeIdx, _depth;
+    bool _stop;
+    std::mutex _mtx;
+    std::condition_variable _slotFreed, _slotReady;
+    std::thread _thread;
+  };
+
+}
+
+#endif
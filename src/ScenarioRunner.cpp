@@ -0,0 +1,216 @@
+//
+//  ScenarioRunner.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <thread>
+#include <atomic>
+
+#include "ScenarioRunner.h"
+
+using namespace RTX;
+using namespace std;
+
+ScenarioRunner::ScenarioRunner(EpanetModel::_sp baseModel) : _baseModel(baseModel) {
+  unsigned int hw = thread::hardware_concurrency();
+  _threadCount = (hw > 0) ? hw : 1;
+}
+
+void ScenarioRunner::addScenario(const std::string& name, PointRecord::_sp record, override_t overrides) {
+  Scenario s;
+  s.name = name;
+  s.record = record;
+  s.overrides = overrides;
+  _scenarios.push_back(s);
+}
+
+void ScenarioRunner::setThreadCount(size_t n) {
+  _threadCount = (n < 1) ? 1 : n;
+}
+
+size_t ScenarioRunner::threadCount() {
+  return _threadCount;
+}
+
+#pragma mark - Cloning
+
+void ScenarioRunner::prepare() {
+  if (!_baseModel) {
+    throw RtxException("ScenarioRunner: no base model");
+  }
+  for (auto& s : _scenarios) {
+    if (s.model) {
+      continue;
+    }
+    EpanetModel::_sp clone = ScenarioRunner::cloneModel(_baseModel);
+    clone->setName(_baseModel->name() + " :: " + s.name);
+    ScenarioRunner::shareInputs(_baseModel, clone);
+    if (s.overrides) {
+      s.overrides(clone);
+    }
+    ScenarioRunner::routeOutputs(clone, s.record);
+    s.model = clone;
+  }
+}
+
+EpanetModel::_sp ScenarioRunner::cloneModel(EpanetModel::_sp base) {
+  // the copy constructor gives us an independent EN_Project and fresh element wrappers
+  EpanetModel::_sp clone( new EpanetModel(*base) );
+  clone->copySimulationSettings(base);
+  return clone;
+}
+
+void ScenarioRunner::shareInputs(EpanetModel::_sp base, EpanetModel::_sp clone) {
+  // clones point at the base's input objects. reading a filter only touches its records and its
+  // memo of computed ranges, and both have their own locks, so the clones read them concurrently.
+  // the records belong to the base: trimming them behind the clone's cursor would empty them for everyone else
+  clone->setBoundaryEviction(false);
+  for (auto j : base->junctions()) {
+    auto mine = dynamic_pointer_cast<Junction>(clone->nodeWithName(j->name()));
+    if (!mine) {
+      continue;
+    }
+    mine->setBoundaryFlow(j->boundaryFlow());
+    mine->setHeadMeasure(j->headMeasure());
+    mine->setQualityMeasure(j->qualityMeasure());
+    mine->setQualitySource(j->qualitySource());
+  }
+  for (auto t : base->tanks()) {
+    auto mine = dynamic_pointer_cast<Tank>(clone->nodeWithName(t->name()));
+    if (!mine) {
+      continue;
+    }
+    mine->setGeometry(t->geometry()); // shared curve
+    if (t->levelMeasure()) {
+      mine->setLevelMeasure(t->levelMeasure());
+    }
+    else {
+      mine->setHeadMeasure(t->headMeasure());
+    }
+    mine->setQualityMeasure(t->qualityMeasure());
+  }
+  for (auto r : base->reservoirs()) {
+    auto mine = dynamic_pointer_cast<Reservoir>(clone->nodeWithName(r->name()));
+    if (!mine) {
+      continue;
+    }
+    mine->setBoundaryHead(r->boundaryHead());
+    mine->setBoundaryQuality(r->boundaryQuality());
+  }
+  for (auto p : base->pipes()) {
+    auto mine = dynamic_pointer_cast<Pipe>(clone->linkWithName(p->name()));
+    if (!mine) {
+      continue;
+    }
+    mine->setStatusBoundary(p->statusBoundary());
+    mine->setSettingBoundary(p->settingBoundary());
+    mine->setFlowMeasure(p->flowMeasure());
+  }
+  for (auto v : base->valves()) {
+    auto mine = dynamic_pointer_cast<Valve>(clone->linkWithName(v->name()));
+    if (!mine) {
+      continue;
+    }
+    mine->setStatusBoundary(v->statusBoundary());
+    mine->setSettingBoundary(v->settingBoundary());
+    mine->setFlowMeasure(v->flowMeasure());
+  }
+  for (auto p : base->pumps()) {
+    auto mine = dynamic_pointer_cast<Pump>(clone->linkWithName(p->name()));
+    if (!mine) {
+      continue;
+    }
+    mine->setStatusBoundary(p->statusBoundary());
+    mine->setSettingBoundary(p->settingBoundary());
+    mine->setFlowMeasure(p->flowMeasure());
+    mine->setCurveParameter(p->curveParameter());
+    mine->setEnergyMeasure(p->energyMeasure());
+    mine->setHeadCurve(p->headCurve()); // shared curves
+    mine->setEfficiencyCurve(p->efficiencyCurve());
+  }
+
+  // dma boundaries come from the flow measures we just copied
+  if (!base->dmas().empty()) {
+    clone->initDMAs();
+  }
+}
+
+void ScenarioRunner::routeOutputs(EpanetModel::_sp clone, PointRecord::_sp record) {
+  if (!record) {
+    return;
+  }
+  for (auto j : clone->junctions()) {
+    j->setRecord(record);
+  }
+  for (auto t : clone->tanks()) {
+    t->setRecord(record);
+    t->level()->setRecord(record);
+    t->volume()->setRecord(record);
+    t->flow()->setRecord(record);
+    t->inletQuality()->setRecord(record);
+  }
+  for (auto r : clone->reservoirs()) {
+    r->setRecord(record);
+  }
+  for (auto p : clone->pipes()) {
+    p->setRecord(record);
+    p->quality()->setRecord(record);
+  }
+  for (auto v : clone->valves()) {
+    v->setRecord(record);
+    v->quality()->setRecord(record);
+  }
+  for (auto p : clone->pumps()) {
+    p->setRecord(record);
+    p->quality()->setRecord(record);
+  }
+  clone->setRecordForDmaDemands(record);
+  clone->setRecordForSimulationStats(record);
+  clone->refreshRecordsForModeledStates();
+}
+
+#pragma mark - Running
+
+void ScenarioRunner::runExtendedPeriod(time_t start, time_t end) {
+  this->runAll([=](EpanetModel::_sp m){ m->runExtendedPeriod(start, end); });
+}
+
+void ScenarioRunner::runForecast(time_t start, time_t end) {
+  this->runAll([=](EpanetModel::_sp m){ m->runForecast(start, end); });
+}
+
+void ScenarioRunner::runAll(std::function<void(EpanetModel::_sp)> runner) {
+  this->prepare();
+
+  // each idle worker claims the next unstarted scenario
+  atomic<size_t> next(0);
+  auto work = [&]() {
+    size_t i;
+    while ((i = next++) < _scenarios.size()) {
+      Scenario& s = _scenarios[i];
+      try {
+        runner(s.model);
+        s.success = true;
+      } catch (const std::exception& e) {
+        s.success = false;
+        s.errorMessage = e.what();
+      } catch (const std::string& e) {
+        s.success = false;
+        s.errorMessage = e;
+      }
+    }
+  };
+
+  size_t nThreads = min(_threadCount, _scenarios.size());
+  vector<thread> pool;
+  for (size_t i = 1; i < nThreads; ++i) {
+    pool.push_back(thread(work));
+  }
+  work(); // the calling thread pulls its weight too
+  for (auto& t : pool) {
+    t.join();
+  }
+}
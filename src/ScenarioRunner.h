@@ -0,0 +1,76 @@
+//
+//  ScenarioRunner.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_ScenarioRunner_h
+#define epanet_rtx_ScenarioRunner_h
+
+#include <vector>
+#include <string>
+#include <functional>
+
+#include "EpanetModel.h"
+#include "PointRecord.h"
+#include "rtxMacros.h"
+
+namespace RTX {
+
+  /*!
+   \class ScenarioRunner
+   \brief Runs many copies of one EpanetModel side by side
+
+   Each scenario gets its own clone of the base model, with its own EPANET project. Before a clone runs, it takes the base model's simulation settings and shares the base's element inputs (measurements and boundary series) and Curve objects. Then the scenario's override function is applied: a pump schedule, a demand multiplier, or anything else. Each clone writes its results to its own PointRecord. Clones never evict boundary data, since the input records are the base's.
+
+   Clones are built on the calling thread, because opening EPANET projects is not safe to do concurrently. The simulations themselves run on a pool of worker threads. Each idle worker takes the next scenario that has not started, so long and short runs balance out across cores.
+
+   The clones read the shared input graphs concurrently. Evaluating a filter writes only to its record and to its memo of computed ranges, and both are locked; everything else on a filter changes only through its setters. So don't reconfigure an input series while scenarios are running.
+
+   */
+
+  class ScenarioRunner : public RTX_object {
+  public:
+    RTX_BASE_PROPS(ScenarioRunner);
+    typedef std::function<void(EpanetModel::_sp)> override_t;
+
+    class Scenario {
+    public:
+      std::string name;
+      PointRecord::_sp record;
+      override_t overrides;
+      EpanetModel::_sp model; // the clone, once prepared
+      bool success = false;
+      std::string errorMessage;
+    };
+
+    ScenarioRunner(EpanetModel::_sp baseModel);
+
+    void addScenario(const std::string& name, PointRecord::_sp record, override_t overrides = override_t());
+    const std::vector<Scenario>& scenarios() { return _scenarios; };
+
+    void setThreadCount(size_t n);
+    size_t threadCount();
+
+    void prepare(); // clone any scenarios that don't have a model yet
+    void runExtendedPeriod(time_t start, time_t end);
+    void runForecast(time_t start, time_t end);
+
+    // the cloning steps, for anything else that needs a private copy of a running model
+    static EpanetModel::_sp cloneModel(EpanetModel::_sp base); // not thread safe: call from one thread at a time
+    static void shareInputs(EpanetModel::_sp base, EpanetModel::_sp clone);
+    static void routeOutputs(EpanetModel::_sp clone, PointRecord::_sp record);
+
+  private:
+    void runAll(std::function<void(EpanetModel::_sp)> runner);
+
+    EpanetModel::_sp _baseModel;
+    std::vector<Scenario> _scenarios;
+    size_t _threadCount;
+  };
+
+}
+
+#endif
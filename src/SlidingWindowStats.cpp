@@ -0,0 +1,312 @@
+//
+//  SlidingWindowStats.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <cmath>
+#include <algorithm>
+
+#include "SlidingWindowStats.h"
+
+using namespace RTX;
+using namespace std;
+
+// NaNs are not ordered, so give them a place: after every number, and equal to each other
+static inline bool orderedBefore(double a, double b) {
+  return (a < b) || (b != b && a == a);
+}
+
+void SlidingWindowStats::Sum::add(double v) {
+  double t = _sum + v;
+  if (fabs(_sum) >= fabs(v)) {
+    _c += (_sum - t) + v;
+  }
+  else {
+    _c += (v - t) + _sum;
+  }
+  _sum = t;
+}
+
+#pragma mark - OrderTree
+
+void SlidingWindowStats::OrderTree::clear() {
+  _nodes.clear();
+  _free.clear();
+  _root = -1;
+}
+
+void SlidingWindowStats::OrderTree::update(int32_t n) {
+  _nodes[n].size = 1 + sizeOf(_nodes[n].left) + sizeOf(_nodes[n].right);
+}
+
+void SlidingWindowStats::OrderTree::split(int32_t n, double v, int32_t& l, int32_t& r) {
+  if (n < 0) {
+    l = r = -1;
+    return;
+  }
+  if (orderedBefore(_nodes[n].value, v)) {
+    this->split(_nodes[n].right, v, _nodes[n].right, r);
+    l = n;
+  }
+  else {
+    this->split(_nodes[n].left, v, l, _nodes[n].left);
+    r = n;
+  }
+  this->update(n);
+}
+
+int32_t SlidingWindowStats::OrderTree::merge(int32_t l, int32_t r) {
+  if (l < 0 || r < 0) {
+    return (l < 0) ? r : l;
+  }
+  if (_nodes[l].priority > _nodes[r].priority) {
+    _nodes[l].right = this->merge(_nodes[l].right, r);
+    this->update(l);
+    return l;
+  }
+  _nodes[r].left = this->merge(l, _nodes[r].left);
+  this->update(r);
+  return r;
+}
+
+void SlidingWindowStats::OrderTree::insert(double v) {
+  // xorshift: priorities only need to be unrelated to the values
+  _seed ^= _seed << 13;
+  _seed ^= _seed >> 17;
+  _seed ^= _seed << 5;
+  node_t node = {v, _seed, 1, -1, -1};
+  int32_t n;
+  if (_free.empty()) {
+    n = (int32_t)_nodes.size();
+    _nodes.push_back(node);
+  }
+  else {
+    n = _free.back();
+    _free.pop_back();
+    _nodes[n] = node;
+  }
+  this->insertAt(_root, n);
+}
+
+void SlidingWindowStats::OrderTree::insertAt(int32_t& slot, int32_t n) {
+  // walk down to where the new node's priority belongs, then split what hangs there around it
+  if (slot < 0 || _nodes[n].priority > _nodes[slot].priority) {
+    this->split(slot, _nodes[n].value, _nodes[n].left, _nodes[n].right);
+    this->update(n);
+    slot = n;
+    return;
+  }
+  ++_nodes[slot].size;
+  if (orderedBefore(_nodes[n].value, _nodes[slot].value)) {
+    this->insertAt(_nodes[slot].left, n);
+  }
+  else {
+    this->insertAt(_nodes[slot].right, n);
+  }
+}
+
+void SlidingWindowStats::OrderTree::erase(double v) {
+  this->eraseAt(_root, v);
+}
+
+bool SlidingWindowStats::OrderTree::eraseAt(int32_t& slot, double v) {
+  if (slot < 0) {
+    return false;
+  }
+  bool found;
+  if (orderedBefore(v, _nodes[slot].value)) {
+    found = this->eraseAt(_nodes[slot].left, v);
+  }
+  else if (orderedBefore(_nodes[slot].value, v)) {
+    found = this->eraseAt(_nodes[slot].right, v);
+  }
+  else {
+    _free.push_back(slot);
+    slot = this->merge(_nodes[slot].left, _nodes[slot].right);
+    return true;
+  }
+  if (found) {
+    --_nodes[slot].size;
+  }
+  return found;
+}
+
+double SlidingWindowStats::OrderTree::select(size_t k) const {
+  int32_t n = _root;
+  while (n >= 0) {
+    size_t leftSize = sizeOf(_nodes[n].left);
+    if (k < leftSize) {
+      n = _nodes[n].left;
+    }
+    else if (k == leftSize) {
+      return _nodes[n].value;
+    }
+    else {
+      k -= leftSize + 1;
+      n = _nodes[n].right;
+    }
+  }
+  return NAN;
+}
+
+#pragma mark - SlidingWindowStats
+
+SlidingWindowStats::SlidingWindowStats(const double* values, int kernels) : _values(values), _kernels(kernels), _lo(0), _hi(0), _shift(0), _useTree(false) {
+
+}
+
+void SlidingWindowStats::reset(size_t lo) {
+  _lo = _hi = lo;
+  _sum.clear();
+  _sumSq.clear();
+  _minIdx.clear();
+  _maxIdx.clear();
+  _sorted.clear();
+  _tree.clear();
+  _useTree = false;
+}
+
+void SlidingWindowStats::advanceTo(size_t lo, size_t hi) {
+  if (hi < lo) {
+    hi = lo;
+  }
+  if (lo < _lo || hi < _hi || lo >= _hi) {
+    // moved backwards, or nothing carries over
+    this->reset(lo);
+  }
+  while (_hi < hi) {
+    this->push(_hi++);
+  }
+  while (_lo < lo) {
+    this->pop(_lo++);
+  }
+  if (_kernels & KernelExtrema) {
+    while (!_minIdx.empty() && _minIdx.front() < _lo) {
+      _minIdx.pop_front();
+    }
+    while (!_maxIdx.empty() && _maxIdx.front() < _lo) {
+      _maxIdx.pop_front();
+    }
+  }
+  if (_lo == _hi) {
+    // shed any drift the compensated sums picked up
+    this->reset(_lo);
+  }
+}
+
+void SlidingWindowStats::push(size_t i) {
+  double v = _values[i];
+  if (_kernels & KernelMoments) {
+    if (_lo == i) {
+      _shift = v; // first point in an empty window
+    }
+    double d = v - _shift;
+    _sum.add(d);
+    _sumSq.add(d * d);
+  }
+  if (_kernels & KernelExtrema) {
+    while (!_minIdx.empty() && _values[_minIdx.back()] >= v) {
+      _minIdx.pop_back();
+    }
+    _minIdx.push_back(i);
+    while (!_maxIdx.empty() && _values[_maxIdx.back()] <= v) {
+      _maxIdx.pop_back();
+    }
+    _maxIdx.push_back(i);
+  }
+  if (_kernels & KernelOrder) {
+    if (_useTree) {
+      _tree.insert(v);
+    }
+    else if (_sorted.size() < RTX_SLIDING_WINDOW_TREE_SIZE) {
+      _sorted.insert(upper_bound(_sorted.begin(), _sorted.end(), v, orderedBefore), v);
+    }
+    else {
+      // wide enough that shifting the vector costs more than walking a tree
+      for (double x : _sorted) {
+        _tree.insert(x);
+      }
+      _tree.insert(v);
+      _sorted.clear();
+      _useTree = true;
+    }
+  }
+}
+
+void SlidingWindowStats::pop(size_t i) {
+  double v = _values[i];
+  if (_kernels & KernelMoments) {
+    double d = v - _shift;
+    _sum.add(-d);
+    _sumSq.add(-(d * d));
+  }
+  if (_kernels & KernelOrder) {
+    if (_useTree) {
+      _tree.erase(v);
+    }
+    else {
+      auto it = lower_bound(_sorted.begin(), _sorted.end(), v, orderedBefore);
+      if (it != _sorted.end() && !orderedBefore(v, *it)) {
+        _sorted.erase(it);
+      }
+    }
+  }
+}
+
+double SlidingWindowStats::mean() const {
+  size_t n = this->count();
+  if (n == 0) {
+    return NAN;
+  }
+  return _shift + _sum.value() / (double)n;
+}
+
+double SlidingWindowStats::variance() const {
+  size_t n = this->count();
+  if (n == 0) {
+    return NAN;
+  }
+  double m = _sum.value() / (double)n;
+  double var = _sumSq.value() / (double)n - m * m;
+  return (var < 0.) ? 0. : var;
+}
+
+double SlidingWindowStats::min() const {
+  if (_minIdx.empty()) {
+    return NAN;
+  }
+  return _values[_minIdx.front()];
+}
+
+double SlidingWindowStats::max() const {
+  if (_maxIdx.empty()) {
+    return NAN;
+  }
+  return _values[_maxIdx.front()];
+}
+
+double SlidingWindowStats::orderStatistic(size_t k) const {
+  return _useTree ? _tree.select(k) : _sorted[k];
+}
+
+double SlidingWindowStats::percentile(double p) const {
+  if (p < 0. || p > 1.) {
+    return 0.;
+  }
+  size_t n = _useTree ? _tree.size() : _sorted.size();
+  if (n == 0) {
+    return 0;
+  }
+  if (n == 1 && p == 0.5) {
+    return this->orderStatistic(0);
+  }
+  // tail-quantile ranks: the lower half counts up from the smallest value, the upper half down from the largest.
+  size_t k = (size_t)ceil(n * ((p <= 0.5) ? p : 1. - p));
+  if (k == 0 || k >= n) {
+    return NAN;
+  }
+  return this->orderStatistic((p <= 0.5) ? k - 1 : n - k);
+}
@@ -0,0 +1,106 @@
+//
+//  SlidingWindowStats.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_SlidingWindowStats_h
+#define epanet_rtx_SlidingWindowStats_h
+
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
+#include <deque>
+
+#ifndef RTX_SLIDING_WINDOW_TREE_SIZE
+#define RTX_SLIDING_WINDOW_TREE_SIZE 4096 // windows wider than this keep their order in a tree instead of a sorted vector
+#endif
+
+namespace RTX {
+
+  /*!
+   \class SlidingWindowStats
+   \brief Streaming statistics over a window [lo,hi) that slides forward across a column of values
+
+   Moving the window only touches the values that enter or leave it, so evaluating a statistic at every step of a series costs O(n) overall instead of O(n·w). Moments use compensated running sums, min/max use monotonic index deques, and percentiles use a sorted copy of the window. While the window is small that copy is a flat vector (binary insert/erase -- a memmove beats chasing nodes); once it holds more than RTX_SLIDING_WINDOW_TREE_SIZE values it moves into an OrderTree, so each slide costs O(log w) rather than O(w). Only the kernels asked for are maintained.
+
+   Window bounds must never decrease; calling advanceTo() with a smaller bound restarts the window from scratch.
+
+   */
+
+  class SlidingWindowStats {
+  public:
+    typedef enum {
+      KernelMoments = 1 << 0, /*!< count, mean, variance */
+      KernelExtrema = 1 << 1, /*!< min, max */
+      KernelOrder   = 1 << 2  /*!< percentiles */
+    } Kernel;
+
+    /// Neumaier-compensated sum that tolerates subtraction of values previously added
+    class Sum {
+    public:
+      void add(double v);
+      void clear() { _sum = 0; _c = 0; };
+      double value() const { return _sum + _c; };
+    private:
+      double _sum = 0, _c = 0;
+    };
+
+    /// a multiset of values, ordered, that finds the k-th smallest in O(log n): a treap with subtree sizes, its nodes pooled in one vector
+    class OrderTree {
+    public:
+      void insert(double v);
+      void erase(double v); // one copy, if there is one
+      double select(size_t k) const; // k-th smallest, from zero
+      size_t size() const { return (_root < 0) ? 0 : _nodes[_root].size; };
+      void clear();
+    private:
+      typedef struct {
+        double value;
+        uint32_t priority, size;
+        int32_t left, right;
+      } node_t;
+      std::vector<node_t> _nodes;
+      std::vector<int32_t> _free;
+      int32_t _root = -1;
+      uint32_t _seed = 2463534242u;
+      uint32_t sizeOf(int32_t n) const { return (n < 0) ? 0 : _nodes[n].size; };
+      void update(int32_t n);
+      void insertAt(int32_t& slot, int32_t n);
+      bool eraseAt(int32_t& slot, double v);
+      void split(int32_t n, double v, int32_t& l, int32_t& r); // l gets the values ordered before v
+      int32_t merge(int32_t l, int32_t r); // every value in l is ordered before every value in r
+    };
+
+    SlidingWindowStats(const double* values, int kernels); // values must outlive the window
+    void advanceTo(size_t lo, size_t hi);
+
+    size_t count() const { return _hi - _lo; };
+    double mean() const;
+    double variance() const; // population variance
+    double min() const;
+    double max() const;
+    double percentile(double p) const; // same rank convention as PointCollection::percentile
+
+  private:
+    void push(size_t i);
+    void pop(size_t i);
+    void reset(size_t lo);
+
+    const double* _values;
+    int _kernels;
+    size_t _lo, _hi;
+    double _shift; // moments are accumulated about this value to limit cancellation
+    Sum _sum, _sumSq;
+    std::deque<size_t> _minIdx, _maxIdx;
+    std::vector<double> _sorted; // small windows
+    OrderTree _tree; // wide windows, until the next reset
+    bool _useTree;
+    double orderStatistic(size_t k) const;
+  };
+
+}
+
+#endif
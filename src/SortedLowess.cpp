@@ -0,0 +1,191 @@
+//
+//  SortedLowess.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <cmath>
+#include <algorithm>
+
+#include "SortedLowess.h"
+
+using namespace RTX;
+using namespace std;
+
+// the weighted least-squares sums, in one pass about xs. weights are selects rather than branches, and
+// the robustness multiply is a template parameter, so the loop body is straight-line code.
+template<bool robust>
+static inline void __weightedSums(const double* x, const double* y, const double* rw, size_t b, size_t e, double xs, double h, double& sw, double& swd, double& swdd, double& swy, double& swdy) {
+  const double h9 = .999 * h, h1 = .001 * h, hInv = 1. / h;
+  for (size_t j = b; j < e; ++j) {
+    double d = x[j] - xs;
+    double r = fabs(d);
+    double u = r * hInv;
+    double t = 1. - u * u * u;
+    double w = t * t * t;
+    w = (r > h1) ? w : 1.;
+    w = (r <= h9) ? w : 0.;
+    if (robust) {
+      w *= rw[j];
+    }
+    double wy = w * y[j];
+    sw += w;
+    swd += w * d;
+    swdd += w * d * d;
+    swy += wy;
+    swdy += wy * d;
+  }
+}
+
+SortedLowess::SortedLowess(double fraction, int nSteps, double delta) : _fraction(fraction), _delta(delta), _nSteps(nSteps), _ns(2), _y(NULL) {
+
+}
+
+double SortedLowess::valueAt(const time_t* times, const double* values, size_t n, time_t at) {
+  if (n == 0 || at < times[0] || at > times[n - 1]) {
+    return NAN;
+  }
+  if (n < 2) {
+    return values[0];
+  }
+
+  if (_x.size() < n) {
+    _x.resize(n);
+    _ys.resize(n);
+    _rw.resize(n);
+    _res.resize(n);
+  }
+  for (size_t j = 0; j < n; ++j) {
+    _x[j] = (double)(times[j] - times[0]);
+  }
+  _y = values;
+  _ns = max(min((size_t)(_fraction * (double)n), n), (size_t)2);
+
+  for (int iter = 1; iter <= _nSteps; ++iter) {
+    this->fitAll(n, iter > 1);
+    for (size_t j = 0; j < n; ++j) {
+      _res[j] = _y[j] - _ys[j];
+    }
+    this->robustnessWeights(n);
+  }
+
+  // the last pass only matters where we are going to read it
+  bool robust = (_nSteps > 0);
+  size_t hi = lower_bound(times, times + n, at) - times;
+  size_t lo = (times[hi] == at) ? hi : hi - 1;
+  if (_delta > 0) {
+    this->fitAll(n, robust); // skipped points are interpolated, so fit the lot
+  }
+  else {
+    size_t nleft = 0;
+    _ys[lo] = this->fitAt(lo, nleft, n, robust);
+    if (hi != lo) {
+      _ys[hi] = this->fitAt(hi, nleft, n, robust);
+    }
+  }
+  if (hi == lo) {
+    return _ys[lo];
+  }
+  double dv = _ys[hi] - _ys[lo];
+  return _ys[lo] + dv * (at - times[lo]) / (times[hi] - times[lo]);
+}
+
+double SortedLowess::fitAt(size_t i, size_t& nleft, size_t n, bool robust) {
+  const double* x = _x.data();
+  const double* y = _y;
+  const double* rw = _rw.data();
+
+  // nearest _ns points: slide right while that shrinks the radius
+  size_t nright = nleft + _ns - 1;
+  while (nright < n - 1 && x[i] - x[nleft] > x[nright + 1] - x[i]) {
+    ++nleft;
+    ++nright;
+  }
+
+  const double xs = x[i];
+  const double h = max(xs - x[nleft], x[nright] - xs);
+  const double h9 = .999 * h;
+  // pick up ties on the right
+  size_t nrt = i;
+  while (nrt + 1 < n && x[nrt + 1] - xs <= h9) {
+    ++nrt;
+  }
+
+  double sw = 0, swd = 0, swdd = 0, swy = 0, swdy = 0;
+  if (robust) {
+    __weightedSums<true>(x, y, rw, nleft, nrt + 1, xs, h, sw, swd, swdd, swy, swdy);
+  }
+  else {
+    __weightedSums<false>(x, y, rw, nleft, nrt + 1, xs, h, sw, swd, swdd, swy, swdy);
+  }
+
+  if (sw <= 0.) {
+    return y[i]; // every neighbor was rejected as an outlier
+  }
+  double ys = swy / sw;
+  if (h > 0.) {
+    // weighted linear fit, evaluated at xs
+    double a = swd / sw;
+    double c = swdd / sw - a * a;
+    if (sqrt(c) > .001 * (x[n - 1] - x[0])) {
+      double b = -a / c;
+      ys += b * (swdy - a * swy) / sw;
+    }
+  }
+  return ys;
+}
+
+void SortedLowess::fitAll(size_t n, bool robust) {
+  size_t nleft = 0, i = 0;
+  long last = -1; // last point actually fitted
+  do {
+    _ys[i] = this->fitAt(i, nleft, n, robust);
+    if (last >= 0 && last < (long)i - 1) {
+      // points skipped within delta -- interpolate
+      double denom = _x[i] - _x[last];
+      for (size_t j = last + 1; j < i; ++j) {
+        double alpha = (_x[j] - _x[last]) / denom;
+        _ys[j] = alpha * _ys[i] + (1. - alpha) * _ys[last];
+      }
+    }
+    last = i;
+    double cut = _x[last] + _delta;
+    for (i = last + 1; i < n; ++i) {
+      if (_x[i] > cut) {
+        break;
+      }
+      if (_x[i] == _x[last]) {
+        _ys[i] = _ys[last];
+        last = i;
+      }
+    }
+    i = max((size_t)last + 1, i - 1);
+  } while (last < (long)n - 1);
+}
+
+void SortedLowess::robustnessWeights(size_t n) {
+  // six times the (pseudo-)median absolute residual, as in the reference implementation
+  for (size_t i = 0; i < n; ++i) {
+    _rw[i] = fabs(_res[i]);
+  }
+  size_t m1 = n / 2;
+  nth_element(_rw.begin(), _rw.begin() + m1, _rw.begin() + n);
+  double m2 = *max_element(_rw.begin(), _rw.begin() + m1);
+  double cmad = 3. * (_rw[m1] + m2);
+  double c9 = .999 * cmad, c1 = .001 * cmad;
+  for (size_t i = 0; i < n; ++i) {
+    double r = fabs(_res[i]);
+    if (r <= c1) {
+      _rw[i] = 1.;
+    }
+    else if (r > c9) {
+      _rw[i] = 0.;
+    }
+    else {
+      double u = r / cmad;
+      _rw[i] = (1. - u * u) * (1. - u * u);
+    }
+  }
+}
@@ -0,0 +1,49 @@
+//
+//  SortedLowess.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_SortedLowess_h
+#define epanet_rtx_SortedLowess_h
+
+#include <time.h>
+#include <stddef.h>
+#include <vector>
+
+namespace RTX {
+
+  /*!
+   \class SortedLowess
+   \brief Cleveland's robust LOWESS, specialized for sorted time series windows
+
+   Follows the same algorithm as CppLowess::TemplatedLowess (same neighborhoods, tricube and bisquare weights, and robustness iterations), but reads times and values in place and keeps its scratch buffers between calls, so smoothing a window allocates nothing once the buffers have grown. Each local fit is a single branch-free pass of weighted sums, and the last iteration only fits the points that bracket the requested time.
+
+   Times are taken relative to the start of the window, which keeps the regression well conditioned -- the generic routine works on raw epoch seconds and loses several digits to cancellation.
+
+   */
+
+  class SortedLowess {
+  public:
+    SortedLowess(double fraction, int nSteps = 2, double delta = 0);
+
+    /// smooth the n points (times sorted ascending and unique) and return the smoothed curve, linearly interpolated at `at`.
+    double valueAt(const time_t* times, const double* values, size_t n, time_t at);
+
+  private:
+    void fitAll(size_t n, bool robust);
+    double fitAt(size_t i, size_t& nleft, size_t n, bool robust); // nleft carries the neighborhood forward between calls with increasing i
+    void robustnessWeights(size_t n);
+
+    double _fraction, _delta;
+    int _nSteps;
+    size_t _ns; // points in each neighborhood
+    const double* _y;
+    std::vector<double> _x, _ys, _rw, _res;
+  };
+
+}
+
+#endif
@@ -1,10 +1,13 @@
 #include "SqliteAdapter.h"
 
+#include <algorithm>
 #include <set>
 #include <sstream>
+#include <regex>
 #include <boost/filesystem.hpp>
 #include <boost/algorithm/string/join.hpp>
 #include <boost/algorithm/string/replace.hpp>
+#include <boost/lexical_cast.hpp>
 
 #include "WhereClause.h"
 
@@ -16,21 +19,51 @@ typedef const unsigned char* sqltext;
 
 /******************************************************************************************/
 const string initTablesStr = "CREATE TABLE 'meta' ('series_id' INTEGER PRIMARY KEY ASC AUTOINCREMENT, 'name' TEXT UNIQUE ON CONFLICT ABORT, 'units' TEXT, 'regular_period' INTEGER, 'regular_offset' INTEGER); CREATE TABLE 'points' ('time' INTEGER, 'series_id' INTEGER REFERENCES 'meta'('series_id'), 'value' REAL, 'confidence' REAL, 'quality' INTEGER, UNIQUE (series_id, time asc) ON CONFLICT IGNORE); PRAGMA user_version = 2";
+// same schema, but points are stored in (series_id, time) order instead of beside a separate unique index
+const string initClusteredTablesStr = "CREATE TABLE 'meta' ('series_id' INTEGER PRIMARY KEY ASC AUTOINCREMENT, 'name' TEXT UNIQUE ON CONFLICT ABORT, 'units' TEXT, 'regular_period' INTEGER, 'regular_offset' INTEGER); CREATE TABLE 'points' ('time' INTEGER, 'series_id' INTEGER REFERENCES 'meta'('series_id'), 'value' REAL, 'confidence' REAL, 'quality' INTEGER, PRIMARY KEY (series_id, time asc) ON CONFLICT IGNORE) WITHOUT ROWID; PRAGMA user_version = 2";
 /******************************************************************************************/
 
-#define _dbq (*(_db.get()))
+#define _dbq (*(_writer->db.get()))
 
 const string _selectSingleStr = "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? AND time = ? order by time asc";
-const string _selectRangeStr = "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? AND time >= ? AND time <= ? order by time asc";
-const string _selectNextStr = "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? AND time > ? order by time asc LIMIT 1";
-const string _selectPreviousStr = "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? AND time < ? order by time desc LIMIT 1";
+// reads go by series_id (from _metaCache), so they never touch the meta table
+const string _selectRangeStr = "SELECT time,value,quality,confidence FROM points WHERE series_id = ? AND time >= ? AND time <= ? order by time asc";
+const string _selectNextStr = "SELECT time,value,quality,confidence FROM points WHERE series_id = ? AND time > ? order by time asc LIMIT 1";
+const string _selectPreviousStr = "SELECT time,value,quality,confidence FROM points WHERE series_id = ? AND time < ? order by time desc LIMIT 1";
+const string _selectSeriesIdStr = "SELECT series_id FROM meta WHERE name = ?";
 const string _insertSingleStr = "INSERT INTO points(time,series_id,value,quality,confidence) VALUES (?,?,?,?,?)";
 const string _selectFirstStr = "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? order by time asc limit 1";
 const string _selectLastStr = "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? order by time desc limit 1";
 const string _selectNamesStr = "select series_id,name,units from meta order by name asc";
 
-const string _selectNextWhereValueStr = "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? AND time > ? [#] order by time asc LIMIT 1";
-const string _selectPreviousWhereValueStr = "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? AND time < ? [#] order by time desc LIMIT 1";
+// batched reads: [#] is replaced with one "?" per series
+const string _selectRangesStr = "SELECT series_id,time,value,quality,confidence FROM points WHERE series_id IN ([#]) AND time >= ? AND time <= ? order by series_id asc, time asc";
+const string _selectPreviousManyStr = "SELECT p.series_id,p.time,p.value,p.quality,p.confidence FROM points p INNER JOIN (SELECT series_id, max(time) AS t FROM points WHERE series_id IN ([#]) AND time < ? GROUP BY series_id) m ON p.series_id = m.series_id AND p.time = m.t";
+const size_t _maxNamesPerSelect = 500; // stays well under the oldest SQLITE_MAX_VARIABLE_NUMBER (999)
+const int _busyTimeoutMsec = 5000; // WAL checkpoints and recovery can still lock readers out briefly
+
+const string _makeInListStr(const std::string& tpl, size_t count);
+const string _makeInListStr(const std::string& tpl, size_t count) {
+  vector<string> marks(count, "?");
+  string stmt = tpl;
+  boost::replace_all(stmt, "[#]", boost::algorithm::join(marks, ","));
+  return stmt;
+}
+
+// prepared statements are cached by sql, so lists are padded to a few fixed lengths rather than one statement per count.
+// the padding binds series_id 0, which is never assigned.
+size_t _inListSlots(size_t count);
+size_t _inListSlots(size_t count) {
+  for (size_t slots : {(size_t)1, (size_t)8, (size_t)64}) {
+    if (count <= slots) {
+      return slots;
+    }
+  }
+  return _maxNamesPerSelect;
+}
+
+const string _selectNextWhereValueStr = "SELECT time,value,quality,confidence FROM points WHERE series_id = ? AND time > ? [#] order by time asc LIMIT 1";
+const string _selectPreviousWhereValueStr = "SELECT time,value,quality,confidence FROM points WHERE series_id = ? AND time < ? [#] order by time desc LIMIT 1";
 
 const string _makeSelectStr(const std::string& tpl, WhereClause q);
 const string _makeSelectStr(const std::string& tpl, WhereClause q) {
@@ -66,9 +99,14 @@ SqliteAdapter::SqliteAdapter( errCallback_t cb ) : DbAdapter(cb) {
   _transactionStackCount = 0;
   _maxTransactionStackCount = 50000;
   _connected = false;
+  clusteredStorage = RTX_SQLITE_CLUSTERED_POINTS;
+  _wal = true;
+  _readerCount = RTX_SQLITE_READER_CONNECTIONS;
 }
 SqliteAdapter::~SqliteAdapter() {
-  
+  _RTX_DB_SCOPED_LOCK;
+  this->closeReaders();
+  _writer.reset();
 }
 
 const DbAdapter::adapterOptions SqliteAdapter::options() const {
@@ -85,10 +123,48 @@ const DbAdapter::adapterOptions SqliteAdapter::options() const {
 }
 
 std::string SqliteAdapter::connectionString() {
-  return _path;
+  return _connectionString;
 }
 void SqliteAdapter::setConnectionString(const std::string& con) {
-  _path = con;
+  // a file path, optionally followed by options: "points.db?readers=4&wal=1"
+  _connectionString = con;
+  size_t q = con.find('?');
+  _path = con.substr(0, q);
+  _wal = true;
+  _readerCount = RTX_SQLITE_READER_CONNECTIONS;
+  if (q == string::npos) {
+    return;
+  }
+  
+  const string opts = con.substr(q + 1);
+  regex kvReg("([^=]+)=([^&\\s]+)&?"); // key - value pair
+  std::map<std::string, std::string> kvPairs;
+  {
+    auto kv_begin = sregex_iterator(opts.begin(), opts.end(), kvReg);
+    auto kv_end = sregex_iterator();
+    for (auto it = kv_begin ; it != kv_end; ++it) {
+      kvPairs[(*it)[1]] = (*it)[2];
+    }
+  }
+  
+  const map<string, function<void(string)> >
+  kvSetters({
+    {"readers", [&](string v){this->_readerCount = std::max(0, boost::lexical_cast<int>(v));}},
+    {"wal", [&](string v){this->_wal = boost::lexical_cast<bool>(v);}}
+  });
+  
+  for (auto kv : kvPairs) {
+    if (kvSetters.count(kv.first) > 0) {
+      try {
+        kvSetters.at(kv.first)(kv.second);
+      } catch (const boost::bad_lexical_cast& e) {
+        cerr << "SqliteAdapter: could not read option " << kv.first << "=" << kv.second << endl;
+      }
+    }
+    else {
+      cerr << "SqliteAdapter: unknown option " << kv.first << endl;
+    }
+  }
 }
 
 void SqliteAdapter::doConnect() {
@@ -103,6 +179,9 @@ void SqliteAdapter::doConnect() {
   dbPath /= _path;
   auto realPath = dbPath.native();
   
+  this->closeReaders();
+  _writer.reset();
+  
   sqlite3* _rawDb;
   int returnCode;
   returnCode = sqlite3_open_v2(realPath.c_str(), &_rawDb, SQLITE_OPEN_READWRITE, NULL); // only if exists
@@ -111,7 +190,7 @@ void SqliteAdapter::doConnect() {
     returnCode = sqlite3_open_v2(realPath.c_str(), &_rawDb, SQLITE_OPEN_READWRITE | SQLITE_OPEN_CREATE, NULL);
     if (returnCode == SQLITE_OK) {
       shared_ptr<sqlite3> dbHandle = shared_ptr<sqlite3>(_rawDb, [=](sqlite3* ptr) { sqlite3_close_v2(ptr); });
-      _db.reset(new sqlite::database(dbHandle));
+      _writer.reset(new Connection(make_shared<sqlite::database>(dbHandle)));
       if (!this->initTables()) {
         throw runtime_error("could not initialize tables in db. check permissions.");
       }
@@ -123,7 +202,7 @@ void SqliteAdapter::doConnect() {
   }
   else if (returnCode == SQLITE_OK) {
     shared_ptr<sqlite3> dbHandle = shared_ptr<sqlite3>(_rawDb, [=](sqlite3* ptr) { sqlite3_close_v2(ptr); });
-    _db.reset(new sqlite::database(dbHandle));
+    _writer.reset(new Connection(make_shared<sqlite::database>(dbHandle)));
   }
   if( returnCode != SQLITE_OK ){
     sqlite3_close(_rawDb);
@@ -145,6 +224,19 @@ void SqliteAdapter::doConnect() {
     cerr << "Point Record Database Schema version not compatible. Require version " << sqlitePointRecordCurrentDbVersion << " or greater. Updating." << endl;
     updateSuccess = this->updateSchema();
   }
+  sqlite3_busy_timeout(_writer->db->connection().get(), _busyTimeoutMsec);
+  
+  // in WAL mode readers work from the last commit, so they can run alongside the writer on their own connections
+  if (_wal) {
+    string mode;
+    _dbq << "PRAGMA journal_mode=WAL;" >> mode;
+    if (mode == "wal") {
+      this->openReaders(realPath);
+    }
+    else {
+      cerr << "SqliteAdapter: could not use WAL for " << realPath << " (journal mode is " << mode << "). Reads will share the writer's connection." << endl;
+    }
+  }
   
   _errCallback("OK");
   _connected = true;
@@ -158,7 +250,7 @@ IdentifierUnitsList SqliteAdapter::idUnitsList() {
     return _idCache;
   }
   
-  _metaCache.clear();
+  map<string,int> metaCache;
   _idCache.clear();
     
   _dbq << _selectNamesStr
@@ -168,51 +260,134 @@ IdentifierUnitsList SqliteAdapter::idUnitsList() {
       units = Units::unitOfType(*unitStr);
     }
     _idCache.set(name,units);
-    _metaCache[name] = uid;
+    metaCache[name] = uid;
   };
+  {
+    lock_guard<mutex> metaLock(_metaMtx);
+    _metaCache.swap(metaCache);
+  }
     
   return _idCache;
 }
 
 // TRANSACTIONS
 void SqliteAdapter::beginTransaction() {
+  _RTX_DB_SCOPED_LOCK; // lock first, then test: two callers can't both open one
   if (!_inTransaction) {
-    _RTX_DB_SCOPED_LOCK;
     _dbq << "begin;";
     _inTransaction = true;
   }
 }
 void SqliteAdapter::endTransaction() {
-  if (_inTransaction) {
-    this->commit();
-    //_inTransaction = false;
-  }
+  this->commit(); // tests under the lock, like begin
 }
 
 // READ
 std::vector<Point> SqliteAdapter::selectRange(const std::string& id, TimeRange range) {
   vector<Point> points;
   
-  _RTX_DB_SCOPED_LOCK;
-  _dbq << _selectRangeStr << id << (int)range.start << (int)range.end
-  >> [&](int t, double v, int q, double c) {
-    points.push_back(Point((time_t)t, v, Point::PointQuality( q ), c));
-  };
+  this->withReader({id}, [&](Connection& conn) {
+    int tsUid = this->seriesId(id, conn);
+    if (tsUid == 0) {
+      return;
+    }
+    conn.statement(_selectRangeStr) << tsUid << (int)range.start << (int)range.end
+    >> [&](int t, double v, int q, double c) {
+      points.push_back(Point((time_t)t, v, Point::PointQuality( q ), c));
+    };
+  });
   
   return points;
 }
 
-Point SqliteAdapter::selectNext(const std::string& id, time_t time, WhereClause q) {
-  vector<Point> points;
-  _RTX_DB_SCOPED_LOCK;
+std::map<std::string, std::vector<Point> > SqliteAdapter::selectRanges(const std::vector<std::string>& ids, TimeRange range) {
+  map<string, vector<Point> > out;
   
-  auto selectStr = (q.clauses.empty()) ? _selectNextStr : _makeSelectStr(_selectNextWhereValueStr, q);
+  this->withReader(ids, [&](Connection& conn) {
+    vector<int> uids = this->seriesIds(ids, conn);
+    map<int, string> names;
+    for (size_t i = 0; i < ids.size(); ++i) {
+      names[uids[i]] = ids[i];
+    }
+    names.erase(0);
+    vector<int> known;
+    for (auto& n : names) {
+      known.push_back(n.first);
+    }
+    for (size_t first = 0; first < known.size(); first += _maxNamesPerSelect) {
+      size_t count = std::min(_maxNamesPerSelect, known.size() - first);
+      size_t slots = _inListSlots(count);
+      auto& ps = conn.statement(_makeInListStr(_selectRangesStr, slots));
+      for (size_t i = first; i < first + count; ++i) {
+        ps << known[i];
+      }
+      for (size_t i = count; i < slots; ++i) {
+        ps << 0;
+      }
+      ps << (int)range.start << (int)range.end;
+      ps >> [&](int uid, int t, double v, int q, double c) {
+        out[names[uid]].push_back(Point((time_t)t, v, Point::PointQuality( q ), c));
+      };
+    }
+  });
   
-  _dbq << selectStr << id << (int)time
-  >> [&](int t, double v, int q, double c) {
+  return out;
+}
+
+std::map<std::string, Point> SqliteAdapter::selectPreviousMany(const std::vector<std::string>& ids, time_t time) {
+  map<string, Point> out;
+  
+  this->withReader(ids, [&](Connection& conn) {
+    vector<int> uids = this->seriesIds(ids, conn);
+    map<int, string> names;
+    for (size_t i = 0; i < ids.size(); ++i) {
+      names[uids[i]] = ids[i];
+    }
+    names.erase(0);
+    vector<int> known;
+    for (auto& n : names) {
+      known.push_back(n.first);
+    }
+    for (size_t first = 0; first < known.size(); first += _maxNamesPerSelect) {
+      size_t count = std::min(_maxNamesPerSelect, known.size() - first);
+      size_t slots = _inListSlots(count);
+      auto& ps = conn.statement(_makeInListStr(_selectPreviousManyStr, slots));
+      for (size_t i = first; i < first + count; ++i) {
+        ps << known[i];
+      }
+      for (size_t i = count; i < slots; ++i) {
+        ps << 0;
+      }
+      ps << (int)time;
+      ps >> [&](int uid, int t, double v, int q, double c) {
+        out[names[uid]] = Point((time_t)t, v, Point::PointQuality( q ), c);
+      };
+    }
+  });
+  
+  return out;
+}
+
+Point SqliteAdapter::selectNext(const std::string& id, time_t time, WhereClause q) {
+  vector<Point> points;
+  auto read = [&](int t, double v, int q, double c) {
     points.push_back(Point((time_t)t, v, Point::PointQuality( q ), c));
   };
   
+  this->withReader({id}, [&](Connection& conn) {
+    int tsUid = this->seriesId(id, conn);
+    if (tsUid == 0) {
+      return;
+    }
+    if (q.clauses.empty()) {
+      conn.statement(_selectNextStr) << tsUid << (int)time >> read;
+    }
+    else {
+      // value filters change from call to call, so these aren't kept prepared
+      *conn.db << _makeSelectStr(_selectNextWhereValueStr, q) << tsUid << (int)time >> read;
+    }
+  });
+  
   if (points.size() > 0) {
     return points.front();
   }
@@ -222,15 +397,24 @@ Point SqliteAdapter::selectNext(const std::string& id, time_t time, WhereClause
 Point SqliteAdapter::selectPrevious(const std::string& id, time_t time, WhereClause q) {
   
   vector<Point> points;
-  _RTX_DB_SCOPED_LOCK;
-  
-  auto selectStr = (q.clauses.empty()) ? _selectPreviousStr : _makeSelectStr(_selectPreviousWhereValueStr, q);
-  
-  _dbq << selectStr << id << (int)time
-  >> [&](int t, double v, int q, double c) {
+  auto read = [&](int t, double v, int q, double c) {
     points.push_back(Point((time_t)t, v, Point::PointQuality( q ), c));
   };
   
+  this->withReader({id}, [&](Connection& conn) {
+    int tsUid = this->seriesId(id, conn);
+    if (tsUid == 0) {
+      return;
+    }
+    if (q.clauses.empty()) {
+      conn.statement(_selectPreviousStr) << tsUid << (int)time >> read;
+    }
+    else {
+      // value filters change from call to call, so these aren't kept prepared
+      *conn.db << _makeSelectStr(_selectPreviousWhereValueStr, q) << tsUid << (int)time >> read;
+    }
+  });
+  
   if (points.size() > 0) {
     return points.front();
   }
@@ -246,9 +430,12 @@ bool SqliteAdapter::insertIdentifierAndUnits(const std::string& id, Units units)
       _dbq << "insert or ignore into meta (name,units) values (?,?)"
       << id << units.to_string();
     
-      int uid = (int)_db->last_insert_rowid();    
-      // add to the cache.
-      _metaCache[id] = uid;
+      // add to the cache. look it up: if the name was already there, nothing was inserted
+      {
+        lock_guard<mutex> metaLock(_metaMtx);
+        _metaCache.erase(id);
+      }
+      this->seriesId(id, *_writer);
       _idCache.set(id, units);
       success = true;
     }
@@ -278,9 +465,14 @@ void SqliteAdapter::insertSingle(const std::string& id, Point point) {
 void SqliteAdapter::insertSingleInTransaction(const std::string& id, Point point) {
   
   _RTX_DB_SCOPED_LOCK; 
-  int tsUid = _metaCache[id];
-  _dbq << _insertSingleStr << (int)point.time << tsUid << point.value << (int)point.quality << point.confidence;
-  
+  int tsUid = this->seriesId(id, *_writer);
+  if (tsUid == 0) {
+    return; // not registered
+  }
+  auto& ps = _writer->statement(_insertSingleStr);
+  ps << (int)point.time << tsUid << point.value << (int)point.quality << point.confidence;
+  ps.execute();
+  this->markUncommitted(tsUid);
 }
 
 
@@ -289,12 +481,68 @@ void SqliteAdapter::insertRange(const std::string& id, std::vector<Point> points
   this->commit(); // commit any transactions in progress
   
   this->beginTransaction();
-  for(const Point &p : points) {
-    this->insertSingleInTransaction(id, p);
+  {
+    _RTX_DB_SCOPED_LOCK;
+    int tsUid = this->seriesId(id, *_writer);
+    if (tsUid > 0) {
+      // one prepared statement, re-bound for each point
+      auto& ps = _writer->statement(_insertSingleStr);
+      for(const Point &p : points) {
+        ps << (int)p.time << tsUid << p.value << (int)p.quality << p.confidence;
+        ps++;
+      }
+      this->markUncommitted(tsUid);
+    }
   }
   this->endTransaction();
 }
 
+// handles are just the series_id, so a snapshot never touches the meta table or the name cache.
+DbAdapter::seriesHandle_t SqliteAdapter::resolveSeriesHandle(const std::string& id) {
+  _RTX_DB_SCOPED_LOCK;
+  int uid = this->seriesId(id, *_writer);
+  if (uid == 0) {
+    cerr << "no registered series with that id: " << id << endl;
+  }
+  return (seriesHandle_t)uid; // series_id is autoincrement, so zero is never a real series
+}
+
+void SqliteAdapter::insertSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values) {
+  
+  bool ownTransaction = !_inTransaction;
+  if (ownTransaction) {
+    this->beginTransaction();
+  }
+  
+  size_t nInserted = 0;
+  {
+    _RTX_DB_SCOPED_LOCK;
+    // one prepared statement, re-bound for each series
+    auto& ps = _writer->statement(_insertSingleStr);
+    const size_t n = std::min(handles.size(), values.size());
+    for (size_t i = 0; i < n; ++i) {
+      if (handles[i] == 0) {
+        continue;
+      }
+      ps << (int)time << (int)handles[i] << values[i] << (int)Point::opc_rtx_override << 0.;
+      ps++;
+      ++nInserted;
+    }
+    lock_guard<mutex> metaLock(_metaMtx);
+    _uncommitted.insert(handles.begin(), handles.begin() + n);
+    _uncommitted.erase(0);
+    _transactionStackCount += (int)nInserted;
+  }
+  
+  if (ownTransaction) {
+    this->endTransaction();
+  }
+  else {
+    this->checkTransactions();
+  }
+}
+
+
 // UPDATE
 bool SqliteAdapter::assignUnitsToRecord(const std::string& name, const Units& units) {
   
@@ -310,6 +558,8 @@ void SqliteAdapter::removeRecord(const std::string& id) {
   _RTX_DB_SCOPED_LOCK;
   _dbq << "delete from points where series_id = (SELECT series_id FROM meta where name = \'" + id + "\');";
   _dbq << "delete from meta where name = \'" + id + "\'";
+  lock_guard<mutex> metaLock(_metaMtx);
+  _metaCache.erase(id);
 }
 void SqliteAdapter::removeAllRecords() {
   _RTX_DB_SCOPED_LOCK;
@@ -321,7 +571,8 @@ void SqliteAdapter::removeAllRecords() {
 #pragma mark private
 
 bool SqliteAdapter::initTables() {
-  auto err = sqlite3_exec(_db->connection().get(), initTablesStr.c_str(), nullptr, nullptr, nullptr);
+  const string& init = clusteredStorage ? initClusteredTablesStr : initTablesStr;
+  auto err = sqlite3_exec(_writer->db->connection().get(), init.c_str(), nullptr, nullptr, nullptr);
   return (err == SQLITE_OK);
 }
 
@@ -370,6 +621,142 @@ bool SqliteAdapter::updateSchema() {
 
 
 
+// prepared once per connection, then reset and re-bound on every use
+sqlite::database_binder& SqliteAdapter::Connection::statement(const std::string& sql) {
+  auto& ps = _statements[sql];
+  if (!ps) {
+    ps.reset(new sqlite::database_binder(db->connection(), sql));
+  }
+  else {
+    ps->reset();
+  }
+  return *ps;
+}
+
+void SqliteAdapter::Connection::clearStatements() {
+  for (auto& ps : _statements) {
+    ps.second->used(true); // binders run themselves on destruction unless marked used
+  }
+  _statements.clear();
+}
+
+// the caller has the connection to itself. zero if the name isn't registered (series_id is autoincrement, so never zero).
+int SqliteAdapter::seriesId(const std::string& id, Connection& conn) {
+  {
+    lock_guard<mutex> metaLock(_metaMtx);
+    auto found = _metaCache.find(id);
+    if (found != _metaCache.end()) {
+      return found->second;
+    }
+  }
+  int uid = 0;
+  conn.statement(_selectSeriesIdStr) << id >> [&](int sid) {
+    uid = sid;
+  };
+  if (uid > 0) {
+    lock_guard<mutex> metaLock(_metaMtx);
+    _metaCache[id] = uid;
+  }
+  return uid;
+}
+
+vector<int> SqliteAdapter::seriesIds(const std::vector<std::string>& ids, Connection& conn) {
+  vector<int> uids;
+  uids.reserve(ids.size());
+  for (const string& id : ids) {
+    uids.push_back(this->seriesId(id, conn));
+  }
+  return uids;
+}
+
+void SqliteAdapter::markUncommitted(int uid) {
+  lock_guard<mutex> metaLock(_metaMtx);
+  _uncommitted.insert(uid);
+}
+
+// borrow an idle reader, or without a pool, share the writer's connection (and wait for its lock).
+// a series with rows written since "begin" is read through the writer, the only connection that can see them.
+void SqliteAdapter::withReader(const std::vector<std::string>& ids, const std::function<void(Connection&)>& query) {
+  bool uncommitted = false;
+  {
+    lock_guard<mutex> metaLock(_metaMtx);
+    for (const string& id : ids) {
+      if (_uncommitted.empty()) {
+        break;
+      }
+      auto found = _metaCache.find(id);
+      if (found == _metaCache.end() || _uncommitted.count(found->second)) {
+        uncommitted = true; // a name not in the cache might be one of them
+        break;
+      }
+    }
+  }
+  if (uncommitted) {
+    _RTX_DB_SCOPED_LOCK;
+    query(*_writer);
+    return;
+  }
+  
+  Connection* reader = nullptr;
+  {
+    unique_lock<mutex> poolLock(_poolMtx);
+    _readerReturned.wait(poolLock, [&]{ return _readers.empty() || !_idleReaders.empty(); });
+    if (!_idleReaders.empty()) {
+      reader = _idleReaders.back();
+      _idleReaders.pop_back();
+    }
+  }
+  
+  if (!reader) {
+    _RTX_DB_SCOPED_LOCK;
+    if (!_writer) {
+      throw runtime_error("SqliteAdapter: no open database"); // not the same as an empty result
+    }
+    query(*_writer);
+    return;
+  }
+  
+  auto giveBack = [&]() {
+    {
+      lock_guard<mutex> poolLock(_poolMtx);
+      _idleReaders.push_back(reader);
+    }
+    _readerReturned.notify_all();
+  };
+  try {
+    query(*reader);
+  } catch (...) {
+    giveBack();
+    throw;
+  }
+  giveBack();
+}
+
+void SqliteAdapter::openReaders(const std::string& realPath) {
+  lock_guard<mutex> poolLock(_poolMtx);
+  for (int i = 0; i < _readerCount; ++i) {
+    sqlite3* rawDb;
+    if (sqlite3_open_v2(realPath.c_str(), &rawDb, SQLITE_OPEN_READONLY, NULL) != SQLITE_OK) {
+      cerr << "SqliteAdapter: could not open a reader for " << realPath << ": " << sqlite3_errmsg(rawDb) << endl;
+      sqlite3_close(rawDb);
+      break;
+    }
+    sqlite3_busy_timeout(rawDb, _busyTimeoutMsec);
+    shared_ptr<sqlite3> dbHandle = shared_ptr<sqlite3>(rawDb, [=](sqlite3* ptr) { sqlite3_close_v2(ptr); });
+    _readers.push_back(unique_ptr<Connection>(new Connection(make_shared<sqlite::database>(dbHandle))));
+    _idleReaders.push_back(_readers.back().get());
+  }
+}
+
+void SqliteAdapter::closeReaders() {
+  unique_lock<mutex> poolLock(_poolMtx);
+  _readerReturned.wait(poolLock, [&]{ return _idleReaders.size() == _readers.size(); }); // let reads in progress finish
+  _idleReaders.clear();
+  _readers.clear();
+  poolLock.unlock();
+  _readerReturned.notify_all(); // anyone waiting falls back to the writer
+}
+
 void SqliteAdapter::checkTransactions() {
   if (_inTransaction) {
     if (_transactionStackCount >= _maxTransactionStackCount) {
@@ -392,6 +779,8 @@ void SqliteAdapter::commit() {
     _dbq << "end;";
     _transactionStackCount = 0;
     _inTransaction = false;
+    lock_guard<mutex> metaLock(_metaMtx);
+    _uncommitted.clear(); // the pool sees them now
   }
 }
 
@@ -2,6 +2,13 @@
 #define SqliteAdapter_hpp
 
 #include <stdio.h>
+#include <map>
+#include <set>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
+#include <functional>
 
 #include "DbAdapter.h"
 
@@ -10,8 +17,24 @@
 
 #include "WhereClause.h"
 
+// new databases store points clustered on (series_id, time) in a WITHOUT ROWID table
+#ifndef RTX_SQLITE_CLUSTERED_POINTS
+#define RTX_SQLITE_CLUSTERED_POINTS false
+#endif
+
+// read-only connections kept open beside the writer, unless the connection string says otherwise ("points.db?readers=4")
+#ifndef RTX_SQLITE_READER_CONNECTIONS
+#define RTX_SQLITE_READER_CONNECTIONS 4
+#endif
 
 namespace RTX {
+  
+  // the connection string is a file path, optionally followed by options: "points.db?readers=4&wal=1".
+  // the file is opened in WAL mode (wal=0 leaves its journal mode alone) with one writer connection, plus a pool
+  // of read-only connections that read in parallel with each other and with the writer. pool readers only see
+  // the last commit, so a read of a series with rows written in the open transaction goes through the writer
+  // instead: an empty answer for rows written but not yet committed would be remembered as "no data". every other
+  // read stays on the pool. with readers=0, or without WAL, reads always share the writer's connection and lock.
   class SqliteAdapter : public DbAdapter {
   public:
     SqliteAdapter( errCallback_t cb );
@@ -35,11 +58,15 @@ namespace RTX {
     std::vector<Point> selectRange(const std::string& id, TimeRange range);
     Point selectNext(const std::string& id, time_t time, WhereClause q = WhereClause());
     Point selectPrevious(const std::string& id, time_t time, WhereClause q = WhereClause());
+    std::map<std::string, std::vector<Point> > selectRanges(const std::vector<std::string>& ids, TimeRange range);
+    std::map<std::string, Point> selectPreviousMany(const std::vector<std::string>& ids, time_t time);
     
     // CREATE
     bool insertIdentifierAndUnits(const std::string& id, Units units);
     void insertSingle(const std::string& id, Point point);
     void insertRange(const std::string& id, std::vector<Point> points);
+    seriesHandle_t resolveSeriesHandle(const std::string& id);
+    void insertSnapshot(time_t time, const std::vector<seriesHandle_t>& handles, const std::vector<double>& values);
     
     // UPDATE
     bool assignUnitsToRecord(const std::string& name, const Units& units);
@@ -49,12 +76,35 @@ namespace RTX {
     void removeAllRecords();
     
     std::string basePath;
+    bool clusteredStorage; // layout for databases created from here on; existing files keep theirs
     
   private:
-    std::shared_ptr<sqlite::database> _db;        
-    std::string _path;
-    
-    bool _inTransaction;
+    // a connection, and the statements prepared on it
+    class Connection {
+    public:
+      Connection(std::shared_ptr<sqlite::database> db) : db(db) { };
+      ~Connection() { this->clearStatements(); }; // before the connection goes
+      std::shared_ptr<sqlite::database> db;
+      sqlite::database_binder& statement(const std::string& sql);
+      void clearStatements();
+    private:
+      std::map<std::string, std::unique_ptr<sqlite::database_binder> > _statements; // by sql
+    };
+    
+    std::unique_ptr<Connection> _writer; // guarded by _dbMtx
+    std::string _path, _connectionString;
+    bool _wal;
+    int _readerCount;
+    
+    std::vector<std::unique_ptr<Connection> > _readers;
+    std::vector<Connection*> _idleReaders;
+    std::mutex _poolMtx;
+    std::condition_variable _readerReturned;
+    void openReaders(const std::string& realPath);
+    void closeReaders(); // waits for reads in progress
+    void withReader(const std::vector<std::string>& ids, const std::function<void(Connection&)>& query);
+    
+    std::atomic<bool> _inTransaction; // set and cleared under _dbMtx
     int _transactionStackCount;
     int _maxTransactionStackCount;
     void checkTransactions();
@@ -68,6 +118,11 @@ namespace RTX {
     void setDbSchemaVersion(int v);
     
     std::map<std::string,int> _metaCache;
+    std::mutex _metaMtx; // readers use the cache too, without taking _dbMtx
+    std::set<int> _uncommitted; // series_ids written since "begin", guarded by _metaMtx
+    void markUncommitted(int uid);
+    int seriesId(const std::string& id, Connection& conn);
+    std::vector<int> seriesIds(const std::vector<std::string>& ids, Connection& conn);
     IdentifierUnitsList _idCache;
     
   };
@@ -0,0 +1,161 @@
+//
+//  StateStore.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <algorithm>
+
+#include "StateStore.h"
+
+using namespace RTX;
+using namespace std;
+
+void StateStore::resize(size_t nodeCount, size_t linkCount) {
+  for (int i = 0; i < QuantityCount; ++i) {
+    quantity_t q = (quantity_t)i;
+    size_t n = isLinkQuantity(q) ? linkCount : nodeCount;
+    _columns[q].resize(n, 0.);
+    _scale[q].resize(n, 1.);
+    _shift[q].resize(n, 0.);
+  }
+}
+
+double StateStore::value(quantity_t q, int offset) const {
+  if (offset < 0 || (size_t)offset >= _columns[q].size()) {
+    return 0.;
+  }
+  return _columns[q][offset];
+}
+
+void StateStore::setValue(quantity_t q, int offset, double value) {
+  if (offset < 0 || (size_t)offset >= _columns[q].size()) {
+    return;
+  }
+  _columns[q][offset] = value;
+}
+
+void StateStore::resetConversions() {
+  for (int i = 0; i < QuantityCount; ++i) {
+    std::fill(_scale[i].begin(), _scale[i].end(), 1.);
+    std::fill(_shift[i].begin(), _shift[i].end(), 0.);
+  }
+}
+
+void StateStore::setConversion(quantity_t q, int offset, double scale, double shift) {
+  if (offset < 0 || (size_t)offset >= _columns[q].size()) {
+    return;
+  }
+  _scale[q][offset] = scale;
+  _shift[q][offset] = shift;
+}
+
+void StateStore::applyConversion(quantity_t q) {
+  double *v = _columns[q].data();
+  const double *scale = _scale[q].data();
+  const double *shift = _shift[q].data();
+  const size_t n = _columns[q].size();
+  // straight-line loop over contiguous arrays; the compiler vectorizes this
+  for (size_t i = 0; i < n; ++i) {
+    v[i] = v[i] * scale[i] + shift[i];
+  }
+}
+
+void StateStore::clearSegments() {
+  _segmentEnd.clear();
+  _segmentVolume.clear();
+  _segmentQuality.clear();
+}
+
+void StateStore::beginSegmentOwner() {
+  _segmentEnd.push_back(_segmentVolume.size());
+}
+
+void StateStore::appendSegment(double volume, double quality) {
+  if (_segmentEnd.empty()) {
+    this->beginSegmentOwner();
+  }
+  _segmentVolume.push_back(volume);
+  _segmentQuality.push_back(quality);
+  _segmentEnd.back() = _segmentVolume.size();
+}
+
+size_t StateStore::segmentCount(size_t owner) const {
+  if (owner >= _segmentEnd.size()) {
+    return 0;
+  }
+  return (size_t)_segmentEnd[owner] - this->segmentBegin(owner);
+}
+
+const double* StateStore::segmentVolumes(size_t owner) const {
+  return _segmentVolume.data() + this->segmentBegin(std::min(owner, _segmentEnd.size()));
+}
+
+const double* StateStore::segmentQualities(size_t owner) const {
+  return _segmentQuality.data() + this->segmentBegin(std::min(owner, _segmentEnd.size()));
+}
+
+void StateStore::write(std::ostream& out) const {
+  uint32_t nQuantities = QuantityCount;
+  out.write((const char*)&nQuantities, sizeof(nQuantities));
+  for (int i = 0; i < QuantityCount; ++i) {
+    uint64_t n = _columns[i].size();
+    out.write((const char*)&n, sizeof(n));
+    out.write((const char*)_columns[i].data(), n * sizeof(double));
+  }
+  uint64_t nOwners = _segmentEnd.size(), nSegments = _segmentVolume.size();
+  out.write((const char*)&nOwners, sizeof(nOwners));
+  out.write((const char*)_segmentEnd.data(), nOwners * sizeof(uint64_t));
+  out.write((const char*)&nSegments, sizeof(nSegments));
+  out.write((const char*)_segmentVolume.data(), nSegments * sizeof(double));
+  out.write((const char*)_segmentQuality.data(), nSegments * sizeof(double));
+}
+
+bool StateStore::read(std::istream& in) {
+  uint32_t nQuantities = 0;
+  in.read((char*)&nQuantities, sizeof(nQuantities));
+  if (!in || nQuantities != QuantityCount) {
+    return false;
+  }
+  std::vector<double> columns[QuantityCount];
+  for (int i = 0; i < QuantityCount; ++i) {
+    uint64_t n = 0;
+    in.read((char*)&n, sizeof(n));
+    if (!in || n > (1ull << 32)) {
+      return false;
+    }
+    columns[i].resize(n);
+    in.read((char*)columns[i].data(), n * sizeof(double));
+    if (!in) {
+      return false;
+    }
+  }
+  uint64_t nOwners = 0, nSegments = 0;
+  in.read((char*)&nOwners, sizeof(nOwners));
+  if (!in || nOwners > (1ull << 32)) {
+    return false;
+  }
+  std::vector<uint64_t> segmentEnd(nOwners);
+  in.read((char*)segmentEnd.data(), nOwners * sizeof(uint64_t));
+  in.read((char*)&nSegments, sizeof(nSegments));
+  if (!in || nSegments > (1ull << 32) || !std::is_sorted(segmentEnd.begin(), segmentEnd.end()) || (nOwners > 0 ? segmentEnd.back() : 0) != nSegments) {
+    return false;
+  }
+  std::vector<double> segmentVolume(nSegments), segmentQuality(nSegments);
+  in.read((char*)segmentVolume.data(), nSegments * sizeof(double));
+  in.read((char*)segmentQuality.data(), nSegments * sizeof(double));
+  if (!in) {
+    return false;
+  }
+  for (int i = 0; i < QuantityCount; ++i) {
+    _columns[i].swap(columns[i]);
+    _scale[i].resize(_columns[i].size(), 1.);
+    _shift[i].resize(_columns[i].size(), 0.);
+  }
+  _segmentEnd.swap(segmentEnd);
+  _segmentVolume.swap(segmentVolume);
+  _segmentQuality.swap(segmentQuality);
+  return true;
+}
@@ -0,0 +1,93 @@
+//
+//  StateStore.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_StateStore_h
+#define epanet_rtx_StateStore_h
+
+#include <vector>
+#include <cstdint>
+#include <iostream>
+#include "rtxMacros.h"
+
+namespace RTX {
+
+  /*!
+   \class StateStore
+   \brief Columnar storage for simulated element states
+
+   Holds one contiguous array per simulated quantity, owned by the Model. Node quantities are sized to the engine's node count, link quantities to its link count. Elements address their values by offset (their engine index) rather than owning scattered state variables.
+
+   Each column may also carry a per-slot linear unit conversion (value * scale + shift), applied in a single pass over the column after the engine has filled it.
+
+   Separately, the store can hold the engine's water quality segments: the parcels of water inside each link (then each tank), downstream first, in engine units. Node quality alone can't rebuild them. They are only filled on request (Model::captureSegmentQuality), for checkpoints and forks.
+
+   */
+
+  class StateStore : public RTX_object {
+  public:
+    RTX_BASE_PROPS(StateStore);
+
+    enum quantity_t : int {
+      // node quantities
+      Head = 0,
+      Pressure,
+      Demand,
+      Quality,
+      InletQuality,
+      Level,
+      Volume,
+      TankFlow,
+      // link quantities
+      Flow,
+      Setting,
+      Status,
+      Energy,
+      QuantityCount
+    };
+
+    static bool isLinkQuantity(quantity_t q) { return q >= Flow; };
+
+    void resize(size_t nodeCount, size_t linkCount);
+    size_t size(quantity_t q) const { return _columns[q].size(); };
+
+    double* column(quantity_t q) { return _columns[q].data(); };
+    const double* column(quantity_t q) const { return _columns[q].data(); };
+
+    double value(quantity_t q, int offset) const;
+    void setValue(quantity_t q, int offset, double value);
+
+    // unit conversion, per slot. slots that are never set are passed through unchanged.
+    void resetConversions();
+    void setConversion(quantity_t q, int offset, double scale, double shift);
+    void applyConversion(quantity_t q);
+
+    // quality segments, owner by owner: call beginSegmentOwner, then appendSegment for each of its segments
+    void clearSegments();
+    void beginSegmentOwner();
+    void appendSegment(double volume, double quality);
+    size_t segmentOwnerCount() const { return _segmentEnd.size(); };
+    size_t segmentCount(size_t owner) const;
+    const double* segmentVolumes(size_t owner) const;
+    const double* segmentQualities(size_t owner) const;
+
+    // raw columns (then segments) as native-endian binary, for hot-start checkpoints. conversions are not saved.
+    void write(std::ostream& out) const;
+    bool read(std::istream& in); // false, and unchanged, if the stream is short or malformed
+
+  private:
+    std::vector<double> _columns[QuantityCount];
+    std::vector<double> _scale[QuantityCount];
+    std::vector<double> _shift[QuantityCount];
+    std::vector<uint64_t> _segmentEnd; // owner i's segments are [_segmentEnd[i-1], _segmentEnd[i])
+    std::vector<double> _segmentVolume, _segmentQuality;
+    size_t segmentBegin(size_t owner) const { return (owner == 0) ? 0 : (size_t)_segmentEnd[owner - 1]; };
+  };
+
+}
+
+#endif
@@ -7,29 +7,31 @@
 //
 
 #include "StatsTimeSeries.h"
+#include "SlidingWindowStats.h"
 #include <boost/foreach.hpp>
 #include <math.h>
 
-#include <future>
-
 using namespace RTX;
 using namespace std;
 using PC = PointCollection;
 using ST = StatsTimeSeries;
 
-const map<StatsTimeSeries::StatsTimeSeriesType, function<double(const PC::pvRange, double)> > __getters({
-  {ST::StatsTimeSeriesMean,   [](const PC::pvRange r, double pct)->double { return PC::mean(r); } },
-  {ST::StatsTimeSeriesStdDev, [](const PC::pvRange r, double pct)->double { return sqrt(PC::variance(r)); } },
-  {ST::StatsTimeSeriesMedian, [](const PC::pvRange r, double pct)->double { return PC::percentile(.5,r); } },
-  {ST::StatsTimeSeriesQ25,    [](const PC::pvRange r, double pct)->double { return PC::percentile(.25,r); } },
-  {ST::StatsTimeSeriesQ75,    [](const PC::pvRange r, double pct)->double { return PC::percentile(.75,r); } },
-  {ST::StatsTimeSeriesIQR,    [](const PC::pvRange r, double pct)->double { return PC::interquartilerange(r); } },
-  {ST::StatsTimeSeriesMax,    [](const PC::pvRange r, double pct)->double { return PC::max(r); } },
-  {ST::StatsTimeSeriesMin,    [](const PC::pvRange r, double pct)->double { return PC::min(r); } },
-  {ST::StatsTimeSeriesCount,  [](const PC::pvRange r, double pct)->double { return PC::count(r); } },
-  {ST::StatsTimeSeriesVar,    [](const PC::pvRange r, double pct)->double { return PC::variance(r); } },
-  {ST::StatsTimeSeriesRMS,    [](const PC::pvRange r, double pct)->double { return PC::variance(r) + pow(PC::mean(r), 2.); } },
-  {ST::StatsTimeSeriesPercentile, [](const PC::pvRange r, double pct)->double { return PC::percentile(pct,r); } },
+using SW = SlidingWindowStats;
+
+// statistic -> (kernels it needs, how to read it off the window)
+const map<StatsTimeSeries::StatsTimeSeriesType, pair<int, function<double(const SW&, double)> > > __getters({
+  {ST::StatsTimeSeriesMean,   {SW::KernelMoments, [](const SW& w, double pct)->double { return w.mean(); }} },
+  {ST::StatsTimeSeriesStdDev, {SW::KernelMoments, [](const SW& w, double pct)->double { return sqrt(w.variance()); }} },
+  {ST::StatsTimeSeriesMedian, {SW::KernelOrder,   [](const SW& w, double pct)->double { return w.percentile(.5); }} },
+  {ST::StatsTimeSeriesQ25,    {SW::KernelOrder,   [](const SW& w, double pct)->double { return w.percentile(.25); }} },
+  {ST::StatsTimeSeriesQ75,    {SW::KernelOrder,   [](const SW& w, double pct)->double { return w.percentile(.75); }} },
+  {ST::StatsTimeSeriesIQR,    {SW::KernelOrder,   [](const SW& w, double pct)->double { return (w.count() == 0) ? NAN : w.percentile(.75) - w.percentile(.25); }} },
+  {ST::StatsTimeSeriesMax,    {SW::KernelExtrema, [](const SW& w, double pct)->double { return w.max(); }} },
+  {ST::StatsTimeSeriesMin,    {SW::KernelExtrema, [](const SW& w, double pct)->double { return w.min(); }} },
+  {ST::StatsTimeSeriesCount,  {0,                 [](const SW& w, double pct)->double { return w.count(); }} },
+  {ST::StatsTimeSeriesVar,    {SW::KernelMoments, [](const SW& w, double pct)->double { return w.variance(); }} },
+  {ST::StatsTimeSeriesRMS,    {SW::KernelMoments, [](const SW& w, double pct)->double { return w.variance() + pow(w.mean(), 2.); }} },
+  {ST::StatsTimeSeriesPercentile, {SW::KernelOrder, [](const SW& w, double pct)->double { return w.percentile(pct); }} },
 });
 
 
@@ -83,39 +85,27 @@ PointCollection StatsTimeSeries::filterPointsInRange(TimeRange range) {
     qRange.correctWithRange(range);
   }
   
-  set<time_t> times = this->timeValuesInRange(qRange);
+  TimeList times = this->timeValuesInRange(qRange);
   
   auto subranges = this->subRanges(times);
   vector<Point> outPoints;
   outPoints.reserve(subranges.ranges.size());
   
-  map< time_t,future<double> > statsTasks;
+  Units u1 = this->statsUnits(this->source()->units(), this->statsType());
+  Units u2 = this->units();
+  auto getter = __getters.at(_statsType);
+  
+  // windows advance monotonically through the retained collection, so one kernel slides across all of them.
+  SlidingWindowStats window(subranges.retainedCollection.columns().values.data(), getter.first);
+  
   for(auto &x : subranges.ranges) {
     time_t t = x.first;
     PC::pvRange r = x.second;
     if (PC::count(r) == 0 && _statsType != StatsTimeSeriesCount) {
       continue;
     }
-    
-    auto mySource = this->source();
-    Units u1 = this->statsUnits(this->source()->units(), this->statsType());
-    Units u2 = this->units();
-    double pct = _percentile;
-    
-    auto task = async(launch::deferred, [=]()->double {
-      if (!mySource) {
-        return 0.0;
-      }
-      double v = __getters.at(_statsType)(r,pct);
-      return Units::convertValue(v, u1, u2);
-    });
-    
-    statsTasks.insert( std::pair< time_t, future<double> >(t,std::move(task)) );
-  }
-  
-  for (auto& taskPair : statsTasks) {
-    time_t t = taskPair.first;
-    double v = taskPair.second.get();
+    window.advanceTo(r.first.index(), r.second.index());
+    double v = Units::convertValue(getter.second(window, _percentile), u1, u2);
     Point outPoint(t,v);
     if (outPoint.isValid) {
       outPoints.push_back(outPoint);
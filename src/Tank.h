@@ -32,9 +32,6 @@ namespace RTX {
     double initLevel();
     double diameter();
     
-    // public ivars for temporary (that is, steady-state) solutions
-    double state_level;
-    
     void setGeometry(Curve::_sp curve);
     Curve::_sp geometry();
     
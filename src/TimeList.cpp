@@ -0,0 +1,171 @@
+//
+//  TimeList.cpp
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#include <algorithm>
+
+#include "TimeList.h"
+
+using namespace RTX;
+using namespace std;
+
+TimeList::TimeList() : _regular(false), _start(0), _period(0), _count(0), _begin(0) {
+
+}
+
+TimeList::TimeList(vector<time_t> times) : _regular(false), _start(0), _period(0), _begin(0) {
+  if (!is_sorted(times.begin(), times.end())) {
+    sort(times.begin(), times.end());
+  }
+  times.erase(unique(times.begin(), times.end()), times.end());
+  _count = times.size();
+  _times = make_shared<const vector<time_t> >(std::move(times));
+}
+
+TimeList::TimeList(initializer_list<time_t> times) : TimeList(vector<time_t>(times)) {
+
+}
+
+TimeList::TimeList(const set<time_t>& times) : _regular(false), _start(0), _period(0), _count(times.size()), _begin(0) {
+  _times = make_shared<const vector<time_t> >(times.begin(), times.end());
+}
+
+TimeList::TimeList(shared_ptr<const vector<time_t> > sortedTimes, size_t begin, size_t end) : _regular(false), _start(0), _period(0), _count(end - begin), _times(sortedTimes), _begin(begin) {
+
+}
+
+TimeList TimeList::regular(time_t start, time_t period, size_t count) {
+  TimeList l;
+  if (period <= 0) {
+    // not really a range. one value at most.
+    return (count > 0) ? TimeList({start}) : l;
+  }
+  l._regular = true;
+  l._start = start;
+  l._period = period;
+  l._count = count;
+  return l;
+}
+
+TimeRange TimeList::range() const {
+  if (this->empty()) {
+    return TimeRange();
+  }
+  return TimeRange(this->front(), this->back());
+}
+
+size_t TimeList::lowerBound(time_t t) const {
+  if (_regular) {
+    if (_count == 0 || t <= _start) {
+      return 0;
+    }
+    size_t i = (size_t)((t - _start + _period - 1) / _period);
+    return min(i, _count);
+  }
+  if (_count == 0) {
+    return 0;
+  }
+  auto first = _times->begin() + _begin;
+  return lower_bound(first, first + _count, t) - first;
+}
+
+bool TimeList::contains(time_t t) const {
+  size_t i = this->lowerBound(t);
+  return i < _count && (*this)[i] == t;
+}
+
+void TimeList::makeExplicit() {
+  if (!_regular && _times && _times.use_count() == 1 && _begin == 0 && _times->size() == _count) {
+    return;
+  }
+  auto v = make_shared<vector<time_t> >();
+  v->reserve(_count + 1);
+  for (size_t i = 0; i < _count; ++i) {
+    v->push_back((*this)[i]);
+  }
+  _times = v;
+  _begin = 0;
+  _regular = false;
+  _start = 0;
+  _period = 0;
+}
+
+void TimeList::insert(time_t t) {
+  size_t i = this->lowerBound(t);
+  if (i < _count && (*this)[i] == t) {
+    return;
+  }
+  this->makeExplicit();
+  // we are the only owner now, so writing through is safe
+  auto& v = const_cast<vector<time_t>&>(*_times);
+  v.insert(v.begin() + i, t);
+  ++_count;
+}
+
+TimeList TimeList::shifted(time_t offset) const {
+  if (_regular) {
+    return TimeList::regular(_start + offset, _period, _count);
+  }
+  vector<time_t> v;
+  v.reserve(_count);
+  for (size_t i = 0; i < _count; ++i) {
+    v.push_back((*this)[i] + offset);
+  }
+  return TimeList(std::move(v));
+}
+
+TimeList TimeList::subList(TimeRange range) const {
+  size_t lo = this->lowerBound(range.start);
+  size_t hi = this->lowerBound(range.end);
+  if (hi < _count && (*this)[hi] == range.end) {
+    ++hi;
+  }
+  if (hi <= lo) {
+    return TimeList();
+  }
+  if (_regular) {
+    return TimeList::regular((*this)[lo], _period, hi - lo);
+  }
+  return TimeList(_times, _begin + lo, _begin + hi);
+}
+
+TimeList TimeList::unionOf(const TimeList& a, const TimeList& b) {
+  if (a.empty()) {
+    return b;
+  }
+  if (b.empty() || a == b) {
+    return a;
+  }
+  vector<time_t> v;
+  v.reserve(a.size() + b.size());
+  set_union(a.begin(), a.end(), b.begin(), b.end(), back_inserter(v));
+  return TimeList(std::move(v));
+}
+
+bool TimeList::operator==(const TimeList& other) const {
+  if (_count != other._count) {
+    return false;
+  }
+  if (_count == 0) {
+    return true;
+  }
+  if (this->front() != other.front() || this->back() != other.back()) {
+    return false;
+  }
+  if (_regular && other._regular) {
+    return _period == other._period || _count == 1;
+  }
+  if (!_regular && !other._regular && _times == other._times && _begin == other._begin) {
+    return true;
+  }
+  for (size_t i = 0; i < _count; ++i) {
+    if ((*this)[i] != other[i]) {
+      return false;
+    }
+  }
+  return true;
+}
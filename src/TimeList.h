@@ -0,0 +1,104 @@
+//
+//  TimeList.h
+//  epanet-rtx
+//
+//  Created by the EPANET-RTX Development Team
+//  See README.md and license.txt for more information
+//
+
+#ifndef epanet_rtx_TimeList_h
+#define epanet_rtx_TimeList_h
+
+#include <time.h>
+#include <vector>
+#include <set>
+#include <memory>
+#include <iterator>
+#include <initializer_list>
+
+#include "TimeRange.h"
+
+namespace RTX {
+
+  /*!
+   \class TimeList
+   \brief An ordered list of unique time values
+
+   Stored either as a contiguous sorted vector, or -- for regular clocks -- as an arithmetic range (start, period, count) that is never expanded. Explicit lists can share storage with the PointCollection they came from, so taking the times of a collection does not copy. Comparing two regular lists is O(1); anything else is a single pass that exits early on size or end points.
+
+   */
+
+  class TimeList {
+  public:
+    class const_iterator {
+    public:
+      typedef std::random_access_iterator_tag iterator_category;
+      typedef time_t value_type;
+      typedef std::ptrdiff_t difference_type;
+      typedef const time_t* pointer;
+      typedef time_t reference;
+
+      const_iterator() : _l(NULL), _i(0) {};
+      const_iterator(const TimeList* l, size_t i) : _l(l), _i(i) {};
+
+      time_t operator*() const { return (*_l)[_i]; };
+      time_t operator[](difference_type n) const { return (*_l)[_i + n]; };
+      const_iterator& operator++() { ++_i; return *this; };
+      const_iterator operator++(int) { const_iterator t = *this; ++_i; return t; };
+      const_iterator& operator--() { --_i; return *this; };
+      const_iterator operator--(int) { const_iterator t = *this; --_i; return t; };
+      const_iterator& operator+=(difference_type n) { _i += n; return *this; };
+      const_iterator& operator-=(difference_type n) { _i -= n; return *this; };
+      const_iterator operator+(difference_type n) const { return const_iterator(_l, _i + n); };
+      const_iterator operator-(difference_type n) const { return const_iterator(_l, _i - n); };
+      difference_type operator-(const const_iterator& o) const { return (difference_type)_i - (difference_type)o._i; };
+      bool operator==(const const_iterator& o) const { return _i == o._i && _l == o._l; };
+      bool operator!=(const const_iterator& o) const { return !(*this == o); };
+      bool operator<(const const_iterator& o) const { return _i < o._i; };
+
+    private:
+      const TimeList* _l;
+      size_t _i;
+    };
+
+    TimeList();
+    TimeList(std::vector<time_t> times); // sorted and de-duplicated if needed
+    TimeList(std::initializer_list<time_t> times);
+    TimeList(const std::set<time_t>& times);
+    TimeList(std::shared_ptr<const std::vector<time_t> > sortedTimes, size_t begin, size_t end); // shares storage, no checks
+    static TimeList regular(time_t start, time_t period, size_t count);
+
+    size_t size() const { return _count; };
+    bool empty() const { return _count == 0; };
+    time_t operator[](size_t i) const { return _regular ? (_start + (time_t)i * _period) : (*_times)[_begin + i]; };
+    time_t front() const { return (*this)[0]; };
+    time_t back() const { return (*this)[_count - 1]; };
+    const_iterator begin() const { return const_iterator(this, 0); };
+    const_iterator end() const { return const_iterator(this, _count); };
+
+    bool isRegular() const { return _regular; };
+    time_t period() const { return _period; }; // zero unless regular
+    TimeRange range() const;
+
+    size_t lowerBound(time_t t) const; // index of the first time >= t
+    bool contains(time_t t) const;
+    void insert(time_t t);
+    TimeList shifted(time_t offset) const;
+    TimeList subList(TimeRange range) const;
+    static TimeList unionOf(const TimeList& a, const TimeList& b);
+
+    bool operator==(const TimeList& other) const;
+    bool operator!=(const TimeList& other) const { return !(*this == other); };
+
+  private:
+    void makeExplicit(); // materialize into a private vector before writing
+    bool _regular;
+    time_t _start, _period;
+    size_t _count;
+    std::shared_ptr<const std::vector<time_t> > _times;
+    size_t _begin;
+  };
+
+}
+
+#endif
@@ -26,18 +26,19 @@ using namespace std;
 #pragma mark - Time Series methods
 
 
-TimeSeries::TimeSeries() : _valid(true) {
+TimeSeries::TimeSeries() : _valid(true), _version(1), _bumpEpoch(0) {
   _name = "";
   _points.reset( new PointRecord() );
   setName("Time Series");
   _units = RTX_NO_UNITS;
 }
 
-TimeSeries::TimeSeries(const std::string& name, const RTX::Units& units) {
+TimeSeries::TimeSeries(const std::string& name, const RTX::Units& units) : _version(1), _bumpEpoch(0) {
   _name = name;
   _units = units;
   _points.reset( new PointRecord() );
   _points->registerAndGetIdentifierForSeriesWithUnits(name, units);
+  _recordHandle = _points->handleForIdentifier(name);
   _valid = true;
 }
 
@@ -61,6 +62,7 @@ void TimeSeries::setValid(bool v) {
 void TimeSeries::setName(const std::string& name) {
   _name = name;
   _points->registerAndGetIdentifierForSeriesWithUnits(name, this->units());
+  _recordHandle = _points->handleForIdentifier(name);
 }
 
 std::string TimeSeries::name() {
@@ -78,10 +80,12 @@ void TimeSeries::setUserDescription(const std::string& desc) {
 
 void TimeSeries::insert(Point thisPoint) {
   _points->addPoint(name(), thisPoint);
+  this->bumpVersion();
 }
 
 void TimeSeries::insertPoints(std::vector<Point> points) {
   _points->addPoints(name(), points);
+  this->bumpVersion();
 }
 
 Point TimeSeries::point(time_t time) {
@@ -117,7 +121,7 @@ std::vector< Point > TimeSeries::points(TimeRange range) {
   return points;
 }
 
-std::set<time_t> TimeSeries::timeValuesInRange(TimeRange range) {
+TimeList TimeSeries::timeValuesInRange(TimeRange range) {
   auto points = this->pointCollection(range);
   return points.times();
 }
@@ -186,6 +190,8 @@ void TimeSeries::setRecord(PointRecord::_sp record) {
   }
   if (record->registerAndGetIdentifierForSeriesWithUnits(this->name(),this->units())) {
     _points = record;
+    _recordHandle = _points->handleForIdentifier(this->name());
+    this->bumpVersion();
   }
   return;
 }
@@ -196,14 +202,17 @@ PointRecord::_sp TimeSeries::record() {
 
 void TimeSeries::resetCache() {
   _points->reset(name());
+  this->bumpVersion();
 }
 
 void TimeSeries::invalidate() {
+  this->bumpVersion();
   if(_points) {
     _points->invalidate(this->name());
     if (!_points->registerAndGetIdentifierForSeriesWithUnits(this->name(), this->units())) {
       PointRecord::_sp pr( new PointRecord() );
       _points = pr;
+      _recordHandle = _points->handleForIdentifier(this->name());
     }
   }
 }
@@ -250,18 +259,49 @@ bool TimeSeries::hasUpstreamSeries(TimeSeries::_sp other) {
 
 
 void TimeSeries::filterDidAddSource(TimeSeriesFilter::_sp filter) {
+  std::lock_guard<std::mutex> lock(_sinksMutex);
   _sinks.insert(filter);
 }
 void TimeSeries::filterDidRemoveSource(TimeSeriesFilter::_sp filter) {
+  std::lock_guard<std::mutex> lock(_sinksMutex);
   _sinks.erase(filter);
 }
 bool TimeSeries::isSink(TimeSeriesFilter::_sp filter) {
+  std::lock_guard<std::mutex> lock(_sinksMutex);
   return _sinks.count(filter) > 0;
 }
 std::set<TimeSeriesFilter::_sp> TimeSeries::sinks() {
+  std::lock_guard<std::mutex> lock(_sinksMutex);
   return _sinks;
 }
 
+void TimeSeries::bumpVersion() {
+  static std::atomic<uint64_t> lastEpoch(0);
+  this->bumpVersion(++lastEpoch);
+}
+
+void TimeSeries::bumpVersion(uint64_t epoch) {
+  // a series reachable along several paths only needs bumping once per epoch
+  if (_bumpEpoch.exchange(epoch) == epoch) {
+    return;
+  }
+  ++_version;
+  // walk a copy: sinks may be bumping (or rewiring) from other threads
+  for (auto& sink : this->sinks()) {
+    TimeSeries* ts = sink.get();
+    ts->bumpVersion(epoch);
+  }
+}
+
+bool TimeSeries::versionTracksData() {
+  return !(_points && _points->changesExternally());
+}
+
+uint64_t TimeSeries::clockVersion() {
+  auto c = this->clock();
+  return c ? c->version() : 0;
+}
+
 bool TimeSeries::supportsQualifiedQuery() {
   return (_points && _points->supportsQualifiedQuery());
 }
@@ -14,6 +14,7 @@
 #include <map>
 #include <iostream>
 #include <atomic>
+#include <mutex>
 
 #include "rtxMacros.h"
 #include "Point.h"
@@ -81,7 +82,7 @@ namespace RTX {
     PointCollection pointCollection(TimeRange range);
     virtual std::vector< Point > points(TimeRange range); // points in range
 
-    virtual std::set<time_t> timeValuesInRange(TimeRange range);
+    virtual TimeList timeValuesInRange(TimeRange range);
     virtual time_t timeAfter(time_t t);
     virtual time_t timeBefore(time_t t);
 
@@ -93,6 +94,7 @@ namespace RTX {
 
     virtual PointRecord::_sp record();
     virtual void setRecord(PointRecord::_sp record);
+    PointRecord::seriesHandle_t recordHandle() { return _recordHandle; }; /// for PointRecord::addSnapshot
 
     Units units();
     virtual void setUnits(Units newUnits);
@@ -101,6 +103,10 @@ namespace RTX {
     virtual std::vector<TimeSeries::_sp> rootTimeSeries() { return std::vector<TimeSeries::_sp> {this->sp()}; };
     virtual void resetCache();
     virtual void invalidate();
+    uint64_t version() { return _version; }; // changes whenever this series, or anything upstream of it, may have changed
+    void bumpVersion(); // also bumps every sink. call this after writing to our record directly.
+    virtual bool versionTracksData(); // false if our data can change without the version moving (e.g. an external database)
+    virtual uint64_t clockVersion(); // moves whenever a clock at or upstream of this series is re-anchored or re-periodized
 
     virtual std::ostream& toStream(std::ostream &stream);
 
@@ -136,11 +142,16 @@ namespace RTX {
 
   private:
     PointRecord::_sp _points;
+    PointRecord::seriesHandle_t _recordHandle;
     std::string _name, _userDescription;
     Units _units;
     std::pair<time_t, time_t> _validTimeRange;
     time_t _expectedPeriod;
     std::set<TimeSeriesFilter_sp> _sinks;
+    std::mutex _sinksMutex;
+    std::atomic<uint64_t> _version;
+    std::atomic<uint64_t> _bumpEpoch; // last bump that reached us, so a diamond-shaped graph is walked once
+    void bumpVersion(uint64_t epoch);
 
   };
 
@@ -16,7 +16,7 @@ const size_t _tsfilter_max_search = 10; // FIXME 💩
 const size_t _stride_multiplier = 25;
 const time_t _stride_basis = 60*60; // 1 hour
 
-TimeSeriesFilter::TimeSeriesFilter() {
+TimeSeriesFilter::TimeSeriesFilter() : _memoizable(false), _memoizableVersion(0) {
   _resampleMode = ResampleModeLinear;
 }
 
@@ -83,7 +83,7 @@ bool TimeSeriesFilter::hasUpstreamSeries(TimeSeries::_sp ts) {
 vector<Point> TimeSeriesFilter::points(TimeRange range) {
   
   PointCollection cached;
-  set<time_t> pointTimes;
+  TimeList pointTimes;
   auto canDrop = this->canDropPoints();
   PointCollection outCollection;
   bool didFetch = false;
@@ -92,6 +92,20 @@ vector<Point> TimeSeriesFilter::points(TimeRange range) {
     return vector<Point>();
   }
   
+  // already computed at this version? then the record holds the answer -- unless it has since evicted some of it.
+  uint64_t version = this->version();
+  uint64_t clockVersion = this->clockVersion();
+  TimeList computedTimes;
+  if (this->computedTimesInRange(range, version, clockVersion, computedTimes)) {
+    if (computedTimes.empty()) {
+      return vector<Point>();
+    }
+    vector<Point> memo = TimeSeries::points(range);
+    if (memo.size() == computedTimes.size() && memo.front().time == computedTimes.front() && memo.back().time == computedTimes.back()) {
+      return memo;
+    }
+  }
+  
   cached = PointCollection(TimeSeries::points(range), this->units()); // base class call -> find any pre-cached points
   
   if (canDrop) {
@@ -115,6 +129,7 @@ vector<Point> TimeSeriesFilter::points(TimeRange range) {
   // important optimization. if this range has already been constructed and cached, then don't recreate it.
   if (cached.times() == pointTimes) {
     // all time values are there, so the cache is valid and complete.
+    this->didComputeRange(range, version, clockVersion, pointTimes);
     return cached.points();
   }
   else if (!didFetch) {
@@ -123,12 +138,57 @@ vector<Point> TimeSeriesFilter::points(TimeRange range) {
     outCollection = this->filterPointsInRange(range);
   }
   
-  this->insertPoints(outCollection.points());
+  // straight to the record: caching our own output is not a change to our data, so it doesn't bump the version.
+  this->record()->addPoints(this->name(), outCollection.points());
   outCollection = outCollection.trimmedToRange(range); // safeguard if filter doesn't respected the range
+  this->didComputeRange(range, version, clockVersion, outCollection.times());
   return outCollection.points();
 }
 
 
+bool TimeSeriesFilter::computedTimesInRange(TimeRange range, uint64_t version, uint64_t clockVersion, TimeList& times) {
+  lock_guard<mutex> lock(_computedMutex);
+  if (_memoizableVersion != version) {
+    _memoizable = true;
+    for (auto root : this->rootTimeSeries()) {
+      _memoizable = _memoizable && root->versionTracksData();
+    }
+    _memoizableVersion = version;
+  }
+  if (!_memoizable) {
+    return false;
+  }
+  if (!_computed.empty() && (_computed.front().version != version || _computed.front().clockVersion != clockVersion)) {
+    _computed.clear(); // something upstream changed, or a clock moved its grid. all of it is stale.
+    return false;
+  }
+  for (auto& c : _computed) {
+    if (c.range.start <= range.start && range.end <= c.range.end) {
+      times = c.times.subList(range);
+      return true;
+    }
+  }
+  return false;
+}
+
+void TimeSeriesFilter::didComputeRange(TimeRange range, uint64_t version, uint64_t clockVersion, const TimeList& times) {
+  if (!range.isValid()) {
+    return; // nothing is computed for an invalid range, and its empty answer would hide every valid range inside it
+  }
+  lock_guard<mutex> lock(_computedMutex);
+  if (version != this->version() || clockVersion != this->clockVersion() || version != _memoizableVersion || !_memoizable) {
+    return; // changed while we were computing, or can't be trusted
+  }
+  if (!_computed.empty() && (_computed.front().version != version || _computed.front().clockVersion != clockVersion)) {
+    _computed.clear();
+  }
+  _computed.push_back({range, version, clockVersion, times.subList(range)});
+  if (_computed.size() > RTX_FILTER_COMPUTED_RANGES) {
+    _computed.pop_front();
+  }
+}
+
+
 Point TimeSeriesFilter::pointBefore(time_t time) {
   Point p;
   p.time = time;
@@ -333,7 +393,7 @@ PointCollection TimeSeriesFilter::filterPointsInRange(TimeRange range) {
   bool dataOk = false;
   dataOk = data.convertToUnits(this->units());
   if (dataOk && this->willResample()) {
-    set<time_t> timeValues = this->timeValuesInRange(range);
+    TimeList timeValues = this->timeValuesInRange(range);
     dataOk = data.resample(timeValues, _resampleMode);
   }
   
@@ -345,8 +405,8 @@ PointCollection TimeSeriesFilter::filterPointsInRange(TimeRange range) {
 }
 
 
-set<time_t> TimeSeriesFilter::timeValuesInRange(TimeRange range) {
-  set<time_t> times;
+TimeList TimeSeriesFilter::timeValuesInRange(TimeRange range) {
+  TimeList times;
   
   if (!range.isValid() || !this->source()) {
     return times;
@@ -449,6 +509,10 @@ bool TimeSeriesFilter::canChangeToUnits(Units units) {
 }
 
 
+uint64_t TimeSeriesFilter::clockVersion() {
+  return TimeSeries::clockVersion() + (_source ? _source->clockVersion() : 0);
+}
+
 std::vector<TimeSeries::_sp> TimeSeriesFilter::rootTimeSeries() {
   std::vector<TimeSeries::_sp> roots;
   TimeSeries::_sp source = this->source();
@@ -9,6 +9,12 @@
 
 #include "TimeSeries.h"
 #include <set>
+#include <deque>
+#include <mutex>
+
+#ifndef RTX_FILTER_COMPUTED_RANGES
+#define RTX_FILTER_COMPUTED_RANGES 16 // recently computed ranges remembered per filter
+#endif
 
 namespace RTX {
   
@@ -21,10 +27,10 @@ namespace RTX {
   
   
   /*!
-   \fn virtual std::set<time_t> TimeSeriesFilter::timeValuesInRange(TimeRange range)
+   \fn virtual TimeList TimeSeriesFilter::timeValuesInRange(TimeRange range)
    \brief Allow derived classes to specify the occurence of points in time. Optional.
    \param range The time range over which to report time values.
-   \return A set of time values where the Time Series may provide points.
+   \return An ordered list of time values where the Time Series may provide points.
   
    Overriding this method is optional. Base functionality reports clock ticks if there is a clock, or the time values for this object's source points, if a source is set.
    */
@@ -86,11 +92,12 @@ namespace RTX {
     virtual TimeRange expandedRange(TimeRange r);
     
     virtual std::vector<TimeSeries::_sp> rootTimeSeries();
+    virtual uint64_t clockVersion();
     
     // methods you must override to provide info to the base class
     virtual PointCollection filterPointsInRange(TimeRange range);
     
-    virtual std::set<time_t> timeValuesInRange(TimeRange range);
+    virtual TimeList timeValuesInRange(TimeRange range);
     virtual time_t timeAfter(time_t t);
     virtual time_t timeBefore(time_t t);
     
@@ -106,6 +113,20 @@ namespace RTX {
     TimeSeriesFilter::_sp source(TimeSeries::_sp source) {this->setSource(source); return share_me(this);};
     
   private:
+    // ranges already computed, with the versions they were computed at and the times they produced.
+    // a repeat query inside one of them is validated by comparing versions -- data and clocks -- without fetching anything.
+    struct ComputedRange {
+      TimeRange range;
+      uint64_t version, clockVersion;
+      TimeList times;
+    };
+    bool computedTimesInRange(TimeRange range, uint64_t version, uint64_t clockVersion, TimeList& times);
+    void didComputeRange(TimeRange range, uint64_t version, uint64_t clockVersion, const TimeList& times);
+    std::deque<ComputedRange> _computed;
+    std::mutex _computedMutex;
+    bool _memoizable; // every root's version tracks its data. re-checked whenever our version moves.
+    uint64_t _memoizableVersion;
+    
     TimeSeries::_sp _source;
     Clock::_sp _clock;
     ResampleMode _resampleMode;
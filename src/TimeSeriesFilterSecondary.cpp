@@ -12,8 +12,14 @@ using namespace RTX;
 
 void TimeSeriesFilterSecondary::setSecondary(TimeSeries::_sp secondary) {
   if (this->canSetSecondary(secondary)) {
+    if (_secondary && _secondary != this->source()) { // if it is also our primary we stay registered with it
+      _secondary->filterDidRemoveSource(share_me(this));
+    }
     _secondary = secondary;
     this->didSetSecondary(secondary);
+    if (secondary) {
+      secondary->filterDidAddSource(share_me(this));
+    }
   }
 }
 
@@ -34,6 +40,10 @@ bool TimeSeriesFilterSecondary::hasUpstreamSeries(TimeSeries::_sp other) {
   return TimeSeriesFilter::hasUpstreamSeries(other) || (this->secondary() && this->secondary()->hasUpstreamSeries(other));
 }
 
+uint64_t TimeSeriesFilterSecondary::clockVersion() {
+  return TimeSeriesFilter::clockVersion() + (_secondary ? _secondary->clockVersion() : 0);
+}
+
 std::vector<TimeSeries::_sp> TimeSeriesFilterSecondary::rootTimeSeries() {
   std::vector<TimeSeries::_sp> roots;
   if (this->source()) {
@@ -23,6 +23,7 @@ namespace RTX {
     virtual void didSetSecondary(TimeSeries::_sp secondary);
     TimeSeriesFilterSecondary::_sp secondary(TimeSeries::_sp sec) {this->setSecondary(sec); return share_me(this);};
     virtual std::vector<TimeSeries::_sp> rootTimeSeries();
+    virtual uint64_t clockVersion();
     
     virtual bool hasUpstreamSeries(TimeSeries::_sp other);
     
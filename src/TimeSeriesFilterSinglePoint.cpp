@@ -46,7 +46,7 @@ PointCollection TimeSeriesFilterSinglePoint::filterPointsInRange(TimeRange range
   
   PointCollection outData(outPoints, this->units());
   if (this->willResample() || (didDropPoints && this->clock())) {
-    set<time_t> timeValues = this->timeValuesInRange(range); // if infinite recursion occurs here, check canDropPoints
+    TimeList timeValues = this->timeValuesInRange(range); // if infinite recursion occurs here, check canDropPoints
     outData.resample(timeValues);
   }
   
@@ -1,5 +1,5 @@
 #include "TimeSeriesLowess.h"
-#include "Lowess.h"
+#include "SortedLowess.h"
 
 using namespace RTX;
 using namespace std;
@@ -7,6 +7,7 @@ using PC = RTX::PointCollection;
 
 TimeSeriesLowess::TimeSeriesLowess() {
   _fraction = 0.5;
+  _delta = 0;
   this->setSummaryOnly(false);
 }
 
@@ -21,6 +22,14 @@ double TimeSeriesLowess::fraction() {
   return _fraction;
 }
 
+void TimeSeriesLowess::setDelta(time_t seconds) {
+  _delta = (seconds > 0) ? seconds : 0;
+  this->invalidate();
+}
+time_t TimeSeriesLowess::delta() {
+  return _delta;
+}
+
 PointCollection TimeSeriesLowess::filterPointsInRange(RTX::TimeRange range) {
   
   TimeRange qRange = range;
@@ -31,11 +40,16 @@ PointCollection TimeSeriesLowess::filterPointsInRange(RTX::TimeRange range) {
     qRange.correctWithRange(range);
   }
   
-  set<time_t> times = this->timeValuesInRange(qRange);
+  TimeList times = this->timeValuesInRange(qRange);
   auto subranges = this->subRanges(times);
   vector<Point> outPoints;
   outPoints.reserve(subranges.ranges.size());
   
+  // one engine for every window, so its scratch space is reused
+  SortedLowess lowess(this->fraction(), 2, (double)this->delta());
+  const time_t* times0 = subranges.retainedCollection.columns().times.data();
+  const double* values0 = subranges.retainedCollection.columns().values.data();
+  
   for (auto &rm : subranges.ranges) {
     // lowess requires in-sample smoothing. in case of gaps, drop the point.
     time_t t = rm.first;
@@ -45,7 +59,8 @@ PointCollection TimeSeriesLowess::filterPointsInRange(RTX::TimeRange range) {
     if (!r.contains(t) || PC::count(pvr) == 0) {
       continue;
     }
-    double v = this->valueFromSampleAtTime(pvr,t);
+    size_t i0 = pvr.first.index();
+    double v = lowess.valueAt(times0 + i0, values0 + i0, PC::count(pvr), t);
     Point p(t,v);
     if (p.isValid) {
       outPoints.push_back(p);
@@ -58,43 +73,3 @@ PointCollection TimeSeriesLowess::filterPointsInRange(RTX::TimeRange range) {
   }
   return ret;
 }
-
-
-double TimeSeriesLowess::valueFromSampleAtTime(PointCollection::pvRange r, time_t t) {
-  CppLowess::TemplatedLowess<vector<double>, double> lowess;
-  
-  vector<double> x;
-  vector<double> y;
-  auto i = r.first;
-  while (i != r.second) {
-    x.push_back(static_cast<double>(i->time));
-    y.push_back(i->value);
-    ++i;
-  }
-  
-  vector<double> out(x.size()), tmp1(x.size()), tmp2(x.size());
-  
-  lowess.lowess(x, y, this->fraction(), 2, 0.0, out, tmp1, tmp2);
-  
-  vector<Point> outPoints;
-  for (int i=0; i < x.size(); ++i) {
-    outPoints.push_back(Point(static_cast<time_t>(x.at(i)),out.at(i)));
-  }
-  
-  
-  
-  PointCollection outC(outPoints,this->units());
-  
-  outC.resample({t});
-  
-  Point p;
-  if (outC.count() > 0) { 
-    p = outC.points().front();
-  }
-  
-  return p.value;
-}
-
-
-
-
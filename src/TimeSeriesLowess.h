@@ -14,12 +14,15 @@ namespace RTX {
     void setFraction(double f);
     double fraction();
     
+    void setDelta(time_t seconds); /// points within this many seconds of the last fitted point are interpolated rather than fitted. zero (the default) fits every point.
+    time_t delta();
+    
   protected:
     PointCollection filterPointsInRange(TimeRange range);
     
   private:
     double _fraction;
-    double valueFromSampleAtTime(PointCollection::pvRange r, time_t t);
+    time_t _delta;
 
   };
 }
@@ -55,9 +55,7 @@ vector< Point > TimeSeriesSynthetic::points(TimeRange range) {
     return outPoints;
   }
   
-  set<time_t> times;
-  
-  times = this->clock()->timeValuesInRange(range);
+  TimeList times = this->clock()->timeValuesInRange(range);
   outPoints.reserve(times.size());
   
   for(time_t now : times) {
@@ -325,6 +325,18 @@ double Units::convertValue(double value, const Units& fromUnits, const Units& to
   }
 }
 
+bool Units::linearConversion(const Units& fromUnits, const Units& toUnits, double& scale, double& shift) {
+  if (!fromUnits.isSameDimensionAs(toUnits)) {
+    cerr << "Units are not dimensionally consistent" << endl;
+    scale = 0.;
+    shift = 0.;
+    return false;
+  }
+  scale = fromUnits._conversion / toUnits._conversion;
+  shift = (fromUnits._offset * scale) - toUnits._offset;
+  return true;
+}
+
 // factory for string input
 Units Units::unitOfType(const string& unitString) {
   
@@ -146,6 +146,7 @@ namespace RTX {
     const double conversion() const;
     const double offset() const;
     static double convertValue(double value, const Units& fromUnits, const Units& toUnits);
+    static bool linearConversion(const Units& fromUnits, const Units& toUnits, double& scale, double& shift); // convertValue(v) == v * scale + shift
     static Units unitOfType(const std::string& unitString);
     const std::string to_string() const;
     const std::string rawUnitString(bool ignoreZeroDimensions = true) const;
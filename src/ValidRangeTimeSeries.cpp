@@ -116,7 +116,7 @@ PointCollection ValidRangeTimeSeries::filterPointsInRange(TimeRange range) {
   PointCollection outData(outP,this->units());
   
   if (this->willResample()) {
-    set<time_t> resTimes = this->timeValuesInRange(range);
+    TimeList resTimes = this->timeValuesInRange(range);
     outData.resample(resTimes);
   }
   
@@ -0,0 +1,90 @@
+#include <iostream>
+#include <math.h>
+
+#include "bench_main.h"
+#include "PointCollection.h"
+#include "SortedLowess.h"
+#include "Lowess.h"
+
+using namespace RTX;
+using namespace std;
+
+////////////////////////
+// lowess
+BOOST_AUTO_TEST_SUITE(lowess)
+
+BOOST_AUTO_TEST_CASE(lowess_windows) {
+  
+  // TimeSeriesLowess smooths one window per output time. "before" is its old per-sample path: copy the window,
+  // allocate scratch, run the generic Lowess.h routine over all of it, then resample the result at t.
+  // "after" is SortedLowess reading the same window in place, exact and on a 5-minute fitting grid.
+  const time_t t0 = 1599999600, step = 60, outStep = 300, span = 2 * 86400;
+  vector<time_t> times;
+  vector<double> values;
+  for (time_t t = t0; t <= t0 + span; t += step) {
+    double spike = (t % 1300 == 0) ? 25. : 0.; // a few outliers for the robustness passes
+    times.push_back(t);
+    values.push_back(50. + 5. * sin((double)t / 2000.) + (double)(t % 7) / 3. + spike);
+  }
+  
+  for (time_t w : {3600, 6 * 3600}) {
+    vector<time_t> at;
+    for (time_t t = t0 + w/2; t + w/2 <= t0 + span; t += outStep) {
+      at.push_back(t);
+    }
+    const size_t n = (size_t)(w / step) + 1;
+    auto first = [&](time_t t) { return (size_t)((t - w/2 - t0) / step); };
+    
+    vector<double> before(at.size());
+    double timeBefore = secondsFor([&]{
+      for (size_t k = 0; k < at.size(); ++k) {
+        CppLowess::TemplatedLowess<vector<double>, double> lowess;
+        vector<double> x, y;
+        for (size_t i = first(at[k]); i < first(at[k]) + n; ++i) {
+          x.push_back(static_cast<double>(times[i]));
+          y.push_back(values[i]);
+        }
+        vector<double> out(x.size()), tmp1(x.size()), tmp2(x.size());
+        lowess.lowess(x, y, 0.5, 2, 0.0, out, tmp1, tmp2);
+        vector<Point> outPoints;
+        for (size_t i = 0; i < x.size(); ++i) {
+          outPoints.push_back(Point(static_cast<time_t>(x[i]), out[i]));
+        }
+        PointCollection outC(outPoints, RTX_GALLON_PER_MINUTE);
+        outC.resample({at[k]});
+        before[k] = (outC.count() > 0) ? outC.points().front().value : nan("");
+      }
+    });
+    
+    auto timeSorted = [&](double delta, vector<double>& after) {
+      after.resize(at.size());
+      SortedLowess lowess(0.5, 2, delta);
+      return secondsFor([&]{
+        for (size_t k = 0; k < at.size(); ++k) {
+          size_t i0 = first(at[k]);
+          after[k] = lowess.valueAt(&times[i0], &values[i0], n, at[k]);
+        }
+      });
+    };
+    auto maxDiff = [&](const vector<double>& after) {
+      double d = 0;
+      for (size_t k = 0; k < at.size(); ++k) {
+        d = max(d, fabs(after[k] - before[k]));
+      }
+      return d;
+    };
+    vector<double> exact, coarse;
+    double timeExact = timeSorted(0., exact);
+    double timeCoarse = timeSorted((double)outStep, coarse);
+    
+    cout << "lowess, " << n << "-point windows, " << at.size() << " fits: before " << timeBefore << " s; sorted "
+    << timeExact << " s (" << (timeBefore / timeExact) << "x, max difference " << maxDiff(exact) << "); sorted on a "
+    << outStep << " s grid " << timeCoarse << " s (" << (timeBefore / timeCoarse) << "x, max difference " << maxDiff(coarse) << ")" << endl;
+    BOOST_CHECK_SMALL(maxDiff(exact), 1e-6);
+    BOOST_CHECK_SMALL(maxDiff(coarse), 0.5);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+// lowess
+/////////////////////////
@@ -0,0 +1,4 @@
+
+#define __AS_MAIN
+  #include "bench_main.h"
+#undef __AS_MAIN
@@ -0,0 +1,12 @@
+#ifdef __AS_MAIN
+  #define BOOST_TEST_MODULE EPANET_RTX_BENCHMARKS
+#endif
+#include <boost/test/unit_test.hpp>
+#include <chrono>
+
+// wall time of one call to f, in seconds
+template<class F> double secondsFor(F f) {
+  auto start = std::chrono::steady_clock::now();
+  f();
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
@@ -0,0 +1,118 @@
+#include <iostream>
+#include <filesystem>
+#include <cstdio>
+
+#include "bench_main.h"
+#include "SqliteAdapter.h"
+
+using namespace RTX;
+using namespace std;
+
+////////////////////////
+// sqlite
+BOOST_AUTO_TEST_SUITE(sqlite)
+
+static string freshFile(const string& name) {
+  string file = (std::filesystem::temp_directory_path() / name).string();
+  for (string f : {file, file + "-wal", file + "-shm"}) {
+    std::remove(f.c_str());
+  }
+  return file;
+}
+
+BOOST_AUTO_TEST_CASE(sqlite_statements) {
+  
+  // bulk inserts and hot previous-point lookups. "before" issues the statements the way SqliteAdapter used to:
+  // re-prepared on every call, and looked up through a join on the series name. "after" is the adapter itself,
+  // with its prepared statements keyed by series_id, on both table layouts. all three use the same WAL file setup.
+  const time_t t0 = 1000000000;
+  const int nPoints = 20000, nLookups = 20000;
+  vector<Point> points;
+  for (int i = 0; i < nPoints; ++i) {
+    points.push_back(Point(t0 + 60 * i, (double)i));
+  }
+  auto lookupTime = [&](int i) { return t0 + 60 * (i % nPoints) + 30; };
+  
+  double insertBefore, lookupBefore;
+  {
+    const string file = freshFile("rtx-bench-joined.db");
+    {
+      SqliteAdapter adapter([](const std::string){});
+      adapter.clusteredStorage = false;
+      adapter.setConnectionString(file);
+      adapter.doConnect();
+      BOOST_REQUIRE(adapter.adapterConnected());
+      BOOST_REQUIRE(adapter.insertIdentifierAndUnits("level", RTX_FOOT));
+    }
+    {
+      sqlite::database db(file);
+      const string name = "level";
+      int uid = 0;
+      db << "select series_id from meta where name = ?" << name >> uid;
+      BOOST_REQUIRE(uid > 0);
+      
+      insertBefore = secondsFor([&]{
+        db << "begin;";
+        for (const Point& p : points) {
+          db << "INSERT INTO points(time,series_id,value,quality,confidence) VALUES (?,?,?,?,?)"
+          << (int)p.time << uid << p.value << (int)p.quality << p.confidence;
+        }
+        db << "end;";
+      });
+      
+      int found = 0;
+      lookupBefore = secondsFor([&]{
+        for (int i = 0; i < nLookups; ++i) {
+          int t = (int)lookupTime(i), got = 0;
+          db << "SELECT time,value,quality,confidence FROM points INNER JOIN meta USING(series_id) WHERE name = ? AND time < ? order by time desc LIMIT 1"
+          << name << t >> [&](int pt, double v, int q, double c) { got = pt; };
+          if (got == t - 30) {
+            ++found;
+          }
+        }
+      });
+      BOOST_CHECK_EQUAL(found, nLookups);
+    }
+    for (string f : {file, file + "-wal", file + "-shm"}) {
+      std::remove(f.c_str());
+    }
+  }
+  cout << "sqlite before (joined, re-prepared): " << (nPoints / insertBefore) << " inserts/s, " << (nLookups / lookupBefore) << " previous-point lookups/s" << endl;
+  
+  for (bool clustered : {false, true}) {
+    const string file = freshFile(clustered ? "rtx-bench-clustered.db" : "rtx-bench-rowid.db");
+    {
+      SqliteAdapter adapter([](const std::string){});
+      adapter.clusteredStorage = clustered;
+      adapter.setConnectionString(file);
+      adapter.doConnect();
+      BOOST_REQUIRE(adapter.adapterConnected());
+      BOOST_REQUIRE(adapter.insertIdentifierAndUnits("level", RTX_FOOT));
+      
+      double insertAfter = secondsFor([&]{ adapter.insertRange("level", points); });
+      
+      int found = 0;
+      double lookupAfter = secondsFor([&]{
+        for (int i = 0; i < nLookups; ++i) {
+          time_t t = lookupTime(i);
+          if (adapter.selectPrevious("level", t).time == t - 30) {
+            ++found;
+          }
+        }
+      });
+      
+      cout << "sqlite after (" << (clustered ? "clustered" : "rowid") << "): "
+      << (nPoints / insertAfter) << " inserts/s (" << (insertBefore / insertAfter) << "x), "
+      << (nLookups / lookupAfter) << " previous-point lookups/s (" << (lookupBefore / lookupAfter) << "x)" << endl;
+      BOOST_CHECK_EQUAL(found, nLookups);
+      BOOST_CHECK_EQUAL(adapter.selectRange("level", TimeRange(t0, t0 + 60 * (nPoints - 1))).size(), nPoints);
+    }
+    for (string f : {file, file + "-wal", file + "-shm"}) {
+      std::remove(f.c_str());
+    }
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
+// sqlite
+/////////////////////////
@@ -1,5 +1,7 @@
 #include "test_main.h"
 #include "Junction.h"
+#include "StateStore.h"
+#include <sstream>
 #include <iostream>
 
 BOOST_AUTO_TEST_SUITE(Element)
@@ -33,4 +35,42 @@ BOOST_AUTO_TEST_CASE(ElementRemoveMetadataTest)
   BOOST_CHECK_THROW(e->getMetadataValue("a_key_for_double"), std::out_of_range);
 }
 
+BOOST_AUTO_TEST_CASE(StateStoreCheckpointTest)
+{
+  RTX::StateStore store;
+  store.resize(3, 2);
+  store.setValue(RTX::StateStore::Level, 1, 12.5);
+  store.setValue(RTX::StateStore::Quality, 2, 0.75);
+  store.setValue(RTX::StateStore::Status, 0, 1.);
+  store.beginSegmentOwner();
+  store.appendSegment(10., 0.5);
+  store.appendSegment(4., 0.25);
+  store.beginSegmentOwner(); // an empty link
+  store.beginSegmentOwner();
+  store.appendSegment(7., 1.);
+  
+  std::stringstream buffer;
+  store.write(buffer);
+  
+  RTX::StateStore restored;
+  BOOST_REQUIRE(restored.read(buffer));
+  BOOST_CHECK_EQUAL(restored.size(RTX::StateStore::Head), 3);
+  BOOST_CHECK_EQUAL(restored.size(RTX::StateStore::Flow), 2);
+  BOOST_CHECK_EQUAL(restored.value(RTX::StateStore::Level, 1), 12.5);
+  BOOST_CHECK_EQUAL(restored.value(RTX::StateStore::Quality, 2), 0.75);
+  BOOST_CHECK_EQUAL(restored.value(RTX::StateStore::Status, 0), 1.);
+  BOOST_REQUIRE_EQUAL(restored.segmentOwnerCount(), 3);
+  BOOST_CHECK_EQUAL(restored.segmentCount(0), 2);
+  BOOST_CHECK_EQUAL(restored.segmentCount(1), 0);
+  BOOST_CHECK_EQUAL(restored.segmentCount(2), 1);
+  BOOST_CHECK_EQUAL(restored.segmentVolumes(0)[1], 4.);
+  BOOST_CHECK_EQUAL(restored.segmentQualities(2)[0], 1.);
+  
+  // a truncated stream is rejected, and leaves the store alone
+  std::string bytes = buffer.str();
+  std::stringstream shortBuffer(bytes.substr(0, bytes.size() / 2));
+  BOOST_CHECK(!restored.read(shortBuffer));
+  BOOST_CHECK_EQUAL(restored.value(RTX::StateStore::Level, 1), 12.5);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,9 +1,20 @@
 #include <math.h>
+#include <thread>
+#include <filesystem>
+#include <cstdio>
 
 #include "test_main.h"
 #include "TimeSeriesFilter.h"
 #include "FailoverTimeSeries.h"
 #include "ValidRangeTimeSeries.h"
+#include "AggregatorTimeSeries.h"
+#include "StatsTimeSeries.h"
+#include "MovingAverage.h"
+#include "SlidingWindowStats.h"
+#include "CorrelatorTimeSeries.h"
+#include "TimeSeriesLowess.h"
+#include "QueryPlanner.h"
+#include "Lowess.h"
 #include "DbPointRecord.h"
 #include "ConcreteDbRecords.h"
 
@@ -24,9 +35,13 @@ BOOST_AUTO_TEST_CASE(complex_resampler) {
   time_t origin(1643616000);
   time_t ONE_DAY(60*60*24);
   
-  // data set
+  // data set, in a fresh db outside the working directory
+  const string file = (std::filesystem::temp_directory_path() / "rtx-sample-dataset.db").string();
+  for (string f : {file, file + "-wal", file + "-shm"}) {
+    std::remove(f.c_str());
+  }
   DbPointRecord::_sp db(new SqlitePointRecord());
-  db->setConnectionString("sample_dataset.db");
+  db->setConnectionString(file);
   Clock::_sp c5m(new Clock(60*5, 0));
   
   TimeSeries::_sp raw(new TimeSeries("raw", RTX_FOOT));
@@ -513,9 +528,518 @@ BOOST_AUTO_TEST_CASE(complex_resampler) {
   
   BOOST_CHECK_EQUAL(points.size(), ONE_DAY/(5*60));
   
+  for (string f : {file, file + "-wal", file + "-shm"}) {
+    std::remove(f.c_str());
+  }
+}
+
+
+BOOST_AUTO_TEST_CASE(collection_columns) {
+  
+  PointCollection pc({ Point(10, 1.), Point(20, 2.), Point(30, 3.), Point(40, 4.) }, RTX_FOOT);
+  BOOST_TEST(pc.columns().qualities.empty()); // uniform attributes stay unallocated
+  BOOST_TEST(pc.columns().confidences.empty());
+  
+  auto r = pc.subRange(TimeRange(15, 30));
+  BOOST_CHECK_EQUAL(PointCollection::count(r), 2);
+  BOOST_CHECK_EQUAL(r.first->time, 20);
+  BOOST_CHECK_EQUAL(PointCollection::max(r), 3.);
+  
+  // a differing point allocates its column, copies are unaffected by writes
+  PointCollection copy = pc;
+  pc.apply([](Point& p){ if (p.time == 30) p.addQualFlag(Point::rtx_interpolated); });
+  BOOST_CHECK_EQUAL(pc.columns().qualities.size(), 4);
+  BOOST_TEST(pc.points()[2].hasQual(Point::rtx_interpolated));
+  BOOST_TEST(!copy.points()[2].hasQual(Point::rtx_interpolated));
+  BOOST_TEST(copy.columns().qualities.empty());
+  
+  // trimming shares the columns; writing to the trimmed view leaves the original alone
+  PointCollection trimmed = copy.trimmedToRange(TimeRange(20, 30));
+  BOOST_CHECK_EQUAL(&trimmed.columns(), &copy.columns());
+  BOOST_CHECK_EQUAL(trimmed.count(), 2);
+  BOOST_CHECK_EQUAL(*trimmed.timesBegin(), 20);
+  trimmed.apply([](Point& p){ p.value *= 10.; });
+  BOOST_CHECK_EQUAL(trimmed.points()[1].value, 30.);
+  BOOST_CHECK_EQUAL(copy.points()[2].value, 3.);
+  
+  pc.convertToUnits(RTX_INCH);
+  BOOST_CHECK_CLOSE(pc.points()[3].value, 48., 1e-9);
+  BOOST_CHECK_CLOSE(pc.resampledAtTimes({15, 25}).points()[1].value, 30., 1e-9);
+}
+
+
+BOOST_AUTO_TEST_CASE(time_list) {
+  
+  Clock::_sp c(new Clock(60, 0));
+  TimeList regular = c->timeValuesInRange(TimeRange(30, 600));
+  BOOST_TEST(regular.isRegular());
+  BOOST_CHECK_EQUAL(regular.size(), 10);
+  BOOST_CHECK_EQUAL(regular.front(), 60);
+  BOOST_CHECK_EQUAL(regular.back(), 600);
+  BOOST_TEST(regular.contains(300));
+  BOOST_TEST(!regular.contains(301));
+  
+  vector<Point> pts;
+  for (time_t t = 60; t <= 600; t += 60) {
+    pts.push_back(Point(t, 1.));
+  }
+  PointCollection pc(pts, RTX_FOOT);
+  BOOST_TEST(pc.times() == regular); // explicit vs regular compare without expanding
+  pc.setPoints({Point(60, 1.), Point(600, 1.)});
+  BOOST_TEST(pc.times() != regular);
+  
+  TimeList merged = TimeList::unionOf({10, 20, 40}, {20, 30});
+  BOOST_CHECK_EQUAL(merged.size(), 4);
+  BOOST_CHECK_EQUAL(merged[2], 30);
+  BOOST_CHECK_EQUAL(regular.shifted(5).front(), 65);
+  BOOST_CHECK_EQUAL(regular.subList(TimeRange(100, 300)).size(), 4);
+}
+
+
+BOOST_AUTO_TEST_CASE(aggregator_fanout) {
+  
+  // a balance of balances, so the executor is re-entered from its own workers
+  Clock::_sp c(new Clock(60, 0));
+  BufferPointRecord::_sp buffer(new BufferPointRecord);
+  const int nSources = 6;
+  vector<TimeSeries::_sp> leaves;
+  for (int i = 0; i < nSources; ++i) {
+    TimeSeries::_sp ts(new TimeSeries("leaf " + to_string(i), RTX_GALLON_PER_MINUTE));
+    ts->setRecord(buffer);
+    vector<Point> pts;
+    for (time_t t = 0; t <= 3600; t += 30) {
+      pts.push_back(Point(t, (double)(i + 1)));
+    }
+    ts->insertPoints(pts);
+    leaves.push_back(ts);
+  }
+  
+  AggregatorTimeSeries::_sp outer(new AggregatorTimeSeries());
+  outer->setUnits(RTX_GALLON_PER_MINUTE);
+  outer->setClock(c);
+  for (int g = 0; g < 2; ++g) {
+    AggregatorTimeSeries::_sp inner(new AggregatorTimeSeries());
+    inner->setUnits(RTX_GALLON_PER_MINUTE);
+    for (int i = g * nSources / 2; i < (g + 1) * nSources / 2; ++i) {
+      inner->addSource(leaves[i], (i == 0) ? -1. : 1.);
+    }
+    outer->addSource(inner);
+  }
+  
+  auto points = outer->points(TimeRange(60, 3540));
+  BOOST_CHECK_EQUAL(points.size(), 59);
+  for (const Point& p : points) {
+    BOOST_CHECK_CLOSE(p.value, 19., 1e-9); // -1 + 2 + 3 + 4 + 5 + 6
+  }
+  
+  // without a clock, the output follows the union of source times, with sparse sources resampled
+  TimeSeries::_sp sparse(new TimeSeries("sparse", RTX_GALLON_PER_MINUTE));
+  sparse->setRecord(buffer);
+  sparse->insertPoints({Point(60, 1.), Point(120, 1.), Point(300, 1.)});
+  AggregatorTimeSeries::_sp unclocked(new AggregatorTimeSeries());
+  unclocked->setUnits(RTX_GALLON_PER_MINUTE);
+  unclocked->addSource(leaves[1]);
+  unclocked->addSource(sparse);
+  auto merged = unclocked->points(TimeRange(60, 300));
+  BOOST_CHECK_EQUAL(merged.size(), 9);
+  BOOST_CHECK_CLOSE(merged.back().value, 3., 1e-9);
+  
+  // a diamond: both branches fetch the same filter at once
+  MovingAverage::_sp shared(new MovingAverage());
+  shared->setSource(leaves[2]);
+  AggregatorTimeSeries::_sp diamond(new AggregatorTimeSeries());
+  diamond->setUnits(RTX_GALLON_PER_MINUTE);
+  diamond->setClock(c);
+  for (int b = 0; b < 2; ++b) {
+    AggregatorTimeSeries::_sp branch(new AggregatorTimeSeries());
+    branch->setUnits(RTX_GALLON_PER_MINUTE);
+    branch->addSource(shared);
+    diamond->addSource(branch);
+  }
+  auto doubled = diamond->points(TimeRange(60, 3540));
+  BOOST_CHECK_EQUAL(doubled.size(), 59);
+  for (const Point& p : doubled) {
+    BOOST_CHECK_CLOSE(p.value, 6., 1e-9);
+  }
+}
+
+
+BOOST_AUTO_TEST_CASE(sliding_window_stats) {
+  
+  // the streaming kernels must agree with brute-force stats over each window
+  BufferPointRecord::_sp buffer(new BufferPointRecord);
+  TimeSeries::_sp ts(new TimeSeries("raw", RTX_GALLON_PER_MINUTE));
+  ts->setRecord(buffer);
+  vector<Point> pts;
+  for (time_t t = 60; t <= 4*3600; t += 60) {
+    if (t % 420 == 0) {
+      continue; // a few holes so windows vary in size
+    }
+    pts.push_back(Point(t, 100. + 10. * sin((double)t / 900.) + (double)(t % 7))); // repeated values, too
+  }
+  ts->insertPoints(pts);
+  
+  time_t w = 15 * 60;
+  TimeRange range(3600, 3 * 3600);
+  typedef StatsTimeSeries ST;
+  map<ST::StatsTimeSeriesType, function<double(PointCollection::pvRange)> > brute({
+    {ST::StatsTimeSeriesMean,   [](PointCollection::pvRange r){ return PointCollection::mean(r); }},
+    {ST::StatsTimeSeriesStdDev, [](PointCollection::pvRange r){ return sqrt(PointCollection::variance(r)); }},
+    {ST::StatsTimeSeriesMedian, [](PointCollection::pvRange r){ return PointCollection::percentile(.5, r); }},
+    {ST::StatsTimeSeriesIQR,    [](PointCollection::pvRange r){ return PointCollection::interquartilerange(r); }},
+    {ST::StatsTimeSeriesMax,    [](PointCollection::pvRange r){ return PointCollection::max(r); }},
+    {ST::StatsTimeSeriesMin,    [](PointCollection::pvRange r){ return PointCollection::min(r); }},
+    {ST::StatsTimeSeriesCount,  [](PointCollection::pvRange r){ return (double)PointCollection::count(r); }},
+    {ST::StatsTimeSeriesPercentile, [](PointCollection::pvRange r){ return PointCollection::percentile(.9, r); }},
+  });
+  
+  for (auto& b : brute) {
+    StatsTimeSeries::_sp stats(new StatsTimeSeries);
+    stats->setSource(ts);
+    stats->setWindow(Clock::_sp(new Clock(w)));
+    stats->setSamplingMode(BaseStatsTimeSeries::StatsSamplingModeLagging);
+    stats->setClock(Clock::_sp(new Clock(300)));
+    stats->setStatsType(b.first);
+    stats->setArbitraryPercentile(.9);
+    
+    auto points = stats->points(range);
+    BOOST_CHECK_EQUAL(points.size(), 25);
+    for (const Point& p : points) {
+      PointCollection window = ts->pointCollection(TimeRange(p.time - w, p.time));
+      BOOST_CHECK_CLOSE(p.value, b.second(window.raw()), 1e-6);
+    }
+  }
+  
+  // windows wider than RTX_SLIDING_WINDOW_TREE_SIZE keep their order in a tree
+  TimeSeries::_sp dense(new TimeSeries("dense", RTX_GALLON_PER_MINUTE));
+  dense->setRecord(buffer);
+  vector<Point> densePts;
+  for (time_t t = 1; t <= 3 * 3600; ++t) {
+    densePts.push_back(Point(t, (double)((t * 7919) % 1000)));
+  }
+  dense->insertPoints(densePts);
+  time_t wide = 2 * 3600;
+  BOOST_REQUIRE(wide > RTX_SLIDING_WINDOW_TREE_SIZE);
+  for (auto type : {ST::StatsTimeSeriesMedian, ST::StatsTimeSeriesIQR, ST::StatsTimeSeriesPercentile}) {
+    StatsTimeSeries::_sp stats(new StatsTimeSeries);
+    stats->setSource(dense);
+    stats->setWindow(Clock::_sp(new Clock(wide)));
+    stats->setSamplingMode(BaseStatsTimeSeries::StatsSamplingModeLagging);
+    stats->setClock(Clock::_sp(new Clock(600)));
+    stats->setStatsType(type);
+    stats->setArbitraryPercentile(.9);
+    
+    auto points = stats->points(TimeRange(wide + 600, 3 * 3600));
+    BOOST_CHECK_EQUAL(points.size(), 6);
+    for (const Point& p : points) {
+      PointCollection window = dense->pointCollection(TimeRange(p.time - wide, p.time));
+      BOOST_CHECK_CLOSE(p.value, brute.at(type)(window.raw()), 1e-6);
+    }
+  }
+  
+  // centered 5-point moving average
+  MovingAverage::_sp ma(new MovingAverage);
+  ma->setSource(ts);
+  ma->setWindowSize(5);
+  auto averaged = ma->points(range);
+  BOOST_CHECK(!averaged.empty());
+  for (const Point& p : averaged) {
+    auto it = lower_bound(pts.begin(), pts.end(), p.time, [](const Point& a, time_t t){ return a.time < t; });
+    double sum = 0;
+    for (auto j = it - 2; j <= it + 2; ++j) {
+      sum += j->value;
+    }
+    BOOST_CHECK_CLOSE(p.value, sum / 5., 1e-9);
+    BOOST_CHECK(p.hasQual(Point::rtx_averaged));
+  }
+}
+
+
+BOOST_AUTO_TEST_CASE(correlator_lags) {
+  
+  // the secondary trails the primary by ten minutes; the correlator should find that lag
+  BufferPointRecord::_sp buffer(new BufferPointRecord);
+  TimeSeries::_sp primary(new TimeSeries("primary", RTX_GALLON_PER_MINUTE));
+  TimeSeries::_sp delayed(new TimeSeries("delayed", RTX_GALLON_PER_MINUTE));
+  primary->setRecord(buffer);
+  delayed->setRecord(buffer);
+  vector<Point> p1, p2;
+  for (time_t t = 0; t <= 12*3600; t += 60) {
+    p1.push_back(Point(t, 10. + sin((double)t / 1000.) + 0.5 * sin((double)t / 170.)));
+    p2.push_back(Point(t, 20. + 2. * (sin((double)(t - 600) / 1000.) + 0.5 * sin((double)(t - 600) / 170.))));
+  }
+  primary->insertPoints(p1);
+  delayed->insertPoints(p2);
+  
+  CorrelatorTimeSeries::_sp corr(new CorrelatorTimeSeries);
+  corr->setSource(primary);
+  corr->setSecondary(delayed);
+  corr->setCorrelationWindow(Clock::_sp(new Clock(3600)));
+  corr->setLagSeconds(1800);
+  corr->setClock(Clock::_sp(new Clock(900)));
+  
+  auto points = corr->points(TimeRange(4*3600, 8*3600));
+  BOOST_CHECK_EQUAL(points.size(), 17);
+  for (const Point& p : points) {
+    BOOST_CHECK_CLOSE(p.value, 1., 1e-6);
+    BOOST_CHECK_EQUAL(p.confidence, 600.);
+  }
+  
+  auto curve = corr->lagCurve(6*3600);
+  BOOST_CHECK_EQUAL(curve.size(), 61); // -30 ... 30 minutes
+  BOOST_CHECK_CLOSE(curve.at(600), 1., 1e-6);
+  BOOST_CHECK(curve.at(0) < curve.at(600));
+}
+
+
+BOOST_AUTO_TEST_CASE(lowess_sorted) {
+  
+  // the sorted-window engine should reproduce the reference lowess over each window
+  BufferPointRecord::_sp buffer(new BufferPointRecord);
+  TimeSeries::_sp ts(new TimeSeries("raw", RTX_GALLON_PER_MINUTE));
+  ts->setRecord(buffer);
+  vector<Point> pts;
+  for (time_t t = 1599999600; t <= 1599999600 + 6*3600; t += 60) {
+    double spike = (t % 1300 == 0) ? 25. : 0.; // a few outliers for the robustness passes
+    pts.push_back(Point(t, 50. + 5. * sin((double)t / 2000.) + (double)(t % 7) / 3. + spike));
+  }
+  ts->insertPoints(pts);
+  
+  time_t w = 3600;
+  TimeSeriesLowess::_sp lowess(new TimeSeriesLowess);
+  lowess->setSource(ts);
+  lowess->setWindow(Clock::_sp(new Clock(w)));
+  lowess->setSamplingMode(BaseStatsTimeSeries::StatsSamplingModeCentered);
+  lowess->setClock(Clock::_sp(new Clock(600)));
+  lowess->setFraction(0.5);
+  
+  TimeRange range(1599999600 + 3600, 1599999600 + 5*3600);
+  auto points = lowess->points(range);
+  BOOST_CHECK_EQUAL(points.size(), 25);
+  for (const Point& p : points) {
+    auto window = ts->pointCollection(TimeRange(p.time - w/2, p.time + w/2)).points();
+    vector<double> x, y;
+    for (const Point& wp : window) {
+      x.push_back((double)(wp.time - window.front().time));
+      y.push_back(wp.value);
+    }
+    vector<double> out(x.size()), tmp1(x.size()), tmp2(x.size());
+    CppLowess::TemplatedLowess<vector<double>, double>().lowess(x, y, 0.5, 2, 0., out, tmp1, tmp2);
+    size_t i = (size_t)(p.time - window.front().time) / 60;
+    BOOST_CHECK_CLOSE(p.value, out[i], 1e-8);
+  }
+  
+  // fitting on a coarser grid trades a little accuracy for speed
+  lowess->setDelta(300);
+  auto coarse = lowess->points(range);
+  BOOST_CHECK_EQUAL(coarse.size(), points.size());
+  for (size_t i = 0; i < coarse.size(); ++i) {
+    BOOST_CHECK_SMALL(coarse[i].value - points[i].value, 0.5);
+  }
+}
+
+
+BOOST_AUTO_TEST_CASE(memoized_ranges) {
+  
+  // counts how often the base class has to go upstream
+  class CountingFilter : public TimeSeriesFilter {
+  public:
+    int lookups = 0, computes = 0;
+    TimeList timeValuesInRange(TimeRange range) { ++lookups; return TimeSeriesFilter::timeValuesInRange(range); };
+    PointCollection filterPointsInRange(TimeRange range) { ++computes; return TimeSeriesFilter::filterPointsInRange(range); };
+  };
   
+  TimeSeries::_sp ts(new TimeSeries("raw", RTX_GALLON_PER_MINUTE));
+  ts->setRecord(BufferPointRecord::_sp(new BufferPointRecord));
+  vector<Point> pts;
+  for (time_t t = 0; t <= 3000; t += 60) {
+    pts.push_back(Point(t, (double)t));
+  }
+  ts->insertPoints(pts);
+  
+  shared_ptr<CountingFilter> f(new CountingFilter);
+  f->setRecord(BufferPointRecord::_sp(new BufferPointRecord));
+  f->setSource(ts);
+  AggregatorTimeSeries::_sp agg(new AggregatorTimeSeries);
+  agg->addSource(f);
+  
+  TimeRange range(600, 3600);
+  auto first = f->points(range);
+  BOOST_CHECK_EQUAL(first.size(), 41);
+  BOOST_CHECK_EQUAL(f->computes, 1);
+  
+  // repeats, and anything inside, are answered without asking upstream
+  int lookups = f->lookups;
+  BOOST_CHECK_EQUAL(f->points(range).size(), first.size());
+  BOOST_CHECK_EQUAL(f->points(TimeRange(1200, 2400)).size(), 21);
+  BOOST_CHECK_EQUAL(f->lookups, lookups);
+  BOOST_CHECK_EQUAL(f->computes, 1);
+  
+  // a change at the root moves every downstream version and retires the memo
+  uint64_t fv = f->version(), av = agg->version();
+  ts->insertPoints(vector<Point>({Point(3000, 3000.), Point(3060, 1.), Point(3120, 2.)})); // overlap, so the buffer appends
+  BOOST_CHECK(f->version() > fv);
+  BOOST_CHECK(agg->version() > av);
+  BOOST_CHECK_EQUAL(f->points(range).size(), 43);
+  BOOST_CHECK_EQUAL(f->computes, 2);
+  
+  // an invalid range answers nothing, and must not be remembered as covering the valid ranges inside it
+  shared_ptr<CountingFilter> g(new CountingFilter);
+  g->setSource(ts);
+  BOOST_CHECK(g->points(TimeRange(0, 3600)).empty());
+  BOOST_CHECK_EQUAL(g->points(TimeRange(1200, 2400)).size(), 21);
 }
 
+BOOST_AUTO_TEST_CASE(memoized_clock) {
+  
+  TimeSeries::_sp ts(new TimeSeries("raw", RTX_GALLON_PER_MINUTE));
+  ts->setRecord(BufferPointRecord::_sp(new BufferPointRecord));
+  vector<Point> pts;
+  for (time_t t = 0; t <= 4000; t += 60) {
+    pts.push_back(Point(t, (double)t));
+  }
+  ts->insertPoints(pts);
+  
+  // the clock is shared, as the model shares its master clock with every dma demand
+  Clock::_sp clock(new Clock(300, 0));
+  TimeSeriesFilter::_sp f(new TimeSeriesFilter);
+  f->setRecord(BufferPointRecord::_sp(new BufferPointRecord));
+  f->setSource(ts);
+  f->setClock(clock);
+  TimeSeriesFilter::_sp g(new TimeSeriesFilter);
+  g->setSource(f);
+  
+  TimeRange range(600, 3600);
+  auto first = f->points(range);
+  BOOST_CHECK_EQUAL(first.size(), 11);
+  BOOST_CHECK_EQUAL(first.front().time, 600);
+  BOOST_CHECK_EQUAL(g->points(range).size(), 11);
+  
+  // re-anchoring the clock moves no data version, but the grid remembered for this range is gone
+  uint64_t v = f->version();
+  clock->setStart(60);
+  BOOST_CHECK_EQUAL(f->version(), v);
+  auto moved = f->points(range);
+  BOOST_CHECK_EQUAL(moved.size(), 10);
+  BOOST_CHECK_EQUAL(moved.front().time, 660);
+  BOOST_CHECK_EQUAL(moved.back().time, 3360);
+  // downstream of the clock, too
+  auto below = g->points(range);
+  BOOST_REQUIRE_EQUAL(below.size(), 10);
+  BOOST_CHECK_EQUAL(below.front().time, 660);
+}
+
+BOOST_AUTO_TEST_CASE(version_diamond) {
+  
+  // each level sums both series of the level above. a naive walk bumps the bottom 2^levels times.
+  TimeSeries::_sp top(new TimeSeries("top", RTX_GALLON_PER_MINUTE));
+  vector<TimeSeries::_sp> level({top, top});
+  const int levels = 40;
+  for (int i = 0; i < levels; ++i) {
+    vector<TimeSeries::_sp> next;
+    for (int j = 0; j < 2; ++j) {
+      AggregatorTimeSeries::_sp agg(new AggregatorTimeSeries);
+      agg->addSource(level[0]);
+      agg->addSource(level[1]);
+      next.push_back(agg);
+    }
+    level = next;
+  }
+  
+  uint64_t v = level[0]->version();
+  top->bumpVersion();
+  BOOST_CHECK_EQUAL(level[0]->version(), v + 1);
+}
+
+
+
+BOOST_AUTO_TEST_CASE(shared_graph_reads) {
+  
+  // scenario clones read one input graph from many threads; they must see what one thread would
+  auto makeGraph = []() {
+    BufferPointRecord::_sp buffer(new BufferPointRecord);
+    AggregatorTimeSeries::_sp agg(new AggregatorTimeSeries);
+    agg->setUnits(RTX_GALLON_PER_MINUTE);
+    agg->setClock(Clock::_sp(new Clock(60)));
+    for (int i = 0; i < 4; ++i) {
+      TimeSeries::_sp ts(new TimeSeries("leaf " + to_string(i), RTX_GALLON_PER_MINUTE));
+      ts->setRecord(buffer);
+      vector<Point> pts;
+      for (time_t t = 0; t <= 86400; t += 30) {
+        pts.push_back(Point(t, (double)(i + t % 7)));
+      }
+      ts->insertPoints(pts);
+      agg->addSource(ts);
+    }
+    MovingAverage::_sp ma(new MovingAverage);
+    ma->setSource(agg);
+    StatsTimeSeries::_sp stats(new StatsTimeSeries);
+    stats->setSource(ma);
+    stats->setWindow(Clock::_sp(new Clock(600)));
+    stats->setClock(Clock::_sp(new Clock(300)));
+    stats->setStatsType(StatsTimeSeries::StatsTimeSeriesMedian);
+    return stats;
+  };
+  
+  TimeSeries::_sp shared = makeGraph();
+  vector<thread> readers;
+  vector<size_t> counts(8);
+  for (size_t k = 0; k < counts.size(); ++k) {
+    readers.emplace_back([&, k]() {
+      for (int r = 0; r < 10; ++r) {
+        time_t start = 3600 + (k * 1800 + r * 900) % 72000; // overlapping windows, different orders
+        counts[k] += shared->points(TimeRange(start, start + 3600)).size();
+      }
+    });
+  }
+  for (auto& t : readers) {
+    t.join();
+  }
+  for (size_t n : counts) {
+    BOOST_CHECK_EQUAL(n, 10 * 13);
+  }
+  
+  TimeRange all(3600, 80000);
+  auto expected = makeGraph()->points(all);
+  auto actual = shared->points(all);
+  BOOST_REQUIRE_EQUAL(actual.size(), expected.size());
+  for (size_t i = 0; i < actual.size(); ++i) {
+    BOOST_CHECK_EQUAL(actual[i].time, expected[i].time);
+    BOOST_CHECK_CLOSE(actual[i].value, expected[i].value, 1e-9);
+  }
+}
+
+BOOST_AUTO_TEST_CASE(query_planner) {
+  
+  // roots are found through every kind of filter, de-duplicated, and grouped by record
+  BufferPointRecord::_sp recA(new BufferPointRecord), recB(new BufferPointRecord);
+  TimeSeries::_sp a1(new TimeSeries("a1", RTX_GALLON_PER_MINUTE)), a2(new TimeSeries("a2", RTX_GALLON_PER_MINUTE)), b1(new TimeSeries("b1", RTX_GALLON_PER_MINUTE));
+  a1->setRecord(recA);
+  a2->setRecord(recA);
+  b1->setRecord(recB);
+  
+  TimeSeriesFilter::_sp f(new TimeSeriesFilter);
+  f->setSource(a1);
+  AggregatorTimeSeries::_sp agg(new AggregatorTimeSeries);
+  agg->addSource(f);
+  agg->addSource(a2);
+  agg->addSource(b1);
+  
+  QueryPlanner planner;
+  planner.addSeries(agg);
+  planner.addSeries(f);
+  planner.addSeries(TimeSeries::_sp());
+  auto plan = planner.plan();
+  BOOST_CHECK_EQUAL(plan.size(), 2);
+  BOOST_CHECK(plan[recA] == set<string>({"a1", "a2"}));
+  BOOST_CHECK(plan[recB] == set<string>({"b1"}));
+  
+  planner.prepare(TimeRange(0, 3600)); // nothing database-backed, so nothing to do
+  planner.clear();
+  BOOST_CHECK(planner.empty());
+}
+
+
 
 BOOST_AUTO_TEST_SUITE_END()
 // filters
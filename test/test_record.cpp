@@ -1,5 +1,14 @@
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+
 #include "test_main.h"
 #include "ConcreteDbRecords.h"
+#include "SqliteAdapter.h"
 #include "Units.h"
 
 using namespace RTX;
@@ -28,6 +37,565 @@ BOOST_AUTO_TEST_CASE(record_basic) {
   BOOST_CHECK_EQUAL(record->connectionString(), connection);
 }
 
+BOOST_AUTO_TEST_CASE(record_snapshot) {
+  
+  PointRecord::_sp record(new BufferPointRecord);
+  record->registerAndGetIdentifierForSeriesWithUnits("a", Units::unitOfType("ft"));
+  record->registerAndGetIdentifierForSeriesWithUnits("b", Units::unitOfType("gpm"));
+  
+  auto ha = record->handleForIdentifier("a");
+  auto hb = record->handleForIdentifier("b");
+  BOOST_TEST(ha != hb);
+  BOOST_CHECK_EQUAL(record->handleForIdentifier("a"), ha); // stable
+  BOOST_CHECK_EQUAL(record->identifierForHandle(hb), "b");
+  
+  record->addSnapshot(1000, {ha, hb}, {1.5, 2.5});
+  BOOST_CHECK_EQUAL(record->point("a", 1000).value, 1.5);
+  BOOST_CHECK_EQUAL(record->point("b", 1000).value, 2.5);
+  BOOST_TEST(!record->point("a", 999).isValid);
+  
+  // buffered points are found in the buffer, the snapshot's still in the single-point cache
+  record->addPoints("a", {Point(2000, 3.5), Point(2100, 4.5)});
+  BOOST_CHECK_EQUAL(record->point("a", 2100).value, 4.5);
+  BOOST_CHECK_EQUAL(record->point("a", 1000).value, 1.5);
+  BOOST_TEST(!record->point("a", 2050).isValid);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_contention) {
+  
+  // one writer appending to every series while several readers query them.
+  // reports read throughput; readers must never see a torn or missing range.
+  const int nSeries = 50, nPoints = 1000, nReaders = 4, nWriterRounds = 200;
+  BufferPointRecord::_sp record(new BufferPointRecord);
+  vector<string> ids;
+  for (int i = 0; i < nSeries; ++i) {
+    ids.push_back("s" + to_string(i));
+    record->registerAndGetIdentifierForSeriesWithUnits(ids.back(), RTX_METER);
+    vector<Point> pts;
+    for (int t = 1; t <= nPoints; ++t) {
+      pts.push_back(Point(t, (double)t));
+    }
+    record->addPoints(ids.back(), pts);
+  }
+  
+  atomic<bool> done(false);
+  atomic<long> reads(0), failures(0);
+  auto reader = [&](int seed) {
+    long n = 0;
+    int i = seed;
+    while (!done) {
+      const string& id = ids[i++ % nSeries];
+      Point p = record->pointBefore(id, 600);
+      auto range = record->pointsInRange(id, TimeRange(400, 499));
+      if (!p.isValid || p.value != 599 || range.size() != 100) {
+        ++failures;
+      }
+      n += 2;
+    }
+    reads += n;
+  };
+  
+  vector<thread> readers;
+  auto t1 = chrono::steady_clock::now();
+  for (int r = 0; r < nReaders; ++r) {
+    readers.push_back(thread(reader, r));
+  }
+  for (int round = 0; round < nWriterRounds; ++round) {
+    for (const auto& id : ids) {
+      time_t t = nPoints + round + 1;
+      // overlap the last buffered point so the append is contiguous
+      record->addPoints(id, {Point(t - 1, (double)(t - 1)), Point(t, (double)t)});
+    }
+  }
+  done = true;
+  for (auto& t : readers) {
+    t.join();
+  }
+  double elapsed = chrono::duration<double>(chrono::steady_clock::now() - t1).count();
+  
+  BOOST_TEST_MESSAGE("buffer contention: " << reads << " reads by " << nReaders << " threads in " << elapsed << " s (" << (reads / elapsed) << " reads/s) against " << (nSeries * nWriterRounds) << " writes");
+  BOOST_CHECK_EQUAL(failures.load(), 0);
+  BOOST_CHECK_EQUAL(record->lastPoint(ids.front()).time, nPoints + nWriterRounds);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_view) {
+  
+  BufferPointRecord::_sp record(new BufferPointRecord(10));
+  record->registerAndGetIdentifierForSeriesWithUnits("v", RTX_METER);
+  vector<Point> pts;
+  for (int t = 1; t <= 10; ++t) {
+    pts.push_back(Point(t * 10, (double)t));
+  }
+  record->addPoints("v", pts);
+  
+  auto view = record->pointsView("v", TimeRange(25, 55));
+  BOOST_REQUIRE_EQUAL(view.size(), 3);
+  BOOST_CHECK_EQUAL(view.times()[0], 30);
+  BOOST_CHECK_EQUAL(view.values()[2], 5);
+  BOOST_CHECK_EQUAL(record->pointBefore("v", 55).time, 50);
+  BOOST_CHECK_EQUAL(record->pointAfter("v", 55).time, 60);
+  
+  // appending beyond capacity drops the oldest points; the view keeps its own copy
+  record->addPoints("v", {Point(100, 10.), Point(110, 11.), Point(120, 12.)});
+  BOOST_CHECK_EQUAL(record->range("v").start, 30);
+  BOOST_CHECK_EQUAL(record->range("v").end, 120);
+  BOOST_CHECK_EQUAL(view[0].value, 3);
+  BOOST_TEST(record->pointsView("v", TimeRange(0, 25)).empty());
+}
+
+BOOST_AUTO_TEST_CASE(buffer_trim) {
+  
+  BufferPointRecord::_sp record(new BufferPointRecord(100));
+  record->registerAndGetIdentifierForSeriesWithUnits("v", RTX_METER);
+  vector<Point> pts;
+  for (int t = 1; t <= 10; ++t) {
+    pts.push_back(Point(t * 10, (double)t));
+  }
+  record->addPoints("v", pts);
+  
+  // the point in effect at the trim time survives, so "at or before" still answers from the buffer
+  record->trimBefore("v", 55);
+  BOOST_CHECK_EQUAL(record->range("v").start, 50);
+  BOOST_CHECK_EQUAL(record->pointBefore("v", 56).value, 5);
+  BOOST_CHECK_EQUAL(record->pointsInRange("v", TimeRange(0, 100)).size(), 6);
+  
+  // still contiguous, so appending works as before
+  record->addPoints("v", {Point(100, 10.), Point(110, 11.)});
+  BOOST_CHECK_EQUAL(record->range("v").end, 110);
+  record->trimBefore("v", 0);
+  BOOST_CHECK_EQUAL(record->range("v").start, 50);
+}
+
+// an in-memory database that counts the range queries it answers
+class CountingAdapter : public DbAdapter {
+public:
+  map<string, vector<Point> > data;
+  atomic<int> rangeQueries{0};
+  atomic<int> batchQueries{0};
+  atomic<int> failures{0}; // range queries that fail before any succeed
+  
+  // hold() parks every range query until release(), so a test can line readers up behind a fetch in flight
+  void hold() { lock_guard<mutex> lock(_gateMtx); _held = true; };
+  void release() {
+    {
+      lock_guard<mutex> lock(_gateMtx);
+      _held = false;
+    }
+    _gateCv.notify_all();
+  };
+  void waitForQueries(size_t n) {
+    unique_lock<mutex> lock(_gateMtx);
+    _gateCv.wait(lock, [&]{ return _ranges.size() >= n; });
+  };
+  vector<TimeRange> queriedRanges() { lock_guard<mutex> lock(_gateMtx); return _ranges; };
+  
+  CountingAdapter() : DbAdapter([](const std::string){}) { _connected = true; };
+  const adapterOptions options() const { return {false, false, false, true, false, false}; };
+  string connectionString() { return "counting"; };
+  void setConnectionString(const string& con) { };
+  void doConnect() { _connected = true; };
+  IdentifierUnitsList idUnitsList() { return _ids; };
+  void beginTransaction() { };
+  void endTransaction() { };
+  vector<Point> selectRange(const string& id, TimeRange range) {
+    ++rangeQueries;
+    {
+      unique_lock<mutex> lock(_gateMtx);
+      _ranges.push_back(range);
+      _gateCv.notify_all();
+      _gateCv.wait(lock, [&]{ return !_held; });
+    }
+    if (failures > 0) {
+      --failures;
+      throw runtime_error("connection refused");
+    }
+    vector<Point> out;
+    for (const Point& p : data[id]) {
+      if (range.contains(p.time)) {
+        out.push_back(p);
+      }
+    }
+    return out;
+  };
+  map<string, vector<Point> > selectRanges(const vector<string>& ids, TimeRange range) {
+    ++batchQueries;
+    return DbAdapter::selectRanges(ids, range);
+  };
+  Point selectNext(const string& id, time_t time, WhereClause q) {
+    for (const Point& p : data[id]) {
+      if (p.time > time) {
+        return p;
+      }
+    }
+    return Point();
+  };
+  Point selectPrevious(const string& id, time_t time, WhereClause q) {
+    Point found;
+    for (const Point& p : data[id]) {
+      if (p.time < time) {
+        found = p;
+      }
+    }
+    return found;
+  };
+  bool insertIdentifierAndUnits(const string& id, Units units) { _ids.set(id, units); return true; };
+  void insertSingle(const string& id, Point point) { this->insertRange(id, {point}); };
+  void insertRange(const string& id, vector<Point> points) {
+    auto& v = data[id];
+    v.insert(v.end(), points.begin(), points.end());
+    sort(v.begin(), v.end(), &Point::comparePointTime);
+  };
+  bool assignUnitsToRecord(const string& name, const Units& units) { return true; };
+  void removeRecord(const string& id) { data.erase(id); };
+  void removeAllRecords() { data.clear(); };
+  size_t snapshotIdCount() { return _snapshotIds.size(); };
+private:
+  IdentifierUnitsList _ids;
+  mutex _gateMtx;
+  condition_variable _gateCv;
+  bool _held = false;
+  vector<TimeRange> _ranges;
+};
+
+class CountingDbRecord : public DbPointRecord {
+public:
+  CountingDbRecord(CountingAdapter* adapter) { _adapter = adapter; };
+  time_t now = 0; // coverage ages by this clock, if set
+protected:
+  time_t coverageNow() { return now ? now : DbPointRecord::coverageNow(); };
+};
+
+BOOST_AUTO_TEST_CASE(db_coverage) {
+  
+  CountingAdapter adapter;
+  DbPointRecord::_sp record(new CountingDbRecord(&adapter));
+  record->registerAndGetIdentifierForSeriesWithUnits("status", RTX_DIMENSIONLESS);
+  record->registerAndGetIdentifierForSeriesWithUnits("flow", RTX_GALLON_PER_MINUTE);
+  
+  // a report-by-exception tag: two points, days apart, long settled
+  const time_t t0 = 1000000000;
+  adapter.insertRange("status", {Point(t0, 1.), Point(t0 + 3*86400, 0.)});
+  adapter.insertRange("flow", {Point(t0 + 3600, 5.), Point(t0 + 7200, 6.)});
+  
+  // empty answers are remembered
+  BOOST_TEST(record->pointsInRange("status", TimeRange(t0 + 3600, t0 + 7200)).empty());
+  BOOST_TEST(record->pointsInRange("status", TimeRange(t0 + 3600, t0 + 7200)).empty());
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 1);
+  
+  // a wider request only fetches what it adds
+  BOOST_TEST(record->pointsInRange("status", TimeRange(t0 + 3600, t0 + 10800)).empty());
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 2);
+  
+  // other series in between don't disturb it
+  BOOST_CHECK_EQUAL(record->pointsInRange("flow", TimeRange(t0, t0 + 10800)).size(), 2);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 3);
+  auto pts = record->pointsInRange("status", TimeRange(t0, t0 + 10800));
+  BOOST_REQUIRE_EQUAL(pts.size(), 1);
+  BOOST_CHECK_EQUAL(pts.front().time, t0);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 4); // just [t0, t0 + 3599]
+  
+  // once warm, nothing goes back to the db
+  for (time_t t = t0; t < t0 + 10800; t += 900) {
+    record->pointsInRange("status", TimeRange(t, t + 900));
+    record->pointsInRange("flow", TimeRange(t, t + 900));
+  }
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 4);
+  BOOST_CHECK_EQUAL(record->pointsInRange("status", TimeRange(t0, t0 + 4*86400)).size(), 2);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 5);
+  
+  // a write inside the buffered run goes into it, and its time stays covered
+  record->addPoint("status", Point(t0 + 5400, 1.));
+  BOOST_CHECK_EQUAL(record->pointsInRange("status", TimeRange(t0, t0 + 10800)).size(), 2);
+  BOOST_CHECK_EQUAL(record->pointsInRange("status", TimeRange(t0, t0 + 10800)).back().time, t0 + 5400);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 5);
+  
+  // a write past the run is only in the db, so its time is fetched once more
+  record->addPoint("status", Point(t0 + 3*86400 + 3600, 0.));
+  BOOST_CHECK_EQUAL(record->pointsInRange("status", TimeRange(t0, t0 + 4*86400)).size(), 4);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 6);
+  BOOST_CHECK_EQUAL(record->pointsInRange("status", TimeRange(t0, t0 + 4*86400)).size(), 4);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 6);
+  
+  // recent data may still be arriving, so with no ttl it is always re-fetched
+  record->setRecentCoverageTtl(0);
+  time_t now = time(NULL);
+  record->pointsInRange("status", TimeRange(now - 600, now));
+  record->pointsInRange("status", TimeRange(now - 600, now));
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 8);
+}
+
+BOOST_AUTO_TEST_CASE(db_recent_coverage) {
+  
+  CountingAdapter adapter;
+  CountingDbRecord* counting = new CountingDbRecord(&adapter);
+  DbPointRecord::_sp record(counting);
+  record->registerAndGetIdentifierForSeriesWithUnits("status", RTX_DIMENSIONLESS);
+  record->setRecentCoverageTtl(60);
+  
+  // realtime: a report-by-exception tag, stepped at "now". every read is inside the horizon.
+  const time_t now = 1000000000;
+  counting->now = now;
+  adapter.insertRange("status", {Point(now - 7200, 1.)});
+  for (int step = 0; step < 5; ++step) {
+    BOOST_TEST(record->pointsInRange("status", TimeRange(now - 300, now)).empty());
+  }
+  counting->now = now + 59;
+  BOOST_TEST(record->pointsInRange("status", TimeRange(now - 300, now)).empty());
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 1); // the empty answer holds for the ttl...
+  
+  // ...and no longer
+  counting->now = now + 60;
+  adapter.insertRange("status", {Point(now - 60, 0.)});
+  BOOST_CHECK_EQUAL(record->pointsInRange("status", TimeRange(now - 300, now)).size(), 1);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 2);
+  
+  // the settled part of a span is still remembered for good
+  record->pointsInRange("status", TimeRange(now - 7200, now));
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 3);
+  counting->now = now + 120;
+  BOOST_CHECK_EQUAL(record->pointsInRange("status", TimeRange(now - 7200, now)).size(), 2);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 4);
+  BOOST_CHECK_EQUAL(record->pointsInRange("status", TimeRange(now - 7200, now - 3700)).size(), 1);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 4);
+}
+
+BOOST_AUTO_TEST_CASE(db_failed_fetch) {
+  
+  CountingAdapter adapter;
+  DbPointRecord::_sp record(new CountingDbRecord(&adapter));
+  record->registerAndGetIdentifierForSeriesWithUnits("level", RTX_FOOT);
+  const time_t t0 = 1000000000;
+  adapter.insertRange("level", {Point(t0, 10.), Point(t0 + 3600, 11.)});
+  
+  // a failed query answers empty, but is not remembered as "no data"
+  adapter.failures = 1;
+  BOOST_TEST(record->pointsInRange("level", TimeRange(t0, t0 + 3600)).empty());
+  BOOST_CHECK_EQUAL(record->pointsInRange("level", TimeRange(t0, t0 + 3600)).size(), 2);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 2);
+  
+  // the same goes for a failed prefetch
+  adapter.failures = 1;
+  record->willQuery(TimeRange(t0 + 7200, t0 + 10800), {"level"});
+  record->pointsInRange("level", TimeRange(t0 + 7200, t0 + 10800));
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 4);
+  record->pointsInRange("level", TimeRange(t0 + 7200, t0 + 10800));
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 4);
+}
+
+BOOST_AUTO_TEST_CASE(db_reregister) {
+  
+  CountingAdapter adapter;
+  DbPointRecord::_sp record(new CountingDbRecord(&adapter));
+  record->registerAndGetIdentifierForSeriesWithUnits("flow", RTX_GALLON_PER_MINUTE);
+  const time_t t0 = 1000000000;
+  adapter.insertRange("flow", {Point(t0, 5.), Point(t0 + 3600, 6.)});
+  BOOST_CHECK_EQUAL(record->pointsInRange("flow", TimeRange(t0, t0 + 3600)).size(), 2);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 1);
+  
+  // other units publish a fresh, empty buffer. what was covered in the old one has to be fetched again.
+  record->registerAndGetIdentifierForSeriesWithUnits("flow", RTX_LITER_PER_SECOND);
+  BOOST_CHECK_EQUAL(record->pointsInRange("flow", TimeRange(t0, t0 + 3600)).size(), 2);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 2);
+  BOOST_CHECK_EQUAL(record->pointsInRange("flow", TimeRange(t0, t0 + 3600)).size(), 2);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 2);
+}
+
+BOOST_AUTO_TEST_CASE(db_snapshot_handles) {
+  
+  CountingAdapter adapter;
+  DbPointRecord::_sp record(new CountingDbRecord(&adapter));
+  vector<PointRecord::seriesHandle_t> handles;
+  for (string id : {"a", "b"}) {
+    record->registerAndGetIdentifierForSeriesWithUnits(id, RTX_FOOT);
+    handles.push_back(record->handleForIdentifier(id));
+  }
+  
+  // a long-running process registers over and over. each series still has one adapter handle.
+  const time_t t0 = 1000000000;
+  for (int i = 0; i < 10; ++i) {
+    record->registerAndGetIdentifierForSeriesWithUnits("a", RTX_FOOT);
+    record->registerAndGetIdentifierForSeriesWithUnits("c" + to_string(i), RTX_FOOT);
+    record->addSnapshot(t0 + i, handles, {(double)i, (double)-i});
+  }
+  BOOST_CHECK_EQUAL(adapter.snapshotIdCount(), 2);
+  BOOST_CHECK_EQUAL(adapter.data["a"].size(), 10);
+  BOOST_CHECK_EQUAL(adapter.data["b"].back().value, -9);
+}
+
+BOOST_AUTO_TEST_CASE(db_single_flight) {
+  
+  CountingAdapter adapter;
+  DbPointRecord::_sp record(new CountingDbRecord(&adapter));
+  record->registerAndGetIdentifierForSeriesWithUnits("pressure", RTX_PSI);
+  const time_t t0 = 1000000000;
+  vector<Point> pts;
+  for (time_t t = t0; t <= t0 + 3600; t += 60) {
+    pts.push_back(Point(t, 50.));
+  }
+  adapter.insertRange("pressure", pts);
+  
+  // several chains miss on the same root at once; one query answers them all
+  const int nReaders = 6;
+  atomic<int> wrong(0);
+  vector<thread> readers;
+  adapter.hold();
+  for (int i = 0; i < nReaders; ++i) {
+    readers.push_back(thread([&]{
+      auto got = record->pointsInRange("pressure", TimeRange(t0, t0 + 1800));
+      if (got.size() != 31) {
+        ++wrong;
+      }
+    }));
+  }
+  adapter.waitForQueries(1);
+  adapter.release();
+  for (auto& t : readers) {
+    t.join();
+  }
+  BOOST_CHECK_EQUAL(wrong, 0);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, 1);
+  BOOST_CHECK_EQUAL(record->dbFetches(), 1);
+  BOOST_CHECK_EQUAL(record->coalescedReads() + record->cacheHits(), nReaders - 1);
+  
+  record->pointsInRange("pressure", TimeRange(t0, t0 + 600));
+  BOOST_CHECK_EQUAL(record->cacheHits() + record->coalescedReads(), nReaders);
+  
+  // a read that only partly overlaps a fetch in flight waits, then fetches the rest itself. it counts once, as a fetch.
+  record->resetReadCounters();
+  adapter.hold();
+  thread first([&]{ record->pointsInRange("pressure", TimeRange(t0 + 1801, t0 + 2700)); });
+  adapter.waitForQueries(2); // the first fetch is in flight
+  size_t secondCount = 0;
+  thread second([&]{ secondCount = record->pointsInRange("pressure", TimeRange(t0 + 1801, t0 + 3600)).size(); });
+  adapter.release();
+  first.join();
+  second.join();
+  BOOST_CHECK_EQUAL(secondCount, 30);
+  BOOST_CHECK_EQUAL(record->dbFetches(), 2);
+  BOOST_CHECK_EQUAL(record->coalescedReads() + record->cacheHits(), 0);
+  auto ranges = adapter.queriedRanges();
+  BOOST_REQUIRE_EQUAL(ranges.size(), 3);
+  BOOST_CHECK_GT(ranges[2].start, t0 + 2700); // the second never asked again for what the first was fetching
+}
+
+BOOST_AUTO_TEST_CASE(db_batched_prefetch) {
+  
+  CountingAdapter adapter;
+  DbPointRecord::_sp record(new CountingDbRecord(&adapter));
+  const time_t t0 = 1000000000;
+  vector<string> ids({"level", "flow", "status"});
+  for (const string& id : ids) {
+    record->registerAndGetIdentifierForSeriesWithUnits(id, RTX_DIMENSIONLESS);
+  }
+  adapter.insertRange("level", {Point(t0 - 60, 10.), Point(t0 + 300, 11.), Point(t0 + 600, 12.)});
+  adapter.insertRange("flow", {Point(t0 + 300, 5.)});
+  adapter.insertRange("status", {Point(t0 - 86400, 1.)}); // changed a day before the window
+  
+  // one batched read for all three, not one per series
+  record->willQuery(TimeRange(t0, t0 + 900), ids);
+  BOOST_CHECK_EQUAL(adapter.batchQueries, 1);
+  BOOST_CHECK_EQUAL(record->dbFetches(), 1);
+  int queries = adapter.rangeQueries;
+  
+  // everything in the window, and the point in effect at its start, is now buffered
+  BOOST_CHECK_EQUAL(record->pointsInRange("level", TimeRange(t0, t0 + 900)).size(), 2);
+  BOOST_CHECK_EQUAL(record->pointsInRange("flow", TimeRange(t0, t0 + 900)).size(), 1);
+  BOOST_CHECK_EQUAL(record->pointBefore("level", t0 + 1).time, t0 - 60);
+  BOOST_CHECK_EQUAL(record->pointBefore("status", t0 + 1).time, t0 - 86400);
+  BOOST_CHECK(record->pointsInRange("status", TimeRange(t0 - 86400, t0 + 900)).size() == 1);
+  BOOST_CHECK_EQUAL(adapter.rangeQueries, queries);
+  
+  // warm series are skipped
+  record->willQuery(TimeRange(t0, t0 + 900), ids);
+  BOOST_CHECK_EQUAL(adapter.batchQueries, 1);
+}
+
+BOOST_AUTO_TEST_CASE(sqlite_reader_pool) {
+  
+  const string file = (std::filesystem::temp_directory_path() / "rtx-reader-pool.db").string();
+  for (string f : {file, file + "-wal", file + "-shm"}) {
+    std::remove(f.c_str());
+  }
+  {
+    SqliteAdapter adapter([](const std::string){});
+    adapter.setConnectionString(file + "?readers=2");
+    BOOST_CHECK_EQUAL(adapter.connectionString(), file + "?readers=2");
+    adapter.doConnect();
+    BOOST_REQUIRE(adapter.adapterConnected());
+    adapter.insertIdentifierAndUnits("level", RTX_FOOT);
+    adapter.insertIdentifierAndUnits("flow", RTX_GALLON_PER_MINUTE);
+    
+    const time_t t0 = 1000000000;
+    vector<Point> points;
+    for (int i = 0; i < 100; ++i) {
+      points.push_back(Point(t0 + 60 * i, (double)i));
+    }
+    adapter.insertRange("level", points);
+    adapter.insertRange("flow", points);
+    
+    // more readers than connections: they share the pool
+    atomic<int> wrong(0);
+    vector<thread> readers;
+    for (int r = 0; r < 4; ++r) {
+      readers.push_back(thread([&]{
+        for (int i = 0; i < 50; ++i) {
+          if (adapter.selectRange("level", TimeRange(t0, t0 + 60 * 200)).size() != 100) {
+            ++wrong;
+          }
+        }
+      }));
+    }
+    for (auto& t : readers) {
+      t.join();
+    }
+    BOOST_CHECK_EQUAL(wrong, 0);
+    BOOST_CHECK(adapter.selectRange("unregistered", TimeRange(t0, t0 + 60)).empty());
+    
+    // inside a write transaction, reads see what it has written so far
+    adapter.beginTransaction();
+    adapter.insertSingle("level", Point(t0 + 60 * 100, 100.));
+    BOOST_CHECK_EQUAL(adapter.selectRange("level", TimeRange(t0, t0 + 60 * 200)).size(), 101);
+    BOOST_CHECK_EQUAL(adapter.selectRanges({"level", "flow"}, TimeRange(t0, t0 + 60 * 200))["level"].size(), 101);
+    // series it hasn't written are read from the pool meanwhile, and see the last commit
+    size_t flowCount = 0;
+    thread([&]{ flowCount = adapter.selectRange("flow", TimeRange(t0, t0 + 60 * 200)).size(); }).join();
+    BOOST_CHECK_EQUAL(flowCount, 100);
+    adapter.endTransaction();
+    BOOST_CHECK_EQUAL(adapter.selectRange("level", TimeRange(t0, t0 + 60 * 200)).size(), 101);
+  }
+  for (string f : {file, file + "-wal", file + "-shm"}) {
+    std::remove(f.c_str());
+  }
+}
+
+BOOST_AUTO_TEST_CASE(sqlite_read_in_transaction) {
+  
+  const string file = (std::filesystem::temp_directory_path() / "rtx-read-in-transaction.db").string();
+  for (string f : {file, file + "-wal", file + "-shm"}) {
+    std::remove(f.c_str());
+  }
+  {
+    SqlitePointRecord::_sp record(new SqlitePointRecord);
+    record->setConnectionString(file + "?readers=2");
+    record->registerAndGetIdentifierForSeriesWithUnits("level", RTX_FOOT);
+    auto h = record->handleForIdentifier("level");
+    const time_t t0 = 1000000000;
+    
+    // a hindcast writes old times inside one long transaction, and may read them back before it commits.
+    // the span is older than the coverage horizon, so whatever the read returns is remembered.
+    record->beginBulkOperation();
+    for (int i = 0; i < 10; ++i) {
+      record->addSnapshot(t0 + 60 * i, {h}, {(double)i});
+    }
+    BOOST_CHECK_EQUAL(record->pointsInRange("level", TimeRange(t0, t0 + 540)).size(), 10);
+    record->endBulkOperation();
+    BOOST_CHECK_EQUAL(record->pointsInRange("level", TimeRange(t0, t0 + 540)).size(), 10);
+  }
+  for (string f : {file, file + "-wal", file + "-shm"}) {
+    std::remove(f.c_str());
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END()
 // record
 /////////////////////////